@@ -27,6 +27,93 @@ SFHASH_Hashset* sfhash_load_hashset(
   SFHASH_Error** err
 );
 
+/*
+ * Options for opening a hashset
+ */
+typedef enum {
+  // Read the whole file in when mapping it (MAP_POPULATE)
+  SFHASH_HASHSET_OPEN_POPULATE = 1 << 0,
+  // Ask for the mapping to be backed by huge pages (MADV_HUGEPAGE)
+  SFHASH_HASHSET_OPEN_HUGEPAGES = 1 << 1,
+  // Start reading the file in ahead of use (MADV_WILLNEED)
+  SFHASH_HASHSET_OPEN_WILLNEED = 1 << 2,
+  // Do not read ahead on page faults, as lookups are random (MADV_RANDOM)
+  SFHASH_HASHSET_OPEN_RANDOM = 1 << 3,
+  // Lock the mapping into memory (mlock); fails if that is not permitted
+  SFHASH_HASHSET_OPEN_LOCK = 1 << 4,
+  // Fault in the hashes and indices used by lookups, from one thread per
+  // core, leaving the records to be read on demand
+  SFHASH_HASHSET_OPEN_PREFAULT = 1 << 5,
+  // Verify the file from one thread per core, as by sfhash_hashset_verify,
+  // and fail to open it if it is damaged
+  SFHASH_HASHSET_OPEN_VERIFY = 1 << 6
+} SFHASH_HashsetOpenFlags;
+
+/*
+ * Open a hashset file
+ *
+ * The file is mapped into memory, and unmapped when the hashset is
+ * destroyed. flags is a bitwise-or of SFHASH_HashsetOpenFlags; options
+ * which the platform does not support are ignored, except for locking.
+ * Bits which are not SFHASH_HashsetOpenFlags are an error, as is a shard
+ * or layer manifest, which its own open function takes.
+ *
+ * Returns null on error and sets err to nonnull.
+ */
+SFHASH_Hashset* sfhash_open_hashset(
+  const char* path,
+  uint32_t flags,
+  SFHASH_Error** err
+);
+
+/*
+ * Returns the time in seconds which opening a hashset spent mapping and
+ * warming the file, or 0 for a hashset loaded from memory.
+ */
+double sfhash_hashset_warm_time(const SFHASH_Hashset* hset);
+
+typedef struct {
+  // the number of bytes checked
+  uint64_t bytes;
+  // the time taken to check them, in seconds
+  double seconds;
+} SFHASH_HashsetVerifyStats;
+
+/*
+ * Verify the integrity of a hashset
+ *
+ * Hashsets built with SFHASH_HASHSET_BUILD_CHECKSUMS are checked piece by
+ * piece against their stored BLAKE3 digests, spread over up to threads
+ * threads (one per core if threads is 0). The digests cover the chunks
+ * from the FTOC up to the CSUM chunk holding them; not the magic and the
+ * SHA2-256 hash before the FTOC, nor the CSUM and FEND chunks. Others are
+ * checked against their SHA2-256 hash, which covers all of the file after
+ * that hash, from one thread.
+ *
+ * Sets err to nonnull, naming the damaged chunk if it is known, if the
+ * check fails. If stats is nonnull, it receives the amount checked and the
+ * time taken.
+ */
+void sfhash_hashset_verify(
+  const SFHASH_Hashset* hset,
+  unsigned int threads,
+  SFHASH_HashsetVerifyStats* stats,
+  SFHASH_Error** err
+);
+
+/*
+ * Verify only what lookups in hashset data index tidx read, so that the
+ * parts of a large hashset can be checked as each is first used. Hashsets
+ * without checksums can only be checked whole.
+ */
+void sfhash_hashset_verify_hashset(
+  const SFHASH_Hashset* hset,
+  size_t tidx,
+  unsigned int threads,
+  SFHASH_HashsetVerifyStats* stats,
+  SFHASH_Error** err
+);
+
 /*
  * Free a hashset
  */
@@ -83,6 +170,16 @@ bool sfhash_hashset_lookup(
   const void* hash
 );
 
+/*
+ *  Check if each of the given hashes is contained in a hashset.
+ *
+ *  hashes holds hashes_length hashes packed end to end; results[i] is set
+ *  for the ith hash. The lookups are done in groups so that their memory
+ *  accesses overlap, which makes this much faster than a sfhash_hashset_lookup
+ *  per hash for more than a handful of hashes. Large batches are looked up
+ *  as by sfhash_hashset_lookup_bulk_merge, or in groups as for small ones
+ *  if there is not the memory for that.
+ */
 void sfhash_hashset_lookup_bulk(
   const SFHASH_Hashset* hset,
   size_t tidx,
@@ -91,11 +188,129 @@ void sfhash_hashset_lookup_bulk(
   bool* results
 );
 
+/*
+ *  Check if each of the given hashes is contained in a hashset, by sorting
+ *  the hashes and merging them with the hashset's sorted hashes.
+ *
+ *  This reads the hashset sequentially rather than searching it once per
+ *  hash, which is faster when the batch is large (millions of hashes) and
+ *  not much smaller than the hashset. sfhash_hashset_lookup_bulk switches
+ *  to this by itself for such batches. It needs 16 bytes of temporary
+ *  space per hash. The work is split over up to threads threads, or one
+ *  per core if threads is 0. Compressed hashsets cannot be merged with,
+ *  and are searched as by sfhash_hashset_lookup_bulk_mt instead. If the
+ *  temporary space or the threads cannot be had, the hashes are looked up
+ *  in groups on the calling thread, as small batches are.
+ */
+void sfhash_hashset_lookup_bulk_merge(
+  const SFHASH_Hashset* hset,
+  size_t tidx,
+  const void* hashes,
+  size_t hashes_length,
+  bool* results,
+  unsigned int threads
+);
+
+/*
+ *  Check if each of the given hashes is contained in a hashset, as by
+ *  sfhash_hashset_lookup_bulk, but with the work split over up to threads
+ *  threads, or one per core if threads is 0.
+ *
+ *  The hashes are grouped by their leading byte and each thread looks up a
+ *  run of whole groups, so that each thread reads its own part of the
+ *  hashset. This needs HASH_LENGTH + 5 bytes of temporary space per hash.
+ *  Batches too small to be worth splitting, and any whose temporary space
+ *  or threads cannot be had, are looked up on the calling thread.
+ */
+void sfhash_hashset_lookup_bulk_mt(
+  const SFHASH_Hashset* hset,
+  size_t tidx,
+  const void* hashes,
+  size_t hashes_length,
+  bool* results,
+  unsigned int threads
+);
+
+/*
+ * Lookups in hashset data index tidx with their dispatch done ahead, for
+ * calling in tight loops.
+ *
+ * lookup(ctx, hash) and lookup_bulk(ctx, hashes, hashes_length, results)
+ * are as sfhash_hashset_lookup and sfhash_hashset_lookup_bulk, but call
+ * the code for the hashset's lookup strategy and hash length directly,
+ * where those find it anew on each call. Bulk lookups through a handle do
+ * not switch to merging for large batches.
+ *
+ * A handle is valid until its hashset is destroyed.
+ */
+typedef struct {
+  const void* ctx;
+  size_t hash_length;
+  bool (*lookup)(const void* ctx, const void* hash);
+  void (*lookup_bulk)(
+    const void* ctx,
+    const void* hashes,
+    size_t hashes_length,
+    bool* results
+  );
+} SFHASH_HashsetLookupHandle;
+
+SFHASH_HashsetLookupHandle sfhash_hashset_lookup_handle(
+  const SFHASH_Hashset* hset,
+  size_t tidx
+);
+
+typedef struct {
+  // the number of hashes looked up, and how many were found
+  uint64_t lookups;
+  uint64_t hits;
+  uint64_t misses;
+  // the number of comparisons with stored hashes, as counted by the
+  // searches, each reading one
+  uint64_t probes;
+  // the total and largest widths in hashes of the ranges searched after
+  // the hint, index, or filter narrowed them
+  uint64_t window_total;
+  uint64_t window_max;
+  // misses found without reading any stored hash
+  uint64_t rejections;
+} SFHASH_HashsetLookupStats;
+
+/*
+ * Turn counting of lookup stats on or off, for all hashsets.
+ *
+ * Counting is off by default. While it is on, each lookup updates counters
+ * kept per thread, which costs a few percent on bulk lookups. Returns false
+ * if the library was built with counting compiled out.
+ */
+bool sfhash_hashset_stats_enable(bool enable);
+
+/*
+ * Get the lookup stats of hashset data index tidx, summed over all threads,
+ * counted while counting was on. Merge lookups count lookups and hits only.
+ */
+void sfhash_hashset_stats(
+  const SFHASH_Hashset* hset,
+  size_t tidx,
+  SFHASH_HashsetLookupStats* stats
+);
+
+void sfhash_hashset_stats_reset(
+  const SFHASH_Hashset* hset,
+  size_t tidx
+);
+
 struct SFHASH_HashsetRecordRange {
   size_t beg;
   size_t end;
 };
 
+/*
+ *  Find the positions [beg, end) of a hash in a hashset. Each position may
+ *  be passed to sfhash_hashset_record_for_hash to get a record having the
+ *  hash. The range is empty if the hash is not in the hashset or the
+ *  hashset has no records.
+ */
 const SFHASH_HashsetRecordRange sfhash_hashset_records_lookup(
   const SFHASH_Hashset* hset,
   size_t tidx,
@@ -110,6 +325,49 @@ const SFHASH_HashsetRecord* sfhash_hashset_record_for_hash(
   size_t ridx
 );
 
+/*
+ *  Get the record with the given index in a hashset.
+ */
+const SFHASH_HashsetRecord* sfhash_hashset_record(
+  const SFHASH_Hashset* hset,
+  uint64_t record_index
+);
+
+struct SFHASH_HashsetRecordMatch {
+  size_t hash_index;      // the index of the hash in the batch
+  uint64_t record_index;  // the index of a record having that hash
+};
+
+struct SFHASH_HashsetRecordMatches;
+
+/*
+ *  Find the records for each of the given hashes. There is one match for
+ *  each record having each hash, sorted by record index, so that fetching
+ *  the records in order with sfhash_hashset_record reads them
+ *  sequentially rather than seeking all over the hashset.
+ *
+ *  Sets err to nonnull on error.
+ */
+SFHASH_HashsetRecordMatches* sfhash_hashset_records_lookup_bulk(
+  const SFHASH_Hashset* hset,
+  size_t tidx,
+  const void* hashes,
+  size_t hashes_length,
+  SFHASH_Error** err
+);
+
+size_t sfhash_hashset_record_matches_count(
+  const SFHASH_HashsetRecordMatches* matches
+);
+
+const SFHASH_HashsetRecordMatch* sfhash_hashset_record_matches(
+  const SFHASH_HashsetRecordMatches* matches
+);
+
+void sfhash_hashset_record_matches_destroy(
+  SFHASH_HashsetRecordMatches* matches
+);
+
 int sfhash_hashset_record_field_index_for_type(
   const SFHASH_Hashset* hset,
   SFHASH_HashAlgorithm htype
@@ -134,6 +392,50 @@ SFHASH_HashsetBuildCtx* sfhash_hashset_builder_open(
   SFHASH_Error** err
 );
 
+/*
+ * Optional extras for a hashset builder to write
+ */
+typedef enum {
+  // A minimal perfect hash index for each hash type, for constant-time
+  // lookup at the cost of build time and about 32 extra bits per hash
+  SFHASH_HASHSET_BUILD_PERFECT_HASH = 1 << 0,
+  // BLAKE3 digests of each chunk before the CSUM in 4 MiB pieces, so that
+  // the file can be verified in parallel or a part at a time
+  SFHASH_HASHSET_BUILD_CHECKSUMS = 1 << 1,
+  // Hashes stored without the leading bytes their position implies, for
+  // smaller files and mappings; saves a byte per hash up to 2^18 hashes,
+  // two up to 2^26, less about 1.5 bits per hash. Size hashes are not
+  // compressed. Not with SFHASH_HASHSET_BUILD_PERFECT_HASH.
+  SFHASH_HASHSET_BUILD_COMPRESSED = 1 << 2
+} SFHASH_HashsetBuildFlags;
+
+/*
+ * Set the optional extras (a bitwise-or of SFHASH_HashsetBuildFlags) for a
+ * hashset builder.
+ *
+ * Flags must be set before any records or hashes are added. Sets err to
+ * nonnull on error.
+ */
+void sfhash_hashset_builder_set_flags(
+  SFHASH_HashsetBuildCtx* bctx,
+  uint32_t flags,
+  SFHASH_Error** err
+);
+
+/*
+ * Limit the memory a hashset builder uses for sorting to about bytes.
+ *
+ * Sorts needing more are done in runs, written to the temp dir and merged
+ * back, reading and writing sequentially; so hashsets larger than memory
+ * can be built at about the speed of the disk. 0, the default, is no
+ * limit. Sets err to nonnull on error.
+ */
+void sfhash_hashset_builder_set_memory_limit(
+  SFHASH_HashsetBuildCtx* bctx,
+  uint64_t bytes,
+  SFHASH_Error** err
+);
+
 void sfhash_hashset_builder_add_record(
   SFHASH_HashsetBuildCtx* bctx,
   const void* record
@@ -145,6 +447,83 @@ void sfhash_hashset_builder_add_hash(
   size_t length
 );
 
+/*
+ * Add count records, laid out as in the builder's RDAT, in one call.
+ *
+ * The records are written in blocks, rather than a field at a time. Sets
+ * err to nonnull on error, as when a record added a hash at a time is
+ * incomplete.
+ */
+void sfhash_hashset_builder_add_records(
+  SFHASH_HashsetBuildCtx* bctx,
+  const void* records,
+  size_t count,
+  SFHASH_Error** err
+);
+
+/*
+ * Add count hashes of the given field, packed end to end, each as a record
+ * with no other hashes, in one call. Sets err to nonnull on error.
+ */
+void sfhash_hashset_builder_add_hashes(
+  SFHASH_HashsetBuildCtx* bctx,
+  size_t field,
+  const void* hashes,
+  size_t count,
+  SFHASH_Error** err
+);
+
+struct SFHASH_HashsetBuildThreadCtx;
+
+/*
+ * Open a handle for one producer thread to add records to a hashset
+ * builder.
+ *
+ * What is added through a handle is staged in a buffer of its own and
+ * passed to the builder a block of whole records at a time, so threads
+ * each with a handle need no lock of their own. Records may end up in any
+ * order, which does not matter as they are sorted when written. Every
+ * handle must be closed before sfhash_hashset_builder_write, and records
+ * must not be added through the builder itself while any is open. Sets err
+ * to nonnull on error.
+ */
+SFHASH_HashsetBuildThreadCtx* sfhash_hashset_builder_thread_open(
+  SFHASH_HashsetBuildCtx* bctx,
+  SFHASH_Error** err
+);
+
+void sfhash_hashset_builder_thread_add_record(
+  SFHASH_HashsetBuildThreadCtx* tctx,
+  const void* record
+);
+
+/*
+ * Add the hash of the next field of a record through a thread handle. A
+ * hash is either missing, with length 0, or of its field's length; a
+ * record with a hash of any other length is dropped, and reported when the
+ * handle is closed.
+ *
+ * An error adding through the handle, such as failing to write what it
+ * flushes, is also reported when the handle is closed, and nothing more is
+ * added through it after one.
+ */
+void sfhash_hashset_builder_thread_add_hash(
+  SFHASH_HashsetBuildThreadCtx* tctx,
+  const void* hash,
+  size_t length
+);
+
+/*
+ * Flush what is staged in a thread handle to its builder and destroy the
+ * handle. Sets err to nonnull on error, as when a record is incomplete or
+ * had a hash of the wrong length, or adding through the handle failed;
+ * such records are dropped, and the handle is destroyed regardless.
+ */
+void sfhash_hashset_builder_thread_close(
+  SFHASH_HashsetBuildThreadCtx* tctx,
+  SFHASH_Error** err
+);
+
 uint64_t sfhash_hashset_builder_write(
   SFHASH_HashsetBuildCtx* bctx,
   SFHASH_Error** err
@@ -188,6 +567,322 @@ SFHASH_HashsetBuildCtx* sfhash_hashset_builder_subtract_open(
   SFHASH_Error** err
 );
 
+struct SFHASH_HashsetGroup;
+
+/*
+ * Combine hashsets for finding which of them contain a hash.
+ *
+ * The hashes of each type in the hashsets are merged into one table in
+ * which each hash carries a bitmap of the hashsets containing it, so one
+ * lookup answers for every hashset. The tables are copies; the hashsets
+ * may be destroyed once this returns. Bit i of a bitmap, counting from the
+ * low bit of the first word, stands for hsets[i].
+ *
+ * Returns null on error and sets err to nonnull.
+ */
+SFHASH_HashsetGroup* sfhash_hashset_group_create(
+  const SFHASH_Hashset* const* hsets,
+  size_t hsets_length,
+  SFHASH_Error** err
+);
+
+void sfhash_hashset_group_destroy(SFHASH_HashsetGroup* grp);
+
+/*
+ * The number of uint64_t words in a membership bitmap.
+ */
+size_t sfhash_hashset_group_bitmap_words(const SFHASH_HashsetGroup* grp);
+
+/*
+ * The index of the table for a hash type, for use in group lookups, or -1
+ * if none of the hashsets have hashes of that type.
+ */
+int sfhash_hashset_group_index_for_type(
+  const SFHASH_HashsetGroup* grp,
+  SFHASH_HashAlgorithm htype
+);
+
+/*
+ * Find which hashsets in a group contain a hash.
+ *
+ * Sets the sfhash_hashset_group_bitmap_words words of members to the
+ * membership bitmap of hash, and returns whether any hashset contains it.
+ */
+bool sfhash_hashset_group_lookup(
+  const SFHASH_HashsetGroup* grp,
+  size_t tidx,
+  const void* hash,
+  uint64_t* members
+);
+
+/*
+ * Find which hashsets in a group contain each of the given hashes.
+ *
+ * hashes holds hashes_length hashes packed end to end; the bitmap for the
+ * ith hash is set at members + i * sfhash_hashset_group_bitmap_words(grp).
+ */
+void sfhash_hashset_group_lookup_bulk(
+  const SFHASH_HashsetGroup* grp,
+  size_t tidx,
+  const void* hashes,
+  size_t hashes_length,
+  uint64_t* members
+);
+
+/*
+ * Get the lookup stats of a group table, as for sfhash_hashset_stats. The
+ * rejections are the misses turned away by the group's filter or an empty
+ * slot.
+ */
+void sfhash_hashset_group_stats(
+  const SFHASH_HashsetGroup* grp,
+  size_t tidx,
+  SFHASH_HashsetLookupStats* stats
+);
+
+void sfhash_hashset_group_stats_reset(
+  const SFHASH_HashsetGroup* grp,
+  size_t tidx
+);
+
+/*
+ * A sharded hashset has its own handle, rather than being an
+ * SFHASH_Hashset, because it is not one mapped file: its shards are opened
+ * as lookups need them, and it has no records, sizes, or single header
+ * for the other hashset functions to report. Callers which opened a
+ * hashset with sfhash_open_hashset open its shard manifest with
+ * sfhash_open_hashset_shards instead, and look up with the
+ * sfhash_hashset_shards_ functions, or with the hashset functions on a
+ * shard from sfhash_hashset_shards_shard. sfhash_open_hashset fails on a
+ * shard manifest with an error saying so.
+ */
+struct SFHASH_HashsetShards;
+
+/*
+ * Split a hashset into shard_count shards by hash prefix.
+ *
+ * The leading 64 bits of hashes are split into shard_count equal ranges,
+ * and shard i, holding the hashes of every type in range i, is written to
+ * manifest_path.i.hset, beside a manifest at manifest_path listing the
+ * shards. flags is a bitwise-or of SFHASH_HashsetBuildFlags for each
+ * shard. Shards hold no records, only hashes for lookups.
+ *
+ * Sets err to nonnull on error.
+ */
+void sfhash_hashset_write_shards(
+  const SFHASH_Hashset* hset,
+  size_t shard_count,
+  const char* manifest_path,
+  const char* temp_dir,
+  uint32_t flags,
+  SFHASH_Error** err
+);
+
+/*
+ * Open a sharded hashset from its manifest.
+ *
+ * Only the manifest is read here; each shard is opened, as by
+ * sfhash_open_hashset with flags, when a lookup first needs it, so
+ * shards which no lookup needs are never mapped.
+ *
+ * Returns null on error and sets err to nonnull.
+ */
+SFHASH_HashsetShards* sfhash_open_hashset_shards(
+  const char* manifest_path,
+  uint32_t flags,
+  SFHASH_Error** err
+);
+
+void sfhash_destroy_hashset_shards(SFHASH_HashsetShards* shards);
+
+/*
+ * The number of shards, and the number of them opened so far.
+ */
+size_t sfhash_hashset_shards_count(const SFHASH_HashsetShards* shards);
+
+size_t sfhash_hashset_shards_open_count(const SFHASH_HashsetShards* shards);
+
+/*
+ * The index of the hashset data for a hash type, which is the same in
+ * every shard, or -1 if the shards have no hashes of that type.
+ */
+int sfhash_hashset_shards_index_for_type(
+  const SFHASH_HashsetShards* shards,
+  SFHASH_HashAlgorithm htype
+);
+
+/*
+ * The index of the shard which would hold a hash of hash data index tidx,
+ * or -1 if no shard covers its prefix.
+ */
+int sfhash_hashset_shards_shard_for_hash(
+  const SFHASH_HashsetShards* shards,
+  size_t tidx,
+  const void* hash
+);
+
+/*
+ * Shard i, opening it if need be, for use with the other hashset
+ * functions. The shard is owned by shards.
+ *
+ * Returns null on error and sets err to nonnull.
+ */
+const SFHASH_Hashset* sfhash_hashset_shards_shard(
+  const SFHASH_HashsetShards* shards,
+  size_t i,
+  SFHASH_Error** err
+);
+
+/*
+ * Look up a hash in the shard covering its prefix, opening the shard if
+ * need be.
+ *
+ * Sets err to nonnull and returns false if the shard cannot be opened.
+ */
+bool sfhash_hashset_shards_lookup(
+  const SFHASH_HashsetShards* shards,
+  size_t tidx,
+  const void* hash,
+  SFHASH_Error** err
+);
+
+/*
+ * Look up hashes_length hashes, as by sfhash_hashset_lookup_bulk, with
+ * the hashes gathered by shard and each shard's batch looked up together.
+ *
+ * Sets err to nonnull if a shard cannot be opened; results are then
+ * undefined.
+ */
+void sfhash_hashset_shards_lookup_bulk(
+  const SFHASH_HashsetShards* shards,
+  size_t tidx,
+  const void* hashes,
+  size_t hashes_length,
+  bool* results,
+  SFHASH_Error** err
+);
+
+struct SFHASH_HashsetLayers;
+
+/*
+ * Start a layered hashset, which is updated by appending deltas to it
+ * rather than by rebuilding it.
+ *
+ * Writes a manifest at manifest_path listing the hashset at base_path as
+ * the only layer. Every layer has the base's hash types, in its order.
+ *
+ * Sets err to nonnull on error.
+ */
+void sfhash_hashset_layers_create(
+  const char* manifest_path,
+  const char* base_path,
+  SFHASH_Error** err
+);
+
+/*
+ * Append count records to a layered hashset.
+ *
+ * The records, laid out as for sfhash_hashset_builder_add_records with the
+ * layers' hash types, are built alone into a delta at delta_path, which is
+ * added to the manifest; of the other layers, only the base's FHDR is
+ * read, for its name and description. flags is a bitwise-or of
+ * SFHASH_HashsetBuildFlags for the delta. Deltas hold no records, only
+ * hashes for lookups. delta_path must not be one of the layers.
+ *
+ * Sets err to nonnull on error.
+ */
+void sfhash_hashset_layers_append(
+  const char* manifest_path,
+  const void* records,
+  size_t count,
+  const char* delta_path,
+  const char* temp_dir,
+  uint32_t flags,
+  SFHASH_Error** err
+);
+
+/*
+ * Merge every layer of a layered hashset into one hashset at out_path,
+ * built with flags, and make it the manifest's only layer. If the base has
+ * records, so does the merged hashset: the base's records, and each hash
+ * of the deltas not in them as a record with no other hashes. The old
+ * layers are left for the caller to remove.
+ *
+ * out_path may be one of the layers: the merged hashset is built at
+ * out_path.tmp and renamed over out_path once the layers are closed.
+ *
+ * Sets err to nonnull on error.
+ */
+void sfhash_hashset_layers_compact(
+  const char* manifest_path,
+  const char* out_path,
+  const char* temp_dir,
+  uint32_t flags,
+  SFHASH_Error** err
+);
+
+/*
+ * Open a layered hashset from its manifest, opening each layer as by
+ * sfhash_open_hashset with flags.
+ *
+ * Returns null on error and sets err to nonnull.
+ */
+SFHASH_HashsetLayers* sfhash_open_hashset_layers(
+  const char* manifest_path,
+  uint32_t flags,
+  SFHASH_Error** err
+);
+
+void sfhash_destroy_hashset_layers(SFHASH_HashsetLayers* layers);
+
+/*
+ * The number of layers, the base included.
+ */
+size_t sfhash_hashset_layers_count(const SFHASH_HashsetLayers* layers);
+
+/*
+ * The index of the hashset data for a hash type, which is the same in
+ * every layer, or -1 if the layers have no hashes of that type.
+ */
+int sfhash_hashset_layers_index_for_type(
+  const SFHASH_HashsetLayers* layers,
+  SFHASH_HashAlgorithm htype
+);
+
+/*
+ * Layer i, the base being 0, for use with the other hashset functions.
+ * The layer is owned by layers.
+ */
+const SFHASH_Hashset* sfhash_hashset_layers_layer(
+  const SFHASH_HashsetLayers* layers,
+  size_t i
+);
+
+/*
+ * Look up a hash in every layer; returns whether any has it.
+ */
+bool sfhash_hashset_layers_lookup(
+  const SFHASH_HashsetLayers* layers,
+  size_t tidx,
+  const void* hash
+);
+
+/*
+ * Look up hashes_length hashes, as by sfhash_hashset_lookup_bulk, in the
+ * base, and then those not found in each delta in turn.
+ *
+ * Sets err to nonnull if the hashes missed cannot be gathered for the
+ * deltas; results are then undefined.
+ */
+void sfhash_hashset_layers_lookup_bulk(
+  const SFHASH_HashsetLayers* layers,
+  size_t tidx,
+  const void* hashes,
+  size_t hashes_length,
+  bool* results,
+  SFHASH_Error** err
+);
+
 #ifdef __cplusplus
 }
 #endif
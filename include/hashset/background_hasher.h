@@ -0,0 +1,54 @@
+#pragma once
+
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+/*
+ * SHA-256 of a region which is finished from front to back, computed on a
+ * background thread as it is finished, so that hashing what is done
+ * overlaps with finishing the rest.
+ *
+ * The writer calls finished() each time more of the region is final; the
+ * hashing thread hashes up to there and waits for more. digest() waits for
+ * everything finished to be hashed.
+ */
+class BackgroundHasher {
+public:
+  // Hashes from beg, as it is finished
+  explicit BackgroundHasher(const uint8_t* beg);
+
+  BackgroundHasher(const BackgroundHasher&) = delete;
+
+  BackgroundHasher& operator=(const BackgroundHasher&) = delete;
+
+  // Stops hashing, without waiting for the rest
+  ~BackgroundHasher();
+
+  // Everything before end is final; end may not move back
+  void finished(const uint8_t* end);
+
+  // Waits for everything finished to be hashed, and returns the digest;
+  // nothing may be finished after
+  std::array<uint8_t, 32> digest();
+
+private:
+  void run();
+
+  std::mutex Mutex;
+  std::condition_variable Cond;
+
+  const uint8_t* Hashed;
+  const uint8_t* Done;
+  bool Closed;
+  bool Stop;
+
+  std::array<uint8_t, 32> Digest;
+  std::exception_ptr Error;
+
+  std::thread Worker;
+};
@@ -1,10 +1,12 @@
 #pragma once
 
+#include "hashset/hash_compare.h"
 #include "hashset/lookupstrategy.h"
 
 #include <algorithm>
 #include <array>
 #include <memory>
+#include <utility>
 
 template <size_t HashLength>
 std::array<uint8_t, HashLength>* hash_ptr_cast(const void* ptr) {
@@ -26,14 +28,177 @@ public:
 
   virtual ~BasicLookupStrategy() {}
 
+  virtual LookupFunctions functions() const override {
+    return lookup_functions<BasicLookupStrategy>();
+  }
+
   virtual bool contains(const uint8_t* hash) const {
-    return std::binary_search(
-      HashesBeg.get(), HashesEnd,
-      *reinterpret_cast<const std::array<uint8_t, HashLength>*>(hash)
-    );
+    return search(0, size(), hash);
+  }
+
+  virtual void contains_bulk(
+    const uint8_t* hashes,
+    size_t count,
+    bool* results) const override
+  {
+    interleaved_search(*this, hashes, count, results);
+  }
+
+  virtual std::pair<size_t, size_t> find_range(const uint8_t* hash) const override {
+    return search_range(0, size(), hash);
+  }
+
+  // The range of indices [l, r) in which hash must be, if it is present.
+  // Subclasses with hints hide this with a narrower window.
+  std::pair<size_t, size_t> window(const uint8_t*) const {
+    return { 0, size() };
   }
 
 protected:
+  size_t size() const {
+    return HashesEnd - HashesBeg.get();
+  }
+
+  bool search(size_t l, size_t r, const uint8_t* hash) const {
+    const auto& h = *reinterpret_cast<const std::array<uint8_t, HashLength>*>(hash);
+
+    if (!lookup_stats_enabled()) {
+      return std::binary_search(
+        HashesBeg.get() + l, HashesBeg.get() + r, h, HashLess<HashLength>()
+      );
+    }
+
+    LookupStatsCounts c;
+    const bool found = std::binary_search(
+      HashesBeg.get() + l, HashesBeg.get() + r, h,
+      CountingLess<HashLess<HashLength>>{c.probes}
+    );
+
+    c.lookups = 1;
+    c.hits = found;
+    c.window(r - l);
+    Stats.add(c);
+
+    return found;
+  }
+
+  std::pair<size_t, size_t> search_range(size_t l, size_t r, const uint8_t* hash) const {
+    const auto& h = *reinterpret_cast<const std::array<uint8_t, HashLength>*>(hash);
+
+    if (!lookup_stats_enabled()) {
+      const auto [i, j] = std::equal_range(
+        HashesBeg.get() + l, HashesBeg.get() + r, h, HashLess<HashLength>()
+      );
+      return { i - HashesBeg.get(), j - HashesBeg.get() };
+    }
+
+    LookupStatsCounts c;
+    const auto [i, j] = std::equal_range(
+      HashesBeg.get() + l, HashesBeg.get() + r, h,
+      CountingLess<HashLess<HashLength>>{c.probes}
+    );
+
+    c.lookups = 1;
+    c.hits = i != j;
+    c.window(r - l);
+    Stats.add(c);
+
+    return { i - HashesBeg.get(), j - HashesBeg.get() };
+  }
+
+  std::pair<size_t, size_t> clamp_window(int64_t l, int64_t r) const {
+    const int64_t n = size();
+    l = std::clamp<int64_t>(l, 0, n);
+    r = std::clamp<int64_t>(r, l, n);
+    return { l, r };
+  }
+
+  /*
+   * Binary searches for a group of hashes at once, advancing all searches
+   * by one probe per pass and prefetching the next probe of each search as
+   * soon as it is known. The searches are independent, so their cache
+   * misses overlap instead of forming one long dependent chain.
+   *
+   * window is not virtual; each subclass passes itself so that its own
+   * window is used without a virtual call per hash.
+   */
+  template <class Strategy>
+  void interleaved_search(
+    const Strategy& strategy,
+    const uint8_t* hashes,
+    size_t count,
+    bool* results) const
+  {
+    constexpr size_t GROUP = 16;
+
+    using Hash = std::array<uint8_t, HashLength>;
+    const Hash* const data = HashesBeg.get();
+    const Hash* const h = reinterpret_cast<const Hash*>(hashes);
+
+    size_t base[GROUP], len[GROUP], end[GROUP];
+
+    const bool stats = lookup_stats_enabled();
+    LookupStatsCounts c;
+
+    for (size_t i = 0; i < count; i += GROUP) {
+      const size_t g = std::min(GROUP, count - i);
+
+      size_t maxlen = 0;
+      for (size_t j = 0; j < g; ++j) {
+        const auto [l, r] = strategy.Strategy::window(h[i + j].data());
+        base[j] = l;
+        len[j] = r - l;
+        end[j] = r;
+        maxlen = std::max(maxlen, len[j]);
+        __builtin_prefetch(data + l + len[j] / 2);
+
+        if (stats) {
+          c.window(len[j]);
+        }
+      }
+
+      // branchless lower bound; a lane with len <= 1 is finished and its
+      // half is 0, so it stands still until the longest search is done
+      while (maxlen > 1) {
+        for (size_t j = 0; j < g; ++j) {
+          const size_t half = len[j] / 2;
+          base[j] += (
+            half && hash_less<HashLength>(data[base[j] + half].data(), h[i + j].data())
+          ) ? half : 0;
+          len[j] -= half;
+          __builtin_prefetch(data + base[j] + len[j] / 2);
+          if (stats) {
+            c.probes += half != 0;
+          }
+        }
+        maxlen -= maxlen / 2;
+      }
+
+      // the lower bound is now base or base + 1
+      for (size_t j = 0; j < g; ++j) {
+        const bool first = len[j] &&
+          hash_eq<HashLength>(data[base[j]].data(), h[i + j].data());
+        const bool second = len[j] && !first && base[j] + 1 < end[j];
+        results[i + j] = first || (
+          second && hash_eq<HashLength>(data[base[j] + 1].data(), h[i + j].data())
+        );
+
+        if (stats) {
+          c.probes += (len[j] != 0) + second;
+        }
+      }
+
+      if (stats) {
+        c.hits += std::count(results + i, results + i + g, true);
+      }
+    }
+
+    if (stats) {
+      c.lookups = count;
+      Stats.add(c);
+    }
+  }
+
   std::unique_ptr<
     std::array<uint8_t, HashLength>[],
     void(*)(std::array<uint8_t, HashLength>*)
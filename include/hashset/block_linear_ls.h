@@ -1,10 +1,41 @@
 #pragma once
 
 #include "hashset/basic_ls.h"
+#include "hashset/convex_hull.h"
 #include "hashset/util.h"
 
 #include <algorithm>
 #include <array>
+#include <cmath>
+#include <iterator>
+#include <limits>
+#include <tuple>
+#include <vector>
+
+/*
+ * Lookups with a window bounded by a pair of lines in each block, rather
+ * than by constants as in BlockLookupStrategy.
+ *
+ * The offset of a hash from its expected index wanders as a random walk,
+ * so over a block it drifts; lines follow the drift where constants must
+ * allow for all of it. Each block has (lower slope, lower intercept, upper
+ * slope, upper intercept), as functions of the expected index.
+ */
+
+using LinearBounds = std::tuple<float, float, float, float>;
+
+// The bounds lines give at expected index x, rounded outwards; the encoder
+// checks its lines with these, so lookups must use them too
+inline int64_t linear_lower(float a, float b, int64_t x) {
+  return static_cast<int64_t>(std::floor(static_cast<double>(a) * x + b));
+}
+
+inline int64_t linear_upper(float a, float b, int64_t x) {
+  return static_cast<int64_t>(std::ceil(static_cast<double>(a) * x + b));
+}
+
+// The bounds of a block with no hashes, which give empty windows
+constexpr LinearBounds EMPTY_LINEAR_BOUNDS{0.0f, 1.0f, 0.0f, -1.0f};
 
 template <
   size_t HashLength,
@@ -12,38 +43,195 @@ template <
 >
 class BlockLinearLookupStrategy: public BasicLookupStrategy<HashLength> {
 public:
+  // blocks has the lines of each of the 2^BlockBits blocks, in order
+  template <class Bounds>
   BlockLinearLookupStrategy(
     const void* beg,
     const void* end,
-//    std::array<std::tuple<double, double, double, double>, (1 << BlockBits)> blocks
-    std::array<std::tuple<float, float, float, float>, (1 << BlockBits)> blocks
+    const Bounds& blocks
   ):
     BasicLookupStrategy<HashLength>(beg, end),
-    Blocks(blocks)
+    Blocks(std::begin(blocks), std::end(blocks))
   {}
 
   virtual ~BlockLinearLookupStrategy() {}
 
+  virtual LookupFunctions functions() const override {
+    return lookup_functions<BlockLinearLookupStrategy>();
+  }
+
   virtual bool contains(const uint8_t* hash) const override {
-    const size_t exp = expected_index(hash, this->HashesEnd - this->HashesBeg.get());
+    const auto [l, r] = window(hash);
+    return this->search(l, r, hash);
+  }
+
+  virtual void contains_bulk(
+    const uint8_t* hashes,
+    size_t count,
+    bool* results) const override
+  {
+    this->interleaved_search(*this, hashes, count, results);
+  }
+
+  virtual std::pair<size_t, size_t> find_range(const uint8_t* hash) const override {
+    const auto [l, r] = window(hash);
+    return this->search_range(l, r, hash);
+  }
+
+  std::pair<size_t, size_t> window(const uint8_t* hash) const {
+    const int64_t exp = expected_index(hash, this->size());
+    const auto& [la, lb, ua, ub] = Blocks[block_index(hash, BlockBits)];
+    return this->clamp_window(
+      exp + linear_lower(la, lb, exp),
+      exp + linear_upper(ua, ub, exp) + 1
+    );
+  }
+
+protected:
+  std::vector<LinearBounds> Blocks;
+};
+
+// The line through the edge of hull, sorted by x, over x
+inline std::pair<double, double> hull_edge_line(
+  const std::vector<Point<int64_t>>& hull,
+  double x)
+{
+  if (hull.size() == 1) {
+    return { 0.0, static_cast<double>(hull[0].y) };
+  }
+
+  size_t i = 0;
+  while (i + 2 < hull.size() && hull[i + 1].x < x) {
+    ++i;
+  }
+
+  const auto& p = hull[i];
+  const auto& q = hull[i + 1];
+  const double a = static_cast<double>(q.y - p.y) / (q.x - p.x);
+  return { a, p.y - a * p.x };
+}
 
-    const size_t bi = hash[0] >> (8 - BlockBits);
 /*
-    std::cout << bi << '\n';
+ * Fits the lines of a block for BlockLinearLookupStrategy to the highest
+ * and lowest offsets at each of its expected indices, with mid the middle
+ * of its range of expected indices.
+ *
+ * Each bound is the line through the edge of the convex hull of the
+ * block's offsets which lies over the middle of the block. Every hull edge
+ * is on a line which bounds all the offsets, and of those lines, this one
+ * gives the narrowest windows on average over the block, as queries are
+ * uniform over it. Each line is then moved out by whatever rounding to
+ * floats lost, so that every hash is in its window.
+ */
+inline LinearBounds fit_linear_bounds(
+  const std::vector<Point<int64_t>>& upper,
+  const std::vector<Point<int64_t>>& lower,
+  double mid)
+{
+  const auto [ua, ub] = hull_edge_line(
+    upper.size() > 1 ? upper_ch(upper) : upper, mid
+  );
+
+  auto lh = lower.size() > 1 ? lower_ch(lower) : lower;
+  std::reverse(lh.begin(), lh.end());
+  const auto [la, lb] = hull_edge_line(lh, mid);
 
-    std::cout << (exp + static_cast<size_t>(std::get<0>(Blocks[bi])*exp + std::get<1>(Blocks[bi]))) << ", " << (exp + static_cast<size_t>(std::get<2>(Blocks[bi])*exp + std::get<3>(Blocks[bi])) + 1) << '\n';
+  LinearBounds lines{
+    static_cast<float>(la), static_cast<float>(lb),
+    static_cast<float>(ua), static_cast<float>(ub)
+  };
+
+  auto& [fla, flb, fua, fub] = lines;
+
+  // a miss smaller than the spacing of floats at a large intercept would
+  // round away, so each step moves the intercept by at least that spacing
+  for (int64_t miss = 1; miss > 0; ) {
+    miss = 0;
+    for (const auto& p: upper) {
+      miss = std::max(miss, p.y - linear_upper(fua, fub, p.x));
+    }
+    if (miss > 0) {
+      fub = std::max(
+        fub + miss, std::nextafter(fub, std::numeric_limits<float>::infinity())
+      );
+    }
+  }
+
+  for (int64_t miss = 1; miss > 0; ) {
+    miss = 0;
+    for (const auto& p: lower) {
+      miss = std::max(miss, linear_lower(fla, flb, p.x) - p.y);
+    }
+    if (miss > 0) {
+      flb = std::min(
+        flb - miss, std::nextafter(flb, -std::numeric_limits<float>::infinity())
+      );
+    }
+  }
 
-    std::cout << to_hex(*std::max(this->HashesBeg.get(), this->HashesBeg.get() + exp + static_cast<size_t>(std::get<0>(Blocks[bi])*exp + std::get<1>(Blocks[bi])))) << '\n' << to_hex(*std::min(this->HashesEnd, this->HashesBeg.get() + exp + static_cast<size_t>(std::get<2>(Blocks[bi])*exp + std::get<3>(Blocks[bi])) + 1)) << '\n';
-*/
+  return lines;
+}
 
-    return std::binary_search(
-      std::max(this->HashesBeg.get(), this->HashesBeg.get() + exp + static_cast<int64_t>(std::get<0>(Blocks[bi])*exp + std::get<1>(Blocks[bi]))),
-      std::min(this->HashesEnd, this->HashesBeg.get() + exp + static_cast<int64_t>(std::get<2>(Blocks[bi])*exp + std::get<3>(Blocks[bi])) + 1),
-      *reinterpret_cast<const std::array<uint8_t, HashLength>*>(hash)
+// Fits the lines of each of 2^block_bits blocks for
+// BlockLinearLookupStrategy to count sorted hashes
+inline std::vector<LinearBounds> make_linear_blocks(
+  const uint8_t* hashes,
+  size_t count,
+  size_t hash_length,
+  unsigned block_bits)
+{
+  std::vector<LinearBounds> blocks(size_t(1) << block_bits, EMPTY_LINEAR_BOUNDS);
+
+  // the highest and lowest offsets at each expected index in the block
+  std::vector<Point<int64_t>> upper, lower;
+
+  const auto fit = [&](size_t bi) {
+    // the middle of the range of expected indices of the block
+    blocks[bi] = fit_linear_bounds(
+      upper, lower, (bi + 0.5) * count / blocks.size()
     );
+    upper.clear();
+    lower.clear();
+  };
+
+  size_t cur = 0;
+  for (size_t i = 0; i < count; ++i) {
+    const uint8_t* h = hashes + i * hash_length;
+    const int64_t e = expected_index(h, count);
+    const int64_t d = static_cast<int64_t>(i) - e;
+
+    const size_t bi = block_index(h, block_bits);
+    if (bi != cur && !upper.empty()) {
+      fit(cur);
+    }
+    cur = bi;
+
+    // offsets rise along a run of hashes with the same expected index, so
+    // the first is the lowest and the last the highest
+    if (!upper.empty() && upper.back().x == e) {
+      upper.back().y = d;
+    }
+    else {
+      upper.emplace_back(e, d);
+      lower.emplace_back(e, d);
+    }
   }
 
-//protected:
-//  std::array<std::tuple<double, double, double, double>, (1 << BlockBits)> Blocks;
-  std::array<std::tuple<float, float, float, float>, (1 << BlockBits)> Blocks;
-};
+  if (!upper.empty()) {
+    fit(cur);
+  }
+
+  return blocks;
+}
+
+template <size_t BlockBits>
+std::array<LinearBounds, (1 << BlockBits)> make_linear_blocks(
+  const uint8_t* hashes,
+  size_t count,
+  size_t hash_length)
+{
+  const auto v = make_linear_blocks(hashes, count, hash_length, BlockBits);
+  std::array<LinearBounds, (1 << BlockBits)> blocks;
+  std::copy(v.begin(), v.end(), blocks.begin());
+  return blocks;
+}
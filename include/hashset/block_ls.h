@@ -3,27 +3,34 @@
 #include "hashset/basic_ls.h"
 #include "hashset/util.h"
 
+#include <iterator>
+#include <utility>
+#include <vector>
+
 template <
   size_t HashLength,
   size_t BlockBits
 >
 class BlockLookupStrategy: public BasicLookupStrategy<HashLength> {
 public:
+  // blocks has the bounds of each of the 2^BlockBits blocks, in order
+  template <class Bounds>
   BlockLookupStrategy(
     const void* beg,
     const void* end,
-    std::array<std::pair<int64_t, int64_t>, (1 << BlockBits)> blocks
+    const Bounds& blocks
   ):
     BasicLookupStrategy<HashLength>(beg, end),
-    Blocks(blocks)
+    Blocks(std::begin(blocks), std::end(blocks))
   {}
 
   virtual ~BlockLookupStrategy() {}
 
-  virtual bool contains(const uint8_t* hash) const override {
-    const size_t exp = expected_index(hash, this->HashesEnd - this->HashesBeg.get());
-    const size_t bi = hash[0] >> (8 - BlockBits);
+  virtual LookupFunctions functions() const override {
+    return lookup_functions<BlockLookupStrategy>();
+  }
 
+  virtual bool contains(const uint8_t* hash) const override {
 /*
     {
       const auto l = std::max(this->HashesBeg.get(), this->HashesBeg.get() + exp + Blocks[bi].first);
@@ -40,13 +47,35 @@ public:
     }
 */
 
-    return std::binary_search(
-      std::max(this->HashesBeg.get(), this->HashesBeg.get() + exp + Blocks[bi].first),
-      std::min(this->HashesEnd, this->HashesBeg.get() + exp + Blocks[bi].second + 1),
-      *reinterpret_cast<const std::array<uint8_t, HashLength>*>(hash)
-    );
+    const auto [l, r] = window(hash);
+    return this->search(l, r, hash);
+  }
+
+  virtual void contains_bulk(
+    const uint8_t* hashes,
+    size_t count,
+    bool* results) const override
+  {
+    this->interleaved_search(*this, hashes, count, results);
+  }
+
+  virtual std::pair<size_t, size_t> find_range(const uint8_t* hash) const override {
+    const auto [l, r] = window(hash);
+    return this->search_range(l, r, hash);
+  }
+
+  std::pair<size_t, size_t> window(const uint8_t* hash) const {
+    const size_t bi = block_index(hash, BlockBits);
+    if (Blocks[bi].first > Blocks[bi].second) {
+      // no hashes in this block
+      return { 0, 0 };
+    }
+
+    const int64_t exp = expected_index(hash, this->size());
+    return this->clamp_window(exp + Blocks[bi].first, exp + Blocks[bi].second + 1);
   }
 
 protected:
-  std::array<std::pair<int64_t, int64_t>, (1 << BlockBits)> Blocks;
+  // on the heap, as there can be 2^16 of them
+  std::vector<std::pair<int64_t, int64_t>> Blocks;
 };
@@ -0,0 +1,165 @@
+#pragma once
+
+#include "hashset/hash_compare.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+/*
+ * HDAC: the sorted hashes of an HDAT, stored without their leading bytes.
+ *
+ * The hashes are split into 2^bucket_bits buckets by their leading bits,
+ * and only the part of each hash after its first prefix_bytes bytes is
+ * kept, as the bucket implies those. The bucket sizes are kept as in the
+ * upper half of an Elias-Fano code: a bit vector holding, for each bucket
+ * in turn, a 1 for each hash in it and then a 0, so bucket b begins at the
+ * number of 1s before its 0. The position of every 64th 0 is sampled, so
+ * finding a bucket reads a word or two of the bit vector and then only
+ * that bucket's suffixes.
+ *
+ * Hashes are random, so leading bytes are all that can be saved: there
+ * are about log2(hash count) - 2 bucket bits, so one byte per hash up to
+ * 2^18 hashes, two up to 2^26, three up to 2^34, less 1 to 1.5 bits per
+ * hash for the directory.
+ *
+ * Layout, integers little-endian:
+ *
+ *   u8      bucket bits
+ *   u8      prefix bytes
+ *   6 bytes padding
+ *   hash count suffixes of (hash length - prefix bytes) bytes
+ *   padding to a multiple of 8 bytes
+ *   u64     the position of every 64th 0 in the bit vector
+ *   u64     the bit vector, (hash count + 2^bucket bits) bits, low bit first
+ */
+
+// The bucket bits for count hashes of length hash_length
+unsigned compressed_bucket_bits(uint64_t count, size_t hash_length);
+
+// The length of an HDAC holding count hashes of length hash_length
+size_t compressed_length(uint64_t count, size_t hash_length);
+
+// The length of the longest HDAC holding at most count hashes; fewer
+// hashes can take more room, with fewer prefix bytes left off
+size_t compressed_length_max(uint64_t count, size_t hash_length);
+
+/*
+ * Writes count sorted hashes of length hash_length as an HDAC. hashes may
+ * be the same as out, for compressing an HDAT in place, but may not
+ * otherwise overlap it.
+ */
+size_t write_compressed(
+  const uint8_t* hashes,
+  uint64_t count,
+  size_t hash_length,
+  uint8_t* out
+);
+
+class CompressedHashes {
+public:
+  // Throws if [beg, end) is not an HDAC of count hashes of hash_length
+  CompressedHashes(
+    const void* beg,
+    const void* end,
+    size_t hash_length,
+    uint64_t count
+  );
+
+  unsigned bucket_bits() const {
+    return BucketBits;
+  }
+
+  unsigned prefix_bytes() const {
+    return PrefixBytes;
+  }
+
+  uint64_t size() const {
+    return Count;
+  }
+
+  uint64_t bucket(const uint8_t* hash) const {
+    return BucketBits ? leading_bits(hash) >> (64 - BucketBits) : 0;
+  }
+
+  // The first hash in bucket b, and one past the last
+  std::pair<uint64_t, uint64_t> bucket_range(uint64_t b) const {
+    if (b == 0) {
+      return { 0, next_zero(0) };
+    }
+
+    // the 0 ending bucket b - 1, and the one ending b
+    const uint64_t z = select_zero(b - 1);
+    return { z + 1 - b, next_zero(z + 1) - b };
+  }
+
+  void prefetch_bucket(uint64_t b) const {
+    __builtin_prefetch(Samples + 8 * (b / 64));
+  }
+
+  const uint8_t* suffix(uint64_t i) const {
+    return Suffixes + i * SuffixLength;
+  }
+
+  // Writes all the hashes, whole and in order, to out
+  void expand(uint8_t* out) const;
+
+  std::vector<uint8_t> expand() const;
+
+private:
+  uint64_t leading_bits(const uint8_t* hash) const {
+    uint64_t x = 0;
+    std::memcpy(&x, hash, std::min<size_t>(HashLength, 8));
+    return from_be(x);
+  }
+
+  static uint64_t load(const uint8_t* p) {
+    uint64_t x;
+    std::memcpy(&x, p, sizeof(x));
+    return from_le(x);
+  }
+
+  uint64_t word(uint64_t w) const {
+    return load(Bits + 8 * w);
+  }
+
+  // The position of the kth 0 in the bit vector
+  uint64_t select_zero(uint64_t k) const {
+    const uint64_t s = load(Samples + 8 * (k / 64));
+    const uint64_t r = k % 64;
+    return r ? nth_zero_after(s + 1, r - 1) : s;
+  }
+
+  // The position of the first 0 at or after p
+  uint64_t next_zero(uint64_t p) const {
+    return nth_zero_after(p, 0);
+  }
+
+  // The position of the nth 0 (counting from 0) at or after p
+  uint64_t nth_zero_after(uint64_t p, uint64_t n) const {
+    uint64_t w = p / 64;
+    uint64_t zeros = ~word(w) & (~uint64_t(0) << (p % 64));
+
+    for (unsigned c; n >= (c = __builtin_popcountll(zeros)); ) {
+      n -= c;
+      zeros = ~word(++w);
+    }
+
+    for ( ; n; --n) {
+      zeros &= zeros - 1;
+    }
+    return 64 * w + __builtin_ctzll(zeros);
+  }
+
+  size_t HashLength;
+  size_t SuffixLength;
+  uint64_t Count;
+  unsigned BucketBits;
+  unsigned PrefixBytes;
+  const uint8_t* Suffixes;
+  const uint8_t* Samples;
+  const uint8_t* Bits;
+};
@@ -0,0 +1,195 @@
+#pragma once
+
+#include "throw.h"
+#include "hashset/compressed_hashes.h"
+#include "hashset/hash_compare.h"
+#include "hashset/lookupstrategy.h"
+
+#include <algorithm>
+#include <utility>
+
+/*
+ * Lookups in an HDAC: the bucket of a hash gives the range of suffixes
+ * which could match it, and those alone are searched.
+ */
+template <size_t HashLength, size_t PrefixBytes>
+class CompressedLookupStrategy: public LookupStrategy {
+public:
+  CompressedLookupStrategy(const CompressedHashes& hashes):
+    Hashes(hashes)
+  {}
+
+  virtual ~CompressedLookupStrategy() {}
+
+  virtual LookupFunctions functions() const override {
+    return lookup_functions<CompressedLookupStrategy>();
+  }
+
+  virtual bool contains(const uint8_t* hash) const override {
+    const auto [l, r] = Hashes.bucket_range(Hashes.bucket(hash));
+    uint64_t probes = 0;
+    const uint64_t i = lower_bound(l, r, hash + PrefixBytes, probes);
+    const bool found = i < r && hash_eq<SUFFIX>(Hashes.suffix(i), hash + PrefixBytes);
+
+    if (lookup_stats_enabled()) {
+      count_lookup(l, r, found, probes + (i < r));
+    }
+
+    return found;
+  }
+
+  virtual void contains_bulk(
+    const uint8_t* hashes,
+    size_t count,
+    bool* results) const override
+  {
+    // Stages per group, as for the perfect hash: the directory samples,
+    // the bucket ranges, then the bucket searches interleaved, prefetching
+    // what each next stage reads.
+    constexpr size_t GROUP = 16;
+
+    uint64_t b[GROUP], base[GROUP], len[GROUP], end[GROUP];
+
+    const bool stats = lookup_stats_enabled();
+    LookupStatsCounts c;
+
+    for (size_t i = 0; i < count; i += GROUP) {
+      const size_t g = std::min(GROUP, count - i);
+      const uint8_t* gh = hashes + i * HashLength;
+
+      for (size_t j = 0; j < g; ++j) {
+        b[j] = Hashes.bucket(gh + j * HashLength);
+        Hashes.prefetch_bucket(b[j] ? b[j] - 1 : 0);
+      }
+
+      size_t maxlen = 0;
+      for (size_t j = 0; j < g; ++j) {
+        const auto [l, r] = Hashes.bucket_range(b[j]);
+        base[j] = l;
+        len[j] = r - l;
+        end[j] = r;
+        maxlen = std::max<size_t>(maxlen, len[j]);
+        __builtin_prefetch(Hashes.suffix(l + len[j] / 2));
+
+        if (stats) {
+          c.window(len[j]);
+        }
+      }
+
+      // branchless lower bound, as in BasicLookupStrategy
+      while (maxlen > 1) {
+        for (size_t j = 0; j < g; ++j) {
+          const size_t half = len[j] / 2;
+          base[j] += (
+            half && hash_less<SUFFIX>(
+              Hashes.suffix(base[j] + half), gh + j * HashLength + PrefixBytes
+            )
+          ) ? half : 0;
+          len[j] -= half;
+          __builtin_prefetch(Hashes.suffix(base[j] + len[j] / 2));
+          if (stats) {
+            c.probes += half != 0;
+          }
+        }
+        maxlen -= maxlen / 2;
+      }
+
+      for (size_t j = 0; j < g; ++j) {
+        const uint8_t* s = gh + j * HashLength + PrefixBytes;
+        const bool first = len[j] && hash_eq<SUFFIX>(Hashes.suffix(base[j]), s);
+        const bool second = len[j] && !first && base[j] + 1 < end[j];
+        results[i + j] = first || (
+          second && hash_eq<SUFFIX>(Hashes.suffix(base[j] + 1), s)
+        );
+
+        if (stats) {
+          c.probes += (len[j] != 0) + second;
+        }
+      }
+
+      if (stats) {
+        c.hits += std::count(results + i, results + i + g, true);
+      }
+    }
+
+    if (stats) {
+      c.lookups = count;
+      Stats.add(c);
+    }
+  }
+
+  virtual std::pair<size_t, size_t> find_range(const uint8_t* hash) const override {
+    const auto [l, r] = Hashes.bucket_range(Hashes.bucket(hash));
+    uint64_t probes = 0;
+    const uint64_t i = lower_bound(l, r, hash + PrefixBytes, probes);
+
+    uint64_t j = i;
+    while (j < r && hash_eq<SUFFIX>(Hashes.suffix(j), hash + PrefixBytes)) {
+      ++j;
+    }
+
+    if (lookup_stats_enabled()) {
+      // the run of matches, and the first hash past it
+      count_lookup(l, r, i != j, probes + (j - i) + (j < r));
+    }
+
+    return { i, j };
+  }
+
+private:
+  static constexpr size_t SUFFIX = HashLength - PrefixBytes;
+
+  uint64_t lower_bound(uint64_t l, uint64_t r, const uint8_t* s, uint64_t& probes) const {
+    while (l < r) {
+      const uint64_t m = l + (r - l) / 2;
+      ++probes;
+      if (hash_less<SUFFIX>(Hashes.suffix(m), s)) {
+        l = m + 1;
+      }
+      else {
+        r = m;
+      }
+    }
+    return l;
+  }
+
+  void count_lookup(uint64_t l, uint64_t r, bool found, uint64_t probes) const {
+    LookupStatsCounts c;
+    c.lookups = 1;
+    c.hits = found;
+    c.window(r - l);
+    c.probes = probes;
+    Stats.add(c);
+  }
+
+  CompressedHashes Hashes;
+};
+
+template <size_t HashLength>
+struct MakeCompressedLookupStrategy {
+  LookupStrategy* operator()(const CompressedHashes& hashes) {
+    switch (hashes.prefix_bytes()) {
+    case 1:
+      return make<1>(hashes);
+    case 2:
+      return make<2>(hashes);
+    case 3:
+      return make<3>(hashes);
+    case 4:
+      return make<4>(hashes);
+    default:
+      THROW("unsupported HDAC prefix length " << hashes.prefix_bytes());
+    }
+  }
+
+private:
+  template <size_t PrefixBytes>
+  LookupStrategy* make(const CompressedHashes& hashes) {
+    if constexpr (PrefixBytes < HashLength) {
+      return new CompressedLookupStrategy<HashLength, PrefixBytes>(hashes);
+    }
+    else {
+      THROW("HDAC prefix length " << PrefixBytes << " is not less than hash length " << HashLength);
+    }
+  }
+};
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+
+/*
+ * External merge sort of fixed-length byte strings, in memcmp order, for
+ * builds with more hashes than memory.
+ *
+ * Strings are collected in a buffer of at most budget bytes; each time it
+ * fills, it is radix sorted and written to temp_dir as a run. Merging
+ * reads the runs back through a buffer apiece, so every read and write is
+ * sequential. If the strings all fit in the buffer, nothing is written and
+ * the merge reads them from the buffer.
+ */
+class ExternalSorter {
+public:
+  // Run files are named for name, which must be unique within temp_dir;
+  // if unique is set, duplicate strings are merged only once
+  ExternalSorter(
+    size_t length,
+    uint64_t budget,
+    const std::filesystem::path& temp_dir,
+    const std::string& name,
+    bool unique
+  );
+
+  ExternalSorter(const ExternalSorter&) = delete;
+
+  ExternalSorter& operator=(const ExternalSorter&) = delete;
+
+  // Removes any runs left
+  ~ExternalSorter();
+
+  void add(const uint8_t* s);
+
+  // Calls out with each string in order, then removes the runs; returns
+  // the number of strings out was called with
+  uint64_t merge(const std::function<void(const uint8_t*)>& out);
+
+  size_t runs() const { return Runs.size(); }
+
+private:
+  void spill();
+
+  void remove_runs();
+
+  size_t Length;
+  uint64_t Budget;
+  std::filesystem::path Dir;
+  std::string Name;
+  bool Unique;
+
+  std::vector<uint8_t> Buf;
+  size_t Capacity;
+  size_t Count;
+
+  std::vector<std::filesystem::path> Runs;
+};
+
+// Sorts count strings of length len at data, dropping duplicates, using
+// no more than budget bytes besides data; returns the number kept
+uint64_t external_sort_unique(
+  uint8_t* data,
+  uint64_t count,
+  size_t len,
+  uint64_t budget,
+  const std::filesystem::path& temp_dir,
+  const std::string& name
+);
@@ -0,0 +1,183 @@
+#pragma once
+
+#include "rwutil.h"
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+/*
+ * Comparisons of fixed-length hashes, ordered as memcmp orders them.
+ *
+ * memcmp is an out-of-line call which must handle any length; for the
+ * lengths of the hashes we store, comparing whole big-endian words for
+ * order and whole vectors for equality is branch-light and inlines into
+ * searches and sorts.
+ */
+
+inline uint64_t load_be64(const uint8_t* p) {
+  uint64_t x;
+  std::memcpy(&x, p, sizeof(x));
+  return from_be(x);
+}
+
+inline uint32_t load_be32(const uint8_t* p) {
+  uint32_t x;
+  std::memcpy(&x, p, sizeof(x));
+  return from_be(x);
+}
+
+template <class T>
+int three_way(T l, T r) {
+  return (l > r) - (l < r);
+}
+
+// The first differing word decides; for random hashes, that is nearly
+// always the first, so the branches predict well.
+template <size_t N>
+int word_cmp(const uint8_t* l, const uint8_t* r) {
+  if constexpr (N >= 8) {
+    const uint64_t a = load_be64(l), b = load_be64(r);
+    if constexpr (N == 8) {
+      return three_way(a, b);
+    }
+    else {
+      return a != b ? three_way(a, b) : word_cmp<N - 8>(l + 8, r + 8);
+    }
+  }
+  else if constexpr (N >= 4) {
+    const uint32_t a = load_be32(l), b = load_be32(r);
+    if constexpr (N == 4) {
+      return three_way(a, b);
+    }
+    else {
+      return a != b ? three_way(a, b) : word_cmp<N - 4>(l + 4, r + 4);
+    }
+  }
+  else {
+    return std::memcmp(l, r, N);
+  }
+}
+
+template <size_t N>
+bool word_eq(const uint8_t* l, const uint8_t* r) {
+  // accumulate the differences, so there is only one branch
+  uint64_t d = 0;
+  size_t i = 0;
+  for ( ; i + 8 <= N; i += 8) {
+    uint64_t a, b;
+    std::memcpy(&a, l + i, 8);
+    std::memcpy(&b, r + i, 8);
+    d |= a ^ b;
+  }
+  for ( ; i + 4 <= N; i += 4) {
+    uint32_t a, b;
+    std::memcpy(&a, l + i, 4);
+    std::memcpy(&b, r + i, 4);
+    d |= a ^ b;
+  }
+  for ( ; i < N; ++i) {
+    d |= l[i] ^ r[i];
+  }
+  return !d;
+}
+
+#ifdef __SSE2__
+// Bit i is set iff byte i of l and r differ, for N a multiple of 16 up to 64.
+template <size_t N>
+uint64_t vector_diff_mask(const uint8_t* l, const uint8_t* r) {
+  static_assert(N % 16 == 0 && N <= 64);
+
+  uint64_t mask = 0;
+  size_t i = 0;
+
+#ifdef __AVX2__
+  for ( ; i + 32 <= N; i += 32) {
+    const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(l + i));
+    const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(r + i));
+    const uint32_t eq = _mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b));
+    mask |= static_cast<uint64_t>(~eq) << i;
+  }
+#endif
+
+  for ( ; i < N; i += 16) {
+    const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(l + i));
+    const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r + i));
+    const uint32_t eq = _mm_movemask_epi8(_mm_cmpeq_epi8(a, b));
+    mask |= static_cast<uint64_t>(~eq & 0xFFFF) << i;
+  }
+
+  return mask;
+}
+#endif
+
+// Ordering needs the first differing byte; measured, word compares find it
+// faster than vector compares do at every length we use, as the first word
+// almost always settles it.
+template <size_t N>
+int hash_cmp(const uint8_t* l, const uint8_t* r) {
+  return word_cmp<N>(l, r);
+}
+
+template <size_t N>
+bool hash_eq(const uint8_t* l, const uint8_t* r) {
+#ifdef __SSE2__
+  if constexpr (N % 16 == 0) {
+    return !vector_diff_mask<N>(l, r);
+  }
+  else
+#endif
+  {
+    return word_eq<N>(l, r);
+  }
+}
+
+template <size_t N>
+bool hash_less(const uint8_t* l, const uint8_t* r) {
+  return hash_cmp<N>(l, r) < 0;
+}
+
+template <size_t N>
+struct HashLess {
+  bool operator()(
+    const std::array<uint8_t, N>& l,
+    const std::array<uint8_t, N>& r) const
+  {
+    return hash_less<N>(l.data(), r.data());
+  }
+};
+
+/*
+ * hash_cmp for a length known only at runtime; lengths which are not hash
+ * lengths fall back to memcmp.
+ */
+inline int hash_cmp(const uint8_t* l, const uint8_t* r, size_t len) {
+  switch (len) {
+  case 4:
+    return hash_cmp<4>(l, r);
+  case 8:
+    return hash_cmp<8>(l, r);
+  case 16:
+    return hash_cmp<16>(l, r);
+  case 20:
+    return hash_cmp<20>(l, r);
+  case 28:
+    return hash_cmp<28>(l, r);
+  case 32:
+    return hash_cmp<32>(l, r);
+  case 48:
+    return hash_cmp<48>(l, r);
+  case 64:
+    return hash_cmp<64>(l, r);
+  default:
+    return std::memcmp(l, r, len);
+  }
+}
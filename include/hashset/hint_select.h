@@ -0,0 +1,45 @@
+#pragma once
+
+#include "hashset/block_linear_ls.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/*
+ * Choosing the hint for a field's sorted hashes when building a hashset.
+ *
+ * Each candidate (no hint, radius, range, constant bounds for each of 2^4
+ * up to 2^max_hint_block_bits() blocks, and lines for about the best of
+ * those numbers of blocks) is made from the hashes, and costed as the
+ * expected number of probes for a lookup: the mean over the hashes of the
+ * binary search probes of their windows, plus the chance that the part of
+ * the hint read is not in cache. The cheapest is written. Hashes far from
+ * uniform, as truncated hashes can be, give wide windows to every hint,
+ * and so get none.
+ */
+
+struct HintCandidate {
+  uint16_t hint_type;
+  // the expected probes for a lookup
+  double cost;
+  // the bounds of a range; a radius is the larger of -left and right
+  int64_t left;
+  int64_t right;
+  // the bounds or lines of each block
+  std::vector<std::pair<int64_t, int64_t>> blocks;
+  std::vector<LinearBounds> lines;
+};
+
+// The most block bits of a hint for hash_count hashes, or 0 if they are
+// too few for blocks; blocks of fewer than 64 hashes cost more than they
+// save
+unsigned max_hint_block_bits(uint64_t hash_count);
+
+// The cheapest hint for count sorted hashes of length hash_length
+HintCandidate select_hint(
+  const uint8_t* hashes,
+  uint64_t count,
+  size_t hash_length
+);
@@ -1,14 +1,34 @@
 #include "hasher/hashset.h"
 #include "hashset/hset_decoder.h"
+#include "hashset/lookup_stats.h"
+
+#include <memory>
+
+class MappedFile;
 
 struct SFHASH_Hashset {
   Holder holder;
+  // set if the hashset was opened from a file rather than loaded
+  std::shared_ptr<MappedFile> mapping;
+  double warm_time = 0.0;
 };
 
 struct SFHASH_HashsetRecord {
 };
 
+struct SFHASH_HashsetRecordMatches {
+  std::vector<SFHASH_HashsetRecordMatch> matches;
+};
+
+// Throws if flags has bits which are not SFHASH_HashsetOpenFlags
+void check_open_flags(uint32_t flags);
+
 int hashset_record_field_index_for_type(
   const RecordHeader& rhdr,
   SFHASH_HashAlgorithm htype
 );
+
+void fill_lookup_stats(
+  const LookupStatsCounts& c,
+  SFHASH_HashsetLookupStats* stats
+);
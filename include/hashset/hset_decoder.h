@@ -19,11 +19,17 @@ struct Holder {
       HashsetHint,
       ConstHashsetData,
       std::unique_ptr<LookupStrategy>,
-      ConstRecordIndex
+      ConstRecordIndex,
+      HashsetIndex
     >
   > hsets;
   RecordHeader rhdr;
   ConstRecordData rdat;
+  // the FTOC and the whole file, for checking the file against its CSUM
+  TableOfContents ftoc;
+  ChunkChecksums csum;
+  const uint8_t* beg;
+  const uint8_t* end;
 };
 
 Chunk decode_chunk(const uint8_t* beg, const uint8_t*& cur, const uint8_t* end);
@@ -39,7 +45,9 @@ struct State {
     SBRK, // section break
     HHDR,
     HINT,
+    HIDX,
     HDAT,
+    CSUM,
     DONE
   };
 };
@@ -52,10 +60,16 @@ HashsetHeader parse_hhdr(const Chunk& ch);
 
 HashsetHint parse_hint(const Chunk& ch);
 
+HashsetIndex parse_hidx(const Chunk& ch);
+
 ConstHashsetData parse_hdat(const Chunk& ch);
 
+ConstHashsetData parse_hdac(const Chunk& ch);
+
 ConstRecordIndex parse_ridx(const Chunk& ch);
 
+ChunkChecksums parse_csum(const Chunk& ch);
+
 RecordHeader parse_rhdr(const Chunk& ch);
 
 ConstRecordData parse_rdat(const Chunk& ch);
@@ -135,10 +149,18 @@ State::Type handle_rhdr(const Chunk& ch, Holder& h);
 
 State::Type handle_ftoc(const Chunk& ch, Holder& h);
 
+State::Type handle_hint(const Chunk& ch, Holder& h);
+
+State::Type handle_hidx(const Chunk& ch, Holder& h);
+
 State::Type handle_hdat(const Chunk& ch, Holder& h);
 
+State::Type handle_hdac(const Chunk& ch, Holder& h);
+
 State::Type handle_rdat(const Chunk& ch, Holder& h);
 
+State::Type handle_csum(const Chunk& ch, Holder& h);
+
 State::Type handle_fend(const Chunk& ch, Holder& h);
 
 class UnexpectedChunkType: public std::exception {
@@ -146,7 +168,7 @@ class UnexpectedChunkType: public std::exception {
 
 template <class ChunkIterator>
 Holder decode_chunks(ChunkIterator ch, ChunkIterator ch_end) {
-  Holder h;
+  Holder h{};
   State::Type state = State::INIT;
 
   try {
@@ -197,6 +219,9 @@ Holder decode_chunks(ChunkIterator ch, ChunkIterator ch_end) {
         if ((ch->type & 0xFFFF0000) == Chunk::HHDR) {
           state = handle_hhdr(*ch++, h);
         }
+        else if (ch->type == Chunk::CSUM) {
+          state = handle_csum(*ch++, h);
+        }
         else if (ch->type == Chunk::FEND) {
           state = handle_fend(*ch++, h);
         }
@@ -205,6 +230,15 @@ Holder decode_chunks(ChunkIterator ch, ChunkIterator ch_end) {
         }
         break;
 
+      case State::CSUM:
+        if (ch->type == Chunk::FEND) {
+          state = handle_fend(*ch++, h);
+        }
+        else {
+          throw UnexpectedChunkType();
+        }
+        break;
+
       case State::HHDR:
         switch (ch->type) {
         case Chunk::HINT:
@@ -212,16 +246,35 @@ Holder decode_chunks(ChunkIterator ch, ChunkIterator ch_end) {
           break;
         default:
           throw UnexpectedChunkType();
+        case Chunk::HIDX:
         case Chunk::HDAT:
+        case Chunk::HDAC:
           // intentional fall-through to HINT state
           ;
         }
         [[fallthrough]];
 
       case State::HINT:
+        switch (ch->type) {
+        case Chunk::HIDX:
+          state = handle_hidx(*ch++, h);
+          break;
+        default:
+          throw UnexpectedChunkType();
+        case Chunk::HDAT:
+        case Chunk::HDAC:
+          // intentional fall-through to HIDX state
+          ;
+        }
+        [[fallthrough]];
+
+      case State::HIDX:
         if (ch->type == Chunk::HDAT) {
           state = handle_hdat(*ch++, h);
         }
+        else if (ch->type == Chunk::HDAC) {
+          state = handle_hdac(*ch++, h);
+        }
         else {
           throw UnexpectedChunkType();
         }
@@ -250,3 +303,6 @@ Holder decode_chunks(ChunkIterator ch, ChunkIterator ch_end) {
 }
 
 Holder decode_hset(const uint8_t* beg, const uint8_t* end);
+
+// Decodes only the FHDR, for when the rest of the hset is not wanted
+FileHeader decode_hset_fhdr(const uint8_t* beg, const uint8_t* end);
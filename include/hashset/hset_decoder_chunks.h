@@ -16,10 +16,16 @@ HashsetFilter parse_filter(const Chunk& ch);
 
 HashsetHint parse_hint(const Chunk& ch);
 
+HashsetIndex parse_hidx(const Chunk& ch);
+
 ConstHashsetData parse_hdat(const Chunk& ch);
 
+ConstHashsetData parse_hdac(const Chunk& ch);
+
 ConstRecordIndex parse_ridx(const Chunk& ch);
 
+ChunkChecksums parse_csum(const Chunk& ch);
+
 RecordHeader parse_rhdr(const Chunk& ch);
 
 ConstRecordData parse_rdat(const Chunk& ch);
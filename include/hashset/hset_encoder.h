@@ -4,6 +4,7 @@
 #include <filesystem>
 #include <fstream>
 #include <iosfwd>
+#include <mutex>
 #include <string>
 #include <tuple>
 #include <utility>
@@ -37,6 +38,44 @@ struct SFHASH_HashsetBuildCtx {
   std::vector<std::ofstream> tmp_hashes_out;
 
   size_t field_pos;
+
+  uint32_t flags;
+
+  std::filesystem::path tmp_dir;
+  // sorts needing more memory than this go through tmp_dir; 0 for no limit
+  uint64_t memory_limit;
+
+  // guards the outputs and counts when thread handles flush to them
+  std::mutex mutex;
+  size_t open_threads;
+};
+
+// A producer thread's handle on a builder, which stages what the thread
+// adds and hands it to the builder a block at a time
+struct SFHASH_HashsetBuildThreadCtx {
+  SFHASH_HashsetBuildCtx* bctx;
+
+  size_t field_pos;
+  uint64_t record_count;
+
+  // whole records, with records; else the hashes of each field
+  std::vector<uint8_t> recs;
+  std::vector<std::vector<uint8_t>> hashes;
+  std::vector<uint64_t> hash_counts;
+
+  // the fields of the record being added whose hashes are staged, for
+  // dropping the record if it goes bad
+  std::vector<bool> staged;
+  // whether a hash of the record being added had the wrong length
+  bool bad_record;
+  // records dropped for that, reported on close
+  uint64_t bad_records;
+  // the first error adding through the handle, which has nowhere to go
+  // until close; nothing more is added once there is one
+  std::string error;
+
+  // staged bytes are flushed after the record which reaches this
+  size_t buffer_length;
 };
 
 size_t write_hashset(
@@ -52,6 +91,65 @@ void size_to_u64(uint8_t* dst, const char* src, size_t dlen);
 
 void check_strlen(const char* s, const char* sname);
 
+/*
+ * Parses lines of hashes, a space-separated column per field with empty
+ * columns for missing hashes, and adds them to a hashset builder.
+ *
+ * The text is cut into line-aligned chunks, which are parsed and converted
+ * a round of one per thread at a time, each thread adding its records
+ * through a thread handle of its own. Errors are reported with the line
+ * they are on.
+ */
+class TextIngester {
+public:
+  using Converter = std::pair<void (*)(uint8_t* dst, const char* src, size_t dlen), size_t>;
+
+  // threads = 0 for one per core
+  TextIngester(
+    SFHASH_HashsetBuildCtx* bctx,
+    const std::vector<Converter>& conv,
+    unsigned threads = 0,
+    size_t chunk_length = 1 << 22
+  );
+
+  // Adds the whole lines in [beg, end), and the partial line at the end if
+  // last; returns where what is left begins
+  const char* ingest(const char* beg, const char* end, bool last);
+
+  void ingest(std::istream& in);
+
+  // Maps infile and adds all of it
+  void ingest(const std::filesystem::path& infile);
+
+  // The number of lines added so far
+  size_t lines() const { return LineNo; }
+
+private:
+  struct Chunk {
+    const char* beg;
+    const char* end;
+    SFHASH_HashsetBuildThreadCtx* tctx;
+    // a line's record, a presence byte and hash for each field
+    std::vector<uint8_t> rec;
+    size_t lines;
+    // the first bad line, counting from 1, or 0
+    size_t error_line;
+    std::string error;
+    std::string col;
+  };
+
+  void parse(Chunk& c) const;
+
+  void close_handles(unsigned n);
+
+  SFHASH_HashsetBuildCtx* Bctx;
+  const std::vector<Converter>& Conv;
+  size_t RecordLength;
+  size_t ChunkLength;
+  std::vector<Chunk> Chunks;
+  size_t LineNo;
+};
+
 void write_hset(
   std::istream& in,
   const std::vector<SFHASH_HashAlgorithm>& htypes,
@@ -61,7 +159,22 @@ void write_hset(
   const std::filesystem::path& outfile,
   const std::filesystem::path& tmpdir,
   bool with_records,
-  bool with_hashsets
+  bool with_hashsets,
+  uint32_t flags = 0
+);
+
+// As write_hset from a stream, but maps infile
+void write_hset(
+  const std::filesystem::path& infile,
+  const std::vector<SFHASH_HashAlgorithm>& htypes,
+  const std::vector<std::pair<void (*)(uint8_t* dst, const char* src, size_t dlen), size_t>>& conv,
+  const char* hset_name,
+  const char* hset_desc,
+  const std::filesystem::path& outfile,
+  const std::filesystem::path& tmpdir,
+  bool with_records,
+  bool with_hashsets,
+  uint32_t flags = 0
 );
 
 std::vector<
@@ -1,15 +1,19 @@
 #pragma once
 
+#include <array>
 #include <cstddef>
 #include <cstdint>
 #include <string>
+#include <tuple>
 #include <utility>
 #include <vector>
 
 #include "rwutil.h"
+#include "hashset/hint_select.h"
 #include "hashset/hset_structs.h"
 
 struct binary_fuse8_s;
+struct PerfectHashData;
 using binary_fuse8_t = binary_fuse8_s;
 
 template <auto func, typename... Args>
@@ -104,20 +108,35 @@ size_t write_hhnn(
   char* out
 );
 
-size_t length_hint_data();
+size_t length_hint_data(uint16_t hint_type);
 
-size_t length_hint();
+size_t length_hint(uint16_t hint_type);
 
-size_t write_hint_data(
+// The room for the HINT of up to hash_count hashes, whichever is chosen
+size_t length_hint_max(uint64_t hash_count);
+
+size_t write_block_hint_data(
   const std::vector<std::pair<int64_t, int64_t>>& block_bounds,
   char* out
 );
 
-size_t write_hint(
-  const std::vector<std::pair<int64_t, int64_t>>& block_bounds,
+size_t write_linear_hint_data(
+  const std::vector<std::tuple<float, float, float, float>>& block_lines,
   char* out
 );
 
+size_t write_hint_data(const HintCandidate& hint, char* out);
+
+size_t write_hint(const HintCandidate& hint, char* out);
+
+size_t length_hidx_data(uint64_t hash_count);
+
+size_t length_hidx(uint64_t hash_count);
+
+size_t write_hidx_data(const PerfectHashData& phd, char* out);
+
+size_t write_hidx(const PerfectHashData& phd, char* out);
+
 size_t length_filter_data(uint64_t hash_count);
 
 size_t length_filter(uint64_t hash_count);
@@ -140,6 +159,23 @@ size_t write_hdat(
   char* out
 );
 
+size_t length_hdac_data(size_t hash_count, size_t hash_size);
+
+size_t length_hdac(size_t hash_count, size_t hash_size);
+
+// hdat may be where the data will go, to compress it in place
+size_t write_hdac_data(
+  const HashsetData& hdat,
+  size_t hash_size,
+  char* out
+);
+
+size_t write_hdac(
+  const HashsetData& hdat,
+  size_t hash_size,
+  char* out
+);
+
 size_t length_ridx_data(size_t record_count);
 
 size_t length_ridx(size_t record_count);
@@ -220,6 +256,24 @@ size_t write_ftoc(
   char* out
 );
 
+size_t length_csum_data(size_t segment_count);
+
+size_t length_csum(size_t segment_count);
+
+size_t write_csum_data(
+  const char* beg,
+  const TableOfContents& toc,
+  unsigned threads,
+  char* out
+);
+
+size_t write_csum(
+  const char* beg,
+  const TableOfContents& toc,
+  unsigned threads,
+  char* out
+);
+
 size_t length_fend_data();
 
 size_t length_fend();
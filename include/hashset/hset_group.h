@@ -0,0 +1,110 @@
+#pragma once
+
+#include "hasher/hashset.h"
+#include "hashset/lookup_stats.h"
+#include "hashset/perfect_hash.h"
+#include "hashset/hset_structs.h"
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/*
+ * A blocked Bloom filter: each key sets its bits within a single 64-byte
+ * block, so checking a key costs at most one cache miss.
+ */
+class GroupFilter {
+public:
+  GroupFilter() = default;
+
+  explicit GroupFilter(uint64_t key_count);
+
+  static uint64_t key(const uint8_t* hash, size_t len) noexcept {
+    return perfect_hash_key(hash, len, SEED);
+  }
+
+  void insert(uint64_t k) noexcept;
+
+  bool maybe_contains(uint64_t k) const noexcept {
+    const Block& b = Blocks[block(k)];
+    const uint64_t h = perfect_hash_mix(k);
+    for (unsigned i = 0; i < BITS_PER_KEY; ++i) {
+      const unsigned bit = (h >> (9 * i)) & 511;
+      if (!((b.w[bit / 64] >> (bit % 64)) & 1)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void prefetch(uint64_t k) const noexcept {
+    __builtin_prefetch(Blocks.data() + block(k));
+  }
+
+private:
+  static constexpr uint64_t SEED = 0x47726F7570536574ull;
+  static constexpr unsigned BITS_PER_KEY = 7;
+
+  uint64_t block(uint64_t k) const noexcept {
+    return perfect_hash_reduce(k, Blocks.size());
+  }
+
+  struct alignas(64) Block {
+    uint64_t w[8];
+  };
+
+  std::vector<Block> Blocks;
+};
+
+/*
+ * The hashes of one type from every hashset in a group, merged into one
+ * sorted array without duplicates. Each entry is a hash followed by a
+ * bitmap of the hashsets which contain it, so one search answers for all
+ * of them. Offsets, indexed by the leading bits of a hash, narrow the
+ * search to a few entries; the filter turns most misses away before that.
+ * The stats count filter rejections as rejections.
+ */
+struct GroupTable {
+  SFHASH_HashAlgorithm hash_type;
+  size_t hash_length;
+  size_t stride;
+  uint64_t count;
+  unsigned bits;
+  std::vector<uint64_t> offsets;
+  std::vector<uint8_t> entries;
+  GroupFilter filter;
+  std::unique_ptr<LookupStats> stats;
+};
+
+/*
+ * Merges the sorted hashes of length hash_length in the given hashsets'
+ * HDATs into a table; the first of each pair is the hashset's bit in the
+ * membership bitmaps, which are words 64-bit words long.
+ */
+GroupTable make_group_table(
+  SFHASH_HashAlgorithm hash_type,
+  size_t hash_length,
+  const std::vector<std::pair<size_t, ConstHashsetData>>& hsds,
+  size_t words
+);
+
+bool group_lookup(
+  const GroupTable& t,
+  size_t words,
+  const uint8_t* hash,
+  uint64_t* members
+);
+
+void group_lookup_bulk(
+  const GroupTable& t,
+  size_t words,
+  const uint8_t* hashes,
+  size_t count,
+  uint64_t* members
+);
+
+struct SFHASH_HashsetGroup {
+  size_t words;
+  std::vector<GroupTable> tables;
+};
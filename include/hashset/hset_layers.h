@@ -0,0 +1,41 @@
+#pragma once
+
+#include "hasher/hashset.h"
+#include "hashset/hset_manifest.h"
+
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+ * A hashset updated by appending deltas rather than rebuilding it.
+ *
+ * Each layer is an ordinary hset file: the first is the base, and each
+ * after it a delta holding only the hashes appended to it, so an update
+ * costs as much as its delta. Lookups consult every layer. Compaction
+ * merges the layers into one. A text manifest lists the hash types and the
+ * layers:
+ *
+ *   hasher-layers 1
+ *   type <SFHASH_HashAlgorithm> <hash length> <hash name>
+ *   ...
+ *   layer <path>
+ *   ...
+ *
+ * with the base first, and paths relative to the manifest's directory.
+ */
+
+struct LayerManifest {
+  std::vector<ManifestType> types;
+  std::vector<std::string> layers;
+};
+
+LayerManifest read_layer_manifest(std::istream& in);
+
+void write_layer_manifest(const LayerManifest& m, std::ostream& out);
+
+struct SFHASH_HashsetLayers {
+  LayerManifest manifest;
+  std::vector<std::unique_ptr<SFHASH_Hashset, void (*)(SFHASH_Hashset*)>> layers;
+};
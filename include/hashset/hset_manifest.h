@@ -0,0 +1,82 @@
+#pragma once
+
+#include "hasher/hashset.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+/*
+ * What the text manifests of shards and of layers have in common:
+ *
+ *   <magic> <version>
+ *   type <SFHASH_HashAlgorithm> <hash length> <hash name>
+ *   ...
+ *   <kind> <rest of the entry>
+ *   ...
+ *
+ * Every hset a manifest lists has its types, in their order, so a type's
+ * index is the same in all of them.
+ */
+
+// The magics of the manifests of shards and of layers
+extern const char SHARD_MANIFEST_MAGIC[];
+extern const char LAYER_MANIFEST_MAGIC[];
+
+struct ManifestType {
+  SFHASH_HashAlgorithm hash_type;
+  size_t hash_length;
+  std::string hash_name;
+};
+
+// Reads a manifest, returning its types and passing each other entry to
+// entry with its kind, the rest of its line, and its line number; entry
+// returns false for a kind it does not know. what names the manifest in
+// errors.
+std::vector<ManifestType> read_manifest(
+  std::istream& in,
+  const char* magic,
+  unsigned version,
+  const char* what,
+  const std::function<bool(const std::string&, std::istream&, size_t)>& entry
+);
+
+// Throws, naming the function which opens it, if [beg, end) is a manifest
+// rather than an hset
+void check_not_manifest(const uint8_t* beg, const uint8_t* end);
+
+// Writes a manifest's header and types, for its entries to follow
+void write_manifest_types(
+  const std::vector<ManifestType>& types,
+  const char* magic,
+  unsigned version,
+  std::ostream& out
+);
+
+// The types of hset, as a manifest has them
+std::vector<ManifestType> manifest_types(const SFHASH_Hashset& hset);
+
+// Throws unless hset, opened from path, has exactly the given types, in
+// their order
+void check_hset_types(
+  const SFHASH_Hashset& hset,
+  const std::vector<ManifestType>& types,
+  const std::string& path
+);
+
+// Builds an hset at path with the given types, with records or with
+// hashsets only, from whatever add puts in the builder
+void write_manifest_hset(
+  const std::string& name,
+  const std::string& desc,
+  const std::vector<ManifestType>& types,
+  bool with_records,
+  const std::filesystem::path& path,
+  const char* temp_dir,
+  uint32_t flags,
+  const std::function<void(SFHASH_HashsetBuildCtx*)>& add
+);
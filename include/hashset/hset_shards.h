@@ -0,0 +1,76 @@
+#pragma once
+
+#include "hasher/hashset.h"
+#include "hashset/hset_manifest.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*
+ * A hashset split into shards by hash prefix.
+ *
+ * Each shard is an ordinary hset file holding, for every hash type, the
+ * hashes whose leading 64 bits (big-endian, zero-padded for shorter
+ * hashes) are in [first, last]; the shards' ranges do not overlap. A text
+ * manifest lists the hash types and the shards:
+ *
+ *   hasher-shards 1
+ *   type <SFHASH_HashAlgorithm> <hash length> <hash name>
+ *   ...
+ *   shard <first, 16 hex digits> <last, 16 hex digits> <path>
+ *   ...
+ *
+ * with the shards in order of prefix, and their paths relative to the
+ * manifest's directory.
+ */
+
+struct ShardEntry {
+  uint64_t first;
+  uint64_t last;
+  std::string path;
+};
+
+struct ShardManifest {
+  std::vector<ManifestType> types;
+  std::vector<ShardEntry> shards;
+};
+
+ShardManifest read_shard_manifest(std::istream& in);
+
+void write_shard_manifest(const ShardManifest& m, std::ostream& out);
+
+// The leading 64 bits of a hash, by which it is sharded
+uint64_t shard_prefix(const uint8_t* hash, size_t hash_length);
+
+// The index of the shard covering prefix p, or -1 if none does
+int shard_for_prefix(const ShardManifest& m, uint64_t p);
+
+// The first prefix of shard i of n equal ranges
+uint64_t shard_range_first(size_t i, size_t n);
+
+struct SFHASH_HashsetShards {
+  ShardManifest manifest;
+  // the manifest's directory, against which shard paths are resolved
+  std::string dir;
+  uint32_t flags;
+
+  // each shard is opened on first use
+  struct Shard {
+    std::once_flag opened;
+    std::unique_ptr<SFHASH_Hashset, void (*)(SFHASH_Hashset*)> hset{
+      nullptr, sfhash_destroy_hashset
+    };
+  };
+
+  std::unique_ptr<Shard[]> shards;
+  mutable std::atomic<size_t> open_count{0};
+};
+
+// Opens shard i if it is not yet open; throws if it cannot be
+const SFHASH_Hashset& open_shard(const SFHASH_HashsetShards& s, size_t i);
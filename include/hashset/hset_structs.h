@@ -1,6 +1,7 @@
 #pragma once
 
 #include <array>
+#include <cstddef>
 #include <cstdint>
 #include <iosfwd>
 #include <string>
@@ -69,14 +70,37 @@ struct HashsetHint {
 
 std::ostream& operator<<(std::ostream& out, const HashsetHint& hint);
 
+/*
+ * A hint type has its HintType in the high byte and, for hints with
+ * bounds per block, the number of leading bits of a hash which pick its
+ * block in the low byte; so 'b' 0x08 is constant bounds for 256 blocks.
+ */
 enum HintType {
   BASIC = 0,
-  RADIUS = 1,
-  RANGE = 2,
+  RADIUS = 'r',
+  RANGE = 'R',
   BLOCK = 'b',
-  BLOCK_LINEAR = 4
+  BLOCK_LINEAR = 'l'
 };
 
+constexpr unsigned MIN_HINT_BLOCK_BITS = 4;
+constexpr unsigned MAX_HINT_BLOCK_BITS = 16;
+
+constexpr uint16_t make_hint_type(HintType kind, unsigned block_bits = 0) {
+  return static_cast<uint16_t>((kind << 8) | block_bits);
+}
+
+constexpr HintType hint_kind(uint16_t hint_type) {
+  return static_cast<HintType>(hint_type >> 8);
+}
+
+constexpr unsigned hint_block_bits(uint16_t hint_type) {
+  return hint_type & 0xFF;
+}
+
+// The length of a HINT's data for hint_type, or 0 if it is not a hint type
+size_t hint_data_length(uint16_t hint_type);
+
 struct HashsetFilter {
   uint16_t filter_type;
   const void* beg;
@@ -96,6 +120,46 @@ enum FilterType {
   BINARY_FUSE = 1
 };
 
+struct HashsetIndex {
+  uint16_t index_type;
+  const void* beg;
+  const void* end;
+
+// C++20: bool operator==(const HashsetIndex&) const = default;
+  bool operator==(const HashsetIndex& o) const {
+    return index_type == o.index_type &&
+           beg == o.beg &&
+           end == o.end;
+  }
+};
+
+std::ostream& operator<<(std::ostream& out, const HashsetIndex& hidx);
+
+enum IndexType {
+  PERFECT_HASH = 1
+};
+
+struct ChunkChecksums {
+  uint16_t checksum_type;
+  uint64_t segment_length;
+  const void* beg;
+  const void* end;
+
+// C++20: bool operator==(const ChunkChecksums&) const = default;
+  bool operator==(const ChunkChecksums& o) const {
+    return checksum_type == o.checksum_type &&
+           segment_length == o.segment_length &&
+           beg == o.beg &&
+           end == o.end;
+  }
+};
+
+std::ostream& operator<<(std::ostream& out, const ChunkChecksums& csum);
+
+enum ChecksumType {
+  BLAKE3_256 = 1
+};
+
 struct HashsetData {
   uint8_t* beg;
   uint8_t* end;
@@ -108,10 +172,12 @@ std::ostream& operator<<(std::ostream& out, const HashsetData& hdat);
 struct ConstHashsetData {
   const void* beg;
   const void* end;
+  // an HDAC rather than an HDAT: not an array of hashes
+  bool compressed = false;
 
 // C++20: bool operator==(const ConstHashsetData&) const = default;
   bool operator==(const ConstHashsetData& o) const {
-    return beg == o.beg && end == o.end;
+    return beg == o.beg && end == o.end && compressed == o.compressed;
   }
 };
 
@@ -200,9 +266,12 @@ struct Chunk {
     RDAT = 0x52444154,
     HHDR = 0x48480000,
     HDAT = 0x48444154,
+    HDAC = 0x48444143,
     HINT = 0x48494E54,
     FLTR = 0x464C5452,
+    HIDX = 0x48494458,
     RIDX = 0x52494458,
+    CSUM = 0x4353554D,
     FEND = 0x46454E44
   };
 
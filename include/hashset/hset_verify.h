@@ -0,0 +1,68 @@
+#pragma once
+
+#include "hasher/hashset.h"
+#include "hashset/hset_structs.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct Holder;
+
+// the length of the pieces into which CSUM cuts the chunks it covers
+constexpr uint64_t CSUM_SEGMENT_LENGTH = 1 << 22;
+
+constexpr size_t CSUM_DIGEST_LENGTH = 32;
+
+struct ChecksumSegment {
+  uint64_t off;
+  uint64_t len;
+  // the FTOC entry of the chunk and the digest for this piece of it
+  size_t entry;
+  size_t digest;
+};
+
+/*
+ * The pieces covered by the digests in the CSUM chunk listed in the FTOC:
+ * each chunk before the CSUM, from its offset up to the next chunk's (so
+ * including any padding), cut into pieces of segment_length, at least one
+ * per chunk.
+ */
+std::vector<ChecksumSegment> checksum_segments(
+  const TableOfContents& ftoc,
+  uint64_t segment_length
+);
+
+/*
+ * Writes the digest of each segment of [beg, ...) to out, using up to
+ * threads threads.
+ */
+void compute_checksums(
+  const uint8_t* beg,
+  const std::vector<ChecksumSegment>& segs,
+  uint8_t* out,
+  unsigned threads
+);
+
+/*
+ * Checks each segment of [beg, ...) against its digest, using up to
+ * threads threads. Returns the first segment which does not match, or
+ * segs.size() if all do.
+ */
+size_t verify_checksums(
+  const uint8_t* beg,
+  const std::vector<ChecksumSegment>& segs,
+  const uint8_t* digests,
+  unsigned threads
+);
+
+/*
+ * Verifies a decoded hset, or only the parts of it which lookups in
+ * hashset tidx read if tidx is not -1. Throws on a mismatch.
+ */
+void verify_hset(
+  const Holder& h,
+  int tidx,
+  unsigned threads,
+  SFHASH_HashsetVerifyStats* stats
+);
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Counters of the work done by lookups, kept by each lookup strategy.
+ *
+ * Counting is off until turned on by set_lookup_stats_enabled(), and while
+ * it is off a lookup pays one relaxed load to find that out. Building with
+ * HASHER_NO_LOOKUP_STATS defined removes the counting altogether.
+ *
+ * Each thread counts into its own slot, on its own cache line, so threads
+ * looking up in the same hashset do not fight over the counters; total()
+ * sums the slots.
+ */
+
+struct LookupStatsCounts {
+  uint64_t lookups = 0;
+  uint64_t hits = 0;
+  // stored hashes compared against, as the searches count them
+  uint64_t probes = 0;
+  // the total and largest widths of the windows searched, in hashes
+  uint64_t window_total = 0;
+  uint64_t window_max = 0;
+  // misses found without reading HDAT, from the hint or index alone
+  uint64_t rejections = 0;
+
+  void window(size_t w) {
+    window_total += w;
+    window_max = w > window_max ? w : window_max;
+    rejections += !w;
+  }
+};
+
+// About the most hashes a binary search of a window of w hashes compares
+// against; an estimate, for choosing hints, where lookups count the
+// comparisons they make
+inline uint64_t binary_search_probes(size_t w) {
+  return w ? 64 - __builtin_clzll(w) : 0;
+}
+
+// A comparator which counts its comparisons into n, for searches done by
+// the standard algorithms
+template <class Less>
+struct CountingLess {
+  uint64_t& n;
+
+  template <class A, class B>
+  bool operator()(const A& a, const B& b) const {
+    ++n;
+    return Less()(a, b);
+  }
+};
+
+// set_lookup_stats_enabled() returns false if counting was compiled out
+#ifdef HASHER_NO_LOOKUP_STATS
+constexpr bool lookup_stats_enabled() { return false; }
+
+inline bool set_lookup_stats_enabled(bool) { return false; }
+#else
+inline std::atomic<bool> LookupStatsEnabled{false};
+
+inline bool lookup_stats_enabled() {
+  return LookupStatsEnabled.load(std::memory_order_relaxed);
+}
+
+inline bool set_lookup_stats_enabled(bool enabled) {
+  LookupStatsEnabled.store(enabled, std::memory_order_relaxed);
+  return true;
+}
+#endif
+
+class LookupStats {
+public:
+  LookupStats() {
+    reset();
+  }
+
+  void add(const LookupStatsCounts& c) {
+    auto& s = Slots[slot()];
+    s.lookups.fetch_add(c.lookups, std::memory_order_relaxed);
+    s.hits.fetch_add(c.hits, std::memory_order_relaxed);
+    s.probes.fetch_add(c.probes, std::memory_order_relaxed);
+    s.window_total.fetch_add(c.window_total, std::memory_order_relaxed);
+    s.rejections.fetch_add(c.rejections, std::memory_order_relaxed);
+
+    uint64_t m = s.window_max.load(std::memory_order_relaxed);
+    while (c.window_max > m &&
+           !s.window_max.compare_exchange_weak(m, c.window_max, std::memory_order_relaxed)) {}
+  }
+
+  LookupStatsCounts total() const {
+    LookupStatsCounts t;
+    for (const auto& s: Slots) {
+      t.lookups += s.lookups.load(std::memory_order_relaxed);
+      t.hits += s.hits.load(std::memory_order_relaxed);
+      t.probes += s.probes.load(std::memory_order_relaxed);
+      t.window_total += s.window_total.load(std::memory_order_relaxed);
+      t.rejections += s.rejections.load(std::memory_order_relaxed);
+
+      const uint64_t m = s.window_max.load(std::memory_order_relaxed);
+      t.window_max = m > t.window_max ? m : t.window_max;
+    }
+    return t;
+  }
+
+  void reset() {
+    for (auto& s: Slots) {
+      s.lookups = s.hits = s.probes = 0;
+      s.window_total = s.window_max = s.rejections = 0;
+    }
+  }
+
+private:
+  // more threads than slots share slots, which is still correct
+  static constexpr size_t SLOTS = 64;
+
+  static size_t slot() {
+    static std::atomic<size_t> next{0};
+    thread_local const size_t s = next++ % SLOTS;
+    return s;
+  }
+
+  struct alignas(64) Slot {
+    std::atomic<uint64_t> lookups, hits, probes,
+                          window_total, window_max, rejections;
+  };
+
+  std::array<Slot, SLOTS> Slots;
+};
@@ -1,13 +1,74 @@
 #pragma once
 
+#include "hashset/lookup_stats.h"
+
 #include <cstddef>
 #include <cstdint>
+#include <utility>
 
 struct SFHASH_Hashset;
 
+/*
+ * Entry points for lookups bound to one strategy class, taking that
+ * strategy as ls; they call its functions directly, not through the
+ * vtable, so a caller can resolve them once and then call them in a loop.
+ */
+struct LookupFunctions {
+  bool (*contains)(const void* ls, const void* hash);
+
+  void (*contains_bulk)(
+    const void* ls,
+    const void* hashes,
+    size_t count,
+    bool* results
+  );
+};
+
 class LookupStrategy {
 public:
   virtual ~LookupStrategy() {}
 
+  // The entry points for this strategy's own class; each class which
+  // overrides contains must override this, with lookup_functions<itself>()
+  virtual LookupFunctions functions() const = 0;
+
   virtual bool contains(const uint8_t* hash) const = 0;
+
+  // Sets results[i] to whether the ith hash in the packed array hashes is
+  // contained, for i in [0, count)
+  virtual void contains_bulk(
+    const uint8_t* hashes,
+    size_t count,
+    bool* results
+  ) const = 0;
+
+  // Returns the range of indices [l, r) of the hashes equal to hash; the
+  // range is empty if hash is not contained
+  virtual std::pair<size_t, size_t> find_range(const uint8_t* hash) const = 0;
+
+  // Counters of the lookups done while lookup_stats_enabled()
+  LookupStats& stats() const {
+    return Stats;
+  }
+
+protected:
+  mutable LookupStats Stats;
 };
+
+template <class Strategy>
+LookupFunctions lookup_functions() {
+  return {
+    [](const void* ls, const void* hash) {
+      return static_cast<const Strategy*>(
+        static_cast<const LookupStrategy*>(ls)
+      )->Strategy::contains(static_cast<const uint8_t*>(hash));
+    },
+    [](const void* ls, const void* hashes, size_t count, bool* results) {
+      static_cast<const Strategy*>(
+        static_cast<const LookupStrategy*>(ls)
+      )->Strategy::contains_bulk(
+        static_cast<const uint8_t*>(hashes), count, results
+      );
+    }
+  };
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+/*
+ * A read-only mapping of a whole file, with the SFHASH_HashsetOpenFlags
+ * which apply to the mapping as a whole (populate, huge pages, advice,
+ * locking) applied to it.
+ */
+class MappedFile {
+public:
+  MappedFile(const std::string& path, uint32_t flags);
+
+  const uint8_t* begin() const {
+    return static_cast<const uint8_t*>(Region.get_address());
+  }
+
+  const uint8_t* end() const {
+    return begin() + Region.get_size();
+  }
+
+private:
+  boost::interprocess::file_mapping File;
+  boost::interprocess::mapped_region Region;
+};
+
+/*
+ * Touches each page of the given ranges, spread over up to threads
+ * threads, so that they are read in before the first lookup needs them.
+ */
+void prefault_pages(
+  const std::vector<std::pair<const void*, const void*>>& ranges,
+  unsigned threads
+);
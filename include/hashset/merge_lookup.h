@@ -0,0 +1,244 @@
+#pragma once
+
+#include "hashset/hash_compare.h"
+#include "hashset/util.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+/*
+ * Bulk lookup by sorting the queries and merging them against HDAT.
+ *
+ * Searching for each hash costs a few cache misses per hash no matter how
+ * many hashes are looked up. When a batch is a sizable fraction of the
+ * hashset, it is cheaper to sort the batch and walk it and HDAT together,
+ * reading HDAT once, in order.
+ */
+
+// A query: the first 4 bytes of its hash, big-endian, so that prefixes
+// order as the hashes do, and its position in the batch. Keeping these
+// small keeps the sort cheap; the rest of the hash is read only to break
+// ties and to confirm matches.
+struct MergeQuery {
+  uint32_t prefix;
+  uint32_t idx;
+};
+
+inline uint32_t merge_prefix(const uint8_t* h) {
+  return load_be32(h);
+}
+
+/*
+ * LSD radix sorts n queries on bytes [lo, hi) of their prefixes, where
+ * byte 0 is the least significant, using scratch as a buffer. Passes on
+ * bytes which are the same for every query are skipped. Returns whichever
+ * of queries or scratch holds the sorted queries.
+ */
+MergeQuery* radix_sort_queries(
+  MergeQuery* queries,
+  MergeQuery* scratch,
+  size_t n,
+  unsigned lo,
+  unsigned hi
+);
+
+template <size_t HashLength>
+class MergeJoin {
+public:
+  using Hash = std::array<uint8_t, HashLength>;
+
+  MergeJoin(
+    const Hash* data,
+    size_t n,
+    const Hash* queries,
+    bool* results
+  ):
+    Data(data), N(n), Queries(queries), Results(results)
+  {}
+
+  // Sorts and merges top-byte buckets [bb, be); s holds the queries sorted
+  // on their top bytes, bstart the bucket bounds in s, and t is scratch.
+  void operator()(
+    MergeQuery* s,
+    MergeQuery* t,
+    const std::array<size_t, 257>& bstart,
+    unsigned bb,
+    unsigned be) const
+  {
+    // everything before the first hash with top byte bb precedes all of
+    // these queries
+    size_t j = std::partition_point(
+      Data, Data + N, [bb](const Hash& h) { return h[0] < bb; }
+    ) - Data;
+
+    for (unsigned b = bb; b < be; ++b) {
+      const size_t off = bstart[b], len = bstart[b + 1] - off;
+      if (!len) {
+        continue;
+      }
+
+      MergeQuery* q = radix_sort_queries(s + off, t + off, len, 0, 3);
+      sort_ties(q, q + len);
+      j = merge(q, q + len, j);
+    }
+  }
+
+private:
+  bool less(const Hash& h, const MergeQuery& m) const {
+    const uint32_t p = merge_prefix(h.data());
+    return p < m.prefix || (
+      p == m.prefix &&
+      hash_less<HashLength>(h.data(), Queries[m.idx].data())
+    );
+  }
+
+  // The radix sort orders the queries by prefix only; finish the runs of
+  // queries which share a prefix.
+  void sort_ties(MergeQuery* beg, MergeQuery* end) const {
+    for (MergeQuery* i = beg; i != end; ) {
+      MergeQuery* j = i + 1;
+      while (j != end && j->prefix == i->prefix) {
+        ++j;
+      }
+
+      if (j - i > 1) {
+        std::sort(
+          i, j,
+          [this](const MergeQuery& l, const MergeQuery& r) {
+            return hash_less<HashLength>(
+              Queries[l.idx].data(), Queries[r.idx].data()
+            );
+          }
+        );
+      }
+
+      i = j;
+    }
+  }
+
+  // Data[j] is the first hash not less than the query before beg; returns
+  // the first hash not less than the query before end.
+  size_t merge(const MergeQuery* beg, const MergeQuery* end, size_t j) const {
+    // the queries and results are reached through the indices in random
+    // order, so fetch them well ahead of use
+    constexpr ptrdiff_t AHEAD = 16;
+
+    for (const MergeQuery* m = beg; m != end; ++m) {
+      if (end - m > AHEAD) {
+        __builtin_prefetch(Queries + m[AHEAD].idx);
+        __builtin_prefetch(Results + m[AHEAD].idx, 1);
+      }
+
+      if (j < N && less(Data[j], *m)) {
+        // gallop, so that sparse queries skip over HDAT quickly
+        size_t lo = j + 1, hi = j + 1, step = 1;
+        while (hi < N && less(Data[hi], *m)) {
+          lo = hi + 1;
+          hi += step;
+          step <<= 1;
+        }
+
+        j = std::partition_point(
+          Data + lo, Data + std::min(hi, N),
+          [this, m](const Hash& h) { return less(h, *m); }
+        ) - Data;
+      }
+
+      Results[m->idx] = j < N &&
+        merge_prefix(Data[j].data()) == m->prefix &&
+        hash_eq<HashLength>(Data[j].data(), Queries[m->idx].data());
+    }
+    return j;
+  }
+
+  const Hash* Data;
+  size_t N;
+  const Hash* Queries;
+  bool* Results;
+};
+
+/*
+ * Looks up count hashes in the sorted hashes [beg, end), setting results[i]
+ * for the ith hash. Uses 16 bytes of scratch space per hash.
+ *
+ * The queries are partitioned on their top bytes; the partitions are then
+ * sorted and merged independently, split over up to threads threads.
+ */
+template <size_t HashLength>
+struct MergeLookup {
+  void operator()(
+    const void* beg,
+    const void* end,
+    const uint8_t* hashes,
+    size_t count,
+    bool* results,
+    unsigned threads) const
+  {
+    // query indices are 32-bit, so take enormous batches in pieces
+    constexpr size_t MAX_BATCH = std::numeric_limits<uint32_t>::max();
+
+    for (size_t off = 0; off < count; off += MAX_BATCH) {
+      lookup(
+        beg, end,
+        hashes + off * HashLength, std::min(count - off, MAX_BATCH),
+        results + off,
+        threads
+      );
+    }
+  }
+
+private:
+  void lookup(
+    const void* beg,
+    const void* end,
+    const uint8_t* hashes,
+    size_t count,
+    bool* results,
+    unsigned threads) const
+  {
+    using Hash = std::array<uint8_t, HashLength>;
+
+    const Hash* data = static_cast<const Hash*>(beg);
+    const Hash* queries = reinterpret_cast<const Hash*>(hashes);
+
+    std::vector<MergeQuery> a(count), b(count);
+    for (size_t i = 0; i < count; ++i) {
+      a[i] = { merge_prefix(queries[i].data()), static_cast<uint32_t>(i) };
+    }
+
+    MergeQuery* s = radix_sort_queries(a.data(), b.data(), count, 3, 4);
+    MergeQuery* t = s == a.data() ? b.data() : a.data();
+
+    std::array<size_t, 257> bstart;
+    for (unsigned k = 0; k < bstart.size(); ++k) {
+      bstart[k] = std::partition_point(
+        s, s + count, [k](const MergeQuery& m) { return (m.prefix >> 24) < k; }
+      ) - s;
+    }
+
+    const MergeJoin<HashLength> join(
+      data, static_cast<const Hash*>(end) - data, queries, results
+    );
+
+    // give each thread a run of whole buckets holding about 1/threads of
+    // the queries; threads then touch disjoint parts of HDAT
+    threads = std::clamp(threads, 1u, 256u);
+
+    std::vector<unsigned> tb{0};
+    for (unsigned k = 1; k < threads; ++k) {
+      tb.push_back(std::lower_bound(
+        bstart.begin(), bstart.end() - 1, k * (count / threads)
+      ) - bstart.begin());
+    }
+    tb.push_back(256);
+
+    run_on_threads(threads, [&](unsigned k) {
+      if (tb[k] < tb[k + 1]) {
+        join(s, t, bstart, tb[k], tb[k + 1]);
+      }
+    });
+  }
+};
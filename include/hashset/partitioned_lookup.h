@@ -0,0 +1,134 @@
+#pragma once
+
+#include "hashset/lookupstrategy.h"
+#include "hashset/util.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+/*
+ * Bulk lookup split over threads.
+ *
+ * Splitting a batch into contiguous pieces would have every thread search
+ * all of HDAT. Instead, the hashes are first grouped by their top bytes,
+ * and each thread searches a run of whole groups, so that the threads read
+ * disjoint parts of HDAT (and of any index over it) and each part stays in
+ * the cache of the core searching it.
+ */
+
+// Fewer hashes than this per thread are not worth a thread.
+constexpr size_t PARTITIONED_LOOKUP_MIN_PER_THREAD = 1 << 14;
+
+template <size_t HashLength>
+struct PartitionedLookup {
+  void operator()(
+    const LookupStrategy& ls,
+    const uint8_t* hashes,
+    size_t count,
+    bool* results,
+    unsigned threads) const
+  {
+    threads = std::clamp<size_t>(
+      threads, 1, std::max<size_t>(1, count / PARTITIONED_LOOKUP_MIN_PER_THREAD)
+    );
+
+    if (threads == 1) {
+      ls.contains_bulk(hashes, count, results);
+      return;
+    }
+
+    // query indices are 32-bit, so take enormous batches in pieces
+    constexpr size_t MAX_BATCH = std::numeric_limits<uint32_t>::max();
+
+    for (size_t off = 0; off < count; off += MAX_BATCH) {
+      lookup(
+        ls,
+        hashes + off * HashLength, std::min(count - off, MAX_BATCH),
+        results + off,
+        threads
+      );
+    }
+  }
+
+private:
+  using Hash = std::array<uint8_t, HashLength>;
+
+  void lookup(
+    const LookupStrategy& ls,
+    const uint8_t* hashes,
+    size_t count,
+    bool* results,
+    unsigned threads) const
+  {
+    threads = std::min(threads, 256u);
+
+    const Hash* queries = reinterpret_cast<const Hash*>(hashes);
+
+    // each thread counts and groups a contiguous slice of the batch
+    const auto slice = [count, threads](unsigned k) {
+      return count / threads * k + std::min<size_t>(k, count % threads);
+    };
+
+    std::vector<std::array<size_t, 256>> pos(threads);
+    run_on_threads(threads, [&](unsigned k) {
+      auto& c = pos[k];
+      c.fill(0);
+      for (size_t i = slice(k); i < slice(k + 1); ++i) {
+        ++c[queries[i][0]];
+      }
+    });
+
+    // turn the counts into where each thread puts its hashes of each group
+    std::array<size_t, 257> bstart;
+    size_t sum = 0;
+    for (unsigned b = 0; b < 256; ++b) {
+      bstart[b] = sum;
+      for (unsigned k = 0; k < threads; ++k) {
+        const size_t c = pos[k][b];
+        pos[k][b] = sum;
+        sum += c;
+      }
+    }
+    bstart[256] = sum;
+
+    std::unique_ptr<Hash[]> grouped(new Hash[count]);
+    std::unique_ptr<uint32_t[]> idx(new uint32_t[count]);
+    std::unique_ptr<bool[]> found(new bool[count]);
+
+    run_on_threads(threads, [&](unsigned k) {
+      auto& p = pos[k];
+      for (size_t i = slice(k); i < slice(k + 1); ++i) {
+        const size_t j = p[queries[i][0]]++;
+        grouped[j] = queries[i];
+        idx[j] = static_cast<uint32_t>(i);
+      }
+    });
+
+    // give each thread a run of whole groups holding about 1/threads of
+    // the hashes
+    std::vector<unsigned> tb{0};
+    for (unsigned k = 1; k < threads; ++k) {
+      tb.push_back(std::lower_bound(
+        bstart.begin(), bstart.end() - 1, k * (count / threads)
+      ) - bstart.begin());
+    }
+    tb.push_back(256);
+
+    run_on_threads(threads, [&](unsigned k) {
+      const size_t beg = bstart[tb[k]], end = bstart[tb[k + 1]];
+      if (beg == end) {
+        return;
+      }
+
+      ls.contains_bulk(grouped[beg].data(), end - beg, found.get() + beg);
+
+      for (size_t j = beg; j < end; ++j) {
+        results[idx[j]] = found[j];
+      }
+    });
+  }
+};
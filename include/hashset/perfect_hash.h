@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "rwutil.h"
+
+/*
+ * A minimal perfect hash function in the style of PTHash (Pibiri & Trani,
+ * SIGIR 2021). Keys are hashed into buckets; each bucket stores a pilot
+ * value, chosen at build time so that every key in the bucket lands in a
+ * free slot of [0, key_count). A table of positions then maps each slot to
+ * the index of its key in HDAT, so a lookup is one slot computation and
+ * one compare against the hash at that index.
+ */
+
+inline uint64_t perfect_hash_mix(uint64_t x) {
+  // murmur3 fmix64
+  x ^= x >> 33;
+  x *= 0xFF51AFD7ED558CCDull;
+  x ^= x >> 33;
+  x *= 0xC4CEB9FE1A85EC53ull;
+  x ^= x >> 33;
+  return x;
+}
+
+inline uint64_t perfect_hash_key(const uint8_t* key, size_t len, uint64_t seed) {
+  uint64_t h = seed;
+  uint64_t w;
+
+  size_t i = 0;
+  for ( ; i + 8 <= len; i += 8) {
+    std::memcpy(&w, key + i, 8);
+    h = ((h ^ w) << 29 | (h ^ w) >> 35) * 0x9E3779B97F4A7C15ull;
+  }
+
+  if (i < len) {
+    w = 0;
+    std::memcpy(&w, key + i, len - i);
+    h = ((h ^ w) << 29 | (h ^ w) >> 35) * 0x9E3779B97F4A7C15ull;
+  }
+
+  return perfect_hash_mix(h ^ len);
+}
+
+// maps x uniformly onto [0, n)
+inline uint64_t perfect_hash_reduce(uint64_t x, uint64_t n) {
+  __extension__ using uint128_t = unsigned __int128;
+  return static_cast<uint64_t>((static_cast<uint128_t>(x) * n) >> 64);
+}
+
+uint64_t perfect_hash_bucket_count(uint64_t key_count);
+
+class PerfectHash {
+public:
+  PerfectHash();
+
+  // without tables; for computing buckets and slots while building
+  PerfectHash(uint64_t seed, uint64_t key_count, uint64_t bucket_count);
+
+  // [beg, end) is the HIDX data following the index type
+  PerfectHash(const void* beg, const void* end);
+
+  uint64_t key_count() const noexcept {
+    return KeyCount;
+  }
+
+  uint64_t bucket(uint64_t h) const noexcept {
+    // 60% of keys go to the first 30% of buckets; skewing the bucket sizes
+    // this way makes pilot search for the large buckets cheap
+    const uint32_t lo = static_cast<uint32_t>(h);
+    return (h >> 32) < DENSE_THRESHOLD ?
+      (static_cast<uint64_t>(lo) * DenseBuckets) >> 32 :
+      DenseBuckets + ((static_cast<uint64_t>(lo) * (BucketCount - DenseBuckets)) >> 32);
+  }
+
+  uint64_t slot(uint64_t h, uint32_t pilot) const noexcept {
+    return perfect_hash_reduce(h ^ perfect_hash_mix(pilot), KeyCount);
+  }
+
+  uint64_t hash(const uint8_t* key, size_t len) const noexcept {
+    return perfect_hash_key(key, len, Seed);
+  }
+
+  uint32_t pilot(uint64_t b) const noexcept {
+    return load_u32(Pilots, b);
+  }
+
+  uint64_t position_at(uint64_t s) const noexcept {
+    return load_u32(Positions, s);
+  }
+
+  void prefetch_pilot(uint64_t b) const noexcept {
+    __builtin_prefetch(Pilots + 4 * b);
+  }
+
+  void prefetch_position(uint64_t s) const noexcept {
+    __builtin_prefetch(Positions + 4 * s);
+  }
+
+  // Returns the HDAT index at which the key must be, if it is present
+  uint64_t position(const uint8_t* key, size_t len) const noexcept {
+    const uint64_t h = hash(key, len);
+    return position_at(slot(h, pilot(bucket(h))));
+  }
+
+  static constexpr uint64_t DENSE_THRESHOLD = 0x99999999; // 0.6 * 2^32
+
+private:
+  static uint32_t load_u32(const uint8_t* a, uint64_t i) noexcept {
+    // the chunk has no alignment guarantee
+    uint32_t v;
+    std::memcpy(&v, a + 4 * i, 4);
+    return from_le(v);
+  }
+
+  uint64_t Seed;
+  uint64_t KeyCount;
+  uint64_t BucketCount;
+  uint64_t DenseBuckets;
+  const uint8_t* Pilots;
+  const uint8_t* Positions;
+};
+
+struct PerfectHashData {
+  uint64_t seed;
+  uint64_t key_count;
+  std::vector<uint32_t> pilots;
+  std::vector<uint32_t> positions;
+};
+
+/*
+ * Builds a perfect hash over the distinct hashes in the sorted range
+ * [beg, end). Each slot maps to the first occurrence of its hash.
+ */
+PerfectHashData make_perfect_hash(
+  const uint8_t* beg,
+  const uint8_t* end,
+  size_t hash_length
+);
@@ -0,0 +1,163 @@
+#pragma once
+
+#include "hashset/basic_ls.h"
+#include "hashset/perfect_hash.h"
+
+#include <algorithm>
+
+template <size_t HashLength>
+class PerfectHashLookupStrategy: public BasicLookupStrategy<HashLength> {
+public:
+  PerfectHashLookupStrategy(
+    const void* beg,
+    const void* end,
+    const PerfectHash& ph
+  ):
+    BasicLookupStrategy<HashLength>(beg, end),
+    PH(ph)
+  {}
+
+  virtual ~PerfectHashLookupStrategy() {}
+
+  virtual LookupFunctions functions() const override {
+    return lookup_functions<PerfectHashLookupStrategy>();
+  }
+
+  virtual bool contains(const uint8_t* hash) const override {
+    if (PH.key_count() == 0) {
+      if (lookup_stats_enabled()) {
+        this->Stats.add(counts(this->size(), false));
+      }
+      return false;
+    }
+
+    // a damaged index must not send us outside HDAT
+    const uint64_t pos = PH.position(hash, HashLength);
+    const bool found = pos < this->size() &&
+                       hash_eq<HashLength>(this->HashesBeg[pos].data(), hash);
+
+    if (lookup_stats_enabled()) {
+      this->Stats.add(counts(pos, found));
+    }
+
+    return found;
+  }
+
+  virtual std::pair<size_t, size_t> find_range(const uint8_t* hash) const override {
+    if (PH.key_count() == 0) {
+      if (lookup_stats_enabled()) {
+        this->Stats.add(counts(this->size(), false));
+      }
+      return { 0, 0 };
+    }
+
+    // the index holds the first of each run of equal hashes
+    const uint64_t pos = PH.position(hash, HashLength);
+    if (pos >= this->size() ||
+        !hash_eq<HashLength>(this->HashesBeg[pos].data(), hash))
+    {
+      if (lookup_stats_enabled()) {
+        this->Stats.add(counts(pos, false));
+      }
+      return { 0, 0 };
+    }
+
+    size_t end = pos + 1;
+    while (end < this->size() &&
+           hash_eq<HashLength>(this->HashesBeg[end].data(), hash))
+    {
+      ++end;
+    }
+
+    if (lookup_stats_enabled()) {
+      // the run of equal hashes, and the one after it which ended it
+      LookupStatsCounts c = counts(pos, true);
+      c.probes += end - pos - (end == this->size());
+      this->Stats.add(c);
+    }
+
+    return { pos, end };
+  }
+
+  virtual void contains_bulk(
+    const uint8_t* hashes,
+    size_t count,
+    bool* results) const override
+  {
+    if (PH.key_count() == 0) {
+      std::fill(results, results + count, false);
+      if (lookup_stats_enabled()) {
+        LookupStatsCounts c;
+        c.lookups = c.rejections = count;
+        this->Stats.add(c);
+      }
+      return;
+    }
+
+    // Each lookup is a chain of three dependent loads (pilot, position,
+    // hash); run a group through each stage together, prefetching what the
+    // next stage reads, so that the loads within a stage overlap.
+    constexpr size_t GROUP = 32;
+
+    const uint64_t n = this->size();
+    uint64_t h[GROUP], x[GROUP];
+
+    const bool stats = lookup_stats_enabled();
+    LookupStatsCounts c;
+
+    for (size_t i = 0; i < count; i += GROUP) {
+      const size_t g = std::min(GROUP, count - i);
+      const uint8_t* gh = hashes + i * HashLength;
+
+      for (size_t j = 0; j < g; ++j) {
+        h[j] = PH.hash(gh + j * HashLength, HashLength);
+        x[j] = PH.bucket(h[j]);
+        PH.prefetch_pilot(x[j]);
+      }
+
+      for (size_t j = 0; j < g; ++j) {
+        x[j] = PH.slot(h[j], PH.pilot(x[j]));
+        PH.prefetch_position(x[j]);
+      }
+
+      for (size_t j = 0; j < g; ++j) {
+        x[j] = PH.position_at(x[j]);
+        __builtin_prefetch(this->HashesBeg.get() + x[j]);
+      }
+
+      for (size_t j = 0; j < g; ++j) {
+        results[i + j] = x[j] < n &&
+          hash_eq<HashLength>(this->HashesBeg[x[j]].data(), gh + j * HashLength);
+      }
+
+      if (stats) {
+        for (size_t j = 0; j < g; ++j) {
+          const bool in = x[j] < n;
+          c.window(in);
+          c.probes += in;
+          c.hits += results[i + j];
+        }
+      }
+    }
+
+    if (stats) {
+      c.lookups = count;
+      this->Stats.add(c);
+    }
+  }
+
+protected:
+  // A position past the end of HDAT rejects a hash without reading HDAT;
+  // any other is a window of one hash.
+  LookupStatsCounts counts(uint64_t pos, bool found) const {
+    const bool in = pos < this->size();
+    LookupStatsCounts c;
+    c.lookups = 1;
+    c.hits = found;
+    c.window(in);
+    c.probes = in;
+    return c;
+  }
+
+  PerfectHash PH;
+};
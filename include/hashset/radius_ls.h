@@ -18,13 +18,31 @@ public:
 
   virtual ~RadiusLookupStrategy() {}
 
+  virtual LookupFunctions functions() const override {
+    return lookup_functions<RadiusLookupStrategy>();
+  }
+
   virtual bool contains(const uint8_t* hash) const override {
-    const size_t exp = expected_index(hash, this->HashesEnd - this->HashesBeg.get());
-    return std::binary_search(
-      std::max(this->HashesBeg.get(), this->HashesBeg.get() + exp - Radius),
-      std::min(this->HashesEnd, this->HashesBeg.get() + exp + Radius + 1),
-      *reinterpret_cast<const std::array<uint8_t, HashLength>*>(hash)
-    );
+    const auto [l, r] = window(hash);
+    return this->search(l, r, hash);
+  }
+
+  virtual void contains_bulk(
+    const uint8_t* hashes,
+    size_t count,
+    bool* results) const override
+  {
+    this->interleaved_search(*this, hashes, count, results);
+  }
+
+  virtual std::pair<size_t, size_t> find_range(const uint8_t* hash) const override {
+    const auto [l, r] = window(hash);
+    return this->search_range(l, r, hash);
+  }
+
+  std::pair<size_t, size_t> window(const uint8_t* hash) const {
+    const int64_t exp = expected_index(hash, this->size());
+    return this->clamp_window(exp - Radius, exp + Radius + 1);
   }
 
 protected:
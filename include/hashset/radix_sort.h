@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Parallel MSD radix sort of fixed-length byte strings, in place, in
+ * memcmp order.
+ *
+ * The strings are counted by their first byte which varies (a record's
+ * first byte is a presence flag, usually set in all of them), from one
+ * slice per thread, and permuted into their buckets. The buckets are then
+ * handed out to the threads, largest first, and each sorts its buckets by
+ * the following bytes the same way, down to buckets small enough for a
+ * comparison sort. Hashes are uniform, so the buckets are even and every
+ * thread has work.
+ *
+ * The first permutation is a single pass on one thread; everything after
+ * it runs on all of them.
+ */
+
+// Sorts count strings of length len at data over up to threads threads
+// (one per core if 0). If idx is nonnull, idx[i] moves with string i, and
+// equal strings are ordered by their idx.
+void radix_sort(
+  uint8_t* data,
+  uint64_t* idx,
+  size_t count,
+  size_t len,
+  unsigned threads
+);
+
+// As radix_sort without idx, dropping duplicates from each bucket once it
+// is sorted; returns the number of strings kept
+size_t radix_sort_unique(
+  uint8_t* data,
+  size_t count,
+  size_t len,
+  unsigned threads
+);
@@ -23,9 +23,11 @@ public:
 
   virtual ~RangeLookupStrategy() {}
 
-  virtual bool contains(const uint8_t* hash) const override {
-    const size_t exp = expected_index(hash, this->HashesEnd - this->HashesBeg.get());
+  virtual LookupFunctions functions() const override {
+    return lookup_functions<RangeLookupStrategy>();
+  }
 
+  virtual bool contains(const uint8_t* hash) const override {
 /*
     {
       const auto l = std::max(this->HashesBeg.get(), this->HashesBeg.get() + exp + RadiusLeft);
@@ -42,11 +44,26 @@ public:
     }
 */
 
-    return std::binary_search(
-      std::max(this->HashesBeg.get(), this->HashesBeg.get() + exp + Left),
-      std::min(this->HashesEnd, this->HashesBeg.get() + exp + Right + 1),
-      *reinterpret_cast<const std::array<uint8_t, HashLength>*>(hash)
-    );
+    const auto [l, r] = window(hash);
+    return this->search(l, r, hash);
+  }
+
+  virtual void contains_bulk(
+    const uint8_t* hashes,
+    size_t count,
+    bool* results) const override
+  {
+    this->interleaved_search(*this, hashes, count, results);
+  }
+
+  virtual std::pair<size_t, size_t> find_range(const uint8_t* hash) const override {
+    const auto [l, r] = window(hash);
+    return this->search_range(l, r, hash);
+  }
+
+  std::pair<size_t, size_t> window(const uint8_t* hash) const {
+    const int64_t exp = expected_index(hash, this->size());
+    return this->clamp_window(exp + Left, exp + Right + 1);
   }
 
 protected:
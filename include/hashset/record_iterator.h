@@ -1,6 +1,7 @@
 #pragma once
 
 // C++20: #include <concepts>
+#include <algorithm>
 #include <cstdint>
 #include <cstring>
 #include <iterator>
@@ -13,11 +14,51 @@
 #include "cpp20.h"
 #include "hex.h"
 #include "hashset/arrow_proxy.h"
+#include "hashset/hash_compare.h"
+
+/*
+ * Sorts move values out of the range into temporaries and back. A moved
+ * proxy holds its record inline if it fits, so that sorting does not
+ * allocate; only longer records go on the heap. The longest record, with
+ * one of every hash type, is 432 bytes.
+ */
+constexpr size_t RECORD_PROXY_INLINE = 448;
+
+// No hash is longer than this, so moved HashRecordProxys never allocate
+constexpr size_t HASH_PROXY_INLINE = 64;
+
+// Holds the record o refers to in buf, or on the heap if it is too long
+template <size_t N>
+span<uint8_t> hold_record(
+  span<uint8_t> o,
+  uint8_t (&buf)[N],
+  std::unique_ptr<uint8_t[]>& tmp)
+{
+  uint8_t* p = buf;
+  if (o.size() > N) {
+    tmp.reset(new uint8_t[o.size()]);
+    p = tmp.get();
+  }
+  std::memcpy(p, o.data(), o.size());
+  return { p, o.size() };
+}
+
+// Swaps len bytes a piece at a time, so as to need no buffer for the whole
+inline void swap_bytes(uint8_t* a, uint8_t* b, size_t len) {
+  uint8_t tmp[64];
+  for (size_t off = 0; off < len; off += sizeof(tmp)) {
+    const size_t n = std::min(sizeof(tmp), len - off);
+    std::memcpy(tmp, a + off, n);
+    std::memcpy(a + off, b + off, n);
+    std::memcpy(b + off, tmp, n);
+  }
+}
 
 struct RecordProxy {
 // C++20: std::span<uint8_t> rec;
   span<uint8_t> rec;
   std::unique_ptr<uint8_t[]> tmp;
+  uint8_t buf[RECORD_PROXY_INLINE];
 
 // C++20: RecordProxy(std::span<uint8_t> rec): rec(rec) {
   RecordProxy(span<uint8_t> rec): rec(rec) {
@@ -32,9 +73,7 @@ struct RecordProxy {
   }
 
   RecordProxy(RecordProxy&& o) noexcept {
-    tmp.reset(new uint8_t[o.rec.size()]);
-    std::memcpy(tmp.get(), o.rec.data(), o.rec.size());
-    rec = { tmp.get(), o.rec.size() };
+    rec = hold_record(o.rec, buf, tmp);
   }
 
   RecordProxy& operator=(RecordProxy&& o) noexcept {
@@ -43,7 +82,7 @@ struct RecordProxy {
   }
 
   int cmp(const RecordProxy& o) const noexcept {
-    return std::memcmp(rec.data(), o.rec.data(), rec.size());
+    return hash_cmp(rec.data(), o.rec.data(), rec.size());
   }
 
   bool operator==(const RecordProxy& o) const noexcept {
@@ -223,6 +262,7 @@ struct HashRecordProxy {
   uint64_t* idx;
 
   std::unique_ptr<uint8_t[]> tmp;
+  uint8_t buf[HASH_PROXY_INLINE];
   uint64_t tmp_idx;
 
 // C++20:  HashRecordProxy(std::span<uint8_t> rec, uint64_t* idx): rec(rec), idx(idx) {
@@ -239,10 +279,7 @@ struct HashRecordProxy {
   }
 
   HashRecordProxy(HashRecordProxy&& o) noexcept {
-    tmp.reset(new uint8_t[o.rec.size()]);
-    std::memcpy(tmp.get(), o.rec.data(), o.rec.size());
-    rec = { tmp.get(), o.rec.size() };
-
+    rec = hold_record(o.rec, buf, tmp);
     tmp_idx = *(o.idx);
     idx = &tmp_idx;
   }
@@ -266,8 +303,9 @@ struct HashRecordProxy {
 */
 
   int cmp(const HashRecordProxy& o) const noexcept {
-    const auto r = std::memcmp(rec.data(), o.rec.data(), rec.size());
-    return r == 0 ? static_cast<int64_t>(*(o.idx)) - static_cast<int64_t>(*idx) : r;
+    // equal hashes order by record, so their records are read in order
+    const auto r = hash_cmp(rec.data(), o.rec.data(), rec.size());
+    return r == 0 ? three_way(*idx, *(o.idx)) : r;
   }
 
   bool operator<(const HashRecordProxy& o) const noexcept {
@@ -413,3 +451,11 @@ private:
 };
 
 // C++20: static_assert(std::random_access_iterator<HashRecordIterator>);
+
+/*
+ * Sorts the hashes of length hash_length in [beg, end) and drops
+ * duplicates, returning the new end. Hashes are sorted as fixed-size
+ * arrays, which moves them with plain copies, rather than through
+ * RecordIterator.
+ */
+uint8_t* sort_unique_hashes(uint8_t* beg, uint8_t* end, size_t hash_length);
@@ -2,11 +2,19 @@
 
 #include "throw.h"
 
+#include <cstddef>
 #include <cstdint>
+#include <thread>
 #include <type_traits>
+#include <vector>
 
 uint32_t expected_index(const uint8_t* h, uint32_t set_size);
 
+// The block of a hash for a hint with 2^bits blocks, bits <= 16
+inline size_t block_index(const uint8_t* h, unsigned bits) {
+  return ((static_cast<size_t>(h[0]) << 8) | h[1]) >> (16 - bits);
+}
+
 template <template <size_t> class Func, class... Args>
 auto hashset_dispatcher(size_t hash_length, Args&&... args)
 {
@@ -31,3 +39,28 @@ auto hashset_dispatcher(size_t hash_length, Args&&... args)
     THROW("unsupported hash length " << hash_length);
   }
 }
+
+// Runs func(k) for k in [0, threads), each on its own thread, k = 0 on
+// this one
+template <class Func>
+void run_on_threads(unsigned threads, Func func) {
+  std::vector<std::thread> workers;
+  try {
+    for (unsigned k = 1; k < threads; ++k) {
+      workers.emplace_back(func, k);
+    }
+
+    func(0u);
+  }
+  catch (...) {
+    // destroying a running thread terminates, so wait for those started
+    for (auto& w: workers) {
+      w.join();
+    }
+    throw;
+  }
+
+  for (auto& w: workers) {
+    w.join();
+  }
+}
@@ -83,6 +83,15 @@ this_module = sys.modules[__name__]
 for name, mask in ALL_HASHES:
     setattr(this_module, name.upper(), mask)
 
+# SFHASH_HashsetOpenFlags
+HASHSET_OPEN_POPULATE  = 1 << 0
+HASHSET_OPEN_HUGEPAGES = 1 << 1
+HASHSET_OPEN_WILLNEED  = 1 << 2
+HASHSET_OPEN_RANDOM    = 1 << 3
+HASHSET_OPEN_LOCK      = 1 << 4
+HASHSET_OPEN_PREFAULT  = 1 << 5
+HASHSET_OPEN_VERIFY    = 1 << 6
+
 
 #
 # structs
@@ -160,6 +169,13 @@ class HasherError(Structure):
     _fields_ = [('message', c_char_p)]
 
 
+class HashsetVerifyStats(Structure):
+    _fields_ = [
+        ('bytes',   c_uint64),
+        ('seconds', c_double)
+    ]
+
+
 # const char* sfhash_hash_name(SFHASH_HashAlgorithm hash_type);
 _sfhash_hash_name = _hasher.sfhash_hash_name
 _sfhash_hash_name.argtypes = [c_uint32]
@@ -220,6 +236,21 @@ _sfhash_load_hashset = _hasher.sfhash_load_hashset
 _sfhash_load_hashset.argtypes = [c_void_p, c_void_p, POINTER(POINTER(HasherError))]
 _sfhash_load_hashset.restype = c_void_p
 
+# SFHASH_Hashset* sfhash_open_hashset(const char* path, uint32_t flags, SFHASH_Error** err);
+_sfhash_open_hashset = _hasher.sfhash_open_hashset
+_sfhash_open_hashset.argtypes = [c_char_p, c_uint32, POINTER(POINTER(HasherError))]
+_sfhash_open_hashset.restype = c_void_p
+
+# double sfhash_hashset_warm_time(const SFHASH_Hashset* hset);
+_sfhash_hashset_warm_time = _hasher.sfhash_hashset_warm_time
+_sfhash_hashset_warm_time.argtypes = [c_void_p]
+_sfhash_hashset_warm_time.restype = c_double
+
+# void sfhash_hashset_verify(const SFHASH_Hashset* hset, unsigned int threads, SFHASH_HashsetVerifyStats* stats, SFHASH_Error** err);
+_sfhash_hashset_verify = _hasher.sfhash_hashset_verify
+_sfhash_hashset_verify.argtypes = [c_void_p, c_uint, POINTER(HashsetVerifyStats), POINTER(POINTER(HasherError))]
+_sfhash_hashset_verify.restype = None
+
 # void sfhash_destroy_hashset(SFHASH_HashSet* hset);
 _sfhash_destroy_hashset = _hasher.sfhash_destroy_hashset
 _sfhash_destroy_hashset.argtypes = [c_void_p]
@@ -446,7 +477,7 @@ class Hashset(object):
 
 
 class HSet(Handle):
-    # For internal use only. Use load() to load a hashset.
+    # For internal use only. Use load() or open() to get a hashset.
     def __init__(self, buf):
         super().__init__(buf)
 
@@ -466,6 +497,18 @@ class HSet(Handle):
     def sha2_256(self):
         return bytes(cast(_sfhash_hashset_sha2_256(self.get()), POINTER(c_ubyte * 32)).contents)
 
+    def warm_time(self):
+        return _sfhash_hashset_warm_time(self.get())
+
+    # returns the number of bytes checked and the seconds taken
+    def verify(self, threads=0):
+        stats = HashsetVerifyStats()
+        with Error() as err:
+            _sfhash_hashset_verify(self.get(), threads, byref(stats), byref(err.get()))
+            if err:
+                raise RuntimeError(str(err))
+        return stats.bytes, stats.seconds
+
     def index(self, ht):
         return _sfhash_hashset_index_for_type(self.get(), ht)
 
@@ -480,6 +523,14 @@ class HSet(Handle):
                 raise RuntimeError(str(err))
         return hset
 
+    @classmethod
+    def open(cls, path, flags=0):
+        with Error() as err:
+            hset = cls(_sfhash_open_hashset(str(path).encode('utf-8'), flags, byref(err.get())))
+            if err:
+                raise RuntimeError(str(err))
+        return hset
+
 
 class FuzzyResult(Handle):
     def __init__(self, ptr):
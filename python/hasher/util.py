@@ -44,26 +44,14 @@ class ReadOnlyMmappedFile(object):
 
 
 class MmappedHSet(object):
-    def __init__(self, path: Path | str):
-        self.hset = None
-        self.mfile = None
-
-        self.mfile = ReadOnlyMmappedFile(path)
-        try:
-            self.hset = hasher.HSet.load(self.mfile.buf)
-        except:
-            self.mfile.close()
-            raise
+    # flags is a bitwise-or of the hasher.HASHSET_OPEN_* options
+    def __init__(self, path: Path | str, flags: int = 0):
+        self.hset = hasher.HSet.open(path, flags)
 
     def close(self) -> None:
-        try:
-            if self.hset:
-                self.hset.destroy()
-                self.hset = None
-        finally:
-            if self.mfile:
-                self.mfile.close()
-                self.mfile = None
+        if self.hset:
+            self.hset.destroy()
+            self.hset = None
 
     def __enter__(self) -> Self:
         return self
@@ -383,6 +383,26 @@ class TestHashSetAPI(unittest.TestCase):
 #
 #                    os.remove(outfile)
 
+    def test_hashset_open(self):
+        flags = hasher.HASHSET_OPEN_POPULATE | hasher.HASHSET_OPEN_PREFAULT
+        with hasher.HSet.open('../../test/good.hset', flags) as hset:
+            self.assertEqual('Test Name', hset.name())
+            self.assertTrue(hset.warm_time() >= 0.0)
+
+            hs = hset.hashset(hset.index(hasher.SHA1))
+            self.assertTrue(bytes.fromhex('286ba1181663193d119d7ca18331395cd451de91') in hs)
+            self.assertFalse(bytes.fromhex('baaaaaadbaaaaaadbaaaaaadbaaaaaadbaaaaaad') in hs)
+
+    def test_hashset_open_missing(self):
+        with self.assertRaises(RuntimeError):
+            hasher.HSet.open('../../test/no_such.hset')
+
+    def test_hashset_verify(self):
+        with hasher.HSet.open('../../test/good.hset', hasher.HASHSET_OPEN_VERIFY) as hset:
+            nbytes, secs = hset.verify(2)
+            self.assertEqual(os.path.getsize('../../test/good.hset') - 40, nbytes)
+            self.assertTrue(secs >= 0.0)
+
 
 class HashNameTest(unittest.TestCase):
     def test_hash_name(self):
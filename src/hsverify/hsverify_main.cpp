@@ -0,0 +1,76 @@
+/*
+
+Verify hset files against their checksums, reporting throughput:
+
+hsverify --threads 8 nsrl.hset vs.hset
+
+*/
+
+#include <cstring>
+#include <exception>
+#include <iomanip>
+#include <iostream>
+
+#include <boost/lexical_cast.hpp>
+
+#include "util.h"
+#include "hasher/hashset.h"
+
+int main(int argc, char** argv) {
+  // leading options
+  int a = 1;
+  unsigned int threads = 0;
+  for ( ; a < argc && !std::strncmp(argv[a], "--", 2); ++a) {
+    if (!std::strcmp(argv[a], "--threads") && a + 1 < argc) {
+      try {
+        threads = boost::lexical_cast<unsigned int>(argv[++a]);
+      }
+      catch (const boost::bad_lexical_cast&) {
+        std::cerr << "Error: bad thread count '" << argv[a] << "'" << std::endl;
+        return -1;
+      }
+    }
+    else {
+      std::cerr << "Error: unrecognized option '" << argv[a] << "'" << std::endl;
+      return -1;
+    }
+  }
+
+  if (a == argc) {
+    std::cerr << "Usage: hsverify [--threads N] FILE..." << std::endl;
+    return -1;
+  }
+
+  int ret = 0;
+
+  for ( ; a < argc; ++a) {
+    SFHASH_Error* err = nullptr;
+
+    auto hset = make_unique_del(
+      sfhash_open_hashset(argv[a], 0, &err),
+      sfhash_destroy_hashset
+    );
+
+    SFHASH_HashsetVerifyStats stats{0, 0.0};
+
+    if (!err) {
+      sfhash_hashset_verify(hset.get(), threads, &stats, &err);
+    }
+
+    if (err) {
+      std::cout << argv[a] << ": " << err->message << std::endl;
+      sfhash_free_error(err);
+      ret = 1;
+      continue;
+    }
+
+    std::cout << argv[a] << ": OK, "
+              << stats.bytes << " bytes in "
+              << std::fixed << std::setprecision(3) << stats.seconds << " s ("
+              << std::setprecision(1)
+              << (stats.seconds > 0 ? stats.bytes / stats.seconds / (1 << 20) : 0.0)
+              << " MiB/s)" << std::endl;
+  }
+
+  return ret;
+}
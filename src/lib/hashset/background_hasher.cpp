@@ -0,0 +1,96 @@
+#include "hashset/background_hasher.h"
+
+#include "util.h"
+#include "hasher/hasher.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// The most hashed at once, so that a stop is not kept waiting long
+constexpr size_t BACKGROUND_HASH_SLICE = 1 << 24;
+
+}
+
+BackgroundHasher::BackgroundHasher(const uint8_t* beg):
+  Mutex(),
+  Cond(),
+  Hashed(beg),
+  Done(beg),
+  Closed(false),
+  Stop(false),
+  Digest(),
+  Error(),
+  Worker(&BackgroundHasher::run, this)
+{}
+
+BackgroundHasher::~BackgroundHasher() {
+  if (Worker.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(Mutex);
+      Stop = true;
+    }
+    Cond.notify_one();
+    Worker.join();
+  }
+}
+
+void BackgroundHasher::finished(const uint8_t* end) {
+  {
+    std::lock_guard<std::mutex> lock(Mutex);
+    Done = end;
+  }
+  Cond.notify_one();
+}
+
+std::array<uint8_t, 32> BackgroundHasher::digest() {
+  {
+    std::lock_guard<std::mutex> lock(Mutex);
+    Closed = true;
+  }
+  Cond.notify_one();
+  Worker.join();
+
+  if (Error) {
+    std::rethrow_exception(Error);
+  }
+  return Digest;
+}
+
+void BackgroundHasher::run() {
+  try {
+    auto hasher = make_unique_del(
+      sfhash_create_hasher(SFHASH_SHA_2_256), sfhash_destroy_hasher
+    );
+
+    std::unique_lock<std::mutex> lock(Mutex);
+    while (true) {
+      Cond.wait(lock, [this]() { return Stop || Closed || Hashed < Done; });
+      if (Stop) {
+        return;
+      }
+      else if (Hashed == Done) {
+        // closed, and everything is hashed
+        break;
+      }
+
+      const uint8_t* beg = Hashed;
+      const uint8_t* end = beg + std::min<size_t>(Done - beg, BACKGROUND_HASH_SLICE);
+
+      lock.unlock();
+      sfhash_update_hasher(hasher.get(), beg, end);
+      lock.lock();
+
+      Hashed = end;
+    }
+    lock.unlock();
+
+    SFHASH_HashValues hashes;
+    sfhash_get_hashes(hasher.get(), &hashes);
+    std::memcpy(Digest.data(), hashes.Sha2_256, Digest.size());
+  }
+  catch (...) {
+    Error = std::current_exception();
+  }
+}
@@ -0,0 +1,256 @@
+#include "hashset/compressed_hashes.h"
+
+#include "rwutil.h"
+#include "throw.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// bucket bits, prefix bytes, padding
+constexpr size_t HDAC_HEADER_LENGTH = 8;
+
+// buckets come from the leading 64 bits; past 2^39 buckets (and 4 bytes
+// of prefix), the directory would outgrow any hashset we could hold
+constexpr unsigned HDAC_MAX_BUCKET_BITS = 39;
+
+uint64_t bucket_count(unsigned bucket_bits) {
+  return uint64_t(1) << bucket_bits;
+}
+
+uint64_t sample_count(unsigned bucket_bits) {
+  return (bucket_count(bucket_bits) + 63) / 64;
+}
+
+uint64_t word_count(uint64_t count, unsigned bucket_bits) {
+  return (count + bucket_count(bucket_bits) + 63) / 64;
+}
+
+size_t suffixes_end(uint64_t count, size_t suffix_length) {
+  const size_t e = HDAC_HEADER_LENGTH + count * suffix_length;
+  return e + (8 - e % 8) % 8;
+}
+
+uint64_t leading_bits(const uint8_t* hash, size_t hash_length) {
+  uint64_t x = 0;
+  std::memcpy(&x, hash, std::min<size_t>(hash_length, 8));
+  return from_be(x);
+}
+
+void store(uint64_t x, uint8_t* p) {
+  x = to_le(x);
+  std::memcpy(p, &x, sizeof(x));
+}
+
+}
+
+unsigned compressed_bucket_bits(uint64_t count, size_t hash_length) {
+  // about four hashes per bucket; fewer buckets would save less prefix,
+  // more would cost more bits in the directory than they save
+  const int lg = count ? 63 - __builtin_clzll(count) : 0;
+  return std::clamp<int>(
+    lg - 2,
+    8,
+    std::min<int>(HDAC_MAX_BUCKET_BITS, 8 * (hash_length - 1))
+  );
+}
+
+size_t compressed_length(uint64_t count, size_t hash_length) {
+  const unsigned bb = compressed_bucket_bits(count, hash_length);
+  return suffixes_end(count, hash_length - bb / 8) +
+         8 * sample_count(bb) +
+         8 * word_count(count, bb);
+}
+
+size_t compressed_length_max(uint64_t count, size_t hash_length) {
+  // the length grows with the count, but may fall where the bucket bits
+  // step up, so check the largest count at each step below
+  size_t len = compressed_length(count, hash_length);
+  for (unsigned bb = 8; bb < compressed_bucket_bits(count, hash_length); ++bb) {
+    len = std::max(
+      len, compressed_length((uint64_t(1) << (bb + 3)) - 1, hash_length)
+    );
+  }
+  return len;
+}
+
+size_t write_compressed(
+  const uint8_t* hashes,
+  uint64_t count,
+  size_t hash_length,
+  uint8_t* out)
+{
+  const unsigned bb = compressed_bucket_bits(count, hash_length);
+  const unsigned pb = bb / 8;
+  const size_t slen = hash_length - pb;
+
+  // the directory needs the prefixes, so make it before the suffixes
+  // overwrite them
+  std::vector<uint64_t> samples(sample_count(bb));
+  std::vector<uint64_t> bits(word_count(count, bb));
+
+  uint64_t pos = 0, zeros = 0;
+  const auto end_buckets = [&](uint64_t b) {
+    for ( ; zeros < b; ++zeros, ++pos) {
+      if (zeros % 64 == 0) {
+        samples[zeros / 64] = pos;
+      }
+    }
+  };
+
+  for (uint64_t i = 0; i < count; ++i) {
+    end_buckets(leading_bits(hashes + i * hash_length, hash_length) >> (64 - bb));
+    bits[pos / 64] |= uint64_t(1) << (pos % 64);
+    ++pos;
+  }
+  end_buckets(bucket_count(bb));
+
+  // The suffixes are written from the front, each at or before where its
+  // hash was, so in place they overwrite only hashes already moved, once
+  // past the first few, which might be overwritten by the header first.
+  uint8_t first[HDAC_HEADER_LENGTH][64];
+  const uint64_t fcount = std::min<uint64_t>(count, HDAC_HEADER_LENGTH);
+  for (uint64_t i = 0; i < fcount; ++i) {
+    std::memcpy(first[i], hashes + i * hash_length, hash_length);
+  }
+
+  uint8_t* o = out;
+  *o++ = bb;
+  *o++ = pb;
+  std::fill(o, out + HDAC_HEADER_LENGTH, 0);
+  o = out + HDAC_HEADER_LENGTH;
+
+  for (uint64_t i = 0; i < count; ++i, o += slen) {
+    const uint8_t* h = i < fcount ? first[i] : hashes + i * hash_length;
+    std::memmove(o, h + pb, slen);
+  }
+
+  const size_t send = suffixes_end(count, slen);
+  std::fill(o, out + send, 0);
+  o = out + send;
+
+  for (const uint64_t s: samples) {
+    store(s, o);
+    o += 8;
+  }
+
+  for (const uint64_t w: bits) {
+    store(w, o);
+    o += 8;
+  }
+
+  return o - out;
+}
+
+CompressedHashes::CompressedHashes(
+  const void* beg,
+  const void* end,
+  size_t hash_length,
+  uint64_t count
+):
+  HashLength(hash_length),
+  Count(count)
+{
+  const uint8_t* b = static_cast<const uint8_t*>(beg);
+  const uint8_t* e = static_cast<const uint8_t*>(end);
+  const size_t len = e - b;
+
+  THROW_IF(len < HDAC_HEADER_LENGTH, "HDAC too short for its header");
+
+  BucketBits = b[0];
+  PrefixBytes = b[1];
+
+  THROW_IF(
+    BucketBits > HDAC_MAX_BUCKET_BITS ||
+    BucketBits > 8 * (hash_length - 1) ||
+    PrefixBytes != BucketBits / 8,
+    "bad HDAC bucket bits " << BucketBits
+                            << " and prefix bytes " << PrefixBytes
+  );
+
+  SuffixLength = hash_length - PrefixBytes;
+
+  const uint64_t scount = sample_count(BucketBits);
+  const uint64_t wcount = word_count(count, BucketBits);
+  const size_t send = suffixes_end(count, SuffixLength);
+  const size_t exp = send + 8 * scount + 8 * wcount;
+
+  THROW_IF(
+    len != exp,
+    "expected HDAC length " << exp << ", found " << len
+  );
+
+  Suffixes = b + HDAC_HEADER_LENGTH;
+  Samples = b + send;
+  Bits = Samples + 8 * scount;
+
+  // Lookups trust the directory to stay within the chunk, so check that
+  // it has a 1 per hash, a 0 per bucket, and nothing after, and that the
+  // samples are where it says.
+  const uint64_t buckets = bucket_count(BucketBits);
+  uint64_t ones = 0, zeros = 0;
+
+  for (uint64_t w = 0; w < wcount; ++w) {
+    const uint64_t x = load(Bits + 8 * w);
+    const uint64_t valid = std::min<uint64_t>(64, count + buckets - 64 * w);
+
+    THROW_IF(
+      valid < 64 && (x >> valid),
+      "bits set past the end of the HDAC directory"
+    );
+
+    // the samples of the 0s in this word
+    uint64_t z = ~x & (valid < 64 ? (uint64_t(1) << valid) - 1 : ~uint64_t(0));
+    const uint64_t zc = __builtin_popcountll(z);
+
+    for (uint64_t k = (zeros + 63) / 64 * 64; k < zeros + zc; k += 64) {
+      uint64_t m = z;
+      for (uint64_t n = k - zeros; n; --n) {
+        m &= m - 1;
+      }
+
+      THROW_IF(
+        load(Samples + 8 * (k / 64)) != 64 * w + __builtin_ctzll(m),
+        "bad HDAC directory sample " << k / 64
+      );
+    }
+
+    ones += __builtin_popcountll(x);
+    zeros += zc;
+  }
+
+  THROW_IF(
+    ones != count || zeros != buckets,
+    "HDAC directory has " << ones << " hashes in " << zeros << " buckets, "
+    "expected " << count << " in " << buckets
+  );
+}
+
+void CompressedHashes::expand(uint8_t* out) const {
+  const uint64_t wcount = word_count(Count, BucketBits);
+
+  uint64_t b = 0, i = 0;
+  for (uint64_t w = 0; w < wcount && i < Count; ++w) {
+    for (uint64_t x = word(w), n = 0; n < 64 && i < Count; ++n, x >>= 1) {
+      if (x & 1) {
+        // the bucket's leading bits, then the suffix, which repeats any
+        // bucket bits past the prefix bytes
+        const uint64_t lead = to_be(BucketBits ? b << (64 - BucketBits) : 0);
+        std::memcpy(out, &lead, PrefixBytes);
+        std::memcpy(out + PrefixBytes, suffix(i), SuffixLength);
+        out += HashLength;
+        ++i;
+      }
+      else {
+        ++b;
+      }
+    }
+  }
+}
+
+std::vector<uint8_t> CompressedHashes::expand() const {
+  std::vector<uint8_t> out(Count * HashLength);
+  expand(out.data());
+  return out;
+}
@@ -0,0 +1,206 @@
+#include "hashset/external_sort.h"
+
+#include "error.h"
+#include "hashset/hash_compare.h"
+#include "hashset/radix_sort.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+namespace {
+
+// A run being merged, read a buffer at a time
+struct RunReader {
+  std::ifstream in;
+  std::vector<uint8_t> buf;
+  size_t pos;
+  size_t end;
+
+  RunReader(const std::filesystem::path& p, size_t buflen):
+    in(p, std::ios::binary), buf(buflen), pos(0), end(0)
+  {
+    THROW_IF(!in, "failed to open run " << p);
+  }
+
+  bool refill() {
+    in.read(reinterpret_cast<char*>(buf.data()), buf.size());
+    THROW_IF(in.bad(), "failed to read run");
+    pos = 0;
+    end = in.gcount();
+    return end > 0;
+  }
+
+  const uint8_t* cur() const {
+    return buf.data() + pos;
+  }
+};
+
+}
+
+ExternalSorter::ExternalSorter(
+  size_t length,
+  uint64_t budget,
+  const std::filesystem::path& temp_dir,
+  const std::string& name,
+  bool unique
+):
+  Length(length),
+  Budget(budget),
+  Dir(temp_dir),
+  Name(name),
+  Unique(unique),
+  Buf(),
+  Capacity(std::max<uint64_t>(1, budget / length)),
+  Count(0),
+  Runs()
+{}
+
+ExternalSorter::~ExternalSorter() {
+  try {
+    remove_runs();
+  }
+  catch (...) {
+  }
+}
+
+void ExternalSorter::add(const uint8_t* s) {
+  if (Count == Capacity) {
+    spill();
+  }
+
+  if (Buf.empty()) {
+    Buf.resize(Capacity * Length);
+  }
+
+  std::memcpy(Buf.data() + Count * Length, s, Length);
+  ++Count;
+}
+
+void ExternalSorter::spill() {
+  if (Unique) {
+    Count = radix_sort_unique(Buf.data(), Count, Length, 0);
+  }
+  else {
+    radix_sort(Buf.data(), nullptr, Count, Length, 0);
+  }
+
+  const auto& p = Runs.emplace_back(
+    Dir / (Name + "_run_" + std::to_string(Runs.size()))
+  );
+
+  std::ofstream out;
+  out.exceptions(std::ofstream::failbit);
+  out.open(p, std::ios::binary | std::ios::trunc);
+  out.write(reinterpret_cast<const char*>(Buf.data()), Count * Length);
+
+  Count = 0;
+}
+
+void ExternalSorter::remove_runs() {
+  for (const auto& p: Runs) {
+    std::filesystem::remove(p);
+  }
+  Runs.clear();
+}
+
+uint64_t ExternalSorter::merge(const std::function<void(const uint8_t*)>& out) {
+  if (Runs.empty()) {
+    // everything fit; no need to touch the disk
+    if (Unique) {
+      Count = radix_sort_unique(Buf.data(), Count, Length, 0);
+    }
+    else {
+      radix_sort(Buf.data(), nullptr, Count, Length, 0);
+    }
+
+    for (size_t i = 0; i < Count; ++i) {
+      out(Buf.data() + i * Length);
+    }
+
+    const uint64_t n = Count;
+    std::vector<uint8_t>().swap(Buf);
+    Count = 0;
+    return n;
+  }
+
+  if (Count) {
+    spill();
+  }
+  std::vector<uint8_t>().swap(Buf);
+
+  // split the budget among the readers
+  const size_t buflen = Length * std::max<uint64_t>(
+    1, Budget / Length / Runs.size()
+  );
+
+  std::vector<RunReader> readers;
+  readers.reserve(Runs.size());
+  for (const auto& p: Runs) {
+    readers.emplace_back(p, buflen);
+  }
+
+  // a min-heap of the readers, by their current strings
+  const auto greater = [&readers, len = Length](size_t l, size_t r) {
+    return hash_cmp(readers[l].cur(), readers[r].cur(), len) > 0;
+  };
+
+  std::vector<size_t> heap;
+  for (size_t i = 0; i < readers.size(); ++i) {
+    if (readers[i].refill()) {
+      heap.push_back(i);
+    }
+  }
+  std::make_heap(heap.begin(), heap.end(), greater);
+
+  std::vector<uint8_t> prev(Length);
+  uint64_t n = 0;
+
+  while (!heap.empty()) {
+    std::pop_heap(heap.begin(), heap.end(), greater);
+    auto& r = readers[heap.back()];
+
+    if (!Unique || n == 0 || hash_cmp(r.cur(), prev.data(), Length)) {
+      out(r.cur());
+      if (Unique) {
+        std::memcpy(prev.data(), r.cur(), Length);
+      }
+      ++n;
+    }
+
+    r.pos += Length;
+    if (r.pos < r.end || r.refill()) {
+      std::push_heap(heap.begin(), heap.end(), greater);
+    }
+    else {
+      heap.pop_back();
+    }
+  }
+
+  readers.clear();
+  remove_runs();
+  return n;
+}
+
+uint64_t external_sort_unique(
+  uint8_t* data,
+  uint64_t count,
+  size_t len,
+  uint64_t budget,
+  const std::filesystem::path& temp_dir,
+  const std::string& name)
+{
+  ExternalSorter sorter(len, budget, temp_dir, name, true);
+
+  const uint8_t* end = data + count * len;
+  for (const uint8_t* i = data; i < end; i += len) {
+    sorter.add(i);
+  }
+
+  // every string has been copied out by now, so data may be overwritten
+  uint8_t* o = data;
+  return sorter.merge([&o, len](const uint8_t* s) {
+    std::memcpy(o, s, len);
+    o += len;
+  });
+}
@@ -0,0 +1,174 @@
+#include "hashset/hint_select.h"
+
+#include "hashset/hset_structs.h"
+#include "hashset/lookup_stats.h"
+#include "hashset/util.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+// about the L2 cache; a hint this large is likely to miss on every lookup
+constexpr double HINT_CACHE_BYTES = 256 * 1024;
+
+// bounds with no offsets in them yet
+constexpr std::pair<int64_t, int64_t> EMPTY_BOUNDS{
+  std::numeric_limits<int64_t>::max(),
+  std::numeric_limits<int64_t>::min()
+};
+
+double cache_cost(uint16_t hint_type) {
+  return hint_kind(hint_type) == HintType::BASIC ?
+    0.0 : std::min(1.0, hint_data_length(hint_type) / HINT_CACHE_BYTES);
+}
+
+uint64_t window_probes(int64_t l, int64_t r, uint64_t count) {
+  return binary_search_probes(
+    std::clamp<int64_t>(r - l, 0, static_cast<int64_t>(count))
+  );
+}
+
+void keep_cheaper(HintCandidate& best, HintCandidate&& c) {
+  c.cost += cache_cost(c.hint_type);
+  if (c.cost < best.cost) {
+    best = std::move(c);
+  }
+}
+
+}
+
+unsigned max_hint_block_bits(uint64_t hash_count) {
+  const int lg = hash_count ? 63 - __builtin_clzll(hash_count) : 0;
+  const int bits = std::min<int>(lg - 6, MAX_HINT_BLOCK_BITS);
+  return bits < static_cast<int>(MIN_HINT_BLOCK_BITS) ? 0 : bits;
+}
+
+HintCandidate select_hint(
+  const uint8_t* hashes,
+  uint64_t count,
+  size_t hash_length)
+{
+  HintCandidate best{
+    make_hint_type(HintType::BASIC),
+    static_cast<double>(binary_search_probes(count)),
+    0, 0, {}, {}
+  };
+
+  if (count == 0) {
+    return best;
+  }
+
+  const unsigned max_bits = max_hint_block_bits(count);
+
+  // the offsets of the hashes from their expected indices, bounded overall
+  // and in each of the smallest blocks, with the hashes in each
+  int64_t left = 0, right = 0;
+  std::vector<std::pair<int64_t, int64_t>> bounds(
+    max_bits ? size_t(1) << max_bits : 0, EMPTY_BOUNDS
+  );
+  std::vector<uint64_t> counts(bounds.size());
+
+  for (uint64_t i = 0; i < count; ++i) {
+    const uint8_t* h = hashes + i * hash_length;
+    const int64_t d = static_cast<int64_t>(i) - expected_index(h, count);
+
+    left = std::min(left, d);
+    right = std::max(right, d);
+
+    if (max_bits) {
+      const size_t bi = block_index(h, max_bits);
+      bounds[bi].first = std::min(bounds[bi].first, d);
+      bounds[bi].second = std::max(bounds[bi].second, d);
+      ++counts[bi];
+    }
+  }
+
+  const int64_t radius = std::max(-left, right);
+  if (radius <= std::numeric_limits<uint32_t>::max()) {
+    keep_cheaper(best, {
+      make_hint_type(HintType::RADIUS),
+      static_cast<double>(window_probes(-radius, radius + 1, count)),
+      -radius, radius, {}, {}
+    });
+  }
+
+  keep_cheaper(best, {
+    make_hint_type(HintType::RANGE),
+    static_cast<double>(window_probes(left, right + 1, count)),
+    left, right, {}, {}
+  });
+
+  // constant bounds: every hash in a block has the same window
+  unsigned block_bits = 0;
+  double block_cost = best.cost;
+
+  for (unsigned bits = max_bits; bits >= MIN_HINT_BLOCK_BITS; --bits) {
+    uint64_t probes = 0;
+    for (size_t bi = 0; bi < bounds.size(); ++bi) {
+      if (counts[bi]) {
+        probes += counts[bi] * window_probes(
+          bounds[bi].first, bounds[bi].second + 1, count
+        );
+      }
+    }
+
+    const uint16_t type = make_hint_type(HintType::BLOCK, bits);
+    HintCandidate c{
+      type,
+      static_cast<double>(probes) / count + cache_cost(type),
+      0, 0, {}, {}
+    };
+
+    if (c.cost < block_cost) {
+      block_bits = bits;
+      block_cost = c.cost;
+    }
+
+    if (c.cost < best.cost) {
+      c.blocks = bounds;
+      best = std::move(c);
+    }
+
+    // merge pairs of blocks for one fewer bit
+    for (size_t bi = 0; bi < bounds.size() / 2; ++bi) {
+      bounds[bi] = {
+        std::min(bounds[2 * bi].first, bounds[2 * bi + 1].first),
+        std::max(bounds[2 * bi].second, bounds[2 * bi + 1].second)
+      };
+      counts[bi] = counts[2 * bi] + counts[2 * bi + 1];
+    }
+    bounds.resize(bounds.size() / 2);
+    counts.resize(counts.size() / 2);
+  }
+
+  // Lines narrow the windows of constant bounds by much the same factor at
+  // any bits, and take as much room, so are best near the same bits; they
+  // take a pass each to fit and to cost, so try only there.
+  if (block_bits) {
+    const unsigned lo = std::max(block_bits - 1, MIN_HINT_BLOCK_BITS);
+    const unsigned hi = std::min(block_bits + 1, max_bits);
+
+    for (unsigned bits = lo; bits <= hi; ++bits) {
+      auto lines = make_linear_blocks(hashes, count, hash_length, bits);
+
+      uint64_t probes = 0;
+      for (uint64_t i = 0; i < count; ++i) {
+        const uint8_t* h = hashes + i * hash_length;
+        const int64_t e = expected_index(h, count);
+        const auto& [la, lb, ua, ub] = lines[block_index(h, bits)];
+        probes += window_probes(
+          linear_lower(la, lb, e), linear_upper(ua, ub, e) + 1, count
+        );
+      }
+
+      keep_cheaper(best, {
+        make_hint_type(HintType::BLOCK_LINEAR, bits),
+        static_cast<double>(probes) / count,
+        0, 0, {}, std::move(lines)
+      });
+    }
+  }
+
+  return best;
+}
@@ -2,11 +2,18 @@
 
 #include "error.h"
 #include "hashset/hset.h"
+#include "hashset/hset_verify.h"
 #include "hashset/lookupstrategy.h"
+#include "hashset/mapped_file.h"
+#include "hashset/merge_lookup.h"
+#include "hashset/partitioned_lookup.h"
+#include "hashset/util.h"
 
 #include <algorithm>
+#include <chrono>
 #include <memory>
 #include <numeric>
+#include <thread>
 
 SFHASH_Hashset* sfhash_load_hashset(
   const void* beg,
@@ -18,7 +25,9 @@ SFHASH_Hashset* sfhash_load_hashset(
       decode_hset(
         static_cast<const uint8_t*>(beg),
         static_cast<const uint8_t*>(end)
-      )
+      ),
+      nullptr,
+      0.0
     };
   }
   catch (const std::exception& e) {
@@ -27,6 +36,77 @@ SFHASH_Hashset* sfhash_load_hashset(
   }
 }
 
+void check_open_flags(uint32_t flags) {
+  THROW_IF(
+    flags & ~(
+      SFHASH_HASHSET_OPEN_POPULATE |
+      SFHASH_HASHSET_OPEN_HUGEPAGES |
+      SFHASH_HASHSET_OPEN_WILLNEED |
+      SFHASH_HASHSET_OPEN_RANDOM |
+      SFHASH_HASHSET_OPEN_LOCK |
+      SFHASH_HASHSET_OPEN_PREFAULT |
+      SFHASH_HASHSET_OPEN_VERIFY
+    ),
+    "unknown flags " << std::hex << flags
+  );
+}
+
+SFHASH_Hashset* sfhash_open_hashset(
+  const char* path,
+  uint32_t flags,
+  SFHASH_Error** err
+) {
+  try {
+    check_open_flags(flags);
+
+    using clock = std::chrono::steady_clock;
+
+    // warming is mapping and prefaulting; decoding in between is not
+    const auto t0 = clock::now();
+    auto mf = std::make_shared<MappedFile>(path, flags);
+    const auto t1 = clock::now();
+
+    auto hset = std::make_unique<SFHASH_Hashset>(
+      SFHASH_Hashset{ decode_hset(mf->begin(), mf->end()), mf, 0.0 }
+    );
+
+    const auto t2 = clock::now();
+
+    if (flags & SFHASH_HASHSET_OPEN_PREFAULT) {
+      // only what lookups read; records are fetched far more sparsely
+      std::vector<std::pair<const void*, const void*>> ranges;
+      for (const auto& h: hset->holder.hsets) {
+        const auto& hint = std::get<HashsetHint>(h);
+        const auto& hsd = std::get<ConstHashsetData>(h);
+        const auto& hidx = std::get<HashsetIndex>(h);
+        ranges.emplace_back(hint.beg, hint.end);
+        ranges.emplace_back(hidx.beg, hidx.end);
+        ranges.emplace_back(hsd.beg, hsd.end);
+      }
+
+      prefault_pages(ranges, std::max(1u, std::thread::hardware_concurrency()));
+    }
+
+    const auto t3 = clock::now();
+
+    hset->warm_time = std::chrono::duration<double>((t1 - t0) + (t3 - t2)).count();
+
+    if (flags & SFHASH_HASHSET_OPEN_VERIFY) {
+      verify_hset(hset->holder, -1, 0, nullptr);
+    }
+
+    return hset.release();
+  }
+  catch (const std::exception& e) {
+    fill_error(err, std::string("failed to open hset: ") + e.what());
+    return nullptr;
+  }
+}
+
+double sfhash_hashset_warm_time(const SFHASH_Hashset* hset) {
+  return hset->warm_time;
+}
+
 void sfhash_destroy_hashset(SFHASH_Hashset* hset) {
   delete hset;
 };
@@ -77,6 +157,87 @@ bool sfhash_hashset_lookup(
   return std::get<std::unique_ptr<LookupStrategy>>(hset->holder.hsets[tidx])->contains(static_cast<const uint8_t*>(hash));
 }
 
+SFHASH_HashsetLookupHandle sfhash_hashset_lookup_handle(
+  const SFHASH_Hashset* hset,
+  size_t tidx
+) {
+  const auto& t = hset->holder.hsets[tidx];
+  const LookupStrategy* ls = std::get<std::unique_ptr<LookupStrategy>>(t).get();
+  const LookupFunctions f = ls->functions();
+
+  return {
+    ls,
+    std::get<HashsetHeader>(t).hash_length,
+    f.contains,
+    f.contains_bulk
+  };
+}
+
+// Sorting and merging a batch pays off once the batch is large enough to
+// amortize the sort and dense enough that the merge reads little of HDAT
+// which no query needs.
+constexpr size_t MERGE_LOOKUP_MIN_BATCH = 1 << 20;
+constexpr uint64_t MERGE_LOOKUP_MAX_SPARSITY = 64;
+
+void hashset_lookup_bulk_merge(
+  const SFHASH_Hashset* hset,
+  size_t tidx,
+  const void* hashes,
+  size_t hashes_length,
+  bool* results,
+  unsigned threads
+) {
+  const auto& t = hset->holder.hsets[tidx];
+  const auto& hsd = std::get<ConstHashsetData>(t);
+
+  if (hsd.compressed) {
+    // there are no runs of whole hashes to merge against
+    hashset_dispatcher<PartitionedLookup>(
+      std::get<HashsetHeader>(t).hash_length,
+      *std::get<std::unique_ptr<LookupStrategy>>(t),
+      static_cast<const uint8_t*>(hashes),
+      hashes_length,
+      results,
+      threads
+    );
+    return;
+  }
+
+  hashset_dispatcher<MergeLookup>(
+    std::get<HashsetHeader>(t).hash_length,
+    hsd.beg,
+    hsd.end,
+    static_cast<const uint8_t*>(hashes),
+    hashes_length,
+    results,
+    threads
+  );
+
+  if (lookup_stats_enabled()) {
+    // a merge reads HDAT in runs, not in probes with windows
+    LookupStatsCounts c;
+    c.lookups = hashes_length;
+    c.hits = std::count(results, results + hashes_length, true);
+    std::get<std::unique_ptr<LookupStrategy>>(t)->stats().add(c);
+  }
+}
+
+// Looks the hashes up in groups on this thread, needing no more memory or
+// threads; the bulk lookups fall back to this when they cannot have those
+void lookup_bulk_in_place(
+  const SFHASH_Hashset* hset,
+  size_t tidx,
+  const void* hashes,
+  size_t hashes_length,
+  bool* results)
+{
+  std::get<std::unique_ptr<LookupStrategy>>(hset->holder.hsets[tidx])->contains_bulk(
+    static_cast<const uint8_t*>(hashes),
+    hashes_length,
+    results
+  );
+}
+
 void sfhash_hashset_lookup_bulk(
   const SFHASH_Hashset* hset,
   size_t tidx,
@@ -84,14 +245,112 @@ void sfhash_hashset_lookup_bulk(
   size_t hashes_length,
   bool* results
 ) {
-  const size_t hash_length = std::get<0>(hset->holder.hsets[tidx]).hash_length;
-  for (size_t i = 0; i < hashes_length; ++i) {
-    results[i] = sfhash_hashset_lookup(
-      hset,
-      tidx,
-      static_cast<const uint8_t*>(hashes) + i * hash_length
+  const auto& t = hset->holder.hsets[tidx];
+
+  if (hashes_length >= MERGE_LOOKUP_MIN_BATCH &&
+      hashes_length >= std::get<HashsetHeader>(t).hash_count / MERGE_LOOKUP_MAX_SPARSITY)
+  {
+    // there is no error to report, so if the merge cannot have its
+    // temporary space, look the hashes up in place instead
+    try {
+      hashset_lookup_bulk_merge(hset, tidx, hashes, hashes_length, results, 1);
+      return;
+    }
+    catch (const std::exception&) {
+    }
+  }
+
+  lookup_bulk_in_place(hset, tidx, hashes, hashes_length, results);
+}
+
+void sfhash_hashset_lookup_bulk_merge(
+  const SFHASH_Hashset* hset,
+  size_t tidx,
+  const void* hashes,
+  size_t hashes_length,
+  bool* results,
+  unsigned int threads
+) {
+  try {
+    hashset_lookup_bulk_merge(
+      hset, tidx, hashes, hashes_length, results,
+      threads ? threads : std::max(1u, std::thread::hardware_concurrency())
     );
   }
+  catch (const std::exception&) {
+    lookup_bulk_in_place(hset, tidx, hashes, hashes_length, results);
+  }
+}
+
+void sfhash_hashset_lookup_bulk_mt(
+  const SFHASH_Hashset* hset,
+  size_t tidx,
+  const void* hashes,
+  size_t hashes_length,
+  bool* results,
+  unsigned int threads
+) {
+  const auto& t = hset->holder.hsets[tidx];
+
+  threads = threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+
+  try {
+    if (hashes_length >= MERGE_LOOKUP_MIN_BATCH &&
+        hashes_length >= std::get<HashsetHeader>(t).hash_count / MERGE_LOOKUP_MAX_SPARSITY)
+    {
+      hashset_lookup_bulk_merge(hset, tidx, hashes, hashes_length, results, threads);
+    }
+    else {
+      hashset_dispatcher<PartitionedLookup>(
+        std::get<HashsetHeader>(t).hash_length,
+        *std::get<std::unique_ptr<LookupStrategy>>(t),
+        static_cast<const uint8_t*>(hashes),
+        hashes_length,
+        results,
+        threads
+      );
+    }
+  }
+  catch (const std::exception&) {
+    lookup_bulk_in_place(hset, tidx, hashes, hashes_length, results);
+  }
+}
+
+void fill_lookup_stats(
+  const LookupStatsCounts& c,
+  SFHASH_HashsetLookupStats* stats)
+{
+  *stats = {
+    c.lookups,
+    c.hits,
+    c.lookups - c.hits,
+    c.probes,
+    c.window_total,
+    c.window_max,
+    c.rejections
+  };
+}
+
+bool sfhash_hashset_stats_enable(bool enable) {
+  return set_lookup_stats_enabled(enable);
+}
+
+void sfhash_hashset_stats(
+  const SFHASH_Hashset* hset,
+  size_t tidx,
+  SFHASH_HashsetLookupStats* stats)
+{
+  fill_lookup_stats(
+    std::get<std::unique_ptr<LookupStrategy>>(hset->holder.hsets[tidx])->stats().total(),
+    stats
+  );
+}
+
+void sfhash_hashset_stats_reset(
+  const SFHASH_Hashset* hset,
+  size_t tidx)
+{
+  std::get<std::unique_ptr<LookupStrategy>>(hset->holder.hsets[tidx])->stats().reset();
 }
 
 int hashset_record_field_index_for_type(
@@ -131,13 +390,101 @@ const void* sfhash_hashset_record_field(
 }
 
 const SFHASH_HashsetRecordRange sfhash_hashset_records_lookup(
-  const SFHASH_Hashset* /* hset */,
-  size_t /* tidx */,
-  const void* /* hash */
+  const SFHASH_Hashset* hset,
+  size_t tidx,
+  const void* hash
 ) {
-// TODO: std::binary_search doesn't return a location, so we have nothing
-// to use yet to implement this; maybe we need std::lower_bound?
-  return {};
+  const auto& t = hset->holder.hsets[tidx];
+
+  const auto& ri = std::get<ConstRecordIndex>(t);
+  if (ri.beg == ri.end) {
+    return {};
+  }
+
+  const auto [beg, end] = std::get<std::unique_ptr<LookupStrategy>>(t)->find_range(
+    static_cast<const uint8_t*>(hash)
+  );
+  return { beg, end };
+}
+
+SFHASH_HashsetRecordMatches* sfhash_hashset_records_lookup_bulk(
+  const SFHASH_Hashset* hset,
+  size_t tidx,
+  const void* hashes,
+  size_t hashes_length,
+  SFHASH_Error** err
+) {
+  try {
+    auto m = std::make_unique<SFHASH_HashsetRecordMatches>();
+
+    const auto& t = hset->holder.hsets[tidx];
+    const auto& ri = std::get<ConstRecordIndex>(t);
+    if (ri.beg == ri.end) {
+      return m.release();
+    }
+
+    // most hashes are usually misses; weed them out with the bulk lookup
+    // before searching for the positions of the hits
+    auto hits = std::make_unique<bool[]>(hashes_length);
+    sfhash_hashset_lookup_bulk(hset, tidx, hashes, hashes_length, hits.get());
+
+    const auto& ls = std::get<std::unique_ptr<LookupStrategy>>(t);
+    const uint8_t* h = static_cast<const uint8_t*>(hashes);
+    const size_t hlen = std::get<HashsetHeader>(t).hash_length;
+    const uint64_t* ridx = static_cast<const uint64_t*>(ri.beg);
+
+    for (size_t i = 0; i < hashes_length; ++i) {
+      if (hits[i]) {
+        const auto [beg, end] = ls->find_range(h + i * hlen);
+        for (size_t j = beg; j < end; ++j) {
+          m->matches.push_back({ i, ridx[j] });
+        }
+      }
+    }
+
+    // order by record, so that fetching the records streams through RDAT
+    std::sort(
+      m->matches.begin(), m->matches.end(),
+      [](const SFHASH_HashsetRecordMatch& l, const SFHASH_HashsetRecordMatch& r) {
+        return l.record_index < r.record_index ||
+          (l.record_index == r.record_index && l.hash_index < r.hash_index);
+      }
+    );
+
+    return m.release();
+  }
+  catch (const std::exception& e) {
+    fill_error(err, std::string("failed to look up records: ") + e.what());
+    return nullptr;
+  }
+}
+
+size_t sfhash_hashset_record_matches_count(
+  const SFHASH_HashsetRecordMatches* matches
+) {
+  return matches->matches.size();
+}
+
+const SFHASH_HashsetRecordMatch* sfhash_hashset_record_matches(
+  const SFHASH_HashsetRecordMatches* matches
+) {
+  return matches->matches.data();
+}
+
+void sfhash_hashset_record_matches_destroy(
+  SFHASH_HashsetRecordMatches* matches
+) {
+  delete matches;
+}
+
+const SFHASH_HashsetRecord* sfhash_hashset_record(
+  const SFHASH_Hashset* hset,
+  uint64_t record_index
+) {
+  return reinterpret_cast<const SFHASH_HashsetRecord*>(
+    static_cast<const uint8_t*>(hset->holder.rdat.beg) +
+    record_index * hset->holder.rhdr.record_length
+  );
 }
 
 const SFHASH_HashsetRecord* sfhash_hashset_record_for_hash(
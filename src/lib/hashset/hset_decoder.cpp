@@ -1,10 +1,16 @@
 #include "hashset/hset_decoder.h"
 
 #include "hex.h"
+#include "rwutil.h"
 #include "hashset/basic_ls.h"
 #include "hashset/block_ls.h"
+#include "hashset/block_linear_ls.h"
+#include "hashset/compressed_ls.h"
 #include "hashset/hset_decoder_chunks.h"
+#include "hashset/hset_manifest.h"
+#include "hashset/hset_verify.h"
 #include "hashset/lookupstrategy.h"
+#include "hashset/perfect_hash_ls.h"
 #include "hashset/radius_ls.h"
 #include "hashset/range_ls.h"
 #include "hashset/util.h"
@@ -56,163 +62,174 @@ struct MakeRadiusLookupStrategy: public MakeLookupStrategy<RadiusLookupStrategy,
 template <size_t HashLength>
 struct MakeRangeLookupStrategy: public MakeLookupStrategy<RangeLookupStrategy, HashLength> {};
 
-template <size_t BlockBits>
-std::array<std::pair<int64_t, int64_t>, (1 << BlockBits)> make_blocks(const HashsetHint& hnt) {
-  std::array<std::pair<int64_t, int64_t>, (1 << BlockBits)> blocks;
+template <size_t HashLength>
+struct MakePerfectHashLookupStrategy: public MakeLookupStrategy<PerfectHashLookupStrategy, HashLength> {};
+
+std::vector<std::pair<int64_t, int64_t>> make_blocks(const HashsetHint& hnt) {
+  const uint8_t* beg = static_cast<const uint8_t*>(hnt.beg);
+  const uint8_t* cur = beg;
+  const uint8_t* end = static_cast<const uint8_t*>(hnt.end);
 
-  std::copy(
-    static_cast<const std::pair<int64_t, int64_t>*>(hnt.beg),
-    static_cast<const std::pair<int64_t, int64_t>*>(hnt.end),
-    blocks.begin()
+  std::vector<std::pair<int64_t, int64_t>> blocks(
+    size_t(1) << hint_block_bits(hnt.hint_type)
   );
 
+  for (auto& [lo, hi]: blocks) {
+    lo = read_le<int64_t>(beg, cur, end);
+    hi = read_le<int64_t>(beg, cur, end);
+  }
+
   return blocks;
 }
 
-template <size_t BlockBits, size_t HashLength>
-struct MakeBlockLookupStrategy {
-  template <class... Args>
-  LookupStrategy* operator()(Args&&... args) {
-    return new BlockLookupStrategy<BlockBits, HashLength>(std::forward<Args>(args)...);
+std::vector<LinearBounds> make_linear_blocks(const HashsetHint& hnt) {
+  const uint8_t* beg = static_cast<const uint8_t*>(hnt.beg);
+  const uint8_t* cur = beg;
+  const uint8_t* end = static_cast<const uint8_t*>(hnt.end);
+
+  const auto read_float = [&]() {
+    const uint32_t u = read_le<uint32_t>(beg, cur, end);
+    float f;
+    std::memcpy(&f, &u, sizeof(f));
+    return f;
+  };
+
+  std::vector<LinearBounds> blocks(size_t(1) << hint_block_bits(hnt.hint_type));
+
+  for (auto& [la, lb, ua, ub]: blocks) {
+    la = read_float();
+    lb = read_float();
+    ua = read_float();
+    ub = read_float();
   }
-};
 
-// TODO: there must be a way to template this
-template <size_t HashLength>
-struct MakeBlockLookupStrategy1: public MakeBlockLookupStrategy<HashLength, 1> {};
-
-template <size_t HashLength>
-struct MakeBlockLookupStrategy2: public MakeBlockLookupStrategy<HashLength, 2> {};
-
-template <size_t HashLength>
-struct MakeBlockLookupStrategy3: public MakeBlockLookupStrategy<HashLength, 3> {};
-
-template <size_t HashLength>
-struct MakeBlockLookupStrategy4: public MakeBlockLookupStrategy<HashLength, 4> {};
+  return blocks;
+}
 
-template <size_t HashLength>
-struct MakeBlockLookupStrategy5: public MakeBlockLookupStrategy<HashLength, 5> {};
+// Makes a Strategy<HashLength, BlockBits> for the block bits of a hint
+template <template <size_t, size_t> class Strategy, size_t HashLength>
+struct MakeBlockStrategy {
+  template <class Bounds>
+  LookupStrategy* operator()(
+    unsigned bits,
+    const void* beg,
+    const void* end,
+    const Bounds& blocks)
+  {
+    return make<MIN_HINT_BLOCK_BITS>(bits, beg, end, blocks);
+  }
 
-template <size_t HashLength>
-struct MakeBlockLookupStrategy6: public MakeBlockLookupStrategy<HashLength, 6> {};
+private:
+  template <size_t BlockBits, class Bounds>
+  LookupStrategy* make(
+    unsigned bits,
+    const void* beg,
+    const void* end,
+    const Bounds& blocks)
+  {
+    if constexpr (BlockBits > MAX_HINT_BLOCK_BITS) {
+      THROW("unsupported hint block bits " << bits);
+    }
+    else if (bits == BlockBits) {
+      return new Strategy<HashLength, BlockBits>(beg, end, blocks);
+    }
+    else {
+      return make<BlockBits + 1>(bits, beg, end, blocks);
+    }
+  }
+};
 
 template <size_t HashLength>
-struct MakeBlockLookupStrategy7: public MakeBlockLookupStrategy<HashLength, 7> {};
+struct MakeBlockLookupStrategy: public MakeBlockStrategy<BlockLookupStrategy, HashLength> {};
 
 template <size_t HashLength>
-struct MakeBlockLookupStrategy8: public MakeBlockLookupStrategy<HashLength, 8> {};
+struct MakeBlockLinearLookupStrategy: public MakeBlockStrategy<BlockLinearLookupStrategy, HashLength> {};
 
 std::unique_ptr<LookupStrategy> make_lookup_strategy(
   const HashsetHeader& hsh,
   const HashsetHint& hnt,
-  const ConstHashsetData& hsd)
+  const ConstHashsetData& hsd,
+  const HashsetIndex& hidx)
 {
-  if (hnt.hint_type == 0x6208) {
+  if (hsd.compressed) {
+    // indices and hints index plain hashes
+    THROW_IF(
+      hidx.index_type == IndexType::PERFECT_HASH,
+      "perfect hash over compressed hashes"
+    );
+
     return std::unique_ptr<LookupStrategy>(
-      hashset_dispatcher<MakeBlockLookupStrategy8>(
-        hsh.hash_length, hsd.beg, hsd.end,
-        make_blocks<8>(hnt)
+      hashset_dispatcher<MakeCompressedLookupStrategy>(
+        hsh.hash_length,
+        CompressedHashes(hsd.beg, hsd.end, hsh.hash_length, hsh.hash_count)
       )
     );
   }
-  else {
+  else if (hidx.index_type == IndexType::PERFECT_HASH) {
+    const PerfectHash ph(hidx.beg, hidx.end);
+
+    THROW_IF(
+      ph.key_count() > hsh.hash_count,
+      "perfect hash has " << ph.key_count() << " keys for "
+                          << hsh.hash_count << " hashes"
+    );
+
     return std::unique_ptr<LookupStrategy>(
-      hashset_dispatcher<MakeBasicLookupStrategy>(
-        hsh.hash_length, hsd.beg, hsd.end
+      hashset_dispatcher<MakePerfectHashLookupStrategy>(
+        hsh.hash_length, hsd.beg, hsd.end, ph
       )
     );
   }
 
-/*
-  switch (hnt.hint_type) {
+  // the HINT chunk has been checked to have the data for its type
+  const uint8_t* hbeg = static_cast<const uint8_t*>(hnt.beg);
+  const uint8_t* hcur = hbeg;
+  const uint8_t* hend = static_cast<const uint8_t*>(hnt.end);
+
+  switch (hint_kind(hnt.hint_type)) {
   case HintType::RADIUS:
     return std::unique_ptr<LookupStrategy>(
       hashset_dispatcher<MakeRadiusLookupStrategy>(
         hsh.hash_length, hsd.beg, hsd.end,
-        *static_cast<const uint32_t*>(hnt.beg)
+        read_le<uint32_t>(hbeg, hcur, hend)
       )
     );
+
   case HintType::RANGE:
+    {
+      const int64_t left = read_le<int64_t>(hbeg, hcur, hend);
+      const int64_t right = read_le<int64_t>(hbeg, hcur, hend);
+      return std::unique_ptr<LookupStrategy>(
+        hashset_dispatcher<MakeRangeLookupStrategy>(
+          hsh.hash_length, hsd.beg, hsd.end, left, right
+        )
+      );
+    }
+
+  case HintType::BLOCK:
     return std::unique_ptr<LookupStrategy>(
-      hashset_dispatcher<MakeRangeLookupStrategy>(
-        hsh.hash_length, hsd.beg, hsd.end,
-        *static_cast<const int64_t*>(hnt.beg),
-        *(static_cast<const int64_t*>(hnt.beg) + 1)
+      hashset_dispatcher<MakeBlockLookupStrategy>(
+        hsh.hash_length, hint_block_bits(hnt.hint_type), hsd.beg, hsd.end,
+        make_blocks(hnt)
       )
     );
-  case HintType::BLOCK:
-    {
-      const uint8_t bits = *static_cast<const uint8_t*>(hnt.beg);
-      switch (bits) {
-      case 1:
-        return std::unique_ptr<LookupStrategy>(
-          hashset_dispatcher<MakeBlockLookupStrategy1>(
-            hsh.hash_length, hsd.beg, hsd.end,
-            make_blocks<1>(hnt)
-          )
-        );
-      case 2:
-        return std::unique_ptr<LookupStrategy>(
-          hashset_dispatcher<MakeBlockLookupStrategy2>(
-            hsh.hash_length, hsd.beg, hsd.end,
-            make_blocks<2>(hnt)
-          )
-        );
-      case 3:
-        return std::unique_ptr<LookupStrategy>(
-          hashset_dispatcher<MakeBlockLookupStrategy3>(
-            hsh.hash_length, hsd.beg, hsd.end,
-            make_blocks<3>(hnt)
-          )
-        );
-      case 4:
-        return std::unique_ptr<LookupStrategy>(
-          hashset_dispatcher<MakeBlockLookupStrategy4>(
-            hsh.hash_length, hsd.beg, hsd.end,
-            make_blocks<4>(hnt)
-          )
-        );
-      case 5:
-        return std::unique_ptr<LookupStrategy>(
-          hashset_dispatcher<MakeBlockLookupStrategy5>(
-            hsh.hash_length, hsd.beg, hsd.end,
-            make_blocks<5>(hnt)
-          )
-        );
-
-      case 6:
-        return std::unique_ptr<LookupStrategy>(
-          hashset_dispatcher<MakeBlockLookupStrategy6>(
-            hsh.hash_length, hsd.beg, hsd.end,
-            make_blocks<6>(hnt)
-          )
-        );
-      case 7:
-        return std::unique_ptr<LookupStrategy>(
-          hashset_dispatcher<MakeBlockLookupStrategy7>(
-            hsh.hash_length, hsd.beg, hsd.end,
-            make_blocks<7>(hnt)
-          )
-        );
-      case 8:
-        return std::unique_ptr<LookupStrategy>(
-          hashset_dispatcher<MakeBlockLookupStrategy8>(
-            hsh.hash_length, hsd.beg, hsd.end,
-            make_blocks<8>(hnt)
-          )
-        );
-      }
-    }
+
   case HintType::BLOCK_LINEAR:
-    // TODO: implement this
+    return std::unique_ptr<LookupStrategy>(
+      hashset_dispatcher<MakeBlockLinearLookupStrategy>(
+        hsh.hash_length, hint_block_bits(hnt.hint_type), hsd.beg, hsd.end,
+        make_linear_blocks(hnt)
+      )
+    );
+
   default:
+    // no hint, or none at all, as for sizes
     return std::unique_ptr<LookupStrategy>(
       hashset_dispatcher<MakeBasicLookupStrategy>(
         hsh.hash_length, hsd.beg, hsd.end
       )
     );
   }
-*/
 }
 
 constexpr char MAGIC[] = {'S', 'e', 't', 'O', 'H', 'a', 's', 'h'};
@@ -220,7 +237,10 @@ constexpr char MAGIC[] = {'S', 'e', 't', 'O', 'H', 'a', 's', 'h'};
 void check_magic(const uint8_t*& i, const uint8_t* end) {
   // read magic
   THROW_IF(i + std::size(MAGIC) > end, "out of data reading magic");
-  THROW_IF(std::memcmp(i, MAGIC, std::size(MAGIC)), "bad magic");
+  if (std::memcmp(i, MAGIC, std::size(MAGIC))) {
+    check_not_manifest(i, end);
+    THROW("bad magic");
+  }
   i += std::size(MAGIC);
 }
 
@@ -245,7 +265,8 @@ State::Type handle_hhdr(const Chunk& ch, Holder& h) {
     HashsetHint(),
     ConstHashsetData(),
     nullptr,
-    ConstRecordIndex()
+    ConstRecordIndex(),
+    HashsetIndex()
   );
 
   return State::HHDR;
@@ -267,14 +288,32 @@ State::Type handle_hint(const Chunk& ch, Holder& h) {
 
   hnt = parse_hint(ch);
 
+  const size_t len = hint_data_length(hnt.hint_type);
+
   THROW_IF(
-    hnt.hint_type != 0x6208,
+    !len,
     "bad hint type " << std::hex << std::setw(4) << std::setfill('0') << hnt.hint_type
   );
 
+  check_data_length(ch, len);
+
   return State::HINT;
 }
 
+State::Type handle_hidx(const Chunk& ch, Holder& h) {
+  auto& hset = h.hsets.back();
+  auto& hidx = std::get<HashsetIndex>(hset);
+
+  hidx = parse_hidx(ch);
+
+  THROW_IF(
+    hidx.index_type != IndexType::PERFECT_HASH,
+    "bad index type " << hidx.index_type
+  );
+
+  return State::HIDX;
+}
+
 State::Type handle_hdat(const Chunk& ch, Holder& h) {
   auto& hset = h.hsets.back();
   const auto& hhdr = std::get<HashsetHeader>(hset);
@@ -286,6 +325,18 @@ State::Type handle_hdat(const Chunk& ch, Holder& h) {
   return State::HDAT;
 }
 
+State::Type handle_hdac(const Chunk& ch, Holder& h) {
+  auto& hset = h.hsets.back();
+  const auto& hhdr = std::get<HashsetHeader>(hset);
+  auto& hdat = std::get<ConstHashsetData>(hset);
+
+  // the strategy checks the rest of the HDAC when it is made
+  check_data_length(ch, compressed_length(hhdr.hash_count, hhdr.hash_length));
+
+  hdat = parse_hdac(ch);
+  return State::HDAT;
+}
+
 State::Type handle_ridx(const Chunk& ch, Holder& h) {
   auto& hset = h.hsets.back();
   const auto& hhdr = std::get<HashsetHeader>(hset);
@@ -303,6 +354,17 @@ State::Type handle_rdat(const Chunk& ch, Holder& h) {
   return State::SBRK;
 }
 
+State::Type handle_csum(const Chunk& ch, Holder& h) {
+  h.csum = parse_csum(ch);
+
+  THROW_IF(
+    h.csum.checksum_type != ChecksumType::BLAKE3_256,
+    "bad checksum type " << h.csum.checksum_type
+  );
+
+  return State::CSUM;
+}
+
 State::Type handle_fend(const Chunk&, Holder&) {
   return State::DONE;
 }
@@ -319,8 +381,6 @@ TableOfContents read_ftoc_chunk(const uint8_t* beg, const uint8_t*& cur, const u
   return parse_ftoc(ch);
 }
 
-// TODO: add validation flag
-
 Holder decode_hset(const uint8_t* beg, const uint8_t* end) {
   const uint8_t* cur = beg;
 
@@ -340,10 +400,46 @@ Holder decode_hset(const uint8_t* beg, const uint8_t* end) {
   // set the hset hash now that the FHDR exists to receive it
   h.fhdr.sha2_256 = hset_hash;
 
+  h.ftoc = toc;
+  h.beg = beg;
+  h.end = end;
+
+  if (h.csum.beg) {
+    // the digests are checked on request; their number can be checked now
+    const auto dlen = static_cast<const uint8_t*>(h.csum.end) -
+                      static_cast<const uint8_t*>(h.csum.beg);
+    const auto scount = checksum_segments(toc, h.csum.segment_length).size();
+
+    THROW_IF(
+      dlen != static_cast<ptrdiff_t>(scount * CSUM_DIGEST_LENGTH),
+      "expected " << scount * CSUM_DIGEST_LENGTH << " bytes of digests in CSUM"
+                  << ", found " << dlen
+    );
+  }
+
   // install lookup strategies
-  for (auto& [hsh, hnt, hsd, ls, _]: h.hsets) {
-    ls = make_lookup_strategy(hsh, hnt, hsd);
+  for (auto& [hsh, hnt, hsd, ls, ridx, hidx]: h.hsets) {
+    ls = make_lookup_strategy(hsh, hnt, hsd, hidx);
   }
 
   return h;
 }
+
+FileHeader decode_hset_fhdr(const uint8_t* beg, const uint8_t* end) {
+  const uint8_t* cur = beg;
+
+  check_magic(cur, end);
+  const auto hset_hash = read_hset_hash(cur, end);
+  const TableOfContents toc = read_ftoc_chunk(beg, cur, end);
+
+  const auto e = std::find_if(
+    toc.entries.begin(), toc.entries.end(),
+    [](const auto& e) { return e.second == Chunk::FHDR; }
+  );
+  THROW_IF(e == toc.entries.end(), "no FHDR");
+
+  cur = beg + e->first;
+  FileHeader fhdr = parse_fhdr(decode_chunk(beg, cur, end));
+  fhdr.sha2_256 = hset_hash;
+  return fhdr;
+}
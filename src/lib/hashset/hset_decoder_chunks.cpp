@@ -84,6 +84,25 @@ HashsetHint parse_hint(const Chunk& ch) {
   };
 }
 
+HashsetIndex parse_hidx(const Chunk& ch) {
+  const uint8_t* cur = ch.dbeg;
+  return {
+    read_le<uint16_t>(ch.dbeg, cur, ch.dend),
+    cur,
+    ch.dend
+  };
+}
+
+ChunkChecksums parse_csum(const Chunk& ch) {
+  const uint8_t* cur = ch.dbeg;
+  return {
+    read_le<uint16_t>(ch.dbeg, cur, ch.dend),
+    read_le<uint64_t>(ch.dbeg, cur, ch.dend),
+    cur,
+    ch.dend
+  };
+}
+
 ConstRecordIndex parse_ridx(const Chunk& ch) {
   return { ch.dbeg, ch.dend };
 }
@@ -92,6 +111,10 @@ ConstHashsetData parse_hdat(const Chunk& ch) {
   return { ch.dbeg, ch.dend };
 }
 
+ConstHashsetData parse_hdac(const Chunk& ch) {
+  return { ch.dbeg, ch.dend, true };
+}
+
 ConstRecordData parse_rdat(const Chunk& ch) {
   return { ch.dbeg, ch.dend };
 }
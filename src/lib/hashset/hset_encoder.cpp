@@ -1,11 +1,13 @@
 #include "hashset/hset_encoder.h"
 
 #include <algorithm>
+#include <atomic>
 // C++20: #include <bit>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
 #include <ctime>
+#include <exception>
 #include <filesystem>
 #include <fstream>
 #include <iomanip>
@@ -14,11 +16,14 @@
 #include <iterator>
 #include <limits>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <numeric>
 #include <ostream>
 #include <set>
 #include <stdexcept>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include <boost/lexical_cast.hpp>
@@ -33,10 +38,16 @@ namespace bip = boost::interprocess;
 #include "hex.h"
 #include "rwutil.h"
 #include "util.h"
+#include "hashset/background_hasher.h"
+#include "hashset/compressed_hashes.h"
+#include "hashset/external_sort.h"
+#include "hashset/hint_select.h"
 #include "hashset/hset_encoder_chunks.h"
+#include "hashset/hset_verify.h"
+#include "hashset/perfect_hash.h"
+#include "hashset/radix_sort.h"
 #include "hashset/record_iterator.h"
 #include "hashset/util.h"
-#include "hasher/hasher.h"
 #include "hasher/hashset.h"
 #include "util/istream_line_range.h"
 
@@ -73,36 +84,27 @@ size_t write_to(char* out, const void* buf, size_t len) {
   return len;
 }
 
-template <size_t BlockBits>
-std::vector<std::pair<int64_t, int64_t>> make_block_bounds(
-  RecordIterator beg,
-  RecordIterator end)
-{
-  std::vector<std::pair<int64_t, int64_t>> block_bounds(
-    1 << BlockBits,
-    {
-      std::numeric_limits<int64_t>::max(),
-      std::numeric_limits<int64_t>::min()
-    }
-  );
-
-  const auto count = end - beg;
-
-  for (auto i = beg; i != end; ++i) {
-    const size_t e = expected_index(reinterpret_cast<const uint8_t*>(i->rec.data()), count);
-    const int64_t delta = static_cast<int64_t>(i - beg) - static_cast<int64_t>(e);
-
-    const size_t bi = static_cast<uint8_t>(i->rec[0]) >> (8 - BlockBits);
-    block_bounds[bi].first = std::min(block_bounds[bi].first, delta);
-    block_bounds[bi].second = std::max(block_bounds[bi].second, delta);
-  }
-
-  return block_bounds;
+bool compress_field(uint32_t type, uint32_t flags) {
+  return (flags & SFHASH_HASHSET_BUILD_COMPRESSED) && type != SFHASH_SIZE;
 }
 
+// The room for up to hash_count hashes of a field: an HDAC is written over
+// the sorted hashes, so needs room for them too
+size_t length_hash_data(
+  uint32_t type,
+  uint64_t hash_count,
+  size_t hash_length,
+  uint32_t flags)
+{
+  const size_t len = length_hdat(hash_count, hash_length);
+  return compress_field(type, flags) ?
+    std::max(len, 12 + compressed_length_max(hash_count, hash_length)) : len;
+}
 
-
-size_t count_chunks(const std::vector<RecordFieldDescriptor>& fields) {
+size_t count_chunks(
+  const std::vector<RecordFieldDescriptor>& fields,
+  uint32_t flags)
+{
   size_t chunk_count = 5 + 3 * fields.size();
 
   for (const auto& hi: fields) {
@@ -111,10 +113,21 @@ size_t count_chunks(const std::vector<RecordFieldDescriptor>& fields) {
     }
   }
 
+  if (flags & SFHASH_HASHSET_BUILD_PERFECT_HASH) {
+    chunk_count += fields.size();
+  }
+
+  if (flags & SFHASH_HASHSET_BUILD_CHECKSUMS) {
+    ++chunk_count;
+  }
+
   return chunk_count;
 }
 
-size_t count_chunks_hashsets_only(const std::vector<RecordFieldDescriptor>& fields) {
+size_t count_chunks_hashsets_only(
+  const std::vector<RecordFieldDescriptor>& fields,
+  uint32_t flags)
+{
   size_t chunk_count = 4 + 2 * fields.size();
 
   for (const auto& hi: fields) {
@@ -123,17 +136,31 @@ size_t count_chunks_hashsets_only(const std::vector<RecordFieldDescriptor>& fiel
     }
   }
 
+  if (flags & SFHASH_HASHSET_BUILD_PERFECT_HASH) {
+    chunk_count += fields.size();
+  }
+
+  if (flags & SFHASH_HASHSET_BUILD_CHECKSUMS) {
+    ++chunk_count;
+  }
+
   return chunk_count;
 }
 
+size_t length_csum_bound(size_t chunk_count, uint64_t len) {
+  // no chunk has more than one piece beyond what its length requires
+  return length_csum(chunk_count + len / CSUM_SEGMENT_LENGTH + 1);
+}
+
 size_t length_hset(
   const std::string& hashset_name,
   const std::string& hashset_desc,
   const std::string& timestamp,
   const std::vector<RecordFieldDescriptor>& fields,
-  size_t record_count)
+  size_t record_count,
+  uint32_t flags)
 {
-  size_t chunk_count = count_chunks(fields);
+  size_t chunk_count = count_chunks(fields, flags);
 
   size_t len = length_magic() +
                length_hset_hash() +
@@ -146,15 +173,23 @@ size_t length_hset(
     len += length_hhnn(hi);
 
     if (hi.type != SFHASH_SIZE) {
-      len += length_hint();
+      len += length_hint_max(record_count);
+    }
+
+    if (flags & SFHASH_HASHSET_BUILD_PERFECT_HASH) {
+      len += length_hidx(record_count);
     }
 
     len += length_alignment_padding(len, 4096);
 
-    len += length_hdat(record_count, hi.length) +
+    len += length_hash_data(hi.type, record_count, hi.length, flags) +
            length_ridx(record_count);
   }
 
+  if (flags & SFHASH_HASHSET_BUILD_CHECKSUMS) {
+    len += length_csum_bound(chunk_count, len);
+  }
+
   len += length_fend();
 
   return len;
@@ -165,15 +200,22 @@ size_t length_hset_records_only(
   const std::string& hashset_desc,
   const std::string& timestamp,
   const std::vector<RecordFieldDescriptor>& fields,
-  size_t record_count)
+  size_t record_count,
+  uint32_t flags)
 {
+  // the FTOC has the room layout_initial_chunks left for it
   size_t len = length_magic() +
                length_hset_hash() +
-               length_ftoc(5) +
+               length_ftoc(count_chunks(fields, flags)) +
                length_fhdr(hashset_name, hashset_desc, timestamp) +
                length_rhdr(fields) +
                length_rdat(fields, record_count);
 
+  if (flags & SFHASH_HASHSET_BUILD_CHECKSUMS) {
+    // FTOC, FHDR, RHDR, RDAT
+    len += length_csum_bound(4, len);
+  }
+
   len += length_fend();
 
   return len;
@@ -184,27 +226,41 @@ size_t length_hset_hashsets_only(
   const std::string& hashset_desc,
   const std::string& timestamp,
   const std::vector<RecordFieldDescriptor>& fields,
-  uint64_t record_count,
-  const decltype(SFHASH_HashsetBuildCtx::hsets)& hsets)
+  const decltype(SFHASH_HashsetBuildCtx::hsets)& hsets,
+  uint32_t flags)
 {
-  size_t chunk_count = count_chunks_hashsets_only(fields);
+  size_t chunk_count = count_chunks_hashsets_only(fields, flags);
 
+  // the FTOC has the room layout_initial_chunks left for it
   size_t len = length_magic() +
                length_hset_hash() +
-               length_ftoc(chunk_count) +
+               length_ftoc(count_chunks(fields, flags)) +
                length_fhdr(hashset_name, hashset_desc, timestamp) +
                length_rhdr(fields);
 
   for (size_t i = 0; i < fields.size(); ++i) {
+    // a field has as many hashes as were added for it, which may be far
+    // fewer than there are records
+    const auto& hhdr = std::get<HashsetHeader>(hsets[i]);
+
     len += length_hhnn(fields[i]);
 
     if (fields[i].type != SFHASH_SIZE) {
-      len += length_hint();
+      len += length_hint_max(hhdr.hash_count);
+    }
+
+    if (flags & SFHASH_HASHSET_BUILD_PERFECT_HASH) {
+      len += length_hidx(hhdr.hash_count);
     }
 
     len += length_alignment_padding(len, 4096);
-//    len += length_hdat(std::get<0>(hsets[i]).hash_count, std::get<0>(hsets[i]).hash_length);
-    len += length_hdat(record_count, std::get<HashsetHeader>(hsets[i]).hash_length);
+    len += length_hash_data(
+      fields[i].type, hhdr.hash_count, hhdr.hash_length, flags
+    );
+  }
+
+  if (flags & SFHASH_HASHSET_BUILD_CHECKSUMS) {
+    len += length_csum_bound(chunk_count, len);
   }
 
   len += length_fend();
@@ -232,6 +288,14 @@ void check_strlen(const char* s, const char* sname) {
   );
 }
 
+// The hint and perfect hash of a field, made once its hashes are sorted
+struct FieldIndexes {
+  HintCandidate hint;
+  PerfectHashData phd;
+};
+
+// Writes chunks [first, last) of ftoc, handing each to hasher once it is
+// done, so that the hset hash is computed as the chunks are written
 void write_chunks(
   char* beg,
   const TableOfContents& ftoc,
@@ -247,21 +311,23 @@ void write_chunks(
       uint64_t*
     >
   >& hb,
-  const std::map<uint64_t, size_t>& off2hbidx
+  const std::map<uint64_t, size_t>& off2hbidx,
+  const std::vector<FieldIndexes>& fidx,
+  BackgroundHasher& hasher,
+  size_t first,
+  size_t last
 )
 {
   char* out = beg;
 
-  // magic
-  out += write_magic(out);
-
-  // note the start of the hset hash
-  char* hset_hash = out;
-  // note the start of the data to be hashed
-  const char* hset_data = hset_hash + length_hset_hash();
+  if (first == 0) {
+    // magic
+    write_magic(out);
+  }
 
   // write the chunks
-  for (const auto& [choff, chtype]: ftoc.entries) {
+  for (size_t ci = first; ci < last; ++ci) {
+    const auto& [choff, chtype] = ftoc.entries[ci];
     out = beg + choff;
 
     switch (chtype) {
@@ -282,23 +348,46 @@ void write_chunks(
       break;
 
     case Chunk::Type::HINT:
+      write_hint(fidx[off2hbidx.at(choff)].hint, out);
+      break;
+
+    case Chunk::Type::HIDX:
+      write_hidx(fidx[off2hbidx.at(choff)].phd, out);
+      break;
+
+    case Chunk::Type::HDAT:
       {
         const size_t i = off2hbidx.at(choff);
-        write_hint(make_block_bounds<8>(std::get<1>(hb[i]), std::get<2>(hb[i])), out);
+        HashsetData hdat{
+          std::get<1>(hb[i])->rec.data(),
+          std::get<2>(hb[i])->rec.data()
+        };
+        write_hdat(hdat, out);
       }
       break;
 
-    case Chunk::Type::HDAT:
+    case Chunk::Type::HDAC:
       {
         const size_t i = off2hbidx.at(choff);
         HashsetData hdat{
           std::get<1>(hb[i])->rec.data(),
           std::get<2>(hb[i])->rec.data()
         };
-        write_hdat(hdat, out);
+
+        // compress the hashes where they lie; zero what is left of them,
+        // so that the file is the same each time
+        uint8_t* end = reinterpret_cast<uint8_t*>(out) +
+                       write_hdac(hdat, std::get<0>(hb[i]), out);
+        if (end < hdat.end) {
+          std::fill(end, hdat.end, 0);
+        }
       }
       break;
 
+    case Chunk::Type::CSUM:
+      write_csum(beg, ftoc, std::thread::hardware_concurrency(), out);
+      break;
+
     case Chunk::Type::FEND:
       out += write_fend(out);
       break;
@@ -322,19 +411,133 @@ void write_chunks(
       }
       break;
     }
+
+    // the chunk runs to the next one; FEND, the last, has moved out past
+    // its end
+    hasher.finished(reinterpret_cast<const uint8_t*>(
+      ci + 1 < ftoc.entries.size() ? beg + ftoc.entries[ci + 1].first : out
+    ));
   }
+}
 
-  // hash the hset data
-  auto hasher = make_unique_del(
-    sfhash_create_hasher(SFHASH_SHA_2_256), sfhash_destroy_hasher
-  );
+// The hset hash covers everything after it
+const uint8_t* hset_hashed_data(const char* beg) {
+  return reinterpret_cast<const uint8_t*>(beg) + length_magic() + length_hset_hash();
+}
+
+void write_hset_hash(char* beg, BackgroundHasher& hasher) {
+  const auto digest = hasher.digest();
+  write_bytes(digest.data(), digest.size(), beg + length_magic());
+}
 
-  sfhash_update_hasher(hasher.get(), hset_data, out);
+// Whether sorting count strings of length len needs more than the limit
+bool sort_externally(uint64_t memory_limit, uint64_t count, size_t len) {
+  return memory_limit && count * len > memory_limit;
+}
+
+// Sorts a field's hashes with their record indices through temp files,
+// as hashes followed by big-endian indices, and merges them into its HDAT
+// and RIDX; the records are read and the sections written sequentially
+void scatter_field_externally(
+  const RecordHeader& rhdr,
+  const RecordData& rdat,
+  size_t roff,
+  uint64_t hlen,
+  RecordIterator& hi,
+  uint64_t*& ii,
+  uint64_t memory_limit,
+  const std::filesystem::path& tmp_dir,
+  const std::string& name)
+{
+  ExternalSorter sorter(hlen + 8, memory_limit, tmp_dir, name, false);
+
+  std::vector<uint8_t> key(hlen + 8);
+  uint64_t recno = 0;
+  for (const uint8_t* r = rdat.beg; r < rdat.end; r += rhdr.record_length, ++recno) {
+    if (r[roff - 1] == 0x01) {
+      std::memcpy(key.data(), r + roff, hlen);
+      const uint64_t be = to_be(recno);
+      std::memcpy(key.data() + hlen, &be, 8);
+      sorter.add(key.data());
+    }
+  }
+
+  sorter.merge([&](const uint8_t* k) {
+    std::memcpy(hi->rec.data(), k, hlen);
+    ++hi;
+
+    uint64_t be;
+    std::memcpy(&be, k + hlen, 8);
+    *ii++ = from_be(be);
+  });
+}
+
+void index_field(
+  const RecordFieldDescriptor& field,
+  uint64_t hlen,
+  const RecordIterator& hbeg,
+  const RecordIterator& hend,
+  uint32_t flags,
+  FieldIndexes& fidx)
+{
+  if (field.type != SFHASH_SIZE) {
+    fidx.hint = select_hint(hbeg->rec.data(), hend - hbeg, hlen);
+  }
+
+  if (flags & SFHASH_HASHSET_BUILD_PERFECT_HASH) {
+    fidx.phd = make_perfect_hash(hbeg->rec.data(), hend->rec.data(), hlen);
+  }
+}
 
-  SFHASH_HashValues hashes;
-  sfhash_get_hashes(hasher.get(), &hashes);
+// Runs task(i, t) for each field i on a pool of up to one thread per
+// core, where t is how many threads the task may use itself
+template <class Func>
+void run_field_tasks(size_t fields, Func task) {
+  const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+  const unsigned threads = std::clamp<size_t>(fields, 1, cores);
 
-  write_bytes(hashes.Sha2_256, std::size(hashes.Sha2_256), hset_hash);
+  std::atomic<size_t> next{0};
+  std::vector<std::exception_ptr> errors(threads);
+
+  run_on_threads(threads, [&](unsigned k) {
+    try {
+      for (size_t i; (i = next++) < fields; ) {
+        task(i, std::max(1u, cores / threads));
+      }
+    }
+    catch (...) {
+      errors[k] = std::current_exception();
+      // leave the other fields undone
+      next = fields;
+    }
+  });
+
+  for (const auto& e: errors) {
+    if (e) {
+      std::rethrow_exception(e);
+    }
+  }
+}
+
+void index_fields(
+  const RecordHeader& rhdr,
+  const std::vector<
+    std::tuple<
+      uint64_t,
+      RecordIterator,
+      RecordIterator,
+      uint64_t*,
+      uint64_t*
+    >
+  >& hb,
+  uint32_t flags,
+  std::vector<FieldIndexes>& fidx)
+{
+  fidx.resize(hb.size());
+  run_field_tasks(hb.size(), [&](size_t fi, unsigned) {
+    const auto& [hlen, hbeg, hend, ibeg, iend] = hb[fi];
+    index_field(rhdr.fields[fi], hlen, hbeg, hend, flags, fidx[fi]);
+  });
 }
 
 void scatter_records_to_hashset(
@@ -348,71 +551,320 @@ void scatter_records_to_hashset(
       uint64_t*,
       uint64_t*
     >
-  >& hb)
+  >& hb,
+  uint32_t flags,
+  uint64_t memory_limit,
+  const std::filesystem::path& tmp_dir,
+  std::vector<FieldIndexes>& fidx)
 {
-  RecordIterator rbeg(rdat.beg, rhdr.record_length);
-  RecordIterator rend(rdat.end, rhdr.record_length);
-  size_t recno = 0;
-  // Scatter each record out to the hash sections
-  for (auto i = rbeg; i != rend; ++i) {
-    size_t roff = 1;
-    for (auto& [hlen, hbeg, hi, ibeg, ii]: hb) {
-      if (*i->rec.data() == 0x01) {
-        // write the hash to its HDAT section
-        std::memcpy(hi->rec.data(), i->rec.data() + roff, hlen);
-        ++hi;
-
-        // write the record index to its RIDX section
-        *ii++ = i - rbeg;
+  const size_t fields = hb.size();
+
+  std::vector<bool> external;
+  std::vector<size_t> roffs;
+  size_t roff = 1;
+  for (const auto& h: hb) {
+    external.push_back(
+      sort_externally(memory_limit, rhdr.record_count, std::get<0>(h) + 8)
+    );
+    roffs.push_back(roff);
+    roff += std::get<0>(h) + 1;
+  }
+
+  // Scatter each record out to the hash sections, in one pass over the
+  // records split among the threads. Each slice of records writes its
+  // hashes where they would go if every record before it had each of
+  // them, as no field has more hashes than records.
+  const unsigned threads = std::clamp<uint64_t>(
+    std::thread::hardware_concurrency(),
+    1, std::max<uint64_t>(1, rhdr.record_count / (1 << 16))
+  );
+
+  const auto slice = [n = rhdr.record_count, threads](unsigned k) {
+    return n / threads * k + std::min<uint64_t>(k, n % threads);
+  };
+
+  // the number of hashes each slice has for each field
+  std::vector<std::vector<uint64_t>> scounts(
+    threads, std::vector<uint64_t>(fields, 0)
+  );
+
+  run_on_threads(threads, [&](unsigned k) {
+    const uint64_t rb = slice(k);
+    const uint64_t re = slice(k + 1);
+
+    std::vector<uint8_t*> ho;
+    std::vector<uint64_t*> io;
+    for (const auto& [hlen, hbeg, hi, ibeg, ii]: hb) {
+      ho.push_back(hbeg->rec.data() + rb * hlen);
+      io.push_back(ibeg + rb);
+    }
+
+    const uint8_t* r = rdat.beg + rb * rhdr.record_length;
+    for (uint64_t recno = rb; recno < re; ++recno, r += rhdr.record_length) {
+      for (size_t fi = 0; fi < fields; ++fi) {
+        if (!external[fi] && r[roffs[fi] - 1] == 0x01) {
+          // write the hash to its HDAT section
+          const uint64_t hlen = std::get<0>(hb[fi]);
+          std::memcpy(ho[fi], r + roffs[fi], hlen);
+          ho[fi] += hlen;
+
+          // write the record index to its RIDX section
+          *io[fi]++ = recno;
+        }
+      }
+    }
+
+    for (size_t fi = 0; fi < fields; ++fi) {
+      scounts[k][fi] = io[fi] - (std::get<3>(hb[fi]) + rb);
+    }
+  });
+
+  // the fields too large to sort in memory go one at a time, to keep to
+  // the limit
+  for (size_t fi = 0; fi < fields; ++fi) {
+    if (external[fi]) {
+      auto& [hlen, hbeg, hend, ibeg, iend] = hb[fi];
+      scatter_field_externally(
+        rhdr, rdat, roffs[fi], hlen, hend, iend, memory_limit, tmp_dir,
+        "ridx_" + std::to_string(rhdr.fields[fi].type)
+      );
+    }
+  }
+
+  // Sort and index the fields concurrently
+  fidx.resize(fields);
+  run_field_tasks(fields, [&](size_t fi, unsigned sort_threads) {
+    auto& [hlen, hbeg, hend, ibeg, iend] = hb[fi];
+
+    if (!external[fi]) {
+      // close the gaps left by records without the hash
+      uint8_t* h = hbeg->rec.data();
+      uint64_t n = 0;
+      for (unsigned k = 0; k < threads; ++k) {
+        const uint64_t c = scounts[k][fi];
+        if (n != slice(k)) {
+          std::memmove(h + n * hlen, h + slice(k) * hlen, c * hlen);
+          std::memmove(ibeg + n, ibeg + slice(k), c * sizeof(uint64_t));
+        }
+        n += c;
+      }
+
+      hend = hbeg + n;
+      iend = ibeg + n;
+
+      // Sort hashes and ridx together
+      radix_sort(h, ibeg, n, hlen, sort_threads);
+    }
+
+    // zero the room left by records without the hash, which could hold
+    // hashes moved from it, so that the file is the same each time
+    std::fill(hend->rec.data(), hbeg->rec.data() + rhdr.record_count * hlen, 0);
+    std::fill(iend, ibeg + rhdr.record_count, 0);
+
+    index_field(rhdr.fields[fi], hlen, hbeg, hend, flags, fidx[fi]);
+  });
+}
+
+// One past the last newline in [beg, end), or beg if there is none
+const char* after_last_newline(const char* beg, const char* end) {
+  for (const char* i = end; i > beg; --i) {
+    if (i[-1] == '\n') {
+      return i;
+    }
+  }
+  return beg;
+}
+
+TextIngester::TextIngester(
+  SFHASH_HashsetBuildCtx* bctx,
+  const std::vector<Converter>& conv,
+  unsigned threads,
+  size_t chunk_length
+):
+  Bctx(bctx),
+  Conv(conv),
+  RecordLength(0),
+  ChunkLength(std::max<size_t>(1, chunk_length)),
+  Chunks(threads ? threads : std::max(1u, std::thread::hardware_concurrency())),
+  LineNo(0)
+{
+  for (const auto& c: conv) {
+    RecordLength += 1 + c.second;
+  }
+}
+
+void TextIngester::parse(Chunk& c) const {
+  c.lines = 0;
+  c.error_line = 0;
+  c.rec.resize(RecordLength);
+
+  const size_t fields = Conv.size();
+
+  for (const char* l = c.beg; l < c.end; ) {
+    const char* le = static_cast<const char*>(std::memchr(l, '\n', c.end - l));
+    if (!le) {
+      le = c.end;
+    }
+
+    ++c.lines;
+
+    if (le > l) {
+      const size_t cols = std::count(l, le, ' ') + 1;
+      if (cols != fields) {
+        c.error = cols > fields ? "too many columns" : "too few columns";
+        c.error_line = c.lines;
+        return;
       }
 
-      roff += hlen + 1;
+      std::fill(c.rec.begin(), c.rec.end(), 0);
+      uint8_t* r = c.rec.data();
+
+      try {
+        const char* cb = l;
+        for (const auto& [conv, len]: Conv) {
+          const char* ce = static_cast<const char*>(std::memchr(cb, ' ', le - cb));
+          if (!ce) {
+            ce = le;
+          }
+
+          if (ce > cb) {
+            // the converters want a terminated column
+            *r = 0x01;
+            c.col.assign(cb, ce);
+            conv(r + 1, c.col.c_str(), len);
+          }
+
+          r += 1 + len;
+          cb = ce + 1;
+        }
+
+        sfhash_hashset_builder_thread_add_record(c.tctx, c.rec.data());
+      }
+      catch (const std::exception& e) {
+        c.error = e.what();
+        c.error_line = c.lines;
+        return;
+      }
     }
 
-    ++recno;
-/*
-    if (recno % 10000 == 0) {
-      std::cerr << "scattered " << recno << " records\n";
+    l = le + 1;
+  }
+}
+
+void TextIngester::close_handles(unsigned n) {
+  std::string error;
+  for (unsigned k = 0; k < n; ++k) {
+    SFHASH_Error* err = nullptr;
+    sfhash_hashset_builder_thread_close(Chunks[k].tctx, &err);
+    Chunks[k].tctx = nullptr;
+    if (err) {
+      if (error.empty()) {
+        error = err->message;
+      }
+      sfhash_free_error(err);
     }
-*/
   }
 
-//  std::cerr << "scattered " << recno << " records\n";
+  THROW_IF(!error.empty(), error);
+}
+
+const char* TextIngester::ingest(const char* beg, const char* end, bool last) {
+  for (;;) {
+    // cut a chunk for each thread, ending each after a newline
+    unsigned n = 0;
+    for ( ; n < Chunks.size() && beg < end; ++n) {
+      const char* ce = nullptr;
+      if (static_cast<size_t>(end - beg) > ChunkLength) {
+        ce = static_cast<const char*>(
+          std::memchr(beg + ChunkLength, '\n', end - beg - ChunkLength)
+        );
+        if (ce) {
+          ++ce;
+        }
+      }
+
+      if (!ce) {
+        ce = last ? end : after_last_newline(beg, end);
+      }
+
+      if (ce == beg) {
+        // no whole line left
+        break;
+      }
+
+      Chunks[n].beg = beg;
+      Chunks[n].end = ce;
+      beg = ce;
+    }
+
+    if (n == 0) {
+      return beg;
+    }
+
+    // each thread adds its records through a handle of its own
+    for (unsigned k = 0; k < n; ++k) {
+      SFHASH_Error* err = nullptr;
+      Chunks[k].tctx = sfhash_hashset_builder_thread_open(Bctx, &err);
+      if (err) {
+        const std::string msg = err->message;
+        sfhash_free_error(err);
+        close_handles(k);
+        THROW(msg);
+      }
+    }
+
+    run_on_threads(n, [this](unsigned k) { parse(Chunks[k]); });
+
+    close_handles(n);
 
-  for (auto& [hlen, hbeg, hend, ibeg, iend]: hb) {
-    // Sort hashes and ridx together
-    HashRecordIterator hrbeg(0, hbeg->rec.data(), hlen, ibeg);
-    HashRecordIterator hrend(iend - ibeg, hbeg->rec.data(), hlen, ibeg);
-    std::sort(hrbeg, hrend);
+    for (unsigned k = 0; k < n; ++k) {
+      const auto& c = Chunks[k];
+      THROW_IF(c.error_line, c.error << " at line " << LineNo + c.error_line);
+      LineNo += c.lines;
+    }
   }
+}
+
+void TextIngester::ingest(std::istream& in) {
+  const size_t want = Chunks.size() * ChunkLength;
+
+  std::vector<char> buf;
+  size_t have = 0;
 
-//  std::cerr << "sorted HDAT blocks\n";
+  for (bool last = false; !last; ) {
+    // anything left over is a partial line, which gets longer each time
+    if (buf.size() < have + want) {
+      buf.resize(have + want);
+    }
+
+    in.read(buf.data() + have, want);
+    THROW_IF(in.bad(), "failed to read input");
+    have += in.gcount();
+    last = !in;
+
+    const char* rest = ingest(buf.data(), buf.data() + have, last);
+    have -= rest - buf.data();
+    std::memmove(buf.data(), rest, have);
+  }
 }
 
-// TODO: switch to a std::view for producing these lazily
-std::vector<std::string_view> split(std::string_view s, char delim) {
-  std::vector<std::string_view> splits;
+void TextIngester::ingest(const std::filesystem::path& infile) {
+  // an empty file cannot be mapped
+  if (std::filesystem::file_size(infile) == 0) {
+    return;
+  }
 
-  auto i = s.begin();
-  do {
-    auto j = std::find(i, s.end(), delim);
-    /*
-    * This is a workaround for clang <= 14. Once 15 is out
-    * we should remove this #if.
-    */
-// C++20: #if defined __clang__ && __clang_major__ <= 14
-    splits.emplace_back(i, std::distance(i, j));
-// C++20: #else
-// C++20: splits.emplace_back(i, j);
-// C++20: #endif
-    i = j != s.end() ? j + 1 : j;
-  } while (i != s.end());
+  bip::file_mapping fm(infile.string().c_str(), bip::read_only);
+  bip::mapped_region mr(fm, bip::read_only);
+  mr.advise(bip::mapped_region::advice_sequential);
 
-  return splits;
+  const char* beg = static_cast<const char*>(mr.get_address());
+  ingest(beg, beg + mr.get_size(), true);
 }
 
-void write_hset(
-  std::istream& in,
+template <class Input>
+void write_hset_from(
+  Input& in,
   const std::vector<SFHASH_HashAlgorithm>& htypes,
   const std::vector<std::pair<void (*)(uint8_t* dst, const char* src, size_t dlen), size_t>>& conv,
   const char* hset_name,
@@ -420,7 +872,8 @@ void write_hset(
   const std::filesystem::path& outfile,
   const std::filesystem::path& tmpdir,
   bool with_records,
-  bool with_hashsets)
+  bool with_hashsets,
+  uint32_t flags)
 {
   SFHASH_Error* err = nullptr;
 
@@ -441,48 +894,97 @@ void write_hset(
 
   THROW_IF(err, err->message);
 
-  std::vector<uint8_t> rec;
-  std::string line;
-  size_t lineno = 0;
-  while (in) {
-    std::getline(in, line);
+  if (flags) {
+    sfhash_hashset_builder_set_flags(bctx.get(), flags, &err);
+    THROW_IF(err, err->message);
+  }
+
+  THROW_IF(conv.size() != htypes.size(), "a converter is needed for each hash type");
 
-    ++lineno;
-  //    if (lineno % 10000 == 0) {
-  //      std::cerr << "read " << lineno << " lines\n";
-  //    }
+  TextIngester(bctx.get(), conv).ingest(in);
 
-    if (line.empty()) {
-      continue;
-    }
+  sfhash_hashset_builder_write(bctx.get(), &err);
+  THROW_IF(err, err->message);
+}
+
+void write_hset(
+  std::istream& in,
+  const std::vector<SFHASH_HashAlgorithm>& htypes,
+  const std::vector<std::pair<void (*)(uint8_t* dst, const char* src, size_t dlen), size_t>>& conv,
+  const char* hset_name,
+  const char* hset_desc,
+  const std::filesystem::path& outfile,
+  const std::filesystem::path& tmpdir,
+  bool with_records,
+  bool with_hashsets,
+  uint32_t flags)
+{
+  write_hset_from(
+    in, htypes, conv, hset_name, hset_desc, outfile, tmpdir,
+    with_records, with_hashsets, flags
+  );
+}
+
+void write_hset(
+  const std::filesystem::path& infile,
+  const std::vector<SFHASH_HashAlgorithm>& htypes,
+  const std::vector<std::pair<void (*)(uint8_t* dst, const char* src, size_t dlen), size_t>>& conv,
+  const char* hset_name,
+  const char* hset_desc,
+  const std::filesystem::path& outfile,
+  const std::filesystem::path& tmpdir,
+  bool with_records,
+  bool with_hashsets,
+  uint32_t flags)
+{
+  write_hset_from(
+    infile, htypes, conv, hset_name, hset_desc, outfile, tmpdir,
+    with_records, with_hashsets, flags
+  );
+}
 
-    const auto& cols = split(line, ' ');
+void layout_initial_chunks(SFHASH_HashsetBuildCtx& bctx) {
+  // establish locations of initial chunks
 
-    THROW_IF(cols.size() > htypes.size(), "too many columns at line " << lineno);
-    THROW_IF(cols.size() < htypes.size(), "too few columns at line " << lineno);
+  auto& ftoc = bctx.ftoc;
+  const auto& fhdr = bctx.fhdr;
+  const auto& rhdr = bctx.rhdr;
 
-    for (size_t i = 0; i < cols.size(); ++i) {
-      if (cols[i].empty()) {
-        rec.clear();
-      }
-      else {
-        rec.resize(conv[i].second);
-        conv[i].first(
-          rec.data(),
-          cols[i].data(),
-          conv[i].second
-        );
-      }
+  ftoc.entries.clear();
+
+  uint64_t off = 0;
+
+  off += length_magic();
+  off += length_hset_hash();
 
-      sfhash_hashset_builder_add_hash(bctx.get(), rec.data(), rec.size());
+  // FTOC
+  ftoc.entries.emplace_back(off, Chunk::Type::FTOC);
+  off += length_ftoc(count_chunks(rhdr.fields, bctx.flags));
+
+  // FHDR
+  ftoc.entries.emplace_back(off, Chunk::Type::FHDR);
+  off += length_fhdr(fhdr.name, fhdr.desc, fhdr.time);
+
+  if (bctx.with_records) {
+    // RHDR
+    ftoc.entries.emplace_back(off, Chunk::Type::RHDR);
+    off += length_rhdr(rhdr.fields);
+
+    // RDAT
+    ftoc.entries.emplace_back(off, Chunk::Type::RDAT);
+
+    auto& out = bctx.out;
+    if (out.is_open()) {
+      out.close();
     }
 
-//  if (lineno % 10000) {
-//  std::cerr << "read " << lineno << " lines\n";
-//  }
-  }
+    // resize the output file so the start of the RDAT data is at the end
+    std::filesystem::resize_file(bctx.outfile, off + 12);
 
-  sfhash_hashset_builder_write(bctx.get(), &err);
+    // open the output file ready for appending
+    out.exceptions(std::ofstream::failbit);
+    out.open(bctx.outfile, std::ios::binary | std::ios::app);
+  }
 }
 
 SFHASH_HashsetBuildCtx* hashset_builder_open(
@@ -508,6 +1010,11 @@ SFHASH_HashsetBuildCtx* hashset_builder_open(
       {},
       {},
       {},
+      0,
+      0,
+      tmp_dir,
+      0,
+      {},
       0
     },
     sfhash_hashset_builder_destroy
@@ -557,44 +1064,12 @@ SFHASH_HashsetBuildCtx* hashset_builder_open(
     of.open(outfile);
   }
 
-  // establish locations of initial chunks
-
-  auto& ftoc = bctx->ftoc;
-  const auto& fhdr = bctx->fhdr;
-
-  uint64_t off = 0;
+  layout_initial_chunks(*bctx);
 
-  off += length_magic();
-  off += length_hset_hash();
-
-  // FTOC
-  ftoc.entries.emplace_back(off, Chunk::Type::FTOC);
-  off += length_ftoc(count_chunks(rhdr.fields));
-
-  // FHDR
-  ftoc.entries.emplace_back(off, Chunk::Type::FHDR);
-  off += length_fhdr(fhdr.name, fhdr.desc, fhdr.time);
-
-  if (write_records) {
-    // RHDR
-    ftoc.entries.emplace_back(off, Chunk::Type::RHDR);
-    off += length_rhdr(rhdr.fields);
-
-    // RDAT
-    ftoc.entries.emplace_back(off, Chunk::Type::RDAT);
-
-    // resize the output file so the start of the RDAT data is at the end
-    std::filesystem::resize_file(outfile, off + 12);
-
-    // open the output file ready for appending
-    auto& out = bctx->out;
-    out.exceptions(std::ofstream::failbit);
-    out.open(outfile, std::ios::binary | std::ios::app);
-  }
-  else { // write_hashsets
-    auto& hsets = bctx->hsets;
-    auto& tmp_hashes_files = bctx->tmp_hashes_files;
-    auto& tmp_hashes_out = bctx->tmp_hashes_out;
+  if (!write_records) { // write_hashsets
+    auto& hsets = bctx->hsets;
+    auto& tmp_hashes_files = bctx->tmp_hashes_files;
+    auto& tmp_hashes_out = bctx->tmp_hashes_out;
 
     for (const auto& field: rhdr.fields) {
       // initialize the hashsets from the RHDR fields
@@ -648,6 +1123,77 @@ SFHASH_HashsetBuildCtx* sfhash_hashset_builder_open(
   }
 }
 
+void hashset_builder_set_flags(
+  SFHASH_HashsetBuildCtx* bctx,
+  uint32_t flags)
+{
+  THROW_IF(
+    bctx->rhdr.record_count || bctx->field_pos,
+    "flags must be set before adding records or hashes"
+  );
+
+  THROW_IF(
+    flags & ~(
+      SFHASH_HASHSET_BUILD_PERFECT_HASH |
+      SFHASH_HASHSET_BUILD_CHECKSUMS |
+      SFHASH_HASHSET_BUILD_COMPRESSED
+    ),
+    "unknown flags " << std::hex << flags
+  );
+
+  // the perfect hash maps hashes to places in an array of them
+  THROW_IF(
+    (flags & SFHASH_HASHSET_BUILD_PERFECT_HASH) &&
+    (flags & SFHASH_HASHSET_BUILD_COMPRESSED),
+    "perfect hashes of compressed hashes are not supported"
+  );
+
+  // CSUM is new in version 3
+  bctx->fhdr.version = flags & SFHASH_HASHSET_BUILD_CHECKSUMS ? 3 : 2;
+
+  // the FTOC must have room for any additional chunks
+  bctx->flags = flags;
+  layout_initial_chunks(*bctx);
+}
+
+void sfhash_hashset_builder_set_flags(
+  SFHASH_HashsetBuildCtx* bctx,
+  uint32_t flags,
+  SFHASH_Error** err)
+{
+  try {
+    hashset_builder_set_flags(bctx, flags);
+  }
+  catch (const std::exception& e) {
+    fill_error(err, e.what());
+  }
+}
+
+void hashset_builder_set_memory_limit(
+  SFHASH_HashsetBuildCtx* bctx,
+  uint64_t bytes)
+{
+  THROW_IF(
+    bctx->rhdr.record_count || bctx->field_pos,
+    "the memory limit must be set before adding records or hashes"
+  );
+
+  bctx->memory_limit = bytes;
+}
+
+void sfhash_hashset_builder_set_memory_limit(
+  SFHASH_HashsetBuildCtx* bctx,
+  uint64_t bytes,
+  SFHASH_Error** err)
+{
+  try {
+    hashset_builder_set_memory_limit(bctx, bytes);
+  }
+  catch (const std::exception& e) {
+    fill_error(err, e.what());
+  }
+}
+
 void sfhash_hashset_builder_add_record(
   SFHASH_HashsetBuildCtx* bctx,
   const void* record)
@@ -660,7 +1206,15 @@ void sfhash_hashset_builder_add_record(
     out.write(static_cast<const char*>(record), rhdr.record_length);
   }
   else { // with_hashsets
-    // TODO: implement
+    const uint8_t* r = static_cast<const uint8_t*>(record);
+    for (size_t i = 0; i < rhdr.fields.size(); ++i) {
+      const size_t len = rhdr.fields[i].length;
+      if (r[0] == 0x01) {
+        bctx->tmp_hashes_out[i].write(reinterpret_cast<const char*>(r + 1), len);
+        ++std::get<HashsetHeader>(bctx->hsets[i]).hash_count;
+      }
+      r += 1 + len;
+    }
   }
 
   // advance the field position
@@ -669,6 +1223,135 @@ void sfhash_hashset_builder_add_record(
   ++rhdr.record_count;
 }
 
+// Bytes staged before they are written as a block
+constexpr size_t BUILD_BUFFER_LENGTH = 1 << 20;
+
+void hashset_builder_add_records(
+  SFHASH_HashsetBuildCtx* bctx,
+  const void* records,
+  size_t count)
+{
+  THROW_IF(bctx->field_pos, "a record added to the builder is incomplete");
+
+  auto& rhdr = bctx->rhdr;
+  const uint8_t* recs = static_cast<const uint8_t*>(records);
+
+  if (bctx->with_records) {
+    bctx->out.write(
+      reinterpret_cast<const char*>(recs), count * rhdr.record_length
+    );
+  }
+  else { // with_hashsets
+    // gather each field's hashes into blocks
+    std::vector<uint8_t> buf;
+    size_t roff = 1;
+    for (size_t i = 0; i < rhdr.fields.size(); ++i) {
+      const size_t len = rhdr.fields[i].length;
+      auto& out = bctx->tmp_hashes_out[i];
+      auto& hash_count = std::get<HashsetHeader>(bctx->hsets[i]).hash_count;
+
+      const uint8_t* const end = recs + count * rhdr.record_length;
+      for (const uint8_t* r = recs; r < end; r += rhdr.record_length) {
+        if (r[roff - 1] == 0x01) {
+          buf.insert(buf.end(), r + roff, r + roff + len);
+          ++hash_count;
+        }
+
+        if (buf.size() >= BUILD_BUFFER_LENGTH || r + rhdr.record_length == end) {
+          out.write(reinterpret_cast<const char*>(buf.data()), buf.size());
+          buf.clear();
+        }
+      }
+
+      roff += 1 + len;
+    }
+  }
+
+  rhdr.record_count += count;
+}
+
+void sfhash_hashset_builder_add_records(
+  SFHASH_HashsetBuildCtx* bctx,
+  const void* records,
+  size_t count,
+  SFHASH_Error** err)
+{
+  try {
+    hashset_builder_add_records(bctx, records, count);
+  }
+  catch (const std::exception& e) {
+    fill_error(err, e.what());
+  }
+}
+
+void hashset_builder_add_hashes(
+  SFHASH_HashsetBuildCtx* bctx,
+  size_t field,
+  const void* hashes,
+  size_t count)
+{
+  auto& rhdr = bctx->rhdr;
+
+  THROW_IF(
+    field >= rhdr.fields.size(),
+    "field " << field << " is out of range; there are " << rhdr.fields.size()
+  );
+  THROW_IF(bctx->field_pos, "a record added to the builder is incomplete");
+
+  const size_t len = rhdr.fields[field].length;
+  const uint8_t* hs = static_cast<const uint8_t*>(hashes);
+
+  if (bctx->with_records) {
+    // each hash is a record with no other hashes
+    size_t roff = 1;
+    for (size_t i = 0; i < field; ++i) {
+      roff += 1 + rhdr.fields[i].length;
+    }
+
+    const size_t per_block = std::max<size_t>(1, BUILD_BUFFER_LENGTH / rhdr.record_length);
+    std::vector<uint8_t> buf(std::min(count, per_block) * rhdr.record_length);
+
+    for (size_t done = 0; done < count; ) {
+      const size_t n = std::min(count - done, per_block);
+      std::fill(buf.begin(), buf.end(), 0);
+
+      for (size_t i = 0; i < n; ++i) {
+        uint8_t* r = buf.data() + i * rhdr.record_length;
+        r[roff - 1] = 0x01;
+        std::memcpy(r + roff, hs + (done + i) * len, len);
+      }
+
+      bctx->out.write(
+        reinterpret_cast<const char*>(buf.data()), n * rhdr.record_length
+      );
+      done += n;
+    }
+  }
+  else { // with_hashsets
+    bctx->tmp_hashes_out[field].write(
+      reinterpret_cast<const char*>(hs), count * len
+    );
+    std::get<HashsetHeader>(bctx->hsets[field]).hash_count += count;
+  }
+
+  rhdr.record_count += count;
+}
+
+void sfhash_hashset_builder_add_hashes(
+  SFHASH_HashsetBuildCtx* bctx,
+  size_t field,
+  const void* hashes,
+  size_t count,
+  SFHASH_Error** err)
+{
+  try {
+    hashset_builder_add_hashes(bctx, field, hashes, count);
+  }
+  catch (const std::exception& e) {
+    fill_error(err, e.what());
+  }
+}
+
 void sfhash_hashset_builder_add_hash(
   SFHASH_HashsetBuildCtx* bctx,
   const void* record,
@@ -685,8 +1368,10 @@ void sfhash_hashset_builder_add_hash(
       out.write(static_cast<const char*>(record), length);
     }
     else {
-      std::vector<char> buf(length, 0);
-      out.write(buf.data(), length);
+      // a missing hash is a zero flag and zeros
+      const size_t flen = 1 + bctx->rhdr.fields[field_pos].length;
+      static constexpr char zeros[65] = {};
+      out.write(zeros, flen);
     }
   }
   else { // with_hashsets
@@ -707,7 +1392,262 @@ void sfhash_hashset_builder_add_hash(
   }
 }
 
+SFHASH_HashsetBuildThreadCtx* hashset_builder_thread_open(
+  SFHASH_HashsetBuildCtx* bctx)
+{
+  std::lock_guard<std::mutex> lock(bctx->mutex);
+
+  THROW_IF(bctx->field_pos, "a record added to the builder is incomplete");
+
+  const size_t fields = bctx->rhdr.fields.size();
+
+  auto tctx = std::make_unique<SFHASH_HashsetBuildThreadCtx>(
+    SFHASH_HashsetBuildThreadCtx{
+      bctx,
+      0,
+      0,
+      {},
+      std::vector<std::vector<uint8_t>>(bctx->with_records ? 0 : fields),
+      std::vector<uint64_t>(fields, 0),
+      std::vector<bool>(fields, false),
+      false,
+      0,
+      {},
+      BUILD_BUFFER_LENGTH
+    }
+  );
+
+  ++bctx->open_threads;
+  return tctx.release();
+}
+
+SFHASH_HashsetBuildThreadCtx* sfhash_hashset_builder_thread_open(
+  SFHASH_HashsetBuildCtx* bctx,
+  SFHASH_Error** err)
+{
+  try {
+    return hashset_builder_thread_open(bctx);
+  }
+  catch (const std::exception& e) {
+    fill_error(err, e.what());
+    return nullptr;
+  }
+}
+
+// Hands what a thread handle has staged to its builder; the builder's
+// mutex must be held
+void flush_thread_locked(SFHASH_HashsetBuildThreadCtx& t) {
+  auto& bctx = *t.bctx;
+
+  if (bctx.with_records) {
+    bctx.out.write(reinterpret_cast<const char*>(t.recs.data()), t.recs.size());
+    t.recs.clear();
+  }
+  else { // with_hashsets
+    for (size_t i = 0; i < t.hashes.size(); ++i) {
+      bctx.tmp_hashes_out[i].write(
+        reinterpret_cast<const char*>(t.hashes[i].data()), t.hashes[i].size()
+      );
+      t.hashes[i].clear();
+
+      std::get<HashsetHeader>(bctx.hsets[i]).hash_count += t.hash_counts[i];
+      t.hash_counts[i] = 0;
+    }
+  }
+
+  bctx.rhdr.record_count += t.record_count;
+  t.record_count = 0;
+}
+
+// Unstages the first fields hashes of the record being added
+void drop_thread_record(SFHASH_HashsetBuildThreadCtx& t, size_t fields) {
+  const auto& rhdr = t.bctx->rhdr;
+
+  if (t.bctx->with_records) {
+    size_t rlen = 0;
+    for (size_t i = 0; i < fields; ++i) {
+      rlen += 1 + rhdr.fields[i].length;
+    }
+    t.recs.resize(t.recs.size() - rlen);
+  }
+  else { // with_hashsets
+    for (size_t i = 0; i < fields; ++i) {
+      if (t.staged[i]) {
+        t.hashes[i].resize(t.hashes[i].size() - rhdr.fields[i].length);
+        --t.hash_counts[i];
+      }
+    }
+  }
+
+  std::fill(t.staged.begin(), t.staged.end(), false);
+  t.bad_record = false;
+}
+
+void end_thread_record(SFHASH_HashsetBuildThreadCtx& t) {
+  if (t.bad_record) {
+    drop_thread_record(t, t.staged.size());
+    ++t.bad_records;
+    return;
+  }
+
+  std::fill(t.staged.begin(), t.staged.end(), false);
+  ++t.record_count;
+
+  size_t staged = t.recs.size();
+  for (const auto& h: t.hashes) {
+    staged += h.size();
+  }
+
+  if (staged >= t.buffer_length) {
+    std::lock_guard<std::mutex> lock(t.bctx->mutex);
+    flush_thread_locked(t);
+  }
+}
+
+void hashset_builder_thread_add_record(
+  SFHASH_HashsetBuildThreadCtx* tctx,
+  const void* record)
+{
+  const auto& rhdr = tctx->bctx->rhdr;
+  const uint8_t* r = static_cast<const uint8_t*>(record);
+
+  if (tctx->bctx->with_records) {
+    tctx->recs.insert(tctx->recs.end(), r, r + rhdr.record_length);
+  }
+  else { // with_hashsets
+    for (size_t i = 0; i < rhdr.fields.size(); ++i) {
+      const size_t len = rhdr.fields[i].length;
+      if (r[0] == 0x01) {
+        tctx->hashes[i].insert(tctx->hashes[i].end(), r + 1, r + 1 + len);
+        ++tctx->hash_counts[i];
+      }
+      r += 1 + len;
+    }
+  }
+
+  tctx->field_pos = 0;
+  end_thread_record(*tctx);
+}
+
+void sfhash_hashset_builder_thread_add_record(
+  SFHASH_HashsetBuildThreadCtx* tctx,
+  const void* record)
+{
+  if (!tctx->error.empty()) {
+    return;
+  }
+
+  try {
+    hashset_builder_thread_add_record(tctx, record);
+  }
+  catch (const std::exception& e) {
+    tctx->error = e.what();
+  }
+}
+
+void hashset_builder_thread_add_hash(
+  SFHASH_HashsetBuildThreadCtx* tctx,
+  const void* hash,
+  size_t length)
+{
+  const auto& rhdr = tctx->bctx->rhdr;
+  auto& field_pos = tctx->field_pos;
+  const uint8_t* h = static_cast<const uint8_t*>(hash);
+  const size_t flen = rhdr.fields[field_pos].length;
+
+  if (length != 0 && length != flen) {
+    // there is nowhere to report this until close; stage a missing hash
+    // so the fields stay aligned, and drop the record when it ends
+    tctx->bad_record = true;
+    length = 0;
+  }
+
+  if (tctx->bctx->with_records) {
+    // a missing hash is a zero flag and zeros
+    auto& recs = tctx->recs;
+    const size_t off = recs.size();
+    recs.resize(off + 1 + flen);
+    if (length > 0) {
+      recs[off] = 0x01;
+      std::memcpy(&recs[off + 1], h, flen);
+    }
+  }
+  else { // with_hashsets
+    if (length > 0) {
+      auto& hashes = tctx->hashes[field_pos];
+      hashes.insert(hashes.end(), h, h + flen);
+      ++tctx->hash_counts[field_pos];
+      tctx->staged[field_pos] = true;
+    }
+  }
+
+  if (++field_pos == rhdr.fields.size()) {
+    field_pos = 0;
+    end_thread_record(*tctx);
+  }
+}
+
+void sfhash_hashset_builder_thread_add_hash(
+  SFHASH_HashsetBuildThreadCtx* tctx,
+  const void* hash,
+  size_t length)
+{
+  if (!tctx->error.empty()) {
+    return;
+  }
+
+  try {
+    hashset_builder_thread_add_hash(tctx, hash, length);
+  }
+  catch (const std::exception& e) {
+    tctx->error = e.what();
+  }
+}
+
+void hashset_builder_thread_close(SFHASH_HashsetBuildThreadCtx* tctx) {
+  std::unique_ptr<SFHASH_HashsetBuildThreadCtx> t(tctx);
+  auto& bctx = *t->bctx;
+
+  if (!t->error.empty()) {
+    // what is staged may be part of a record, and the output may be bad
+    std::lock_guard<std::mutex> lock(bctx.mutex);
+    --bctx.open_threads;
+    THROW(t->error);
+  }
+
+  // drop the incomplete record, which would misalign the rest
+  const size_t partial = t->field_pos;
+  drop_thread_record(*t, partial);
+
+  std::lock_guard<std::mutex> lock(bctx.mutex);
+  --bctx.open_threads;
+  flush_thread_locked(*t);
+
+  THROW_IF(partial, "the last record added was incomplete");
+  THROW_IF(
+    t->bad_records,
+    t->bad_records << " records added had a hash of the wrong length"
+  );
+}
+
+void sfhash_hashset_builder_thread_close(
+  SFHASH_HashsetBuildThreadCtx* tctx,
+  SFHASH_Error** err)
+{
+  try {
+    hashset_builder_thread_close(tctx);
+  }
+  catch (const std::exception& e) {
+    fill_error(err, e.what());
+  }
+}
+
 uint64_t hashset_builder_write(SFHASH_HashsetBuildCtx* bctx) {
+  THROW_IF(
+    bctx->open_threads,
+    bctx->open_threads << " thread handles are still open"
+  );
+
   const auto& outfile = bctx->outfile;
 
   auto& ftoc = bctx->ftoc;
@@ -726,7 +1666,8 @@ uint64_t hashset_builder_write(SFHASH_HashsetBuildCtx* bctx) {
         bctx->fhdr.desc,
         bctx->fhdr.time,
         bctx->rhdr.fields,
-        bctx->rhdr.record_count
+        bctx->rhdr.record_count,
+        bctx->flags
       )
       :
       length_hset_records_only(
@@ -734,7 +1675,8 @@ uint64_t hashset_builder_write(SFHASH_HashsetBuildCtx* bctx) {
         bctx->fhdr.desc,
         bctx->fhdr.time,
         bctx->rhdr.fields,
-        bctx->rhdr.record_count
+        bctx->rhdr.record_count,
+        bctx->flags
       );
 
     std::filesystem::resize_file(outfile, hset_size);
@@ -748,14 +1690,17 @@ uint64_t hashset_builder_write(SFHASH_HashsetBuildCtx* bctx) {
     rdat.end = rdat.beg + rhdr.record_count * rhdr.record_length;
 
     // sort the records
-    RecordIterator rbeg(rdat.beg, rhdr.record_length);
-    RecordIterator rend(rdat.end, rhdr.record_length);
-
-    std::sort(rbeg, rend);
-    rend = std::unique(rbeg, rend);
-
-    rdat.end = rend->rec.data();
-    rhdr.record_count = rend - rbeg;
+    rhdr.record_count = sort_externally(
+      bctx->memory_limit, rhdr.record_count, rhdr.record_length
+    ) ?
+      external_sort_unique(
+        rdat.beg, rhdr.record_count, rhdr.record_length,
+        bctx->memory_limit, bctx->tmp_dir, "rdat"
+      ) :
+      radix_sort_unique(
+        rdat.beg, rhdr.record_count, rhdr.record_length, 0
+      );
+    rdat.end = rdat.beg + rhdr.record_count * rhdr.record_length;
 
     off = ftoc.entries.back().first + length_rdat(rhdr.fields, rhdr.record_count);
 
@@ -771,6 +1716,9 @@ uint64_t hashset_builder_write(SFHASH_HashsetBuildCtx* bctx) {
 
     std::map<uint64_t, size_t> off2hbidx;
 
+    // the chunks through RDAT
+    const size_t head_chunks = ftoc.entries.size();
+
     if (bctx->with_hashsets) {
       for (const auto& field: rhdr.fields) {
         // Determine locations for each hash block
@@ -785,12 +1733,34 @@ uint64_t hashset_builder_write(SFHASH_HashsetBuildCtx* bctx) {
         if (field.type != SFHASH_SIZE) {
           ftoc.entries.emplace_back(off, Chunk::Type::HINT);
           off2hbidx[off] = hbidx;
-          off += length_hint();
+          // the hint is chosen once the hashes are sorted; zero what it
+          // leaves of its room, as that could hold records
+          const size_t hlen = length_hint_max(rhdr.record_count);
+          std::fill(out + off, out + off + hlen, 0);
+          off += hlen;
+        }
+
+        // HIDX
+        if (bctx->flags & SFHASH_HASHSET_BUILD_PERFECT_HASH) {
+          ftoc.entries.emplace_back(off, Chunk::Type::HIDX);
+          off2hbidx[off] = hbidx;
+          // the index fills only as much room as there are distinct
+          // hashes; zero the rest, as it could hold records
+          const size_t ilen = length_hidx(rhdr.record_count);
+          std::fill(out + off, out + off + ilen, 0);
+          off += ilen;
         }
 
         // HDAT
-        off += length_alignment_padding(off, 4096);
-        ftoc.entries.emplace_back(off, Chunk::Type::HDAT);
+        // the padding could hold records, too
+        const size_t plen = length_alignment_padding(off, 4096);
+        std::fill(out + off, out + off + plen, 0);
+        off += plen;
+        ftoc.entries.emplace_back(
+          off,
+          compress_field(field.type, bctx->flags) ?
+            Chunk::Type::HDAC : Chunk::Type::HDAT
+        );
         off2hbidx[off] = hbidx;
 
         hb.emplace_back(
@@ -801,7 +1771,9 @@ uint64_t hashset_builder_write(SFHASH_HashsetBuildCtx* bctx) {
           nullptr
         );
 
-        off += length_hdat(rhdr.record_count, field.length);
+        off += length_hash_data(
+          field.type, rhdr.record_count, field.length, bctx->flags
+        );
 
         // RIDX
         ftoc.entries.emplace_back(off, Chunk::Type::RIDX);
@@ -813,52 +1785,51 @@ uint64_t hashset_builder_write(SFHASH_HashsetBuildCtx* bctx) {
       }
     }
 
+    // CSUM
+    if (bctx->flags & SFHASH_HASHSET_BUILD_CHECKSUMS) {
+      ftoc.entries.emplace_back(off, Chunk::Type::CSUM);
+      off += length_csum(checksum_segments(ftoc, CSUM_SEGMENT_LENGTH).size());
+    }
+
     // FEND
     ftoc.entries.emplace_back(off, Chunk::Type::FEND);
     off += length_fend();
 
+    char* const cout = reinterpret_cast<char*>(out);
+    BackgroundHasher hasher(hset_hashed_data(cout));
+
+    std::vector<FieldIndexes> fidx;
+
+    // the records are final, so hash them while the hashes are sorted
+    write_chunks(
+      cout, ftoc, fhdr, rhdr, rdat, hb, off2hbidx, fidx,
+      hasher, 0, head_chunks
+    );
+
     if (bctx->with_hashsets) {
-      scatter_records_to_hashset(rhdr, rdat, hb);
+      scatter_records_to_hashset(
+        rhdr, rdat, hb, bctx->flags, bctx->memory_limit, bctx->tmp_dir, fidx
+      );
     }
 
     // Write
-    write_chunks(reinterpret_cast<char*>(out), ftoc, fhdr, rhdr, rdat, hb, off2hbidx);
+    write_chunks(
+      cout, ftoc, fhdr, rhdr, rdat, hb, off2hbidx, fidx,
+      hasher, head_chunks, ftoc.entries.size()
+    );
+    write_hset_hash(cout, hasher);
   }
   else if (bctx->with_hashsets) {
     // close the temp files
     bctx->tmp_hashes_out.clear();
 
-    for (size_t i = 0; i < bctx->hsets.size(); ++i) {
-      const auto& f = bctx->tmp_hashes_files[i];
-      auto fsize = std::filesystem::file_size(f);
-
-      auto& hhdr = std::get<HashsetHeader>(bctx->hsets[i]);
-
-      {
-        bip::file_mapping fm(f.string().c_str(), bip::read_write);
-        bip::mapped_region mr(fm, bip::read_write);
-
-        uint8_t* out = static_cast<uint8_t*>(mr.get_address());
-
-        RecordIterator hbeg(out, hhdr.hash_length);
-        RecordIterator hend(out + fsize, hhdr.hash_length);
-
-        std::sort(hbeg, hend);
-        hend = std::unique(hbeg, hend);
-
-        fsize = hend->rec.data() - out;
-      }
-
-      std::filesystem::resize_file(f, fsize);
-    }
-
     const auto hset_size = length_hset_hashsets_only(
       bctx->fhdr.name,
       bctx->fhdr.desc,
       bctx->fhdr.time,
       bctx->rhdr.fields,
-      bctx->rhdr.record_count,
-      bctx->hsets
+      bctx->hsets,
+      bctx->flags
     );
 
     std::filesystem::resize_file(outfile, hset_size);
@@ -885,6 +1856,9 @@ uint64_t hashset_builder_write(SFHASH_HashsetBuildCtx* bctx) {
     for (size_t i = 0; i < rhdr.fields.size(); ++i) {
       const auto& field = rhdr.fields[i];
 
+      auto& hhdr = std::get<HashsetHeader>(bctx->hsets[i]);
+      auto& hdat = std::get<HashsetData>(bctx->hsets[i]);
+
       // HHnn
       ftoc.entries.emplace_back(off, make_hhnn_type(field.type));
       off2hbidx[off] = i;
@@ -894,36 +1868,87 @@ uint64_t hashset_builder_write(SFHASH_HashsetBuildCtx* bctx) {
       if (field.type != SFHASH_SIZE) {
         ftoc.entries.emplace_back(off, Chunk::Type::HINT);
         off2hbidx[off] = i;
-        off += length_hint();
+        // room for the largest hint the hashes could get
+        off += length_hint_max(hhdr.hash_count);
+      }
+
+      // HIDX
+      if (bctx->flags & SFHASH_HASHSET_BUILD_PERFECT_HASH) {
+        ftoc.entries.emplace_back(off, Chunk::Type::HIDX);
+        off2hbidx[off] = i;
+        off += length_hidx(hhdr.hash_count);
       }
 
       // HDAT
       off += length_alignment_padding(off, 4096);
-      ftoc.entries.emplace_back(off, Chunk::Type::HDAT);
+      ftoc.entries.emplace_back(
+        off,
+        compress_field(field.type, bctx->flags) ?
+          Chunk::Type::HDAC : Chunk::Type::HDAT
+      );
       off2hbidx[off] = i;
 
-      auto& hhdr = std::get<HashsetHeader>(bctx->hsets[i]);
-      auto& hdat = std::get<HashsetData>(bctx->hsets[i]);
+      // the hashes are sorted where they will stay; the file has room for
+      // them all, and the room left by duplicates is taken by the following
+      // chunks
+      uint8_t* const hout = reinterpret_cast<uint8_t*>(out) + off + 12;
 
       const auto& f = bctx->tmp_hashes_files[i];
-
       const auto fsize = std::filesystem::file_size(f);
 
-      {
+      uint64_t hcount = 0;
+
+      if (sort_externally(bctx->memory_limit, 1, fsize)) {
+        // merge the runs straight into place
+        ExternalSorter sorter(
+          hhdr.hash_length, bctx->memory_limit, bctx->tmp_dir,
+          f.filename().string(), true
+        );
+
+        std::vector<uint8_t> buf(hhdr.hash_length * 4096);
         std::ifstream tif;
-        tif.exceptions(std::ifstream::failbit);
         tif.open(f, std::ios::binary);
-        tif.read(out + off + 12, fsize);
+        THROW_IF(!tif, "failed to open " << f);
+        while (tif.read(reinterpret_cast<char*>(buf.data()), buf.size()) || tif.gcount()) {
+          const uint8_t* end = buf.data() + tif.gcount();
+          for (const uint8_t* h = buf.data(); h < end; h += hhdr.hash_length) {
+            sorter.add(h);
+          }
+        }
+        THROW_IF(tif.bad(), "failed to read " << f);
+
+        uint8_t* o = hout;
+        hcount = sorter.merge([&o, len = hhdr.hash_length](const uint8_t* h) {
+          std::memcpy(o, h, len);
+          o += len;
+        });
       }
+      else {
+        {
+          std::ifstream tif;
+          tif.exceptions(std::ifstream::failbit);
+          tif.open(f, std::ios::binary);
+          tif.read(reinterpret_cast<char*>(hout), fsize);
+        }
+
+        hcount = radix_sort_unique(
+          hout, fsize / hhdr.hash_length, hhdr.hash_length, 0
+        );
+
+        // zero what the duplicates leave, so that the file is the same
+        // each time
+        std::fill(hout + hcount * hhdr.hash_length, hout + fsize, 0);
+      }
+
       std::filesystem::remove(f);
 
-      hdat.beg = reinterpret_cast<uint8_t*>(out) + off + 12;
-      hdat.end = hdat.beg + fsize;
+      hdat.beg = hout;
+      hdat.end = hdat.beg + hcount * hhdr.hash_length;
 
       RecordIterator hbeg(hdat.beg, hhdr.hash_length);
       RecordIterator hend(hdat.end, hhdr.hash_length);
 
-      hhdr.hash_count = hend - hbeg;
+      hhdr.hash_count = hcount;
 
       hb.emplace_back(
         field.length,
@@ -933,15 +1958,31 @@ uint64_t hashset_builder_write(SFHASH_HashsetBuildCtx* bctx) {
         nullptr
       );
 
-      off += length_hdat(hhdr.hash_count, hhdr.hash_length);
+      off += length_hash_data(
+        field.type, hhdr.hash_count, hhdr.hash_length, bctx->flags
+      );
+    }
+
+    // CSUM
+    if (bctx->flags & SFHASH_HASHSET_BUILD_CHECKSUMS) {
+      ftoc.entries.emplace_back(off, Chunk::Type::CSUM);
+      off += length_csum(checksum_segments(ftoc, CSUM_SEGMENT_LENGTH).size());
     }
 
     // FEND
     ftoc.entries.emplace_back(off, Chunk::Type::FEND);
     off += length_fend();
 
+    std::vector<FieldIndexes> fidx;
+    index_fields(rhdr, hb, bctx->flags, fidx);
+
     // Write
-    write_chunks(out, ftoc, fhdr, rhdr, rdat, hb, off2hbidx);
+    BackgroundHasher hasher(hset_hashed_data(out));
+    write_chunks(
+      out, ftoc, fhdr, rhdr, rdat, hb, off2hbidx, fidx,
+      hasher, 0, ftoc.entries.size()
+    );
+    write_hset_hash(out, hasher);
   }
 
   std::filesystem::resize_file(outfile, off);
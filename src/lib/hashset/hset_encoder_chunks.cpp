@@ -2,9 +2,15 @@
 
 #include "cpp20.h"
 #include "rwutil.h"
+#include "throw.h"
 #include "util.h"
+#include "hashset/compressed_hashes.h"
+#include "hashset/hint_select.h"
+#include "hashset/hset_verify.h"
+#include "hashset/perfect_hash.h"
 
 #include <cstring>
+#include <ios>
 #include <numeric>
 
 #include <binaryfusefilter.h>
@@ -151,34 +157,35 @@ size_t write_hhnn(
   );
 }
 
-size_t length_hint_data() {
-  return 2 + // hint type
-         256 * 8 * 2; // bounds for 8-bit buckets
+size_t length_hint_data(uint16_t hint_type) {
+  const size_t len = hint_data_length(hint_type);
+  THROW_IF(!len, "bad hint type " << std::hex << hint_type);
+  return len;
 }
 
-size_t length_hint() {
-  return length_chunk<length_hint_data>();
+size_t length_hint(uint16_t hint_type) {
+  return length_chunk<length_hint_data>(hint_type);
 }
 
-size_t write_hint_data(
+size_t length_hint_max(uint64_t hash_count) {
+  // blocks of either kind take the most room, and a range the most
+  // without them
+  const unsigned bits = max_hint_block_bits(hash_count);
+  return length_hint(
+    bits ?
+      make_hint_type(HintType::BLOCK, bits) :
+      make_hint_type(HintType::RANGE)
+  );
+}
+
+size_t write_block_hint_data(
   const std::vector<std::pair<int64_t, int64_t>>& block_bounds,
   char* out)
 {
-/*
-  for (size_t b = 0; b < block_bounds.size(); ++b) {
-     std::cerr << std::hex << std::setw(2) << std::setfill('0') << b << ' '
-               << std::dec
-               << block_bounds[b].first << ' '
-               << block_bounds[b].second << ' '
-               << (block_bounds[b].second - block_bounds[b].first) << '\n';
-   }
-   std::cerr << '\n';
-*/
-
   const char* beg = out;
 
-  // TODO: set a real hint type
-  out += write_be<uint16_t>(0x6208, out);  // b8 = blocks, 8-bit
+  const unsigned bits = __builtin_ctzll(block_bounds.size());
+  out += write_be<uint16_t>(make_hint_type(HintType::BLOCK, bits), out);
 
   for (const auto& bb: block_bounds) {
     out += write_le<int64_t>(bb.first, out);
@@ -188,16 +195,121 @@ size_t write_hint_data(
   return out - beg;
 }
 
-size_t write_hint(
-  const std::vector<std::pair<int64_t, int64_t>>& block_bounds,
+size_t write_linear_hint_data(
+  const std::vector<std::tuple<float, float, float, float>>& block_lines,
   char* out)
 {
+  const char* beg = out;
+
+  const unsigned bits = __builtin_ctzll(block_lines.size());
+  out += write_be<uint16_t>(make_hint_type(HintType::BLOCK_LINEAR, bits), out);
+
+  const auto write_float = [&out](float f) {
+    uint32_t u;
+    std::memcpy(&u, &f, sizeof(u));
+    out += write_le<uint32_t>(u, out);
+  };
+
+  for (const auto& [la, lb, ua, ub]: block_lines) {
+    write_float(la);
+    write_float(lb);
+    write_float(ua);
+    write_float(ub);
+  }
+
+  return out - beg;
+}
+
+size_t write_hint_data(const HintCandidate& hint, char* out) {
+  const char* beg = out;
+
+  switch (hint_kind(hint.hint_type)) {
+  case HintType::BASIC:
+    out += write_be<uint16_t>(hint.hint_type, out);
+    break;
+
+  case HintType::RADIUS:
+    out += write_be<uint16_t>(hint.hint_type, out);
+    out += write_le<uint32_t>(hint.right, out);
+    break;
+
+  case HintType::RANGE:
+    out += write_be<uint16_t>(hint.hint_type, out);
+    out += write_le<int64_t>(hint.left, out);
+    out += write_le<int64_t>(hint.right, out);
+    break;
+
+  case HintType::BLOCK:
+    out += write_block_hint_data(hint.blocks, out);
+    break;
+
+  case HintType::BLOCK_LINEAR:
+    out += write_linear_hint_data(hint.lines, out);
+    break;
+
+  default:
+    THROW("bad hint type " << std::hex << hint.hint_type);
+  }
+
+  return out - beg;
+}
+
+size_t write_hint(const HintCandidate& hint, char* out) {
 // C++20: return write_chunk<write_hint_data>(
   return write_chunk(
     write_hint_data,
     out,
     "HINT",
-    block_bounds
+    hint
+  );
+}
+
+size_t length_hidx_data(uint64_t hash_count) {
+  // hash_count is an upper bound on the number of distinct hashes
+  return 2 + // index type
+         8 + // seed
+         8 + // key count
+         8 + // bucket count
+         4 * perfect_hash_bucket_count(hash_count) + // pilots
+         4 * hash_count; // positions
+}
+
+size_t length_hidx(uint64_t hash_count) {
+  return length_chunk<length_hidx_data>(hash_count);
+}
+
+size_t write_hidx_data(
+  const PerfectHashData& phd,
+  char* out)
+{
+  const char* beg = out;
+
+  out += write_le<uint16_t>(IndexType::PERFECT_HASH, out);
+  out += write_le<uint64_t>(phd.seed, out);
+  out += write_le<uint64_t>(phd.key_count, out);
+  out += write_le<uint64_t>(phd.pilots.size(), out);
+
+  for (const auto p: phd.pilots) {
+    out += write_le<uint32_t>(p, out);
+  }
+
+  for (const auto p: phd.positions) {
+    out += write_le<uint32_t>(p, out);
+  }
+
+  return out - beg;
+}
+
+size_t write_hidx(
+  const PerfectHashData& phd,
+  char* out)
+{
+// C++20: return write_chunk<write_hidx_data>(
+  return write_chunk(
+    write_hidx_data,
+    out,
+    "HIDX",
+    phd
   );
 }
 
@@ -290,6 +402,42 @@ size_t write_hdat(
   );
 }
 
+size_t length_hdac_data(size_t hash_count, size_t hash_size) {
+  return compressed_length(hash_count, hash_size);
+}
+
+size_t length_hdac(size_t hash_count, size_t hash_size) {
+  return length_chunk<length_hdac_data>(hash_count, hash_size);
+}
+
+size_t write_hdac_data(
+  const HashsetData& hdat,
+  size_t hash_size,
+  char* out)
+{
+  return write_compressed(
+    hdat.beg,
+    (hdat.end - hdat.beg) / hash_size,
+    hash_size,
+    reinterpret_cast<uint8_t*>(out)
+  );
+}
+
+size_t write_hdac(
+  const HashsetData& hdat,
+  size_t hash_size,
+  char* out)
+{
+// C++20: return write_chunk<write_hdac_data>(
+  return write_chunk(
+    write_hdac_data,
+    out,
+    "HDAC",
+    hdat,
+    hash_size
+  );
+}
+
 size_t length_ridx_data(size_t record_count) {
   return record_count * 8;
 }
@@ -485,6 +633,57 @@ size_t write_ftoc(
   );
 }
 
+size_t length_csum_data(size_t segment_count) {
+  return 2 + // checksum type
+         8 + // segment length
+         CSUM_DIGEST_LENGTH * segment_count;
+}
+
+size_t length_csum(size_t segment_count) {
+  return length_chunk<length_csum_data>(segment_count);
+}
+
+size_t write_csum_data(
+  const char* beg,
+  const TableOfContents& toc,
+  unsigned threads,
+  char* out)
+{
+  const char* dbeg = out;
+
+  out += write_le<uint16_t>(ChecksumType::BLAKE3_256, out);
+  out += write_le<uint64_t>(CSUM_SEGMENT_LENGTH, out);
+
+  // the chunks covered must already have been written
+  const auto segs = checksum_segments(toc, CSUM_SEGMENT_LENGTH);
+  compute_checksums(
+    reinterpret_cast<const uint8_t*>(beg),
+    segs,
+    reinterpret_cast<uint8_t*>(out),
+    threads
+  );
+  out += CSUM_DIGEST_LENGTH * segs.size();
+
+  return out - dbeg;
+}
+
+size_t write_csum(
+  const char* beg,
+  const TableOfContents& toc,
+  unsigned threads,
+  char* out)
+{
+// C++20: return write_chunk<write_csum_data>(
+  return write_chunk(
+    write_csum_data,
+    out,
+    "CSUM",
+    beg,
+    toc,
+    threads
+  );
+}
+
 size_t length_fend_data() {
   return 0;
 }
@@ -0,0 +1,417 @@
+#include "hashset/hset_group.h"
+
+#include "error.h"
+#include "throw.h"
+#include "hashset/compressed_hashes.h"
+#include "hashset/hash_compare.h"
+#include "hashset/hset.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <numeric>
+#include <queue>
+
+// with 7 bits set per key, about 0.5% false positives
+constexpr uint64_t FILTER_BITS_PER_KEY = 12;
+
+GroupFilter::GroupFilter(uint64_t key_count):
+  Blocks(std::max<uint64_t>(1, (key_count * FILTER_BITS_PER_KEY + 511) / 512))
+{}
+
+void GroupFilter::insert(uint64_t k) noexcept {
+  Block& b = Blocks[block(k)];
+  const uint64_t h = perfect_hash_mix(k);
+  for (unsigned i = 0; i < BITS_PER_KEY; ++i) {
+    const unsigned bit = (h >> (9 * i)) & 511;
+    b.w[bit / 64] |= uint64_t(1) << (bit % 64);
+  }
+}
+
+uint64_t group_prefix(const uint8_t* hash, size_t len) {
+  uint64_t p = 0;
+  std::memcpy(&p, hash, std::min<size_t>(len, 8));
+  return from_be(p);
+}
+
+uint64_t group_slot(const GroupTable& t, const uint8_t* hash) {
+  return group_prefix(hash, t.hash_length) >> (64 - t.bits);
+}
+
+GroupTable make_group_table(
+  SFHASH_HashAlgorithm hash_type,
+  size_t hash_length,
+  const std::vector<std::pair<size_t, ConstHashsetData>>& hsds,
+  size_t words)
+{
+  GroupTable t{
+    hash_type,
+    hash_length,
+    hash_length + 8 * words,
+    0,
+    0,
+    {},
+    {},
+    {},
+    std::make_unique<LookupStats>()
+  };
+
+  struct Cursor {
+    const uint8_t* cur;
+    const uint8_t* end;
+    size_t bit;
+  };
+
+  const auto greater = [hash_length](const Cursor& l, const Cursor& r) {
+    return hash_cmp(l.cur, r.cur, hash_length) > 0;
+  };
+
+  std::priority_queue<Cursor, std::vector<Cursor>, decltype(greater)> heap(greater);
+
+  uint64_t total = 0;
+  for (const auto& [bit, hsd]: hsds) {
+    const uint8_t* beg = static_cast<const uint8_t*>(hsd.beg);
+    const uint8_t* end = static_cast<const uint8_t*>(hsd.end);
+    if (beg < end) {
+      heap.push({ beg, end, bit });
+      total += (end - beg) / hash_length;
+    }
+  }
+
+  t.entries.reserve(total * t.stride);
+
+  // merge the HDATs, merging the bitmaps of equal hashes
+  uint8_t* last = nullptr;
+  while (!heap.empty()) {
+    Cursor c = heap.top();
+    heap.pop();
+
+    if (!last || hash_cmp(last, c.cur, hash_length)) {
+      t.entries.insert(t.entries.end(), c.cur, c.cur + hash_length);
+      t.entries.insert(t.entries.end(), 8 * words, 0);
+      last = t.entries.data() + t.count * t.stride;
+      ++t.count;
+    }
+
+    uint64_t w;
+    uint8_t* wp = last + hash_length + 8 * (c.bit / 64);
+    std::memcpy(&w, wp, sizeof(w));
+    w |= uint64_t(1) << (c.bit % 64);
+    std::memcpy(wp, &w, sizeof(w));
+
+    c.cur += hash_length;
+    if (c.cur < c.end) {
+      heap.push(c);
+    }
+  }
+
+  t.entries.shrink_to_fit();
+
+  // about four entries per slot
+  t.bits = std::clamp(
+    t.count ? static_cast<int>(std::log2(t.count)) - 2 : 0, 1, 30
+  );
+
+  t.offsets.assign((uint64_t(1) << t.bits) + 1, 0);
+  for (uint64_t i = 0; i < t.count; ++i) {
+    ++t.offsets[group_slot(t, t.entries.data() + i * t.stride) + 1];
+  }
+  std::partial_sum(t.offsets.begin(), t.offsets.end(), t.offsets.begin());
+
+  t.filter = GroupFilter(t.count);
+  for (uint64_t i = 0; i < t.count; ++i) {
+    t.filter.insert(
+      GroupFilter::key(t.entries.data() + i * t.stride, hash_length)
+    );
+  }
+
+  return t;
+}
+
+const uint8_t* group_find(
+  const GroupTable& t,
+  uint64_t l,
+  uint64_t r,
+  const uint8_t* hash,
+  uint64_t& probes)
+{
+  const uint8_t* e = t.entries.data();
+
+  // lower bound over the slot
+  while (l < r) {
+    const uint64_t mid = l + (r - l) / 2;
+    ++probes;
+    if (hash_cmp(e + mid * t.stride, hash, t.hash_length) < 0) {
+      l = mid + 1;
+    }
+    else {
+      r = mid;
+    }
+  }
+
+  probes += l < t.count;
+  return l < t.count && !hash_cmp(e + l * t.stride, hash, t.hash_length) ?
+    e + l * t.stride : nullptr;
+}
+
+void count_group_find(
+  const GroupTable& t,
+  uint64_t s,
+  uint64_t probes,
+  LookupStatsCounts& c)
+{
+  c.window(t.offsets[s + 1] - t.offsets[s]);
+  c.probes += probes;
+}
+
+bool group_lookup(
+  const GroupTable& t,
+  size_t words,
+  const uint8_t* hash,
+  uint64_t* members)
+{
+  const uint8_t* e = nullptr;
+  const bool live = t.filter.maybe_contains(GroupFilter::key(hash, t.hash_length));
+  uint64_t s = 0;
+  uint64_t probes = 0;
+  if (live) {
+    s = group_slot(t, hash);
+    e = group_find(t, t.offsets[s], t.offsets[s + 1], hash, probes);
+  }
+
+  if (lookup_stats_enabled()) {
+    LookupStatsCounts c;
+    c.lookups = 1;
+    c.hits = e != nullptr;
+    if (live) {
+      count_group_find(t, s, probes, c);
+    }
+    else {
+      ++c.rejections;
+    }
+    t.stats->add(c);
+  }
+
+  if (e) {
+    std::memcpy(members, e + t.hash_length, 8 * words);
+    return true;
+  }
+  else {
+    std::fill(members, members + words, 0);
+    return false;
+  }
+}
+
+void group_lookup_bulk(
+  const GroupTable& t,
+  size_t words,
+  const uint8_t* hashes,
+  size_t count,
+  uint64_t* members)
+{
+  // Stage a group of lookups through the filter, the offsets, and the
+  // entries, prefetching what the next stage reads, as for the perfect
+  // hash; most misses drop out at the filter.
+  constexpr size_t GROUP = 16;
+
+  const size_t hlen = t.hash_length;
+  uint64_t k[GROUP], s[GROUP];
+  bool live[GROUP];
+
+  const bool stats = lookup_stats_enabled();
+  LookupStatsCounts c;
+
+  for (size_t i = 0; i < count; i += GROUP) {
+    const size_t g = std::min(GROUP, count - i);
+    const uint8_t* gh = hashes + i * hlen;
+
+    for (size_t j = 0; j < g; ++j) {
+      k[j] = GroupFilter::key(gh + j * hlen, hlen);
+      t.filter.prefetch(k[j]);
+    }
+
+    for (size_t j = 0; j < g; ++j) {
+      live[j] = t.filter.maybe_contains(k[j]);
+      if (live[j]) {
+        s[j] = group_slot(t, gh + j * hlen);
+        __builtin_prefetch(t.offsets.data() + s[j]);
+      }
+    }
+
+    for (size_t j = 0; j < g; ++j) {
+      if (live[j]) {
+        __builtin_prefetch(t.entries.data() + t.offsets[s[j]] * t.stride);
+      }
+    }
+
+    for (size_t j = 0; j < g; ++j) {
+      uint64_t* m = members + (i + j) * words;
+      uint64_t probes = 0;
+      const uint8_t* e = live[j] ?
+        group_find(t, t.offsets[s[j]], t.offsets[s[j] + 1], gh + j * hlen, probes) :
+        nullptr;
+
+      if (e) {
+        std::memcpy(m, e + hlen, 8 * words);
+      }
+      else {
+        std::fill(m, m + words, 0);
+      }
+
+      if (stats) {
+        c.hits += e != nullptr;
+        if (live[j]) {
+          count_group_find(t, s[j], probes, c);
+        }
+        else {
+          ++c.rejections;
+        }
+      }
+    }
+  }
+
+  if (stats) {
+    c.lookups = count;
+    t.stats->add(c);
+  }
+}
+
+SFHASH_HashsetGroup* sfhash_hashset_group_create(
+  const SFHASH_Hashset* const* hsets,
+  size_t hsets_length,
+  SFHASH_Error** err)
+{
+  try {
+    auto grp = std::make_unique<SFHASH_HashsetGroup>();
+    grp->words = std::max<size_t>(1, (hsets_length + 63) / 64);
+
+    // collect the HDATs of each type
+    std::vector<std::pair<HashsetHeader, std::vector<std::pair<size_t, ConstHashsetData>>>> types;
+
+    // compressed hashes, expanded for merging; the table copies them
+    std::vector<std::vector<uint8_t>> expanded;
+
+    for (size_t i = 0; i < hsets_length; ++i) {
+      for (const auto& h: hsets[i]->holder.hsets) {
+        const auto& hhdr = std::get<HashsetHeader>(h);
+
+        auto ti = std::find_if(
+          types.begin(), types.end(),
+          [&hhdr](const auto& t) { return t.first.hash_type == hhdr.hash_type; }
+        );
+
+        if (ti == types.end()) {
+          types.emplace_back(hhdr, std::vector<std::pair<size_t, ConstHashsetData>>());
+          ti = types.end() - 1;
+        }
+
+        THROW_IF(
+          ti->first.hash_length != hhdr.hash_length,
+          "hash length mismatch for " << hhdr.hash_name << ": "
+            << ti->first.hash_length << " != " << hhdr.hash_length
+        );
+
+        const auto& hsd = std::get<ConstHashsetData>(h);
+        if (hsd.compressed) {
+          expanded.push_back(
+            CompressedHashes(
+              hsd.beg, hsd.end, hhdr.hash_length, hhdr.hash_count
+            ).expand()
+          );
+
+          const auto& e = expanded.back();
+          ti->second.emplace_back(
+            i, ConstHashsetData{ e.data(), e.data() + e.size() }
+          );
+        }
+        else {
+          ti->second.emplace_back(i, hsd);
+        }
+      }
+    }
+
+    for (const auto& [hhdr, hsds]: types) {
+      grp->tables.push_back(make_group_table(
+        static_cast<SFHASH_HashAlgorithm>(hhdr.hash_type),
+        hhdr.hash_length,
+        hsds,
+        grp->words
+      ));
+    }
+
+    return grp.release();
+  }
+  catch (const std::exception& e) {
+    fill_error(err, std::string("failed to create hashset group: ") + e.what());
+    return nullptr;
+  }
+}
+
+void sfhash_hashset_group_destroy(SFHASH_HashsetGroup* grp) {
+  delete grp;
+}
+
+size_t sfhash_hashset_group_bitmap_words(const SFHASH_HashsetGroup* grp) {
+  return grp->words;
+}
+
+int sfhash_hashset_group_index_for_type(
+  const SFHASH_HashsetGroup* grp,
+  SFHASH_HashAlgorithm htype)
+{
+  const auto i = std::find_if(
+    grp->tables.begin(),
+    grp->tables.end(),
+    [htype](const GroupTable& t) {
+      return htype == t.hash_type;
+    }
+  );
+
+  return i == grp->tables.end() ? -1 : i - grp->tables.begin();
+}
+
+bool sfhash_hashset_group_lookup(
+  const SFHASH_HashsetGroup* grp,
+  size_t tidx,
+  const void* hash,
+  uint64_t* members)
+{
+  return group_lookup(
+    grp->tables[tidx],
+    grp->words,
+    static_cast<const uint8_t*>(hash),
+    members
+  );
+}
+
+void sfhash_hashset_group_lookup_bulk(
+  const SFHASH_HashsetGroup* grp,
+  size_t tidx,
+  const void* hashes,
+  size_t hashes_length,
+  uint64_t* members)
+{
+  group_lookup_bulk(
+    grp->tables[tidx],
+    grp->words,
+    static_cast<const uint8_t*>(hashes),
+    hashes_length,
+    members
+  );
+}
+
+void sfhash_hashset_group_stats(
+  const SFHASH_HashsetGroup* grp,
+  size_t tidx,
+  SFHASH_HashsetLookupStats* stats)
+{
+  fill_lookup_stats(grp->tables[tidx].stats->total(), stats);
+}
+
+void sfhash_hashset_group_stats_reset(
+  const SFHASH_HashsetGroup* grp,
+  size_t tidx)
+{
+  grp->tables[tidx].stats->reset();
+}
@@ -0,0 +1,455 @@
+#include "hashset/hset_layers.h"
+
+#include "error.h"
+#include "throw.h"
+#include "util.h"
+#include "hashset/compressed_hashes.h"
+#include "hashset/hset.h"
+#include "hashset/hset_decoder.h"
+#include "hashset/mapped_file.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+constexpr unsigned LAYER_MANIFEST_VERSION = 1;
+
+LayerManifest read_layer_manifest(std::istream& in) {
+  LayerManifest m;
+
+  m.types = read_manifest(
+    in, LAYER_MANIFEST_MAGIC, LAYER_MANIFEST_VERSION, "layer",
+    [&m](const std::string& kind, std::istream& ls, size_t lineno) {
+      if (kind != "layer") {
+        return false;
+      }
+
+      std::string path;
+      std::getline(ls >> std::ws, path);
+      THROW_IF(path.empty(), "bad layer at line " << lineno);
+      m.layers.push_back(std::move(path));
+      return true;
+    }
+  );
+
+  THROW_IF(m.layers.empty(), "layer manifest has no layers");
+
+  return m;
+}
+
+void write_layer_manifest(const LayerManifest& m, std::ostream& out) {
+  write_manifest_types(m.types, LAYER_MANIFEST_MAGIC, LAYER_MANIFEST_VERSION, out);
+
+  for (const auto& l: m.layers) {
+    out << "layer " << l << '\n';
+  }
+}
+
+LayerManifest load_layer_manifest(const std::filesystem::path& manifest_path) {
+  std::ifstream in;
+  in.exceptions(std::ifstream::badbit);
+  in.open(manifest_path);
+  THROW_IF(!in, "cannot open " << manifest_path);
+  return read_layer_manifest(in);
+}
+
+// Replaces the manifest whole, so that readers see the old one or the new
+void store_layer_manifest(
+  const LayerManifest& m,
+  const std::filesystem::path& manifest_path)
+{
+  const auto tmp = manifest_path.string() + ".tmp";
+  {
+    std::ofstream out;
+    out.exceptions(std::ofstream::failbit);
+    out.open(tmp, std::ios::trunc);
+    write_layer_manifest(m, out);
+  }
+  std::filesystem::rename(tmp, manifest_path);
+}
+
+std::unique_ptr<SFHASH_Hashset, void (*)(SFHASH_Hashset*)> open_layer(
+  const LayerManifest& m,
+  const std::filesystem::path& manifest_path,
+  size_t i,
+  uint32_t flags)
+{
+  const auto path = (manifest_path.parent_path() / m.layers[i]).string();
+
+  SFHASH_Error* err = nullptr;
+  auto hset = make_unique_del(
+    sfhash_open_hashset(path.c_str(), flags, &err),
+    sfhash_destroy_hashset
+  );
+
+  if (err) {
+    const std::string msg = err->message;
+    sfhash_free_error(err);
+    THROW(msg);
+  }
+
+  // the type indices are shared by every layer
+  check_hset_types(*hset, m.types, path);
+  return hset;
+}
+
+// A layer's path as the manifest has it
+std::string layer_path(
+  const std::filesystem::path& path,
+  const std::filesystem::path& manifest_path)
+{
+  const auto dir = manifest_path.parent_path();
+  return std::filesystem::proximate(path, dir.empty() ? "." : dir).string();
+}
+
+void create_layers(
+  const std::filesystem::path& manifest_path,
+  const std::filesystem::path& base_path)
+{
+  SFHASH_Error* err = nullptr;
+  auto base = make_unique_del(
+    sfhash_open_hashset(base_path.string().c_str(), 0, &err),
+    sfhash_destroy_hashset
+  );
+
+  if (err) {
+    const std::string msg = err->message;
+    sfhash_free_error(err);
+    THROW(msg);
+  }
+
+  LayerManifest m;
+  m.types = manifest_types(*base);
+
+  THROW_IF(m.types.empty(), "hashset has no hashsets to look up");
+
+  m.layers.push_back(layer_path(base_path, manifest_path));
+  store_layer_manifest(m, manifest_path);
+}
+
+void append_layer(
+  const std::filesystem::path& manifest_path,
+  const uint8_t* records,
+  size_t count,
+  const std::filesystem::path& delta_path,
+  const char* temp_dir,
+  uint32_t flags)
+{
+  auto m = load_layer_manifest(manifest_path);
+
+  // building the delta over a layer would truncate it
+  for (const auto& l: m.layers) {
+    std::error_code ec;
+    THROW_IF(
+      std::filesystem::equivalent(manifest_path.parent_path() / l, delta_path, ec),
+      delta_path << " is already the layer " << l
+    );
+  }
+
+  // only the base's FHDR is read, for the delta to be named as it is
+  const MappedFile base(
+    (manifest_path.parent_path() / m.layers.front()).string(), 0
+  );
+  const auto fhdr = decode_hset_fhdr(base.begin(), base.end());
+
+  write_manifest_hset(
+    fhdr.name, fhdr.desc, m.types, false,
+    delta_path, temp_dir, flags,
+    [records, count](SFHASH_HashsetBuildCtx* bctx) {
+      SFHASH_Error* err = nullptr;
+      sfhash_hashset_builder_add_records(bctx, records, count, &err);
+      THROW_IF(err, err->message);
+    }
+  );
+
+  m.layers.push_back(layer_path(delta_path, manifest_path));
+  store_layer_manifest(m, manifest_path);
+}
+
+void compact_layers(
+  const std::filesystem::path& manifest_path,
+  const std::filesystem::path& out_path,
+  const char* temp_dir,
+  uint32_t flags)
+{
+  auto m = load_layer_manifest(manifest_path);
+
+  std::vector<std::unique_ptr<SFHASH_Hashset, void (*)(SFHASH_Hashset*)>> layers;
+  for (size_t i = 0; i < m.layers.size(); ++i) {
+    layers.push_back(open_layer(m, manifest_path, i, 0));
+  }
+
+  // the base's records are carried over, with the deltas' hashes not in
+  // them each a record with no other hashes, as the deltas have no records
+  const auto& base = layers.front()->holder;
+  const bool with_records = base.rdat.beg;
+
+  if (with_records) {
+    const auto& fields = base.rhdr.fields;
+    THROW_IF(
+      fields.size() != m.types.size(),
+      "the base's records have " << fields.size() << " fields, not "
+                                 << m.types.size()
+    );
+    for (size_t ti = 0; ti < fields.size(); ++ti) {
+      THROW_IF(
+        fields[ti].type != m.types[ti].hash_type ||
+        fields[ti].length != m.types[ti].hash_length,
+        "the base's records have " << fields[ti].name
+          << " where the manifest has " << m.types[ti].hash_name
+      );
+    }
+  }
+
+  // the output may be one of the layers, which stay mapped until the build
+  // is done, so it is built beside the output and renamed over it after
+  const std::filesystem::path tmp_path = out_path.string() + ".tmp";
+
+  // the builder sorts all the layers together, dropping what is in more
+  // than one
+  try {
+    write_manifest_hset(
+      base.fhdr.name, base.fhdr.desc, m.types, with_records,
+      tmp_path, temp_dir, flags,
+      [&m, &layers, &base, with_records](SFHASH_HashsetBuildCtx* bctx) {
+        SFHASH_Error* err = nullptr;
+
+        if (with_records) {
+          sfhash_hashset_builder_add_records(
+            bctx, base.rdat.beg, base.rhdr.record_count, &err
+          );
+          THROW_IF(err, err->message);
+        }
+
+        // the base's hashes are in its records, if it has them
+        const size_t first = with_records ? 1 : 0;
+
+        std::vector<uint8_t> expanded, missed;
+        std::unique_ptr<bool[]> in_base;
+
+        for (size_t ti = 0; ti < m.types.size(); ++ti) {
+          const size_t hlen = m.types[ti].hash_length;
+          for (size_t li = first; li < layers.size(); ++li) {
+            const auto& h = layers[li]->holder.hsets[ti];
+            const auto& hhdr = std::get<HashsetHeader>(h);
+            const auto& hsd = std::get<ConstHashsetData>(h);
+
+            const uint8_t* hs = static_cast<const uint8_t*>(hsd.beg);
+            size_t count = hhdr.hash_count;
+
+            if (hsd.compressed) {
+              expanded = CompressedHashes(
+                hsd.beg, hsd.end, hhdr.hash_length, hhdr.hash_count
+              ).expand();
+              hs = expanded.data();
+              count = expanded.size() / hlen;
+            }
+
+            if (with_records) {
+              // a hash in the base's records needs no record of its own
+              in_base.reset(new bool[count]);
+              sfhash_hashset_lookup_bulk(
+                layers.front().get(), ti, hs, count, in_base.get()
+              );
+
+              missed.clear();
+              for (size_t i = 0; i < count; ++i) {
+                if (!in_base[i]) {
+                  missed.insert(missed.end(), hs + i * hlen, hs + (i + 1) * hlen);
+                }
+              }
+
+              hs = missed.data();
+              count = missed.size() / hlen;
+            }
+
+            sfhash_hashset_builder_add_hashes(bctx, ti, hs, count, &err);
+            THROW_IF(err, err->message);
+          }
+        }
+      }
+    );
+  }
+  catch (...) {
+    std::error_code ec;
+    std::filesystem::remove(tmp_path, ec);
+    throw;
+  }
+
+  layers.clear();
+  std::filesystem::rename(tmp_path, out_path);
+
+  m.layers = { layer_path(out_path, manifest_path) };
+  store_layer_manifest(m, manifest_path);
+}
+
+void sfhash_hashset_layers_create(
+  const char* manifest_path,
+  const char* base_path,
+  SFHASH_Error** err)
+{
+  try {
+    create_layers(manifest_path, base_path);
+  }
+  catch (const std::exception& e) {
+    fill_error(err, std::string("failed to create layers: ") + e.what());
+  }
+}
+
+void sfhash_hashset_layers_append(
+  const char* manifest_path,
+  const void* records,
+  size_t count,
+  const char* delta_path,
+  const char* temp_dir,
+  uint32_t flags,
+  SFHASH_Error** err)
+{
+  try {
+    append_layer(
+      manifest_path, static_cast<const uint8_t*>(records), count,
+      delta_path, temp_dir, flags
+    );
+  }
+  catch (const std::exception& e) {
+    fill_error(err, std::string("failed to append layer: ") + e.what());
+  }
+}
+
+void sfhash_hashset_layers_compact(
+  const char* manifest_path,
+  const char* out_path,
+  const char* temp_dir,
+  uint32_t flags,
+  SFHASH_Error** err)
+{
+  try {
+    compact_layers(manifest_path, out_path, temp_dir, flags);
+  }
+  catch (const std::exception& e) {
+    fill_error(err, std::string("failed to compact layers: ") + e.what());
+  }
+}
+
+SFHASH_HashsetLayers* sfhash_open_hashset_layers(
+  const char* manifest_path,
+  uint32_t flags,
+  SFHASH_Error** err)
+{
+  try {
+    auto l = std::make_unique<SFHASH_HashsetLayers>();
+    l->manifest = load_layer_manifest(manifest_path);
+    for (size_t i = 0; i < l->manifest.layers.size(); ++i) {
+      l->layers.push_back(open_layer(l->manifest, manifest_path, i, flags));
+    }
+    return l.release();
+  }
+  catch (const std::exception& e) {
+    fill_error(err, std::string("failed to open layers: ") + e.what());
+    return nullptr;
+  }
+}
+
+void sfhash_destroy_hashset_layers(SFHASH_HashsetLayers* layers) {
+  delete layers;
+}
+
+size_t sfhash_hashset_layers_count(const SFHASH_HashsetLayers* layers) {
+  return layers->layers.size();
+}
+
+int sfhash_hashset_layers_index_for_type(
+  const SFHASH_HashsetLayers* layers,
+  SFHASH_HashAlgorithm htype)
+{
+  const auto& types = layers->manifest.types;
+  const auto i = std::find_if(
+    types.begin(), types.end(),
+    [htype](const ManifestType& t) { return t.hash_type == htype; }
+  );
+
+  return i == types.end() ? -1 : i - types.begin();
+}
+
+const SFHASH_Hashset* sfhash_hashset_layers_layer(
+  const SFHASH_HashsetLayers* layers,
+  size_t i)
+{
+  return layers->layers[i].get();
+}
+
+bool sfhash_hashset_layers_lookup(
+  const SFHASH_HashsetLayers* layers,
+  size_t tidx,
+  const void* hash)
+{
+  // the newest layers are the smallest
+  for (auto l = layers->layers.rbegin(); l != layers->layers.rend(); ++l) {
+    if (sfhash_hashset_lookup(l->get(), tidx, hash)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void layers_lookup_bulk(
+  const SFHASH_HashsetLayers* layers,
+  size_t tidx,
+  const void* hashes,
+  size_t hashes_length,
+  bool* results)
+{
+  const size_t hlen = layers->manifest.types[tidx].hash_length;
+  const uint8_t* hs = static_cast<const uint8_t*>(hashes);
+
+  sfhash_hashset_lookup_bulk(
+    layers->layers.front().get(), tidx, hashes, hashes_length, results
+  );
+
+  // each delta is asked only about the hashes missed so far
+  std::vector<uint8_t> missed;
+  std::vector<size_t> order;
+  std::unique_ptr<bool[]> mresults;
+
+  for (size_t li = 1; li < layers->layers.size(); ++li) {
+    missed.clear();
+    order.clear();
+    for (size_t i = 0; i < hashes_length; ++i) {
+      if (!results[i]) {
+        missed.insert(missed.end(), hs + i * hlen, hs + (i + 1) * hlen);
+        order.push_back(i);
+      }
+    }
+
+    if (order.empty()) {
+      return;
+    }
+
+    mresults.reset(new bool[order.size()]);
+    sfhash_hashset_lookup_bulk(
+      layers->layers[li].get(), tidx, missed.data(), order.size(), mresults.get()
+    );
+
+    for (size_t j = 0; j < order.size(); ++j) {
+      results[order[j]] = mresults[j];
+    }
+  }
+}
+
+void sfhash_hashset_layers_lookup_bulk(
+  const SFHASH_HashsetLayers* layers,
+  size_t tidx,
+  const void* hashes,
+  size_t hashes_length,
+  bool* results,
+  SFHASH_Error** err)
+{
+  try {
+    layers_lookup_bulk(layers, tidx, hashes, hashes_length, results);
+  }
+  catch (const std::exception& e) {
+    fill_error(err, std::string("failed to look up in layers: ") + e.what());
+  }
+}
@@ -0,0 +1,176 @@
+#include "hashset/hset_manifest.h"
+
+#include "throw.h"
+#include "util.h"
+#include "hashset/hset.h"
+
+#include <cstring>
+#include <sstream>
+
+const char SHARD_MANIFEST_MAGIC[] = "hasher-shards";
+const char LAYER_MANIFEST_MAGIC[] = "hasher-layers";
+
+std::vector<ManifestType> read_manifest(
+  std::istream& in,
+  const char* magic,
+  unsigned version,
+  const char* what,
+  const std::function<bool(const std::string&, std::istream&, size_t)>& entry)
+{
+  std::vector<ManifestType> types;
+
+  std::string line;
+  THROW_IF(!std::getline(in, line), "empty " << what << " manifest");
+
+  {
+    std::istringstream ls(line);
+    std::string m;
+    unsigned v = 0;
+    ls >> m >> v;
+    THROW_IF(m != magic, "not a " << what << " manifest");
+    THROW_IF(
+      v != version,
+      "unsupported " << what << " manifest version " << v
+    );
+  }
+
+  for (size_t lineno = 2; std::getline(in, line); ++lineno) {
+    if (line.empty()) {
+      continue;
+    }
+
+    std::istringstream ls(line);
+    std::string kind;
+    ls >> kind;
+
+    if (kind == "type") {
+      uint32_t type = 0;
+      ManifestType t{};
+      ls >> type >> t.hash_length >> t.hash_name;
+      THROW_IF(!ls || t.hash_length == 0, "bad type at line " << lineno);
+      t.hash_type = static_cast<SFHASH_HashAlgorithm>(type);
+      types.push_back(std::move(t));
+    }
+    else {
+      THROW_IF(
+        !entry(kind, ls, lineno),
+        "unknown entry '" << kind << "' at line " << lineno
+      );
+    }
+  }
+
+  THROW_IF(types.empty(), what << " manifest has no types");
+
+  return types;
+}
+
+void check_not_manifest(const uint8_t* beg, const uint8_t* end) {
+  const auto starts_with = [beg, end](const char* magic) {
+    const size_t n = std::strlen(magic);
+    return static_cast<size_t>(end - beg) > n &&
+      !std::memcmp(beg, magic, n) && beg[n] == ' ';
+  };
+
+  THROW_IF(
+    starts_with(SHARD_MANIFEST_MAGIC),
+    "a shard manifest, not an hset; open it with sfhash_open_hashset_shards"
+  );
+  THROW_IF(
+    starts_with(LAYER_MANIFEST_MAGIC),
+    "a layer manifest, not an hset; open it with sfhash_open_hashset_layers"
+  );
+}
+
+void write_manifest_types(
+  const std::vector<ManifestType>& types,
+  const char* magic,
+  unsigned version,
+  std::ostream& out)
+{
+  out << magic << ' ' << version << '\n';
+
+  for (const auto& t: types) {
+    out << "type " << t.hash_type << ' ' << t.hash_length << ' '
+        << t.hash_name << '\n';
+  }
+}
+
+std::vector<ManifestType> manifest_types(const SFHASH_Hashset& hset) {
+  std::vector<ManifestType> types;
+  for (const auto& h: hset.holder.hsets) {
+    const auto& hhdr = std::get<HashsetHeader>(h);
+    types.push_back({
+      static_cast<SFHASH_HashAlgorithm>(hhdr.hash_type),
+      hhdr.hash_length,
+      hhdr.hash_name
+    });
+  }
+  return types;
+}
+
+void check_hset_types(
+  const SFHASH_Hashset& hset,
+  const std::vector<ManifestType>& types,
+  const std::string& path)
+{
+  const auto& hsets = hset.holder.hsets;
+  THROW_IF(
+    hsets.size() != types.size(),
+    path << " has " << hsets.size() << " hash types, not " << types.size()
+  );
+
+  for (size_t ti = 0; ti < types.size(); ++ti) {
+    const auto& hhdr = std::get<HashsetHeader>(hsets[ti]);
+    THROW_IF(
+      hhdr.hash_type != types[ti].hash_type ||
+      hhdr.hash_length != types[ti].hash_length,
+      path << " has " << hhdr.hash_name << " where the manifest has "
+           << types[ti].hash_name
+    );
+  }
+}
+
+void write_manifest_hset(
+  const std::string& name,
+  const std::string& desc,
+  const std::vector<ManifestType>& types,
+  bool with_records,
+  const std::filesystem::path& path,
+  const char* temp_dir,
+  uint32_t flags,
+  const std::function<void(SFHASH_HashsetBuildCtx*)>& add)
+{
+  std::vector<SFHASH_HashAlgorithm> htypes;
+  for (const auto& t: types) {
+    htypes.push_back(t.hash_type);
+  }
+
+  SFHASH_Error* err = nullptr;
+
+  auto bctx = make_unique_del(
+    sfhash_hashset_builder_open(
+      name.c_str(),
+      desc.c_str(),
+      htypes.data(),
+      htypes.size(),
+      with_records,
+      true,
+      path.string().c_str(),
+      temp_dir,
+      &err
+    ),
+    sfhash_hashset_builder_destroy
+  );
+
+  THROW_IF(err, err->message);
+
+  if (flags) {
+    sfhash_hashset_builder_set_flags(bctx.get(), flags, &err);
+    THROW_IF(err, err->message);
+  }
+
+  add(bctx.get());
+
+  sfhash_hashset_builder_write(bctx.get(), &err);
+  THROW_IF(err, err->message);
+}
@@ -8,6 +8,7 @@
 #include <algorithm>
 #include <iterator>
 #include <set>
+#include <vector>
 
 template <auto op>
 std::pair<
@@ -137,8 +138,17 @@ SFHASH_HashsetBuildCtx* setop_open(
       return nullptr;
     }
 
-    for (const auto& r: u) {
-      sfhash_hashset_builder_add_record(bctx.get(), r.data());
+    if (!u.empty()) {
+      std::vector<uint8_t> recs;
+      recs.reserve(u.size() * u.front().size());
+      for (const auto& r: u) {
+        recs.insert(recs.end(), r.begin(), r.end());
+      }
+
+      sfhash_hashset_builder_add_records(bctx.get(), recs.data(), u.size(), err);
+      if (*err) {
+        return nullptr;
+      }
     }
 
     return bctx.release();
@@ -0,0 +1,392 @@
+#include "hashset/hset_shards.h"
+
+#include "error.h"
+#include "throw.h"
+#include "util.h"
+#include "hashset/compressed_hashes.h"
+#include "hashset/hset.h"
+#include "rwutil.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <numeric>
+
+constexpr unsigned SHARD_MANIFEST_VERSION = 1;
+
+ShardManifest read_shard_manifest(std::istream& in) {
+  ShardManifest m;
+
+  m.types = read_manifest(
+    in, SHARD_MANIFEST_MAGIC, SHARD_MANIFEST_VERSION, "shard",
+    [&m](const std::string& kind, std::istream& ls, size_t lineno) {
+      if (kind != "shard") {
+        return false;
+      }
+
+      ShardEntry s{};
+      ls >> std::hex >> s.first >> s.last >> std::ws;
+      std::getline(ls, s.path);
+      THROW_IF(!ls || s.path.empty(), "bad shard at line " << lineno);
+      THROW_IF(s.first > s.last, "empty shard range at line " << lineno);
+      THROW_IF(
+        !m.shards.empty() && s.first <= m.shards.back().last,
+        "shard out of order at line " << lineno
+      );
+      m.shards.push_back(std::move(s));
+      return true;
+    }
+  );
+
+  return m;
+}
+
+void write_shard_manifest(const ShardManifest& m, std::ostream& out) {
+  write_manifest_types(m.types, SHARD_MANIFEST_MAGIC, SHARD_MANIFEST_VERSION, out);
+
+  out << std::hex << std::setfill('0');
+  for (const auto& s: m.shards) {
+    out << "shard " << std::setw(16) << s.first << ' '
+        << std::setw(16) << s.last << ' ' << s.path << '\n';
+  }
+}
+
+uint64_t shard_prefix(const uint8_t* hash, size_t hash_length) {
+  uint64_t p = 0;
+  std::memcpy(&p, hash, std::min<size_t>(hash_length, 8));
+  return from_be(p);
+}
+
+int shard_for_prefix(const ShardManifest& m, uint64_t p) {
+  // the last shard starting at or before p
+  const auto i = std::upper_bound(
+    m.shards.begin(), m.shards.end(), p,
+    [](uint64_t p, const ShardEntry& s) { return p < s.first; }
+  );
+
+  return i == m.shards.begin() || p > (i - 1)->last ?
+    -1 : (i - 1) - m.shards.begin();
+}
+
+uint64_t shard_range_first(size_t i, size_t n) {
+  // floor(i * 2^64 / n), without overflowing
+  __extension__ using uint128_t = unsigned __int128;
+  return static_cast<uint64_t>((static_cast<uint128_t>(i) << 64) / n);
+}
+
+void write_shards(
+  const SFHASH_Hashset& hset,
+  size_t shard_count,
+  const std::filesystem::path& manifest_path,
+  const char* temp_dir,
+  uint32_t flags)
+{
+  THROW_IF(shard_count == 0, "shard_count == 0");
+
+  ShardManifest m;
+  m.types = manifest_types(hset);
+
+  // compressed hashes, expanded for splitting
+  std::vector<std::vector<uint8_t>> expanded;
+  std::vector<std::pair<const uint8_t*, const uint8_t*>> hashes;
+
+  for (const auto& h: hset.holder.hsets) {
+    const auto& hhdr = std::get<HashsetHeader>(h);
+    const auto& hsd = std::get<ConstHashsetData>(h);
+
+    if (hsd.compressed) {
+      expanded.push_back(
+        CompressedHashes(
+          hsd.beg, hsd.end, hhdr.hash_length, hhdr.hash_count
+        ).expand()
+      );
+      const auto& e = expanded.back();
+      hashes.emplace_back(e.data(), e.data() + e.size());
+    }
+    else {
+      hashes.emplace_back(
+        static_cast<const uint8_t*>(hsd.beg),
+        static_cast<const uint8_t*>(hsd.end)
+      );
+    }
+  }
+
+  THROW_IF(m.types.empty(), "hashset has no hashsets to shard");
+
+  const std::string base = manifest_path.filename().string();
+
+  for (size_t i = 0; i < shard_count; ++i) {
+    ShardEntry s{
+      shard_range_first(i, shard_count),
+      i + 1 < shard_count ? shard_range_first(i + 1, shard_count) - 1 : ~uint64_t(0),
+      base + '.' + std::to_string(i) + ".hset"
+    };
+
+    write_manifest_hset(
+      hset.holder.fhdr.name,
+      hset.holder.fhdr.desc,
+      m.types,
+      false,
+      manifest_path.parent_path() / s.path,
+      temp_dir,
+      flags,
+      [&m, &hashes, &s](SFHASH_HashsetBuildCtx* bctx) {
+        // each hash of the shard's range is a record with no other hashes
+        for (size_t ti = 0; ti < m.types.size(); ++ti) {
+          const size_t hlen = m.types[ti].hash_length;
+          const auto [beg, end] = hashes[ti];
+
+          const auto lower = [hlen, beg = beg, end = end](uint64_t p) {
+            size_t l = 0;
+            size_t r = (end - beg) / hlen;
+            while (l < r) {
+              const size_t mid = l + (r - l) / 2;
+              if (shard_prefix(beg + mid * hlen, hlen) < p) {
+                l = mid + 1;
+              }
+              else {
+                r = mid;
+              }
+            }
+            return beg + l * hlen;
+          };
+
+          const uint8_t* h = lower(s.first);
+          const uint8_t* hend = s.last == ~uint64_t(0) ? end : lower(s.last + 1);
+
+          SFHASH_Error* err = nullptr;
+          sfhash_hashset_builder_add_hashes(bctx, ti, h, (hend - h) / hlen, &err);
+          THROW_IF(err, err->message);
+        }
+      }
+    );
+
+    m.shards.push_back(std::move(s));
+  }
+
+  std::ofstream out;
+  out.exceptions(std::ofstream::failbit);
+  out.open(manifest_path, std::ios::trunc);
+  write_shard_manifest(m, out);
+}
+
+void sfhash_hashset_write_shards(
+  const SFHASH_Hashset* hset,
+  size_t shard_count,
+  const char* manifest_path,
+  const char* temp_dir,
+  uint32_t flags,
+  SFHASH_Error** err)
+{
+  try {
+    write_shards(*hset, shard_count, manifest_path, temp_dir, flags);
+  }
+  catch (const std::exception& e) {
+    fill_error(err, std::string("failed to write shards: ") + e.what());
+  }
+}
+
+SFHASH_HashsetShards* sfhash_open_hashset_shards(
+  const char* manifest_path,
+  uint32_t flags,
+  SFHASH_Error** err)
+{
+  try {
+    // the shards are opened later, so check now
+    check_open_flags(flags);
+
+    std::ifstream in;
+    in.exceptions(std::ifstream::badbit);
+    in.open(manifest_path);
+    THROW_IF(!in, "cannot open " << manifest_path);
+
+    auto s = std::make_unique<SFHASH_HashsetShards>();
+    s->manifest = read_shard_manifest(in);
+    s->dir = std::filesystem::path(manifest_path).parent_path().string();
+    s->flags = flags;
+    s->shards.reset(new SFHASH_HashsetShards::Shard[s->manifest.shards.size()]);
+    return s.release();
+  }
+  catch (const std::exception& e) {
+    fill_error(err, std::string("failed to open shards: ") + e.what());
+    return nullptr;
+  }
+}
+
+void sfhash_destroy_hashset_shards(SFHASH_HashsetShards* shards) {
+  delete shards;
+}
+
+const SFHASH_Hashset& open_shard(const SFHASH_HashsetShards& s, size_t i) {
+  auto& shard = s.shards[i];
+
+  std::call_once(shard.opened, [&s, &shard, i]() {
+    const auto path = (std::filesystem::path(s.dir) / s.manifest.shards[i].path).string();
+
+    SFHASH_Error* err = nullptr;
+    auto hset = make_unique_del(
+      sfhash_open_hashset(path.c_str(), s.flags, &err),
+      sfhash_destroy_hashset
+    );
+
+    if (err) {
+      const std::string msg = err->message;
+      sfhash_free_error(err);
+      THROW(msg);
+    }
+
+    // the type indices are shared by every shard
+    check_hset_types(*hset, s.manifest.types, path);
+
+    shard.hset = std::move(hset);
+    ++s.open_count;
+  });
+
+  return *shard.hset;
+}
+
+size_t sfhash_hashset_shards_count(const SFHASH_HashsetShards* shards) {
+  return shards->manifest.shards.size();
+}
+
+size_t sfhash_hashset_shards_open_count(const SFHASH_HashsetShards* shards) {
+  return shards->open_count;
+}
+
+int sfhash_hashset_shards_index_for_type(
+  const SFHASH_HashsetShards* shards,
+  SFHASH_HashAlgorithm htype)
+{
+  const auto& types = shards->manifest.types;
+  const auto i = std::find_if(
+    types.begin(), types.end(),
+    [htype](const ManifestType& t) { return t.hash_type == htype; }
+  );
+
+  return i == types.end() ? -1 : i - types.begin();
+}
+
+int sfhash_hashset_shards_shard_for_hash(
+  const SFHASH_HashsetShards* shards,
+  size_t tidx,
+  const void* hash)
+{
+  return shard_for_prefix(
+    shards->manifest,
+    shard_prefix(
+      static_cast<const uint8_t*>(hash),
+      shards->manifest.types[tidx].hash_length
+    )
+  );
+}
+
+const SFHASH_Hashset* sfhash_hashset_shards_shard(
+  const SFHASH_HashsetShards* shards,
+  size_t i,
+  SFHASH_Error** err)
+{
+  try {
+    return &open_shard(*shards, i);
+  }
+  catch (const std::exception& e) {
+    fill_error(err, std::string("failed to open shard: ") + e.what());
+    return nullptr;
+  }
+}
+
+bool sfhash_hashset_shards_lookup(
+  const SFHASH_HashsetShards* shards,
+  size_t tidx,
+  const void* hash,
+  SFHASH_Error** err)
+{
+  try {
+    const int si = sfhash_hashset_shards_shard_for_hash(shards, tidx, hash);
+    return si != -1 &&
+      sfhash_hashset_lookup(&open_shard(*shards, si), tidx, hash);
+  }
+  catch (const std::exception& e) {
+    fill_error(err, std::string("failed to open shard: ") + e.what());
+    return false;
+  }
+}
+
+void shards_lookup_bulk(
+  const SFHASH_HashsetShards& shards,
+  size_t tidx,
+  const uint8_t* hashes,
+  size_t count,
+  bool* results)
+{
+  const size_t hlen = shards.manifest.types[tidx].hash_length;
+  const size_t n = shards.manifest.shards.size();
+
+  // Count the hashes for each shard, with those no shard covers last, and
+  // lay out each shard's batch contiguously, as a counting sort would.
+  std::vector<int> si(count);
+  std::vector<size_t> offsets(n + 2, 0);
+  for (size_t i = 0; i < count; ++i) {
+    si[i] = shard_for_prefix(shards.manifest, shard_prefix(hashes + i * hlen, hlen));
+    ++offsets[(si[i] == -1 ? n : si[i]) + 1];
+  }
+
+  // a batch all in one shard needs no gathering
+  for (size_t s = 0; s < n; ++s) {
+    if (offsets[s + 1] == count) {
+      sfhash_hashset_lookup_bulk(&open_shard(shards, s), tidx, hashes, count, results);
+      return;
+    }
+  }
+
+  std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+  std::vector<uint8_t> gathered(count * hlen);
+  std::vector<size_t> order(count);
+  {
+    std::vector<size_t> pos(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < count; ++i) {
+      const size_t j = pos[si[i] == -1 ? n : si[i]]++;
+      std::memcpy(gathered.data() + j * hlen, hashes + i * hlen, hlen);
+      order[j] = i;
+    }
+  }
+
+  std::unique_ptr<bool[]> gresults(new bool[count]);
+  std::fill(gresults.get() + offsets[n], gresults.get() + count, false);
+
+  for (size_t s = 0; s < n; ++s) {
+    if (offsets[s] < offsets[s + 1]) {
+      sfhash_hashset_lookup_bulk(
+        &open_shard(shards, s),
+        tidx,
+        gathered.data() + offsets[s] * hlen,
+        offsets[s + 1] - offsets[s],
+        gresults.get() + offsets[s]
+      );
+    }
+  }
+
+  for (size_t j = 0; j < count; ++j) {
+    results[order[j]] = gresults[j];
+  }
+}
+
+void sfhash_hashset_shards_lookup_bulk(
+  const SFHASH_HashsetShards* shards,
+  size_t tidx,
+  const void* hashes,
+  size_t hashes_length,
+  bool* results,
+  SFHASH_Error** err)
+{
+  try {
+    shards_lookup_bulk(
+      *shards, tidx, static_cast<const uint8_t*>(hashes), hashes_length, results
+    );
+  }
+  catch (const std::exception& e) {
+    fill_error(err, std::string("failed to open shard: ") + e.what());
+  }
+}
@@ -41,6 +41,28 @@ std::ostream& operator<<(std::ostream& out, const HashsetHint& hint) {
              << ' ' << hint.end;
 }
 
+size_t hint_data_length(uint16_t hint_type) {
+  const unsigned bits = hint_block_bits(hint_type);
+
+  switch (hint_kind(hint_type)) {
+  case HintType::BASIC:
+    return bits ? 0 : 2;
+  case HintType::RADIUS:
+    // u32 radius
+    return bits ? 0 : 2 + 4;
+  case HintType::RANGE:
+    // i64 left, i64 right
+    return bits ? 0 : 2 + 8 * 2;
+  case HintType::BLOCK:
+  case HintType::BLOCK_LINEAR:
+    // i64 lower, i64 upper; or f32 slope and intercept of each
+    return bits < MIN_HINT_BLOCK_BITS || bits > MAX_HINT_BLOCK_BITS ?
+      0 : 2 + (size_t(16) << bits);
+  default:
+    return 0;
+  }
+}
+
 std::ostream& operator<<(std::ostream& out, const HashsetFilter& filter) {
   return out << "FLTR\n"
              << ' ' << filter.filter_type << '\n'
@@ -48,6 +70,21 @@ std::ostream& operator<<(std::ostream& out, const HashsetFilter& filter) {
              << ' ' << filter.end;
 }
 
+std::ostream& operator<<(std::ostream& out, const HashsetIndex& hidx) {
+  return out << "HIDX\n"
+             << ' ' << hidx.index_type << '\n'
+             << ' ' << hidx.beg << '\n'
+             << ' ' << hidx.end;
+}
+
+std::ostream& operator<<(std::ostream& out, const ChunkChecksums& csum) {
+  return out << "CSUM\n"
+             << ' ' << csum.checksum_type << '\n'
+             << ' ' << csum.segment_length << '\n'
+             << ' ' << csum.beg << '\n'
+             << ' ' << csum.end;
+}
+
 template <class HDAT>
 std::ostream& out_hdat(std::ostream& out, const HDAT& hdat) {
   return out << "HDAT\n"
@@ -0,0 +1,250 @@
+#include "hashset/hset_verify.h"
+
+#include "error.h"
+#include "throw.h"
+#include "util.h"
+#include "hasher/hasher.h"
+#include "hashset/hset.h"
+#include "hashset/hset_decoder.h"
+#include "hashset/hset_encoder_chunks.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#include "vendors/BLAKE3/c/blake3.h"
+
+namespace {
+
+void digest_segment(const uint8_t* beg, const ChecksumSegment& seg, uint8_t* out) {
+  blake3_hasher hasher;
+  blake3_hasher_init(&hasher);
+  blake3_hasher_update(&hasher, beg + seg.off, seg.len);
+  blake3_hasher_finalize(&hasher, out, CSUM_DIGEST_LENGTH);
+}
+
+template <class Func>
+void for_each_segment(size_t count, unsigned threads, Func func) {
+  if (!threads) {
+    threads = std::thread::hardware_concurrency();
+  }
+
+  threads = std::clamp<size_t>(threads, 1, std::max<size_t>(count, 1));
+
+  // segments are handed out one at a time, as chunks vary greatly in size
+  std::atomic<size_t> next{0};
+
+  const auto work = [&next, count, &func]() {
+    for (size_t i; (i = next++) < count; ) {
+      func(i);
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (unsigned t = 1; t < threads; ++t) {
+    workers.emplace_back(work);
+  }
+
+  work();
+
+  for (auto& w: workers) {
+    w.join();
+  }
+}
+
+std::vector<bool> entries_for_hashset(const TableOfContents& ftoc, size_t tidx) {
+  std::vector<bool> sel(ftoc.entries.size());
+
+  int64_t cur = -1;
+  for (size_t i = 0; i < ftoc.entries.size(); ++i) {
+    const uint32_t type = ftoc.entries[i].second;
+
+    if ((type & 0xFFFF0000) == Chunk::HHDR) {
+      ++cur;
+    }
+    else if (type == Chunk::CSUM || type == Chunk::FEND) {
+      cur = -1;
+    }
+
+    // the headers are needed to make sense of anything else
+    sel[i] = type == Chunk::FTOC ||
+             type == Chunk::FHDR ||
+             type == Chunk::RHDR ||
+             cur == static_cast<int64_t>(tidx);
+  }
+
+  return sel;
+}
+
+uint64_t verify_csum(const Holder& h, int tidx, unsigned threads) {
+  auto segs = checksum_segments(h.ftoc, h.csum.segment_length);
+
+  if (tidx != -1) {
+    const auto sel = entries_for_hashset(h.ftoc, tidx);
+    segs.erase(
+      std::remove_if(
+        segs.begin(), segs.end(),
+        [&sel](const ChecksumSegment& s) { return !sel[s.entry]; }
+      ),
+      segs.end()
+    );
+  }
+
+  const size_t bad = verify_checksums(
+    h.beg, segs, static_cast<const uint8_t*>(h.csum.beg), threads
+  );
+
+  THROW_IF(
+    bad < segs.size(),
+    "checksum mismatch in "
+      << printable_chunk_type(h.ftoc.entries[segs[bad].entry].second)
+      << " chunk at offset " << segs[bad].off
+  );
+
+  uint64_t bytes = 0;
+  for (const auto& s: segs) {
+    bytes += s.len;
+  }
+  return bytes;
+}
+
+uint64_t verify_sha2_256(const Holder& h) {
+  // without a CSUM, there is only the hash over everything after it
+  const uint8_t* data = h.beg + length_magic() + length_hset_hash();
+
+  auto hasher = make_unique_del(
+    sfhash_create_hasher(SFHASH_SHA_2_256), sfhash_destroy_hasher
+  );
+
+  sfhash_update_hasher(hasher.get(), data, h.end);
+
+  SFHASH_HashValues hashes;
+  sfhash_get_hashes(hasher.get(), &hashes);
+
+  THROW_IF(
+    std::memcmp(hashes.Sha2_256, h.fhdr.sha2_256.data(), h.fhdr.sha2_256.size()),
+    "SHA2-256 mismatch"
+  );
+
+  return h.end - data;
+}
+
+}
+
+std::vector<ChecksumSegment> checksum_segments(
+  const TableOfContents& ftoc,
+  uint64_t segment_length)
+{
+  const auto& e = ftoc.entries;
+
+  const auto ci = std::find_if(
+    e.begin(), e.end(),
+    [](const auto& ent) { return ent.second == Chunk::CSUM; }
+  );
+
+  THROW_IF(ci == e.end(), "no CSUM chunk in FTOC");
+  THROW_IF(segment_length == 0, "CSUM segment length is 0");
+
+  std::vector<ChecksumSegment> segs;
+  for (size_t i = 0; e.begin() + i != ci; ++i) {
+    const uint64_t cbeg = e[i].first;
+    const uint64_t cend = e[i + 1].first;
+
+    THROW_IF(
+      cend < cbeg,
+      "FTOC entries out of order at " << printable_chunk_type(e[i].second)
+    );
+
+    uint64_t off = cbeg;
+    do {
+      const uint64_t len = std::min(segment_length, cend - off);
+      segs.push_back({ off, len, i, segs.size() });
+      off += len;
+    } while (off < cend);
+  }
+
+  return segs;
+}
+
+void compute_checksums(
+  const uint8_t* beg,
+  const std::vector<ChecksumSegment>& segs,
+  uint8_t* out,
+  unsigned threads)
+{
+  for_each_segment(segs.size(), threads, [&](size_t i) {
+    digest_segment(beg, segs[i], out + segs[i].digest * CSUM_DIGEST_LENGTH);
+  });
+}
+
+size_t verify_checksums(
+  const uint8_t* beg,
+  const std::vector<ChecksumSegment>& segs,
+  const uint8_t* digests,
+  unsigned threads)
+{
+  std::atomic<size_t> bad{segs.size()};
+
+  for_each_segment(segs.size(), threads, [&](size_t i) {
+    uint8_t d[CSUM_DIGEST_LENGTH];
+    digest_segment(beg, segs[i], d);
+
+    if (std::memcmp(d, digests + segs[i].digest * CSUM_DIGEST_LENGTH, sizeof(d))) {
+      // keep the first bad segment, so the report does not vary by thread
+      size_t cur = bad.load();
+      while (i < cur && !bad.compare_exchange_weak(cur, i)) {}
+    }
+  });
+
+  return bad;
+}
+
+void verify_hset(
+  const Holder& h,
+  int tidx,
+  unsigned threads,
+  SFHASH_HashsetVerifyStats* stats)
+{
+  const auto t0 = std::chrono::steady_clock::now();
+
+  const uint64_t bytes = h.csum.beg ?
+    verify_csum(h, tidx, threads) : verify_sha2_256(h);
+
+  const auto t1 = std::chrono::steady_clock::now();
+
+  if (stats) {
+    stats->bytes = bytes;
+    stats->seconds = std::chrono::duration<double>(t1 - t0).count();
+  }
+}
+
+void sfhash_hashset_verify(
+  const SFHASH_Hashset* hset,
+  unsigned int threads,
+  SFHASH_HashsetVerifyStats* stats,
+  SFHASH_Error** err)
+{
+  try {
+    verify_hset(hset->holder, -1, threads, stats);
+  }
+  catch (const std::exception& e) {
+    fill_error(err, std::string("failed to verify hset: ") + e.what());
+  }
+}
+
+void sfhash_hashset_verify_hashset(
+  const SFHASH_Hashset* hset,
+  size_t tidx,
+  unsigned int threads,
+  SFHASH_HashsetVerifyStats* stats,
+  SFHASH_Error** err)
+{
+  try {
+    verify_hset(hset->holder, static_cast<int>(tidx), threads, stats);
+  }
+  catch (const std::exception& e) {
+    fill_error(err, std::string("failed to verify hset: ") + e.what());
+  }
+}
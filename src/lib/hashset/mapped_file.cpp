@@ -0,0 +1,130 @@
+#include "hashset/mapped_file.h"
+
+#include "hasher/hashset.h"
+#include "throw.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <thread>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace bip = boost::interprocess;
+
+namespace {
+
+bip::map_options_t map_options(uint32_t flags) {
+#ifdef MAP_POPULATE
+  if (flags & SFHASH_HASHSET_OPEN_POPULATE) {
+    return MAP_POPULATE;
+  }
+#else
+  (void) flags;
+#endif
+  return bip::default_map_options;
+}
+
+size_t page_size() {
+#ifndef _WIN32
+  return sysconf(_SC_PAGESIZE);
+#else
+  return 4096;
+#endif
+}
+
+}
+
+MappedFile::MappedFile(const std::string& path, uint32_t flags):
+  File(path.c_str(), bip::read_only),
+  Region(File, bip::read_only, 0, 0, nullptr, map_options(flags))
+{
+  // advice is only advice; if it is not taken, lookups are just slower
+  if (flags & SFHASH_HASHSET_OPEN_RANDOM) {
+    Region.advise(bip::mapped_region::advice_random);
+  }
+
+  if (flags & SFHASH_HASHSET_OPEN_WILLNEED) {
+    Region.advise(bip::mapped_region::advice_willneed);
+  }
+
+#ifdef MADV_HUGEPAGE
+  if (flags & SFHASH_HASHSET_OPEN_HUGEPAGES) {
+    madvise(Region.get_address(), Region.get_size(), MADV_HUGEPAGE);
+  }
+#endif
+
+#ifndef _WIN32
+  // but a lock which was asked for and not granted is an error
+  if (flags & SFHASH_HASHSET_OPEN_LOCK) {
+    THROW_IF(
+      mlock(Region.get_address(), Region.get_size()),
+      "mlock failed: " << std::strerror(errno)
+    );
+  }
+#endif
+}
+
+void prefault_pages(
+  const std::vector<std::pair<const void*, const void*>>& ranges,
+  unsigned threads)
+{
+  const size_t psize = page_size();
+
+  // cut the ranges into pieces of about equal size, one per thread
+  size_t total = 0;
+  for (const auto& [beg, end]: ranges) {
+    total += static_cast<const uint8_t*>(end) - static_cast<const uint8_t*>(beg);
+  }
+
+  if (!total) {
+    return;
+  }
+
+  threads = std::clamp(threads, 1u, 256u);
+  const size_t share = (total + threads - 1) / threads;
+
+  std::vector<std::vector<std::pair<const uint8_t*, const uint8_t*>>> work(1);
+  size_t room = share;
+
+  for (const auto& [beg, end]: ranges) {
+    const uint8_t* b = static_cast<const uint8_t*>(beg);
+    const uint8_t* e = static_cast<const uint8_t*>(end);
+
+    while (b < e) {
+      if (!room) {
+        work.emplace_back();
+        room = share;
+      }
+
+      const size_t n = std::min<size_t>(room, e - b);
+      work.back().emplace_back(b, b + n);
+      b += n;
+      room -= n;
+    }
+  }
+
+  const auto touch = [psize](const std::vector<std::pair<const uint8_t*, const uint8_t*>>& pieces) {
+    for (const auto& [b, e]: pieces) {
+      // one read per page faults it in
+      for (const uint8_t* p = b; p < e; p += psize) {
+        *static_cast<const volatile uint8_t*>(p);
+      }
+      *static_cast<const volatile uint8_t*>(e - 1);
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (size_t i = 1; i < work.size(); ++i) {
+    workers.emplace_back(touch, std::cref(work[i]));
+  }
+
+  touch(work[0]);
+
+  for (auto& w: workers) {
+    w.join();
+  }
+}
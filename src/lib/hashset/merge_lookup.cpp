@@ -0,0 +1,46 @@
+#include "hashset/merge_lookup.h"
+
+#include <algorithm>
+
+MergeQuery* radix_sort_queries(
+  MergeQuery* queries,
+  MergeQuery* scratch,
+  size_t n,
+  unsigned lo,
+  unsigned hi)
+{
+  // count every pass's digits in one read of the queries
+  std::vector<std::array<size_t, 256>> counts(hi - lo);
+  for (auto& c: counts) {
+    c.fill(0);
+  }
+
+  for (size_t i = 0; i < n; ++i) {
+    for (unsigned d = lo; d < hi; ++d) {
+      ++counts[d - lo][(queries[i].prefix >> (8 * d)) & 0xFF];
+    }
+  }
+
+  for (unsigned d = lo; d < hi; ++d) {
+    auto& c = counts[d - lo];
+    if (std::find(c.begin(), c.end(), n) != c.end()) {
+      // every query has the same digit here
+      continue;
+    }
+
+    size_t sum = 0;
+    for (auto& x: c) {
+      const size_t cx = x;
+      x = sum;
+      sum += cx;
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+      scratch[c[(queries[i].prefix >> (8 * d)) & 0xFF]++] = queries[i];
+    }
+
+    std::swap(queries, scratch);
+  }
+
+  return queries;
+}
@@ -0,0 +1,210 @@
+#include "hashset/perfect_hash.h"
+
+#include "hashset/hash_compare.h"
+#include "rwutil.h"
+#include "throw.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+uint64_t perfect_hash_bucket_count(uint64_t key_count) {
+  // c = 7 in the PTHash paper's n * c / log2(n) keeps pilot search quick
+  // even with no spare slots; this is nondecreasing in key_count, so the
+  // count for an upper bound on the keys bounds the space needed
+  const double n = std::max<uint64_t>(key_count, 2);
+  return std::max<uint64_t>(2, std::ceil(7.0 * n / std::log2(n)));
+}
+
+uint64_t dense_bucket_count(uint64_t bucket_count) {
+  return std::max<uint64_t>(1, bucket_count * 3 / 10);
+}
+
+PerfectHash::PerfectHash():
+  Seed(0),
+  KeyCount(0),
+  BucketCount(0),
+  DenseBuckets(0),
+  Pilots(nullptr),
+  Positions(nullptr)
+{}
+
+PerfectHash::PerfectHash(
+  uint64_t seed,
+  uint64_t key_count,
+  uint64_t bucket_count
+):
+  Seed(seed),
+  KeyCount(key_count),
+  BucketCount(bucket_count),
+  DenseBuckets(dense_bucket_count(bucket_count)),
+  Pilots(nullptr),
+  Positions(nullptr)
+{}
+
+PerfectHash::PerfectHash(const void* beg, const void* end) {
+  const uint8_t* b = static_cast<const uint8_t*>(beg);
+  const uint8_t* e = static_cast<const uint8_t*>(end);
+  const uint8_t* cur = b;
+
+  Seed = read_le<uint64_t>(b, cur, e);
+  KeyCount = read_le<uint64_t>(b, cur, e);
+  BucketCount = read_le<uint64_t>(b, cur, e);
+
+  THROW_IF(
+    BucketCount < 2 || BucketCount > std::numeric_limits<uint32_t>::max(),
+    "bad perfect hash bucket count " << BucketCount
+  );
+
+  const uint64_t tlen = e - cur;
+  THROW_IF(
+    tlen % 4 || tlen / 4 != BucketCount + KeyCount,
+    "expected " << 4 * (BucketCount + KeyCount)
+                << " bytes of perfect hash tables, found " << tlen
+  );
+
+  DenseBuckets = dense_bucket_count(BucketCount);
+  Pilots = cur;
+  Positions = cur + 4 * BucketCount;
+}
+
+struct PerfectHashKey {
+  uint64_t bucket;
+  uint64_t hash;
+  uint32_t pos;
+};
+
+bool try_make_perfect_hash(
+  const uint8_t* beg,
+  size_t hash_length,
+  const std::vector<uint32_t>& firsts,
+  PerfectHashData& phd)
+{
+  const uint64_t n = phd.key_count;
+  const uint64_t bcount = phd.pilots.size();
+
+  const PerfectHash ph(phd.seed, n, bcount);
+
+  std::vector<PerfectHashKey> keys;
+  keys.reserve(n);
+
+  for (const uint32_t pos: firsts) {
+    const uint64_t h = perfect_hash_key(beg + pos * hash_length, hash_length, phd.seed);
+    keys.push_back({ ph.bucket(h), h, pos });
+  }
+
+  std::sort(
+    keys.begin(), keys.end(),
+    [](const PerfectHashKey& l, const PerfectHashKey& r) {
+      return l.bucket < r.bucket || (l.bucket == r.bucket && l.hash < r.hash);
+    }
+  );
+
+  // keys with the same hash in the same bucket can never be separated
+  if (std::adjacent_find(
+    keys.begin(), keys.end(),
+    [](const PerfectHashKey& l, const PerfectHashKey& r) {
+      return l.bucket == r.bucket && l.hash == r.hash;
+    }) != keys.end())
+  {
+    return false;
+  }
+
+  // find the start of each bucket
+  std::vector<uint64_t> bstart(bcount + 1, 0);
+  for (const auto& k: keys) {
+    ++bstart[k.bucket + 1];
+  }
+  std::partial_sum(bstart.begin(), bstart.end(), bstart.begin());
+
+  // place the largest buckets first, while there are many free slots
+  std::vector<uint32_t> order(bcount);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(
+    order.begin(), order.end(),
+    [&bstart](uint32_t l, uint32_t r) {
+      return bstart[l + 1] - bstart[l] > bstart[r + 1] - bstart[r];
+    }
+  );
+
+  std::vector<uint64_t> taken((n + 63) / 64, 0);
+  std::vector<uint64_t> slots;
+
+  for (const uint32_t b: order) {
+    const uint64_t kbeg = bstart[b], kend = bstart[b + 1];
+    if (kbeg == kend) {
+      // the remaining buckets are empty
+      break;
+    }
+
+    for (uint64_t pilot = 0; ; ++pilot) {
+      if (pilot > std::numeric_limits<uint32_t>::max()) {
+        return false;
+      }
+
+      slots.clear();
+      for (uint64_t k = kbeg; k < kend; ++k) {
+        const uint64_t s = ph.slot(keys[k].hash, pilot);
+        if ((taken[s / 64] >> (s % 64)) & 1 ||
+            std::find(slots.begin(), slots.end(), s) != slots.end())
+        {
+          break;
+        }
+        slots.push_back(s);
+      }
+
+      if (slots.size() == kend - kbeg) {
+        for (uint64_t k = kbeg; k < kend; ++k) {
+          const uint64_t s = slots[k - kbeg];
+          taken[s / 64] |= uint64_t(1) << (s % 64);
+          phd.positions[s] = keys[k].pos;
+        }
+        phd.pilots[b] = pilot;
+        break;
+      }
+    }
+  }
+
+  return true;
+}
+
+PerfectHashData make_perfect_hash(
+  const uint8_t* beg,
+  const uint8_t* end,
+  size_t hash_length)
+{
+  const uint64_t hash_count = (end - beg) / hash_length;
+
+  THROW_IF(
+    hash_count > std::numeric_limits<uint32_t>::max(),
+    "too many hashes for a perfect hash index: " << hash_count
+  );
+
+  // index only the first of each run of equal hashes
+  std::vector<uint32_t> firsts;
+  for (uint64_t i = 0; i < hash_count; ++i) {
+    if (i == 0 || hash_cmp(beg + (i - 1) * hash_length, beg + i * hash_length, hash_length)) {
+      firsts.push_back(i);
+    }
+  }
+
+  PerfectHashData phd{
+    0,
+    firsts.size(),
+    std::vector<uint32_t>(perfect_hash_bucket_count(firsts.size()), 0),
+    std::vector<uint32_t>(firsts.size(), 0)
+  };
+
+  // a failure means a 64-bit collision or a pathological pilot search;
+  // either is vanishingly unlikely to recur with a different seed
+  for (uint64_t attempt = 0; attempt < 16; ++attempt) {
+    phd.seed = perfect_hash_mix(0x5365744F48617368ull + attempt);
+    if (try_make_perfect_hash(beg, hash_length, firsts, phd)) {
+      return phd;
+    }
+    std::fill(phd.pilots.begin(), phd.pilots.end(), 0);
+  }
+
+  THROW("failed to build perfect hash index");
+}
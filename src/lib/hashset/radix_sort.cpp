@@ -0,0 +1,258 @@
+#include "hashset/radix_sort.h"
+
+#include "hashset/hash_compare.h"
+#include "hashset/record_iterator.h"
+#include "hashset/util.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <numeric>
+#include <vector>
+
+namespace {
+
+// Fewer strings than this are sorted by comparison
+constexpr size_t RADIX_SORT_MIN_COUNT = 1 << 12;
+
+// Fewer strings than this per thread are not worth a thread
+constexpr size_t RADIX_SORT_MIN_PER_THREAD = 1 << 16;
+
+using Counts = std::array<size_t, 256>;
+
+struct Strings {
+  uint8_t* data;
+  uint64_t* idx;
+  size_t len;
+
+  uint8_t* at(size_t i) const {
+    return data + i * len;
+  }
+
+  void swap(size_t i, size_t j) const {
+    swap_bytes(at(i), at(j), len);
+    if (idx) {
+      std::swap(idx[i], idx[j]);
+    }
+  }
+};
+
+template <size_t N>
+void sort_fixed(uint8_t* beg, size_t count) {
+  using Hash = std::array<uint8_t, N>;
+  Hash* hbeg = reinterpret_cast<Hash*>(beg);
+  std::sort(hbeg, hbeg + count, HashLess<N>());
+}
+
+void comparison_sort(const Strings& s, size_t beg, size_t count) {
+  if (s.idx) {
+    std::sort(
+      HashRecordIterator(beg, s.data, s.len, s.idx),
+      HashRecordIterator(beg + count, s.data, s.len, s.idx)
+    );
+    return;
+  }
+
+  uint8_t* b = s.at(beg);
+  switch (s.len) {
+  case 8:
+    return sort_fixed<8>(b, count);
+  case 16:
+    return sort_fixed<16>(b, count);
+  case 20:
+    return sort_fixed<20>(b, count);
+  case 28:
+    return sort_fixed<28>(b, count);
+  case 32:
+    return sort_fixed<32>(b, count);
+  case 48:
+    return sort_fixed<48>(b, count);
+  case 64:
+    return sort_fixed<64>(b, count);
+  default:
+    std::sort(
+      RecordIterator(b, s.len),
+      RecordIterator(s.at(beg + count), s.len)
+    );
+  }
+}
+
+void count_bytes(
+  const Strings& s,
+  size_t beg,
+  size_t end,
+  size_t depth,
+  Counts& counts)
+{
+  for (size_t i = beg; i < end; ++i) {
+    ++counts[s.at(i)[depth]];
+  }
+}
+
+// Permutes count strings from beg into buckets by their byte at depth,
+// American flag style; returns where each bucket starts, relative to beg
+std::array<size_t, 257> permute(
+  const Strings& s,
+  size_t beg,
+  size_t depth,
+  const Counts& counts)
+{
+  std::array<size_t, 257> start;
+  start[0] = 0;
+  std::partial_sum(counts.begin(), counts.end(), start.begin() + 1);
+
+  std::array<size_t, 256> next;
+  std::copy(start.begin(), start.end() - 1, next.begin());
+
+  for (unsigned b = 0; b < 256; ++b) {
+    while (next[b] < start[b + 1]) {
+      const uint8_t c = s.at(beg + next[b])[depth];
+      if (c == b) {
+        ++next[b];
+      }
+      else {
+        s.swap(beg + next[b], beg + next[c]++);
+      }
+    }
+  }
+
+  return start;
+}
+
+void sort_bucket(const Strings& s, size_t beg, size_t count, size_t depth) {
+  while (count >= RADIX_SORT_MIN_COUNT && depth < s.len) {
+    Counts counts{};
+    count_bytes(s, beg, beg + count, depth, counts);
+
+    // a byte shared by every string does not split them
+    if (std::find(counts.begin(), counts.end(), count) != counts.end()) {
+      ++depth;
+      continue;
+    }
+
+    const auto start = permute(s, beg, depth, counts);
+    for (unsigned b = 0; b < 256; ++b) {
+      if (counts[b] > 1) {
+        sort_bucket(s, beg + start[b], counts[b], depth + 1);
+      }
+    }
+    return;
+  }
+
+  // strings equal to the end need sorting only by idx
+  if (count > 1 && (depth < s.len || s.idx)) {
+    comparison_sort(s, beg, count);
+  }
+}
+
+// Drops duplicates from count sorted strings; returns the number kept
+size_t unique_bucket(const Strings& s, size_t beg, size_t count) {
+  size_t k = std::min<size_t>(count, 1);
+  for (size_t i = 1; i < count; ++i) {
+    if (hash_cmp(s.at(beg + i), s.at(beg + k - 1), s.len)) {
+      if (k != i) {
+        std::memcpy(s.at(beg + k), s.at(beg + i), s.len);
+      }
+      ++k;
+    }
+  }
+  return k;
+}
+
+size_t sort_strings(const Strings& s, size_t count, unsigned threads, bool unique) {
+  threads = threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+  threads = std::clamp<size_t>(
+    threads, 1, std::max<size_t>(1, count / RADIX_SORT_MIN_PER_THREAD)
+  );
+
+  // each thread counts a contiguous slice
+  const auto slice = [count, threads](unsigned k) {
+    return count / threads * k + std::min<size_t>(k, count % threads);
+  };
+
+  // the first byte which splits the strings
+  size_t depth = 0;
+  Counts counts{};
+  for ( ; depth < s.len && count >= RADIX_SORT_MIN_COUNT; ++depth) {
+    std::vector<Counts> tcounts(threads, Counts{});
+    run_on_threads(threads, [&](unsigned k) {
+      count_bytes(s, slice(k), slice(k + 1), depth, tcounts[k]);
+    });
+
+    counts.fill(0);
+    for (const auto& tc: tcounts) {
+      for (unsigned b = 0; b < 256; ++b) {
+        counts[b] += tc[b];
+      }
+    }
+
+    if (std::find(counts.begin(), counts.end(), count) == counts.end()) {
+      break;
+    }
+  }
+
+  if (depth == s.len || count < RADIX_SORT_MIN_COUNT) {
+    sort_bucket(s, 0, count, depth);
+    return unique ? unique_bucket(s, 0, count) : count;
+  }
+
+  const auto start = permute(s, 0, depth, counts);
+
+  // hand out the buckets, largest first
+  std::array<unsigned, 256> order;
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(
+    order.begin(), order.end(),
+    [&counts](unsigned l, unsigned r) { return counts[l] > counts[r]; }
+  );
+
+  Counts kept = counts;
+  std::atomic<unsigned> next{0};
+
+  run_on_threads(threads, [&](unsigned) {
+    for (unsigned i; (i = next++) < 256; ) {
+      const unsigned b = order[i];
+      sort_bucket(s, start[b], counts[b], depth + 1);
+      if (unique) {
+        kept[b] = unique_bucket(s, start[b], counts[b]);
+      }
+    }
+  });
+
+  if (!unique) {
+    return count;
+  }
+
+  // close the gaps left by the duplicates
+  size_t out = 0;
+  for (unsigned b = 0; b < 256; ++b) {
+    if (out != start[b]) {
+      std::memmove(s.at(out), s.at(start[b]), kept[b] * s.len);
+    }
+    out += kept[b];
+  }
+
+  return out;
+}
+
+}
+
+void radix_sort(
+  uint8_t* data,
+  uint64_t* idx,
+  size_t count,
+  size_t len,
+  unsigned threads)
+{
+  sort_strings({ data, idx, len }, count, threads, false);
+}
+
+size_t radix_sort_unique(
+  uint8_t* data,
+  size_t count,
+  size_t len,
+  unsigned threads)
+{
+  return sort_strings({ data, nullptr, len }, count, threads, true);
+}
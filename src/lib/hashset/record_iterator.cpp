@@ -1,18 +1,19 @@
 #include "hashset/record_iterator.h"
 
 #include "hex.h"
+#include "hashset/util.h"
 
+#include <algorithm>
+#include <array>
 #include <cstring>
 #include <memory>
+#include <utility>
 
 #include <iostream>
 
 void swap_em(RecordProxy& a, RecordProxy& b) {
 //  std::cerr << "swap_em " << to_hex(a.rec) << " <=> " << to_hex(b.rec) << '\n';
-  std::unique_ptr<uint8_t[]> tmp(new uint8_t[a.rec.size()]);
-  std::memcpy(tmp.get(), a.rec.data(), a.rec.size());
-  std::memcpy(a.rec.data(), b.rec.data(), a.rec.size());
-  std::memcpy(b.rec.data(), tmp.get(), a.rec.size());
+  swap_bytes(a.rec.data(), b.rec.data(), a.rec.size());
 }
 
 void swap(RecordProxy a, RecordProxy b) {
@@ -53,10 +54,8 @@ std::ostream& operator<<(std::ostream& out, const RecordIterator& i) {
 
 void swap_em(HashRecordProxy& a, HashRecordProxy& b) {
 //  std::cerr << "swap_em " << to_hex(a.rec) << " <=> " << to_hex(b.rec) << '\n';
-  std::unique_ptr<uint8_t[]> tmp(new uint8_t[a.rec.size()]);
-  std::memcpy(tmp.get(), a.rec.data(), a.rec.size());
-  std::memcpy(a.rec.data(), b.rec.data(), a.rec.size());
-  std::memcpy(b.rec.data(), tmp.get(), a.rec.size());
+  swap_bytes(a.rec.data(), b.rec.data(), a.rec.size());
+  std::swap(*a.idx, *b.idx);
 }
 
 void swap(HashRecordProxy a, HashRecordProxy b) {
@@ -86,3 +85,26 @@ void swap(HashRecordProxy& a, HashRecordProxy& b) {
 std::ostream& operator<<(std::ostream& out, const HashRecordProxy& r) {
   return out << to_hex(r.rec);
 }
+
+template <size_t HashLength>
+struct SortUniqueHashes {
+  uint8_t* operator()(uint8_t* beg, uint8_t* end) const {
+    using Hash = std::array<uint8_t, HashLength>;
+    Hash* hbeg = reinterpret_cast<Hash*>(beg);
+    Hash* hend = reinterpret_cast<Hash*>(end);
+
+    std::sort(hbeg, hend, HashLess<HashLength>());
+    hend = std::unique(
+      hbeg, hend,
+      [](const Hash& l, const Hash& r) {
+        return hash_eq<HashLength>(l.data(), r.data());
+      }
+    );
+
+    return reinterpret_cast<uint8_t*>(hend);
+  }
+};
+
+uint8_t* sort_unique_hashes(uint8_t* beg, uint8_t* end, size_t hash_length) {
+  return hashset_dispatcher<SortUniqueHashes>(hash_length, beg, end);
+}
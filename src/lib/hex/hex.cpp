@@ -3,6 +3,8 @@
 
 #include "hasher/hex.h"
 
+#include <array>
+
 #if defined(HAVE_FUNC_ATTRIBUTE_IFUNC) && defined(HAVE_FUNC_ATTRIBUTE_TARGET)
 
 __attribute__((target("default")))
@@ -85,10 +87,35 @@ uint8_t char_to_nibble(char c) {
   }
 }
 
+// The values of the hex digits, and 0x10 for every other char
+constexpr std::array<uint8_t, 256> make_nibble_table() {
+  std::array<uint8_t, 256> t{};
+  for (unsigned c = 0; c < 256; ++c) {
+    t[c] = '0' <= c && c <= '9' ? c - '0' :
+           'A' <= c && c <= 'F' ? c - 'A' + 10 :
+           'a' <= c && c <= 'f' ? c - 'a' + 10 : 0x10;
+  }
+  return t;
+}
+
+constexpr std::array<uint8_t, 256> NIBBLES = make_nibble_table();
+
 void from_hex(uint8_t* dst, const char* src, size_t dlen) {
   const char* const end = src + 2*dlen;
   for (; src != end; ++dst, src += 2) {
-    *dst = (char_to_nibble(*src) << 4) | char_to_nibble(*(src + 1));
+    // a bad char, or the end of a short string, throws before the next
+    // is read
+    const uint8_t hi = NIBBLES[static_cast<uint8_t>(src[0])];
+    if (hi & 0x10) {
+      char_to_nibble(src[0]);
+    }
+
+    const uint8_t lo = NIBBLES[static_cast<uint8_t>(src[1])];
+    if (lo & 0x10) {
+      char_to_nibble(src[1]);
+    }
+
+    *dst = (hi << 4) | lo;
   }
 }
 
@@ -20,7 +20,6 @@ for i in NSRLFile.*.txt.gz ; do zcat $i | ./nsrldump.py ; done | mkhashset 'NSRL
 #include <cstring>
 #include <exception>
 #include <filesystem>
-#include <fstream>
 #include <iostream>
 #include <vector>
 
@@ -29,8 +28,27 @@ for i in NSRLFile.*.txt.gz ; do zcat $i | ./nsrldump.py ; done | mkhashset 'NSRL
 #include "hashset/hset_encoder.h"
 
 int main(int argc, char** argv) {
-  if (argc < 7) {
-    std::cerr << "Usage: mkhashset NAME DESC TYPE... RECORDS HASHSETS INFILE OUTIFLE" << std::endl;
+  // leading options
+  int a = 1;
+  uint32_t flags = 0;
+  for ( ; a < argc && !std::strncmp(argv[a], "--", 2); ++a) {
+    if (!std::strcmp(argv[a], "--perfect-hash")) {
+      flags |= SFHASH_HASHSET_BUILD_PERFECT_HASH;
+    }
+    else if (!std::strcmp(argv[a], "--checksums")) {
+      flags |= SFHASH_HASHSET_BUILD_CHECKSUMS;
+    }
+    else if (!std::strcmp(argv[a], "--compressed")) {
+      flags |= SFHASH_HASHSET_BUILD_COMPRESSED;
+    }
+    else {
+      std::cerr << "Error: unrecognized option '" << argv[a] << "'" << std::endl;
+      return -1;
+    }
+  }
+
+  if (argc - a < 6) {
+    std::cerr << "Usage: mkhashset [--perfect-hash] [--checksums] [--compressed] NAME DESC TYPE... RECORDS HASHSETS INFILE OUTIFLE" << std::endl;
     return -1;
   }
 
@@ -39,7 +57,7 @@ int main(int argc, char** argv) {
     std::ios_base::sync_with_stdio(false);
 
     std::vector<SFHASH_HashAlgorithm> htypes;
-    for (int i = 3; i < argc - 4; ++i) {
+    for (int i = a + 2; i < argc - 4; ++i) {
       const SFHASH_HashAlgorithm t = sfhash_hash_type(argv[i]);
       THROW_IF(
         t == SFHASH_INVALID,
@@ -59,9 +77,8 @@ int main(int argc, char** argv) {
     const std::filesystem::path outfile = argv[argc-1];
     const std::filesystem::path infile = argv[argc-2];
     const std::filesystem::path tmpdir = ".";
-    std::ifstream in(infile);
 
-    write_hset(in, htypes, conv, argv[1], argv[2], outfile, tmpdir, with_records, with_hashsets);
+    write_hset(infile, htypes, conv, argv[a], argv[a+1], outfile, tmpdir, with_records, with_hashsets, flags);
   }
   catch (const std::exception& e) {
     std::cerr << "Error: " << e.what() << std::endl;
@@ -7,28 +7,42 @@
 #include "hex.h"
 #include "throw.h"
 #include "util.h"
-#include "hashset/convex_hull.h"
+#include "hashset/compressed_hashes.h"
+#include "hashset/compressed_ls.h"
+#include "hashset/hash_compare.h"
 #include "hashset/hset.h"
 #include "hashset/hset_decoder.h"
+#include "hashset/hset_encoder_chunks.h"
+#include "hashset/hset_group.h"
 #include "hashset/lookupstrategy.h"
+#include "hashset/merge_lookup.h"
+#include "hashset/partitioned_lookup.h"
 #include "hashset/basic_ls.h"
 #include "hashset/block_ls.h"
 #include "hashset/block_linear_ls.h"
+#include "hashset/perfect_hash.h"
+#include "hashset/perfect_hash_ls.h"
+#include "hashset/radix_sort.h"
 #include "hashset/radius_ls.h"
 #include "hashset/range_ls.h"
+#include "hashset/record_iterator.h"
 
 #include <algorithm>
 #include <array>
+#include <chrono>
 #include <cmath>
 #include <cstring>
 #include <iomanip>
 #include <iostream>
 #include <filesystem>
 #include <fstream>
+#include <functional>
 #include <limits>
 #include <map>
+#include <numeric>
 #include <random>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -166,147 +180,6 @@ std::pair<int64_t, int64_t> make_left_right(const ConstHashsetData& hsd) {
   return { left, right };
 }
 
-template <class T>
-double distance(const Point<T>& p, double a, double b) {
-  return std::abs(b + a * p.x - p.y) / std::sqrt(1 + a * a);
-}
-
-//std::pair<double, double> least_upper_bound(const std::vector<Point>& pts) {
-template <class T>
-std::pair<float, float> least_upper_bound(const std::vector<Point<T>>& pts) {
-
-  float min_err = std::numeric_limits<float>::max();
-  float best_a = 0.0;
-  float best_b = 0.0;
-
-  // check each segment for best fit
-
-  for (auto j = 1u; j < pts.size(); ++j) {
-    auto i = j - 1;
-
-    const float a = float(pts[j].y - pts[i].y) / (pts[j].x - pts[i].x);
-    const float b = pts[j].y - a * pts[j].x;
-
-    float err = 0.0;
-    for (auto k = 0u; k < pts.size(); ++k) {
-      const auto d = distance(pts[k], a, b);
-      err += d * d;
-    }
-
-    if (err < min_err) {
-      best_a = a;
-      best_b = b;
-      min_err = err;
-    }
-  }
-
-  return { best_a, best_b };
-}
-
-//std::pair<double, double> greatest_lower_bound(const std::vector<Point>& pts) {
-template <class T>
-std::pair<float, float> greatest_lower_bound(const std::vector<Point<T>>& pts) {
-  float min_err = std::numeric_limits<double>::max();
-  float best_a = 0.0;
-  float best_b = 0.0;
-
-  // check each segment for best fit
-
-  for (auto j = 1u; j < pts.size(); ++j) {
-    auto i = j - 1;
-
-    const float a = double(pts[j].y - pts[i].y) / (pts[j].x - pts[i].x);
-    const float b = pts[j].y - a * pts[j].x;
-
-    float err = 0.0;
-    for (auto k = 0u; k < pts.size(); ++k) {
-      const auto d = distance(pts[k], a, b);
-      err += d * d;
-    }
-
-    if (err < min_err) {
-      best_a = a;
-      best_b = b;
-      min_err = err;
-    }
-  }
-
-  return { best_a, best_b };
-}
-
-//std::tuple<double, double, double, double> make_linear_bounds(const std::vector<Point> pts, size_t active_bucket) {
-template <class T>
-std::tuple<float, float, float, float> make_linear_bounds(const std::vector<Point<T>> pts, size_t active_bucket) {
-  const auto uch = upper_ch(pts);
-  const auto lch = lower_ch(pts);
-
-/*
-  std::cout << "uch " << active_bucket << '\n';
-  for (const auto& p: uch) {
-    std::cout << p << '\n';
-  }
-  std::cout << '\n';
-*/
-  const auto ub = least_upper_bound(uch);
-//  std::cout << ub.first << ' ' << ub.second << "\n\n";
-
-/*
-  std::cout << "lch " << active_bucket << '\n';
-  for (const auto& p: lch) {
-    std::cout << p << '\n';
-  }
-  std::cout << '\n';
-*/
-
-  const auto lb = greatest_lower_bound(lch);
-//  std::cout << lb.first << ' ' << lb.second << "\n\n";
-
-  return { lb.first, lb.second, ub.first, ub.second };
-}
-
-template <
-  size_t HashLength,
-  size_t BucketBits
->
-//std::array<std::tuple<double, double, double, double>, (1 << BucketBits)> make_linear_bounds(const ConstHashsetData& hsd) {
-std::array<std::tuple<float, float, float, float>, (1 << BucketBits)> make_linear_bounds(const ConstHashsetData& hsd) {
-
-//  std::array<std::tuple<double, double, double, double>, (1 << BucketBits)> coef;
-  std::array<std::tuple<float, float, float, float>, (1 << BucketBits)> coef;
-
-  const uint8_t* const beg = static_cast<const uint8_t*>(hsd.beg);
-  const uint8_t* const end = static_cast<const uint8_t*>(hsd.end);
-
-  const std::array<uint8_t, HashLength>* hh = reinterpret_cast<const std::array<uint8_t, HashLength>*>(beg);
-
-  const size_t count = (end - beg) / HashLength;
-
-  std::vector<Point<int64_t>> pts;
-  size_t active_bucket = 0;
-
-  for (size_t i = 0; i < count; ++i) {
-    const size_t e = expected_index(hh[i].data(), count);
-    const int64_t delta = static_cast<int64_t>(i) - static_cast<int64_t>(e);
-
-    const size_t bi = hh[i][0] >> (8 - BucketBits);
-    if (bi > active_bucket) {
-      // close the bucket
-      coef[active_bucket] = make_linear_bounds(pts, active_bucket);
-      pts.clear();
-      active_bucket = bi;
-    }
-
-    pts.emplace_back(e, delta);
-  }
-
-  if (!pts.empty()) {
-    // close the last bucket
-    coef[active_bucket] = make_linear_bounds(pts, active_bucket);
-  }
-
-  return coef;
-}
-
 template <
   size_t HashLength,
   size_t BucketBits
@@ -400,7 +273,11 @@ auto make_block_linear_ls(const ConstHashsetData& hsd) {
     std::make_unique<BlockLinearLookupStrategy<HashLength, BucketBits>>(
       hsd.beg,
       hsd.end,
-      make_linear_bounds<HashLength, BucketBits>(hsd)
+      make_linear_blocks<BucketBits>(
+        static_cast<const uint8_t*>(hsd.beg),
+        (static_cast<const uint8_t*>(hsd.end) - static_cast<const uint8_t*>(hsd.beg)) / HashLength,
+        HashLength
+      )
     )
   };
 }
@@ -587,6 +464,63 @@ TEST_CASE("MmapLookupBenchNSRL") {
   do_bench<SFHASH_SHA_1, MmapHolder>(NSRL, make_oom_sequence(0, 6), cases);
 }
 
+// Run with a cold page cache (echo 3 > /proc/sys/vm/drop_caches) to see
+// the difference the open flags make.
+template <SFHASH_HashAlgorithm HType>
+void bench_open(const std::filesystem::path& p) {
+  constexpr size_t HashLength = HashTraits<HType>::length;
+
+  const std::pair<const char*, uint32_t> flag_sets[] = {
+    { "none", 0 },
+    { "populate", SFHASH_HASHSET_OPEN_POPULATE },
+    { "willneed", SFHASH_HASHSET_OPEN_WILLNEED },
+    { "random", SFHASH_HASHSET_OPEN_RANDOM },
+    { "prefault", SFHASH_HASHSET_OPEN_PREFAULT },
+    { "hugepages+prefault", SFHASH_HASHSET_OPEN_HUGEPAGES | SFHASH_HASHSET_OPEN_PREFAULT }
+  };
+
+  RNG rng;
+  const auto hashes = make_random_hashes<HashLength>(rng, 1000000);
+
+  for (const auto& [name, flags]: flag_sets) {
+    SFHASH_Error* err = nullptr;
+
+    const auto t0 = std::chrono::steady_clock::now();
+    const auto hset = make_unique_del(
+      sfhash_open_hashset(p.string().c_str(), flags, &err),
+      sfhash_destroy_hashset
+    );
+    const auto t1 = std::chrono::steady_clock::now();
+
+    THROW_IF(err, err->message);
+
+    const auto tidx = sfhash_hashset_index_for_type(hset.get(), HType);
+
+    size_t hits = 0;
+    for (const auto& h: hashes) {
+      hits += sfhash_hashset_lookup(hset.get(), tidx, h.data());
+    }
+    const auto t2 = std::chrono::steady_clock::now();
+
+    std::cout << p.filename().string() << " " << name << ": "
+              << std::chrono::duration<double, std::milli>(t1 - t0).count()
+              << " ms to open ("
+              << 1000 * sfhash_hashset_warm_time(hset.get())
+              << " ms warming), "
+              << std::chrono::duration<double, std::milli>(t2 - t1).count()
+              << " ms for " << hashes.size() << " lookups ("
+              << hits << " hits)\n";
+  }
+}
+
+TEST_CASE("OpenBenchVS") {
+  bench_open<SFHASH_MD5>(VS);
+}
+
+TEST_CASE("OpenBenchNSRL") {
+  bench_open<SFHASH_SHA_1>(NSRL);
+}
+
 TEST_CASE("MemoryLookupBenchVS") {
   const auto cases = make_std_ls_cases<SFHASH_MD5>();
   do_bench<SFHASH_MD5, MemoryHolder>(VS, make_oom_sequence(0, 6), cases);
@@ -597,6 +531,620 @@ TEST_CASE("MemoryLookupBenchNSRL") {
   do_bench<SFHASH_SHA_1, MemoryHolder>(NSRL, make_oom_sequence(0, 6), cases);
 }
 
+template <size_t HashLength>
+void bench_perfect_hash(size_t count) {
+  RNG rng;
+
+  auto hashes = make_random_hashes<HashLength>(rng, count);
+  std::sort(hashes.begin(), hashes.end());
+
+  const uint8_t* beg = hashes.front().data();
+  const uint8_t* end = beg + count * HashLength;
+
+  const auto t0 = std::chrono::steady_clock::now();
+  const PerfectHashData phd = make_perfect_hash(beg, end, HashLength);
+  const auto t1 = std::chrono::steady_clock::now();
+
+  std::vector<char> hidx(length_hidx_data(count));
+  hidx.resize(write_hidx_data(phd, hidx.data()));
+
+  std::cout << HashLength << " x " << count << " perfect hash: "
+            << std::chrono::duration<double, std::milli>(t1 - t0).count()
+            << " ms to build, "
+            << (8.0 * hidx.size() / count) << " bits/key\n";
+
+  const ConstHashsetData hsd{beg, end};
+  const std::string n = std::to_string(count);
+
+  std::vector<std::pair<std::string, std::unique_ptr<LookupStrategy>>> strats;
+  strats.emplace_back(
+    "perfect/" + n,
+    std::make_unique<PerfectHashLookupStrategy<HashLength>>(
+      beg, end, PerfectHash(hidx.data() + 2, hidx.data() + hidx.size())
+    )
+  );
+  strats.emplace_back("bconst256/" + n, make_block_const_ls<HashLength, 8>(hsd));
+  strats.emplace_back("basic/" + n, make_basic_ls<HashLength>(hsd));
+
+  // half hits, half (almost certain) misses
+  auto queries = make_random_hashes<HashLength>(rng, 100000);
+  for (size_t i = 0; i < queries.size(); i += 2) {
+    queries[i] = hashes[rng() % count];
+  }
+
+  do_some_lookups(strats, queries);
+}
+
+TEST_CASE("PerfectHashBench") {
+  for (size_t count: make_oom_sequence(5, 8)) {
+    bench_perfect_hash<16>(count);
+    bench_perfect_hash<20>(count);
+  }
+}
+
+template <size_t HashLength>
+void bench_bulk_lookup(size_t count) {
+  RNG rng;
+
+  auto hashes = make_random_hashes<HashLength>(rng, count);
+  std::sort(hashes.begin(), hashes.end());
+
+  const ConstHashsetData hsd{hashes.data(), hashes.data() + hashes.size()};
+  const std::string n = std::to_string(count);
+
+  std::vector<std::pair<std::string, std::unique_ptr<LookupStrategy>>> strats;
+  strats.emplace_back("bconst256/" + n, make_block_const_ls<HashLength, 8>(hsd));
+  strats.emplace_back("basic/" + n, make_basic_ls<HashLength>(hsd));
+
+  // half hits, half (almost certain) misses
+  auto queries = make_random_hashes<HashLength>(rng, 100000);
+  for (size_t i = 0; i < queries.size(); i += 2) {
+    queries[i] = hashes[rng() % count];
+  }
+
+  std::unique_ptr<bool[]> results(new bool[queries.size()]);
+
+  for (const auto& [name, ls]: strats) {
+    const std::string tag = std::to_string(HashLength) + " x " + std::to_string(queries.size());
+
+    BENCHMARK(tag + " " + name + " one at a time") {
+      return lookup_func(queries, *ls);
+    };
+
+    // as through sfhash_hashset_lookup_handle
+    const LookupFunctions f = ls->functions();
+    BENCHMARK(tag + " " + name + " one at a time, typed") {
+      size_t hits = 0;
+      for (const auto& q: queries) {
+        hits += f.contains(ls.get(), q.data());
+      }
+      return hits;
+    };
+
+    BENCHMARK(tag + " " + name + " bulk") {
+      ls->contains_bulk(queries.front().data(), queries.size(), results.get());
+      return results[0];
+    };
+  }
+}
+
+TEST_CASE("BulkLookupBench") {
+  for (size_t count: make_oom_sequence(5, 8)) {
+    bench_bulk_lookup<16>(count);
+    bench_bulk_lookup<20>(count);
+  }
+}
+
+void bench_record_sort(size_t count) {
+  RNG rng;
+
+  // md5, sha1, and size records, as the builder sorts them; each run sorts
+  // a fresh copy, so the copy is in the times
+  const size_t rlen = 17 + 21 + 9;
+  std::vector<uint8_t> recs(count * rlen);
+  for (auto& b: recs) {
+    b = rng();
+  }
+
+  const auto hashes = make_random_hashes<20>(rng, count);
+  const uint8_t* hb = hashes.front().data();
+  const uint8_t* he = hb + hashes.size() * 20;
+
+  const std::string tag = std::to_string(count) + " ";
+  std::vector<uint8_t> buf;
+
+  BENCHMARK(tag + "records, RecordIterator") {
+    buf.assign(recs.begin(), recs.end());
+    std::sort(
+      RecordIterator(buf.data(), rlen),
+      RecordIterator(buf.data() + buf.size(), rlen)
+    );
+    return buf[0];
+  };
+
+  BENCHMARK(tag + "records, radix_sort_unique") {
+    buf.assign(recs.begin(), recs.end());
+    return radix_sort_unique(buf.data(), count, rlen, 0);
+  };
+
+  BENCHMARK(tag + "sha1s, RecordIterator") {
+    buf.assign(hb, he);
+    RecordIterator beg(buf.data(), 20);
+    RecordIterator end(buf.data() + buf.size(), 20);
+    std::sort(beg, end);
+    return std::unique(beg, end) - beg;
+  };
+
+  BENCHMARK(tag + "sha1s, sort_unique_hashes") {
+    buf.assign(hb, he);
+    return sort_unique_hashes(buf.data(), buf.data() + buf.size(), 20) - buf.data();
+  };
+
+  BENCHMARK(tag + "sha1s, radix_sort_unique") {
+    buf.assign(hb, he);
+    return radix_sort_unique(buf.data(), count, 20, 0);
+  };
+}
+
+TEST_CASE("RecordSortBench") {
+  for (size_t count: make_oom_sequence(4, 7)) {
+    bench_record_sort(count);
+  }
+}
+
+template <size_t HashLength>
+void bench_linear_hint(size_t count) {
+  RNG rng;
+
+  auto hashes = make_random_hashes<HashLength>(rng, count);
+  std::sort(hashes.begin(), hashes.end());
+
+  const ConstHashsetData hsd{hashes.data(), hashes.data() + hashes.size()};
+  const std::string n = std::to_string(count);
+
+  const BlockLookupStrategy<HashLength, 8> bls(
+    hsd.beg, hsd.end, make_const_bounds<HashLength, 8>(hsd)
+  );
+
+  const BlockLinearLookupStrategy<HashLength, 8> lls(
+    hsd.beg, hsd.end,
+    make_linear_blocks<8>(hashes.front().data(), hashes.size(), HashLength)
+  );
+
+  // half hits, half (almost certain) misses
+  auto queries = make_random_hashes<HashLength>(rng, 100000);
+  for (size_t i = 0; i < queries.size(); i += 2) {
+    queries[i] = hashes[rng() % count];
+  }
+
+  double bw = 0.0, lw = 0.0;
+  for (const auto& q: queries) {
+    const auto [bl, br] = bls.window(q.data());
+    const auto [ll, lr] = lls.window(q.data());
+    bw += br - bl;
+    lw += lr - ll;
+  }
+
+  std::cout << HashLength << " x " << count << " mean window: "
+            << "bconst256 " << bw / queries.size() << ", "
+            << "blinear256 " << lw / queries.size() << '\n';
+
+  const std::pair<std::string, const LookupStrategy*> strats[] = {
+    { "bconst256/" + n, &bls },
+    { "blinear256/" + n, &lls }
+  };
+
+  std::unique_ptr<bool[]> results(new bool[queries.size()]);
+
+  for (const auto& [name, ls]: strats) {
+    const std::string tag = std::to_string(HashLength) + " x " + std::to_string(queries.size());
+
+    BENCHMARK(tag + " " + name + " one at a time") {
+      return lookup_func(queries, *ls);
+    };
+
+    BENCHMARK(tag + " " + name + " bulk") {
+      ls->contains_bulk(queries.front().data(), queries.size(), results.get());
+      return results[0];
+    };
+  }
+}
+
+TEST_CASE("LinearHintBench") {
+  for (size_t count: make_oom_sequence(5, 8)) {
+    bench_linear_hint<16>(count);
+    bench_linear_hint<20>(count);
+  }
+}
+
+template <size_t HashLength>
+void bench_compressed(size_t count) {
+  RNG rng;
+
+  auto hashes = make_random_hashes<HashLength>(rng, count);
+  std::sort(hashes.begin(), hashes.end());
+  hashes.erase(std::unique(hashes.begin(), hashes.end()), hashes.end());
+
+  const uint8_t* beg = hashes.front().data();
+  const uint8_t* end = beg + hashes.size() * HashLength;
+
+  std::vector<uint8_t> hdac(compressed_length(hashes.size(), HashLength));
+  const auto t0 = std::chrono::steady_clock::now();
+  write_compressed(beg, hashes.size(), HashLength, hdac.data());
+  const auto t1 = std::chrono::steady_clock::now();
+
+  const CompressedHashes ch(
+    hdac.data(), hdac.data() + hdac.size(), HashLength, hashes.size()
+  );
+
+  std::cout << HashLength << " x " << count << " compressed: "
+            << std::chrono::duration<double, std::milli>(t1 - t0).count()
+            << " ms to build, "
+            << (8.0 * hdac.size() / hashes.size()) << " bits/key, "
+            << (100.0 * hdac.size() / (end - beg)) << "% of HDAT, "
+            << ch.prefix_bytes() << " prefix bytes\n";
+
+  const ConstHashsetData hsd{beg, end};
+  const std::string n = std::to_string(count);
+
+  std::vector<std::pair<std::string, std::unique_ptr<LookupStrategy>>> strats;
+  strats.emplace_back(
+    "compressed/" + n,
+    std::unique_ptr<LookupStrategy>(MakeCompressedLookupStrategy<HashLength>()(ch))
+  );
+  strats.emplace_back("bconst256/" + n, make_block_const_ls<HashLength, 8>(hsd));
+  strats.emplace_back("basic/" + n, make_basic_ls<HashLength>(hsd));
+
+  // half hits, half (almost certain) misses
+  auto queries = make_random_hashes<HashLength>(rng, 100000);
+  for (size_t i = 0; i < queries.size(); i += 2) {
+    queries[i] = hashes[rng() % hashes.size()];
+  }
+
+  std::unique_ptr<bool[]> results(new bool[queries.size()]);
+
+  for (const auto& [name, ls]: strats) {
+    const std::string tag = std::to_string(HashLength) + " x " + std::to_string(queries.size());
+
+    BENCHMARK(tag + " " + name + " one at a time") {
+      return lookup_func(queries, *ls);
+    };
+
+    BENCHMARK(tag + " " + name + " bulk") {
+      ls->contains_bulk(queries.front().data(), queries.size(), results.get());
+      return results[0];
+    };
+  }
+}
+
+TEST_CASE("CompressedBench") {
+  for (size_t count: make_oom_sequence(5, 8)) {
+    bench_compressed<16>(count);
+    bench_compressed<20>(count);
+  }
+}
+
+template <size_t HashLength>
+void bench_partitioned_lookup(size_t count, size_t qcount) {
+  RNG rng;
+
+  auto hashes = make_random_hashes<HashLength>(rng, count);
+  std::sort(hashes.begin(), hashes.end());
+
+  const ConstHashsetData hsd{hashes.data(), hashes.data() + hashes.size()};
+  const auto ls = make_block_const_ls<HashLength, 8>(hsd);
+
+  // half hits, half (almost certain) misses
+  auto queries = make_random_hashes<HashLength>(rng, qcount);
+  for (size_t i = 0; i < queries.size(); i += 2) {
+    queries[i] = hashes[rng() % count];
+  }
+
+  std::unique_ptr<bool[]> results(new bool[qcount]);
+
+  const auto time = [&](const std::string& name, auto func) {
+    const auto t0 = std::chrono::steady_clock::now();
+    func();
+    const auto t1 = std::chrono::steady_clock::now();
+    std::cout << HashLength << " x " << qcount << " in " << count << " "
+              << name << ": "
+              << std::chrono::duration<double, std::milli>(t1 - t0).count()
+              << " ms\n";
+  };
+
+  time("bconst256 bulk", [&]() {
+    ls->contains_bulk(queries.front().data(), qcount, results.get());
+  });
+
+  for (unsigned threads: { 2u, 4u, std::max(1u, std::thread::hardware_concurrency()) }) {
+    // contiguous pieces, each searching all of HDAT
+    time("split/" + std::to_string(threads), [&]() {
+      run_on_threads(threads, [&](unsigned k) {
+        const size_t b = qcount / threads * k;
+        const size_t e = k + 1 == threads ? qcount : qcount / threads * (k + 1);
+        ls->contains_bulk(queries[b].data(), e - b, results.get() + b);
+      });
+    });
+
+    time("partitioned/" + std::to_string(threads), [&]() {
+      PartitionedLookup<HashLength>()(
+        *ls, queries.front().data(), qcount, results.get(), threads
+      );
+    });
+  }
+}
+
+TEST_CASE("PartitionedLookupBench") {
+  for (size_t count: make_oom_sequence(6, 8)) {
+    for (size_t qcount: make_oom_sequence(5, 7)) {
+      bench_partitioned_lookup<20>(count, qcount);
+    }
+  }
+}
+
+template <size_t HashLength>
+void bench_merge_lookup(size_t count, size_t qcount) {
+  RNG rng;
+
+  auto hashes = make_random_hashes<HashLength>(rng, count);
+  std::sort(hashes.begin(), hashes.end());
+
+  const ConstHashsetData hsd{hashes.data(), hashes.data() + hashes.size()};
+  const auto ls = make_block_const_ls<HashLength, 8>(hsd);
+
+  // half hits, half (almost certain) misses
+  auto queries = make_random_hashes<HashLength>(rng, qcount);
+  for (size_t i = 0; i < queries.size(); i += 2) {
+    queries[i] = hashes[rng() % count];
+  }
+
+  std::unique_ptr<bool[]> results(new bool[qcount]);
+
+  const auto time = [&](const std::string& name, auto func) {
+    const auto t0 = std::chrono::steady_clock::now();
+    func();
+    const auto t1 = std::chrono::steady_clock::now();
+    std::cout << HashLength << " x " << qcount << " in " << count << " "
+              << name << ": "
+              << std::chrono::duration<double, std::milli>(t1 - t0).count()
+              << " ms\n";
+  };
+
+  time("bconst256 bulk", [&]() {
+    ls->contains_bulk(queries.front().data(), qcount, results.get());
+  });
+
+  for (unsigned threads: { 1u, std::max(1u, std::thread::hardware_concurrency()) }) {
+    time("merge/" + std::to_string(threads), [&]() {
+      MergeLookup<HashLength>()(
+        hsd.beg, hsd.end, queries.front().data(), qcount, results.get(), threads
+      );
+    });
+  }
+}
+
+TEST_CASE("MergeLookupBench") {
+  for (size_t count: make_oom_sequence(6, 8)) {
+    for (size_t qcount: make_oom_sequence(5, 8)) {
+      bench_merge_lookup<20>(count, qcount);
+    }
+  }
+}
+
+void bench_records_lookup(size_t count, size_t qcount) {
+  RNG rng;
+
+  // records of a SHA-1 and a size, in random order relative to the hashes
+  constexpr size_t RLEN = 1 + 20 + 1 + 8;
+
+  auto hashes = make_random_hashes<20>(rng, count);
+  std::sort(hashes.begin(), hashes.end());
+
+  std::vector<uint64_t> ridx(count);
+  std::iota(ridx.begin(), ridx.end(), 0);
+  for (size_t i = count - 1; i > 0; --i) {
+    std::swap(ridx[i], ridx[rng() % (i + 1)]);
+  }
+
+  std::vector<uint8_t> rdat(count * RLEN);
+  for (size_t i = 0; i < count; ++i) {
+    uint8_t* r = rdat.data() + ridx[i] * RLEN;
+    r[0] = 1;
+    std::memcpy(r + 1, hashes[i].data(), 20);
+    r[21] = 1;
+    std::memcpy(r + 22, &i, 8);
+  }
+
+  SFHASH_Hashset hset;
+  hset.holder.rhdr = {
+    RLEN, count, { { SFHASH_SHA_1, "SHA-1", 20 }, { SFHASH_SIZE, "size", 8 } }
+  };
+  hset.holder.rdat = { rdat.data(), rdat.data() + rdat.size() };
+
+  const ConstHashsetData hsd{hashes.data(), hashes.data() + hashes.size()};
+  hset.holder.hsets.emplace_back(
+    HashsetHeader{ SFHASH_SHA_1, "SHA-1", 20, count },
+    HashsetHint{},
+    hsd,
+    make_block_const_ls<20, 8>(hsd),
+    ConstRecordIndex{ ridx.data(), ridx.data() + ridx.size() },
+    HashsetIndex{}
+  );
+
+  // half hits, half (almost certain) misses
+  auto queries = make_random_hashes<20>(rng, qcount);
+  for (size_t i = 0; i < queries.size(); i += 2) {
+    queries[i] = hashes[rng() % count];
+  }
+
+  const auto time = [&](const std::string& name, auto func) {
+    const auto t0 = std::chrono::steady_clock::now();
+    const uint64_t sum = func();
+    const auto t1 = std::chrono::steady_clock::now();
+    std::cout << "20 x " << qcount << " in " << count << " "
+              << name << ": "
+              << std::chrono::duration<double, std::milli>(t1 - t0).count()
+              << " ms (" << sum << ")\n";
+  };
+
+  time("records lookup", [&]() {
+    uint64_t sum = 0;
+    for (const auto& q: queries) {
+      const auto [beg, end] = sfhash_hashset_records_lookup(&hset, 0, q.data());
+      for (auto i = beg; i != end; ++i) {
+        const auto r = sfhash_hashset_record_for_hash(&hset, 0, i);
+        sum += static_cast<const uint8_t*>(sfhash_hashset_record_field(r, 21))[1];
+      }
+    }
+    return sum;
+  });
+
+  time("records lookup bulk", [&]() {
+    uint64_t sum = 0;
+    const auto m = make_unique_del(
+      sfhash_hashset_records_lookup_bulk(
+        &hset, 0, queries.data(), queries.size(), nullptr
+      ),
+      sfhash_hashset_record_matches_destroy
+    );
+
+    const auto ms = sfhash_hashset_record_matches(m.get());
+    for (size_t i = 0; i < sfhash_hashset_record_matches_count(m.get()); ++i) {
+      const auto r = sfhash_hashset_record(&hset, ms[i].record_index);
+      sum += static_cast<const uint8_t*>(sfhash_hashset_record_field(r, 21))[1];
+    }
+    return sum;
+  });
+}
+
+TEST_CASE("RecordsLookupBench") {
+  for (size_t count: make_oom_sequence(6, 8)) {
+    for (size_t qcount: make_oom_sequence(4, 7)) {
+      bench_records_lookup(count, qcount);
+    }
+  }
+}
+
+template <size_t HashLength>
+void bench_hash_compare() {
+  RNG rng;
+
+  using Hash = std::array<uint8_t, HashLength>;
+  const auto hashes = make_random_hashes<HashLength>(rng, 100000);
+
+  const auto sort_with = [&hashes](auto less) {
+    auto h = hashes;
+    std::sort(h.begin(), h.end(), less);
+    return h[0][0];
+  };
+
+  const std::string tag = std::to_string(HashLength) + " sort ";
+
+  BENCHMARK(tag + "std::array <") {
+    return sort_with(std::less<Hash>());
+  };
+
+  BENCHMARK(tag + "memcmp") {
+    return sort_with([](const Hash& l, const Hash& r) {
+      return std::memcmp(l.data(), r.data(), HashLength) < 0;
+    });
+  };
+
+  BENCHMARK(tag + "HashLess") {
+    return sort_with(HashLess<HashLength>());
+  };
+}
+
+TEST_CASE("HashCompareBench") {
+  bench_hash_compare<16>();
+  bench_hash_compare<20>();
+  bench_hash_compare<32>();
+  bench_hash_compare<64>();
+}
+
+void bench_group_lookup(size_t set_count, size_t set_size) {
+  RNG rng;
+
+  // sets drawn from a common pool, so that they overlap
+  const auto pool = make_random_hashes<20>(rng, set_count * set_size / 2);
+
+  std::vector<std::vector<std::array<uint8_t, 20>>> sha1s(set_count);
+  std::vector<SFHASH_Hashset> hsets(set_count);
+  std::vector<const SFHASH_Hashset*> ptrs;
+
+  for (size_t i = 0; i < set_count; ++i) {
+    for (size_t j = 0; j < set_size; ++j) {
+      sha1s[i].push_back(pool[rng() % pool.size()]);
+    }
+    std::sort(sha1s[i].begin(), sha1s[i].end());
+
+    const ConstHashsetData hsd{sha1s[i].data(), sha1s[i].data() + set_size};
+    hsets[i].holder.hsets.emplace_back(
+      HashsetHeader{ SFHASH_SHA_1, "SHA-1", 20, set_size },
+      HashsetHint{},
+      hsd,
+      make_block_const_ls<20, 8>(hsd),
+      ConstRecordIndex{},
+      HashsetIndex{}
+    );
+    ptrs.push_back(&hsets[i]);
+  }
+
+  const auto t0 = std::chrono::steady_clock::now();
+  SFHASH_Error* err = nullptr;
+  const auto grp = make_unique_del(
+    sfhash_hashset_group_create(ptrs.data(), ptrs.size(), &err),
+    sfhash_hashset_group_destroy
+  );
+  const auto t1 = std::chrono::steady_clock::now();
+  THROW_IF(err, err->message);
+
+  std::cout << set_count << " x " << set_size << " group: "
+            << std::chrono::duration<double, std::milli>(t1 - t0).count()
+            << " ms to build\n";
+
+  // mostly misses, as when filtering a disk image
+  auto queries = make_random_hashes<20>(rng, 100000);
+  for (size_t i = 0; i < queries.size(); i += 10) {
+    queries[i] = pool[rng() % pool.size()];
+  }
+
+  const size_t words = sfhash_hashset_group_bitmap_words(grp.get());
+  std::vector<uint64_t> members(queries.size() * words);
+
+  const std::string tag = std::to_string(set_count) + " x " + std::to_string(set_size) + " ";
+
+  BENCHMARK(tag + "each hashset") {
+    uint64_t r = 0;
+    for (const auto& q: queries) {
+      for (size_t i = 0; i < set_count; ++i) {
+        r += sfhash_hashset_lookup(&hsets[i], 0, q.data()) << i;
+      }
+    }
+    return r;
+  };
+
+  BENCHMARK(tag + "group") {
+    uint64_t r = 0;
+    for (const auto& q: queries) {
+      r += sfhash_hashset_group_lookup(grp.get(), 0, q.data(), members.data());
+    }
+    return r;
+  };
+
+  BENCHMARK(tag + "group bulk") {
+    sfhash_hashset_group_lookup_bulk(
+      grp.get(), 0, queries.data(), queries.size(), members.data()
+    );
+    return members[0];
+  };
+}
+
+TEST_CASE("GroupLookupBench") {
+  bench_group_lookup(30, 100000);
+  bench_group_lookup(30, 1000000);
+}
+
 TEST_CASE("agreement") {
   const std::vector<std::array<uint8_t, 20>> test1_in{
     to_bytes<20>("03056bc08003a879889005a316b5f9159b1cba5a"),
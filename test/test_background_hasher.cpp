@@ -0,0 +1,60 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "util.h"
+
+#include "hashset/background_hasher.h"
+#include "hasher/hasher.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <vector>
+
+std::array<uint8_t, 32> sha256(const uint8_t* beg, const uint8_t* end) {
+  auto hasher = make_unique_del(
+    sfhash_create_hasher(SFHASH_SHA_2_256), sfhash_destroy_hasher
+  );
+  sfhash_update_hasher(hasher.get(), beg, end);
+
+  SFHASH_HashValues hashes;
+  sfhash_get_hashes(hasher.get(), &hashes);
+
+  std::array<uint8_t, 32> d;
+  std::memcpy(d.data(), hashes.Sha2_256, d.size());
+  return d;
+}
+
+TEST_CASE("background_hasher") {
+  std::mt19937 rng(5);
+  std::vector<uint8_t> buf(3 << 20);
+  std::generate(buf.begin(), buf.end(), std::ref(rng));
+
+  const uint8_t* beg = buf.data() + 40;
+  const uint8_t* end = buf.data() + buf.size();
+
+  BackgroundHasher hasher(beg);
+
+  // finish the region in uneven pieces, as its chunks would be
+  const uint8_t* done = beg;
+  while (done < end) {
+    done += std::min<size_t>(end - done, rng() % (1 << 18));
+    hasher.finished(done);
+  }
+
+  CHECK(hasher.digest() == sha256(beg, end));
+}
+
+TEST_CASE("background_hasher_nothing") {
+  const uint8_t b = 0;
+  BackgroundHasher hasher(&b);
+  CHECK(hasher.digest() == sha256(&b, &b));
+}
+
+TEST_CASE("background_hasher_abandoned") {
+  std::vector<uint8_t> buf(1 << 20, 0x5A);
+  BackgroundHasher hasher(buf.data());
+  hasher.finished(buf.data() + buf.size());
+  // destroyed without a digest; this must not hang
+}
@@ -0,0 +1,329 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "helper.h"
+
+#include "hex.h"
+#include "util.h"
+#include "hasher/hashset.h"
+#include "hashset/basic_ls.h"
+#include "hashset/compressed_hashes.h"
+#include "hashset/compressed_ls.h"
+#include "hashset/hset.h"
+#include "hashset/hset_encoder.h"
+#include "hashset/hset_group.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+template <size_t HashLength>
+std::vector<std::array<uint8_t, HashLength>> make_sorted_hashes(size_t count, unsigned seed) {
+  std::mt19937 rng(seed);
+  std::vector<std::array<uint8_t, HashLength>> hashes(count);
+  for (auto& h: hashes) {
+    for (auto& b: h) {
+      b = rng();
+    }
+  }
+  std::sort(hashes.begin(), hashes.end());
+  hashes.erase(std::unique(hashes.begin(), hashes.end()), hashes.end());
+  return hashes;
+}
+
+template <size_t HashLength>
+std::vector<uint8_t> compress(const std::vector<std::array<uint8_t, HashLength>>& hashes) {
+  std::vector<uint8_t> buf(compressed_length(hashes.size(), HashLength));
+  const size_t len = write_compressed(
+    hashes.empty() ? nullptr : hashes.front().data(),
+    hashes.size(),
+    HashLength,
+    buf.data()
+  );
+  REQUIRE(len == buf.size());
+  return buf;
+}
+
+template <size_t HashLength>
+void check_compressed_round_trip(size_t count, unsigned seed) {
+  const auto hashes = make_sorted_hashes<HashLength>(count, seed);
+  const auto buf = compress(hashes);
+
+  const CompressedHashes ch(
+    buf.data(), buf.data() + buf.size(), HashLength, hashes.size()
+  );
+
+  CHECK(ch.size() == hashes.size());
+  CHECK(ch.prefix_bytes() == ch.bucket_bits() / 8);
+
+  const auto exp = ch.expand();
+  REQUIRE(exp.size() == hashes.size() * HashLength);
+  if (!hashes.empty()) {
+    CHECK(!std::memcmp(exp.data(), hashes.front().data(), exp.size()));
+  }
+
+  // the buckets partition the hashes, in order
+  uint64_t prev = 0;
+  for (const auto& h: hashes) {
+    const auto [l, r] = ch.bucket_range(ch.bucket(h.data()));
+    CHECK(l <= r);
+    CHECK(l >= prev);
+    prev = l;
+
+    const uint64_t i = std::lower_bound(hashes.begin(), hashes.end(), h) - hashes.begin();
+    CHECK(l <= i);
+    CHECK(i < r);
+  }
+}
+
+TEST_CASE("compressed_hashes_round_trip") {
+  check_compressed_round_trip<20>(0, 1);
+  check_compressed_round_trip<20>(1, 2);
+  check_compressed_round_trip<20>(1000, 3);
+  check_compressed_round_trip<16>(10000, 4);
+  // enough for two bytes of prefix
+  check_compressed_round_trip<8>(300000, 5);
+  // the whole hash but a byte is prefix
+  check_compressed_round_trip<4>(70000, 6);
+}
+
+TEST_CASE("compressed_hashes_in_place") {
+  const auto hashes = make_sorted_hashes<20>(5000, 7);
+  const auto exp = compress(hashes);
+
+  std::vector<uint8_t> buf(
+    std::max(hashes.size() * 20, exp.size())
+  );
+  std::memcpy(buf.data(), hashes.front().data(), hashes.size() * 20);
+
+  const size_t len = write_compressed(buf.data(), hashes.size(), 20, buf.data());
+  REQUIRE(len == exp.size());
+  CHECK(std::equal(exp.begin(), exp.end(), buf.begin()));
+}
+
+TEST_CASE("compressed_length_max") {
+  for (uint64_t n = 0; n < (1 << 16); n += 7) {
+    const size_t m = compressed_length_max(n, 20);
+    CHECK(m >= compressed_length(n, 20));
+    CHECK(m >= compressed_length_max(n / 2, 20));
+  }
+}
+
+TEST_CASE("compressed_hashes_damaged") {
+  const auto hashes = make_sorted_hashes<20>(3000, 8);
+  const auto buf = compress(hashes);
+
+  // the wrong count
+  CHECK_THROWS(CompressedHashes(buf.data(), buf.data() + buf.size(), 20, hashes.size() - 1));
+
+  // truncated
+  CHECK_THROWS(CompressedHashes(buf.data(), buf.data() + buf.size() - 8, 20, hashes.size()));
+
+  // bad prefix bytes
+  auto bad = buf;
+  ++bad[1];
+  CHECK_THROWS(CompressedHashes(bad.data(), bad.data() + bad.size(), 20, hashes.size()));
+
+  // a hash moved from one bucket to another
+  bad = buf;
+  bad[bad.size() - 40] ^= 0x01;
+  CHECK_THROWS(CompressedHashes(bad.data(), bad.data() + bad.size(), 20, hashes.size()));
+
+  // a bad sample
+  const size_t samples = 8 + hashes.size() * (20 - buf[1]);
+  bad = buf;
+  bad[samples + (8 - samples % 8) % 8 + 8] ^= 0x01;
+  CHECK_THROWS(CompressedHashes(bad.data(), bad.data() + bad.size(), 20, hashes.size()));
+}
+
+TEST_CASE("CompressedLookupStrategy") {
+  const auto all = make_sorted_hashes<20>(20000, 9);
+
+  // use every other hash, so the rest are known absent
+  std::vector<std::array<uint8_t, 20>> present, absent;
+  for (size_t i = 0; i < all.size(); ++i) {
+    (i % 2 ? absent : present).push_back(all[i]);
+  }
+
+  const auto buf = compress(present);
+
+  const auto ls = std::unique_ptr<LookupStrategy>(
+    MakeCompressedLookupStrategy<20>()(
+      CompressedHashes(buf.data(), buf.data() + buf.size(), 20, present.size())
+    )
+  );
+
+  const BasicLookupStrategy<20> basic(
+    present.front().data(), present.front().data() + present.size() * 20
+  );
+
+  for (size_t i = 0; i < all.size(); ++i) {
+    CHECK(ls->contains(all[i].data()) == !(i % 2));
+    CHECK(ls->find_range(all[i].data()) == basic.find_range(all[i].data()));
+  }
+
+  std::unique_ptr<bool[]> exp(new bool[all.size()]);
+  std::unique_ptr<bool[]> act(new bool[all.size()]);
+
+  basic.contains_bulk(all.front().data(), all.size(), exp.get());
+  ls->contains_bulk(all.front().data(), all.size(), act.get());
+  CHECK(std::equal(exp.get(), exp.get() + all.size(), act.get()));
+
+  // nothing can be found in an empty HDAC
+  const std::vector<std::array<uint8_t, 20>> none;
+  const auto ebuf = compress(none);
+  const auto els = std::unique_ptr<LookupStrategy>(
+    MakeCompressedLookupStrategy<20>()(
+      CompressedHashes(ebuf.data(), ebuf.data() + ebuf.size(), 20, 0)
+    )
+  );
+
+  els->contains_bulk(all.front().data(), all.size(), act.get());
+  CHECK(std::none_of(act.get(), act.get() + all.size(), [](bool b) { return b; }));
+}
+
+std::vector<char> write_compressed_hset(bool with_records, uint32_t flags) {
+  const std::string hsetfile = "test/md5_sha1_z.hset";
+
+  {
+    std::ifstream in("test/md5_sha1_a");
+
+    const std::vector<SFHASH_HashAlgorithm> htypes{ SFHASH_MD5, SFHASH_SHA_1 };
+
+    write_hset(
+      in,
+      htypes,
+      make_text_converters(htypes),
+      "Compressed",
+      "Hashes without their heads",
+      hsetfile,
+      "test",
+      with_records,
+      true,
+      SFHASH_HASHSET_BUILD_COMPRESSED | flags
+    );
+  }
+
+  return read_file(hsetfile);
+}
+
+void check_compressed_hset_round_trip(bool with_records) {
+  const auto hsf = write_compressed_hset(with_records, SFHASH_HASHSET_BUILD_CHECKSUMS);
+
+  SFHASH_Error* err = nullptr;
+
+  auto hset = make_unique_del(
+    sfhash_load_hashset(hsf.data(), hsf.data() + hsf.size(), &err),
+    sfhash_destroy_hashset
+  );
+
+  CHECK(!err);
+  if (err) {
+    FAIL(err->message);
+  }
+
+  REQUIRE(hset);
+
+  sfhash_hashset_verify(hset.get(), 1, nullptr, &err);
+  CHECK(!err);
+  if (err) {
+    FAIL(err->message);
+  }
+
+  const auto md5_idx = sfhash_hashset_index_for_type(hset.get(), SFHASH_MD5);
+  const auto sha1_idx = sfhash_hashset_index_for_type(hset.get(), SFHASH_SHA_1);
+  REQUIRE(md5_idx != -1);
+  REQUIRE(sha1_idx != -1);
+
+  CHECK(std::get<ConstHashsetData>(hset->holder.hsets[md5_idx]).compressed);
+  CHECK(std::get<ConstHashsetData>(hset->holder.hsets[sha1_idx]).compressed);
+
+  std::ifstream in("test/md5_sha1_a");
+  std::string line;
+  std::vector<std::array<uint8_t, 20>> sha1s;
+  std::set<std::array<uint8_t, 20>> seen;
+  while (std::getline(in, line)) {
+    if (line.empty()) {
+      continue;
+    }
+
+    const auto md5 = to_bytes<16>(line.c_str());
+    CHECK(sfhash_hashset_lookup(hset.get(), md5_idx, md5.data()));
+
+    const auto sha1 = to_bytes<20>(line.c_str() + 33);
+    CHECK(sfhash_hashset_lookup(hset.get(), sha1_idx, sha1.data()));
+    sha1s.push_back(sha1);
+    seen.insert(sha1);
+
+    if (with_records) {
+      const auto [beg, end] = sfhash_hashset_records_lookup(hset.get(), md5_idx, md5.data());
+      CHECK(beg < end);
+    }
+  }
+
+  // flip a bit in each to get hashes which should be absent
+  const size_t n = sha1s.size();
+  for (size_t i = 0; i < n; ++i) {
+    auto miss = sha1s[i];
+    miss[19] ^= 0x01;
+    if (!seen.count(miss)) {
+      sha1s.push_back(miss);
+    }
+  }
+
+  std::unique_ptr<bool[]> bulk(new bool[sha1s.size()]);
+  std::unique_ptr<bool[]> merged(new bool[sha1s.size()]);
+
+  sfhash_hashset_lookup_bulk(hset.get(), sha1_idx, sha1s.data(), sha1s.size(), bulk.get());
+  sfhash_hashset_lookup_bulk_merge(hset.get(), sha1_idx, sha1s.data(), sha1s.size(), merged.get(), 2);
+
+  for (size_t i = 0; i < sha1s.size(); ++i) {
+    CHECK(bulk[i] == (i < n));
+    CHECK(merged[i] == (i < n));
+  }
+
+  // and through a handle
+  const auto handle = sfhash_hashset_lookup_handle(hset.get(), sha1_idx);
+  CHECK(handle.hash_length == 20);
+
+  handle.lookup_bulk(handle.ctx, sha1s.data(), sha1s.size(), bulk.get());
+
+  for (size_t i = 0; i < sha1s.size(); ++i) {
+    CHECK(handle.lookup(handle.ctx, sha1s[i].data()) == (i < n));
+    CHECK(bulk[i] == (i < n));
+  }
+
+  // a group expands the hashes
+  const SFHASH_Hashset* hsets[] = { hset.get() };
+  auto grp = make_unique_del(
+    sfhash_hashset_group_create(hsets, 1, &err),
+    sfhash_hashset_group_destroy
+  );
+
+  REQUIRE(!err);
+
+  const auto gidx = sfhash_hashset_group_index_for_type(grp.get(), SFHASH_SHA_1);
+  REQUIRE(gidx != -1);
+
+  for (size_t i = 0; i < sha1s.size(); ++i) {
+    uint64_t members;
+    CHECK(sfhash_hashset_group_lookup(grp.get(), gidx, sha1s[i].data(), &members) == (i < n));
+  }
+}
+
+TEST_CASE("compressed_round_trip_records") {
+  check_compressed_hset_round_trip(true);
+}
+
+TEST_CASE("compressed_round_trip_hashsets_only") {
+  check_compressed_hset_round_trip(false);
+}
+
+TEST_CASE("compressed_with_perfect_hash") {
+  CHECK_THROWS(write_compressed_hset(true, SFHASH_HASHSET_BUILD_PERFECT_HASH));
+}
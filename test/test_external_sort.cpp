@@ -0,0 +1,188 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "helper.h"
+#include "util.h"
+
+#include "hasher/hashset.h"
+#include "hashset/external_sort.h"
+#include "hashset/hset_encoder.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+std::vector<std::vector<uint8_t>> make_ext_strings(size_t count, size_t len) {
+  std::mt19937 rng(count + len);
+
+  std::vector<std::vector<uint8_t>> v;
+  for (size_t i = 0; i < count; ++i) {
+    if (i % 4 == 3) {
+      // a duplicate
+      v.push_back(v[rng() % i]);
+    }
+    else {
+      auto& s = v.emplace_back(len);
+      std::generate(s.begin(), s.end(), std::ref(rng));
+    }
+  }
+  return v;
+}
+
+void check_external_sort(size_t count, size_t len, uint64_t budget, bool unique) {
+  INFO(count << " x " << len << " in " << budget << (unique ? " unique" : ""));
+
+  const auto strs = make_ext_strings(count, len);
+
+  auto exp = strs;
+  std::sort(exp.begin(), exp.end());
+  if (unique) {
+    exp.erase(std::unique(exp.begin(), exp.end()), exp.end());
+  }
+
+  ExternalSorter sorter(len, budget, "test", "ext_sort", unique);
+  for (const auto& s: strs) {
+    sorter.add(s.data());
+  }
+
+  const size_t runs = sorter.runs();
+  CHECK((runs > 0) == (count * len > budget));
+
+  std::vector<std::vector<uint8_t>> act;
+  const auto n = sorter.merge([&act, len](const uint8_t* s) {
+    act.emplace_back(s, s + len);
+  });
+
+  CHECK(n == exp.size());
+  CHECK(act == exp);
+
+  // the runs are gone
+  for (size_t i = 0; i < runs + 1; ++i) {
+    CHECK(!std::filesystem::exists("test/ext_sort_run_" + std::to_string(i)));
+  }
+}
+
+TEST_CASE("external_sort") {
+  // in memory
+  check_external_sort(1000, 20, 1 << 20, false);
+  check_external_sort(1000, 20, 1 << 20, true);
+  // in runs
+  check_external_sort(10000, 20, 4096, false);
+  check_external_sort(10000, 20, 4096, true);
+  check_external_sort(5000, 28, 28 * 1000, true);
+  // a string per run
+  check_external_sort(100, 16, 1, true);
+  // nothing
+  check_external_sort(0, 16, 16, true);
+}
+
+TEST_CASE("external_sort_unique") {
+  const size_t len = 16;
+  const auto strs = make_ext_strings(5000, len);
+
+  std::vector<uint8_t> dat;
+  for (const auto& s: strs) {
+    dat.insert(dat.end(), s.begin(), s.end());
+  }
+
+  auto exp = strs;
+  std::sort(exp.begin(), exp.end());
+  exp.erase(std::unique(exp.begin(), exp.end()), exp.end());
+
+  const auto n = external_sort_unique(
+    dat.data(), strs.size(), len, 1000, "test", "ext_sort_unique"
+  );
+
+  REQUIRE(n == exp.size());
+  for (size_t i = 0; i < n; ++i) {
+    CHECK(std::equal(exp[i].begin(), exp[i].end(), dat.begin() + i * len));
+  }
+}
+
+void build_limited(
+  const std::string& outfile,
+  bool with_records,
+  bool with_hashsets,
+  uint64_t memory_limit)
+{
+  const SFHASH_HashAlgorithm htypes[] = { SFHASH_MD5, SFHASH_SHA_1 };
+
+  SFHASH_Error* err = nullptr;
+  auto bctx = make_unique_del(
+    sfhash_hashset_builder_open(
+      "limited", "built in runs", htypes, 2, with_records, with_hashsets,
+      outfile.c_str(), "test", &err
+    ),
+    sfhash_hashset_builder_destroy
+  );
+  REQUIRE(!err);
+
+  // the same timestamp, so the files can be compared
+  bctx->fhdr.time = "2000-01-01T00:00:00Z";
+
+  sfhash_hashset_builder_set_memory_limit(bctx.get(), memory_limit, &err);
+  REQUIRE(!err);
+
+  std::mt19937 rng(7);
+  std::vector<std::array<uint8_t, 16>> md5s(4000);
+  std::vector<std::array<uint8_t, 20>> sha1s(md5s.size());
+  for (size_t i = 0; i < md5s.size(); ++i) {
+    if (i % 5 == 4) {
+      // a duplicate record
+      md5s[i] = md5s[i / 2];
+      sha1s[i] = sha1s[i / 2];
+    }
+    else {
+      std::generate(md5s[i].begin(), md5s[i].end(), std::ref(rng));
+      std::generate(sha1s[i].begin(), sha1s[i].end(), std::ref(rng));
+    }
+
+    sfhash_hashset_builder_add_hash(bctx.get(), md5s[i].data(), md5s[i].size());
+    sfhash_hashset_builder_add_hash(bctx.get(), sha1s[i].data(), sha1s[i].size());
+  }
+
+  sfhash_hashset_builder_write(bctx.get(), &err);
+  if (err) {
+    FAIL(err->message);
+  }
+}
+
+TEST_CASE("hset_builder_memory_limit") {
+  for (auto [with_records, with_hashsets]: {
+    std::make_pair(true, true),
+    std::make_pair(true, false),
+    std::make_pair(false, true)
+  }) {
+    INFO(with_records << ' ' << with_hashsets);
+
+    build_limited("test/unlimited.hset", with_records, with_hashsets, 0);
+    build_limited("test/limited.hset", with_records, with_hashsets, 4096);
+
+    CHECK(read_file("test/unlimited.hset") == read_file("test/limited.hset"));
+  }
+}
+
+TEST_CASE("hset_builder_memory_limit_late") {
+  const SFHASH_HashAlgorithm htypes[] = { SFHASH_MD5 };
+
+  SFHASH_Error* err = nullptr;
+  auto bctx = make_unique_del(
+    sfhash_hashset_builder_open(
+      "late", "limit after data", htypes, 1, true, true,
+      "test/late_limit.hset", "test", &err
+    ),
+    sfhash_hashset_builder_destroy
+  );
+  REQUIRE(!err);
+
+  const std::array<uint8_t, 16> h{};
+  sfhash_hashset_builder_add_hash(bctx.get(), h.data(), h.size());
+
+  sfhash_hashset_builder_set_memory_limit(bctx.get(), 1 << 20, &err);
+  CHECK(err);
+  sfhash_free_error(err);
+}
@@ -0,0 +1,77 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "hashset/hash_compare.h"
+
+#include <array>
+#include <cstring>
+#include <random>
+
+int sign(int x) {
+  return (x > 0) - (x < 0);
+}
+
+template <size_t N>
+void check_hash_compare() {
+  std::mt19937 rng(N);
+
+  std::array<uint8_t, N> l, r;
+  for (size_t i = 0; i < 1000; ++i) {
+    for (size_t j = 0; j < N; ++j) {
+      l[j] = r[j] = rng();
+    }
+
+    // differ at every position, including none, in turn
+    const size_t d = i % (N + 1);
+    if (d < N) {
+      while (r[d] == l[d]) {
+        r[d] = rng();
+      }
+      // bytes after the first difference must not matter
+      for (size_t j = d + 1; j < N; ++j) {
+        r[j] = rng();
+      }
+    }
+
+    INFO(N << " bytes, differing at " << d);
+
+    const int exp = sign(std::memcmp(l.data(), r.data(), N));
+    REQUIRE(sign(hash_cmp<N>(l.data(), r.data())) == exp);
+    REQUIRE(sign(hash_cmp<N>(r.data(), l.data())) == -exp);
+    REQUIRE(sign(hash_cmp(l.data(), r.data(), N)) == exp);
+    REQUIRE(hash_less<N>(l.data(), r.data()) == (exp < 0));
+    REQUIRE(HashLess<N>()(l, r) == (exp < 0));
+    REQUIRE(hash_eq<N>(l.data(), r.data()) == (exp == 0));
+  }
+}
+
+TEST_CASE("hash_compare_agrees_with_memcmp") {
+  check_hash_compare<4>();
+  check_hash_compare<8>();
+  check_hash_compare<16>();
+  check_hash_compare<20>();
+  check_hash_compare<28>();
+  check_hash_compare<32>();
+  check_hash_compare<48>();
+  check_hash_compare<64>();
+}
+
+TEST_CASE("hash_compare_high_bit") {
+  // bytes compare unsigned, as memcmp compares them
+  std::array<uint8_t, 20> l{}, r{};
+  l[19] = 0x80;
+  r[19] = 0x7F;
+  CHECK(hash_cmp<20>(l.data(), r.data()) > 0);
+  CHECK(!hash_less<20>(l.data(), r.data()));
+
+  std::array<uint8_t, 32> a{}, b{};
+  a[31] = 0xFF;
+  CHECK(hash_less<32>(b.data(), a.data()));
+  CHECK(!hash_eq<32>(a.data(), b.data()));
+}
+
+TEST_CASE("hash_compare_other_lengths") {
+  const uint8_t l[] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13 };
+  const uint8_t r[] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 14 };
+  CHECK(hash_cmp(l, r, 13) < 0);
+  CHECK(hash_cmp(l, r, 12) == 0);
+}
@@ -11,14 +11,14 @@
 #include "hashset/hset_encoder.h"
 #include "hashset/lookupstrategy.h"
 
+#include <algorithm>
 #include <array>
 #include <cstring>
-#include <initializer_list>
 #include <iterator>
 #include <map>
 #include <memory>
+#include <random>
 #include <utility>
-#include <variant>
 #include <vector>
 
 TEST_CASE("load_hashset_good") {
@@ -122,6 +122,124 @@ TEST_CASE("load_hashset_bad") {
   REQUIRE(err->message);
 }
 
+TEST_CASE("open_hashset") {
+  const uint32_t flag_sets[] = {
+    0,
+    SFHASH_HASHSET_OPEN_POPULATE,
+    SFHASH_HASHSET_OPEN_HUGEPAGES | SFHASH_HASHSET_OPEN_RANDOM,
+    SFHASH_HASHSET_OPEN_WILLNEED | SFHASH_HASHSET_OPEN_PREFAULT,
+    SFHASH_HASHSET_OPEN_POPULATE | SFHASH_HASHSET_OPEN_PREFAULT,
+    SFHASH_HASHSET_OPEN_VERIFY
+  };
+
+  for (const uint32_t flags: flag_sets) {
+    SFHASH_Error* err = nullptr;
+
+    const auto hset = make_unique_del(
+      sfhash_open_hashset("test/good.hset", flags, &err),
+      sfhash_destroy_hashset
+    );
+
+    CHECK(!err);
+    if (err) {
+      FAIL(err->message);
+    }
+
+    REQUIRE(hset);
+
+    CHECK(sfhash_hashset_name(hset.get()) == std::string("Test Name"));
+    CHECK(sfhash_hashset_warm_time(hset.get()) >= 0.0);
+
+    const auto h = to_bytes<20>("286ba1181663193d119d7ca18331395cd451de91");
+    CHECK(sfhash_hashset_lookup(hset.get(), 0, h.data()));
+
+    const auto m = to_bytes<20>("baaaaaadbaaaaaadbaaaaaadbaaaaaadbaaaaaad");
+    CHECK(!sfhash_hashset_lookup(hset.get(), 0, m.data()));
+  }
+}
+
+TEST_CASE("open_hashset_unknown_flags") {
+  SFHASH_Error* err = nullptr;
+
+  const auto hset = make_unique_del(
+    sfhash_open_hashset("test/good.hset", 1 << 20, &err),
+    sfhash_destroy_hashset
+  );
+
+  CHECK(!hset);
+  REQUIRE(err);
+  sfhash_free_error(err);
+}
+
+TEST_CASE("open_hashset_missing") {
+  SFHASH_Error* err = nullptr;
+
+  const auto hset = make_unique_del(
+    sfhash_open_hashset("test/no_such.hset", 0, &err),
+    sfhash_destroy_hashset
+  );
+
+  CHECK(!hset);
+  REQUIRE(err);
+  REQUIRE(err->message);
+}
+
+TEST_CASE("open_hashset_bad") {
+  SFHASH_Error* err = nullptr;
+
+  const auto hset = make_unique_del(
+    sfhash_open_hashset("test/sha1", 0, &err),
+    sfhash_destroy_hashset
+  );
+
+  CHECK(!hset);
+  REQUIRE(err);
+  REQUIRE(err->message);
+}
+
+TEST_CASE("load_hashset_warm_time") {
+  const auto f = read_file("test/good.hset");
+
+  SFHASH_Error* err = nullptr;
+
+  const auto hset = make_unique_del(
+    sfhash_load_hashset(f.data(), f.data() + f.size(), &err),
+    sfhash_destroy_hashset
+  );
+
+  REQUIRE(hset);
+  CHECK(sfhash_hashset_warm_time(hset.get()) == 0.0);
+}
+
+TEST_CASE("hashset_verify_sha2_256") {
+  auto f = read_file("test/good.hset");
+
+  SFHASH_Error* err = nullptr;
+
+  const auto hset = make_unique_del(
+    sfhash_load_hashset(f.data(), f.data() + f.size(), &err),
+    sfhash_destroy_hashset
+  );
+
+  REQUIRE(hset);
+
+  // no checksums, so the whole file is checked against its SHA2-256
+  SFHASH_HashsetVerifyStats stats{0, 0.0};
+  sfhash_hashset_verify(hset.get(), 0, &stats, &err);
+  CHECK(!err);
+  if (err) {
+    FAIL(err->message);
+  }
+  CHECK(stats.bytes == f.size() - 40);
+
+  f.back() ^= 0x01;
+
+  sfhash_hashset_verify_hashset(hset.get(), 0, 0, nullptr, &err);
+  REQUIRE(err);
+  CHECK(std::string(err->message).find("SHA2-256") != std::string::npos);
+  sfhash_free_error(err);
+}
+
 // TODO: more parsing tests
 
 TEST_CASE("hashset_index_for_type") {
@@ -132,7 +250,8 @@ TEST_CASE("hashset_index_for_type") {
     HashsetHint{},
     ConstHashsetData{},
     std::unique_ptr<LookupStrategy>(),
-    ConstRecordIndex{}
+    ConstRecordIndex{},
+    HashsetIndex{}
   );
 
   hset.holder.hsets.emplace_back(
@@ -140,7 +259,8 @@ TEST_CASE("hashset_index_for_type") {
     HashsetHint{},
     ConstHashsetData{},
     std::unique_ptr<LookupStrategy>(),
-    ConstRecordIndex{}
+    ConstRecordIndex{},
+    HashsetIndex{}
   );
 
   hset.holder.hsets.emplace_back(
@@ -148,7 +268,8 @@ TEST_CASE("hashset_index_for_type") {
     HashsetHint{},
     ConstHashsetData{},
     std::unique_ptr<LookupStrategy>(),
-    ConstRecordIndex{}
+    ConstRecordIndex{},
+    HashsetIndex{}
   );
 
   CHECK(sfhash_hashset_index_for_type(&hset, SFHASH_SIZE) == 0);
@@ -206,7 +327,8 @@ TEST_CASE("hashset_lookup") {
     HashsetHint{},
     ConstHashsetData{ md5s.begin(),  md5s.end() },
     std::unique_ptr<LookupStrategy>(new BasicLookupStrategy<16>(md5s.begin(), md5s.end())),
-    ConstRecordIndex{}
+    ConstRecordIndex{},
+    HashsetIndex{}
   );
 
   hset.holder.hsets.emplace_back(
@@ -214,7 +336,8 @@ TEST_CASE("hashset_lookup") {
     HashsetHint{},
     ConstHashsetData{ sha1s.begin(), sha1s.end() },
     std::unique_ptr<LookupStrategy>(new BasicLookupStrategy<20>(sha1s.begin(), sha1s.end())),
-    ConstRecordIndex{}
+    ConstRecordIndex{},
+    HashsetIndex{}
   );
 
   // lookup some MD5s
@@ -284,7 +407,8 @@ TEST_CASE("hashset_lookup_bulk") {
     HashsetHint{},
     ConstHashsetData{ sha1s.begin(), sha1s.end() },
     std::unique_ptr<LookupStrategy>(new BasicLookupStrategy<20>(sha1s.begin(), sha1s.end())),
-    ConstRecordIndex{}
+    ConstRecordIndex{},
+    HashsetIndex{}
   );
 
   // lookup some SHA1s
@@ -312,6 +436,208 @@ TEST_CASE("hashset_lookup_bulk") {
   CHECK(results == exp);
 }
 
+TEST_CASE("hashset_lookup_bulk_merge") {
+  std::array sha1s{
+    to_bytes<20>("0af8e028c7048ad772ddec2200ec7e0e4d58b0c3"),
+    to_bytes<20>("1127ceb2c2d789c1d7615b12082ca30222f3c612"),
+    to_bytes<20>("3e909896b309492e00444212bb2b270b5809a0cf"),
+    to_bytes<20>("5cb3a026273fd180a9cfc32bfe3da8730e4bd192"),
+    to_bytes<20>("6007cca8643961ed5f374d2dbf0394dc88110cdb"),
+    to_bytes<20>("78e7f1736d31d8b5b1beb41e2e41769754d3cf3f"),
+    to_bytes<20>("a40ea2ba2d45f9aa4d2b31adfcad0bbdb6670452"),
+    to_bytes<20>("b46c74716a8b1fbf5fedc75f58c9c72b53631123"),
+    to_bytes<20>("c1ec34d963283b8ca0ac899164dfbb3fc2321e38"),
+    to_bytes<20>("fad37e52be19b7a6ea321b848f2d6de4b75efcc9")
+  };
+
+  SFHASH_Hashset hset;
+
+  hset.holder.hsets.emplace_back(
+    HashsetHeader{ SFHASH_SHA_1, "sha1", 20, sha1s.size() },
+    HashsetHint{},
+    ConstHashsetData{ sha1s.begin(), sha1s.end() },
+    std::unique_ptr<LookupStrategy>(new BasicLookupStrategy<20>(sha1s.begin(), sha1s.end())),
+    ConstRecordIndex{},
+    HashsetIndex{}
+  );
+
+  // unsorted, with a repeat and a near miss sharing a long prefix
+  std::vector<std::array<uint8_t, 20>> lookup{
+    to_bytes<20>("fad37e52be19b7a6ea321b848f2d6de4b75efcc9"),
+    to_bytes<20>("0000000000000000000000000000000000000000"),
+    to_bytes<20>("6007cca8643961ed5f374d2dbf0394dc88110cdb"),
+    to_bytes<20>("ffffffffffffffffffffffffffffffffffffffff"),
+    to_bytes<20>("6007cca8643961ed5f374d2dbf0394dc88110cdc"),
+    to_bytes<20>("1127ceb2c2d789c1d7615b12082ca30222f3c612"),
+    to_bytes<20>("6007cca8643961ed5f374d2dbf0394dc88110cdb")
+  };
+
+  const std::vector<uint8_t> exp{ true, false, true, false, false, true, true };
+
+  for (unsigned threads: { 0, 1, 3 }) {
+    std::vector<uint8_t> results(lookup.size());
+
+    sfhash_hashset_lookup_bulk_merge(
+      &hset,
+      0,
+      lookup.data(),
+      lookup.size(),
+      reinterpret_cast<bool*>(results.data()),
+      threads
+    );
+
+    CHECK(results == exp);
+  }
+}
+
+TEST_CASE("hashset_lookup_bulk_mt") {
+  // enough hashes that the batch is split over threads
+  std::mt19937_64 rng(42);
+
+  std::vector<std::array<uint8_t, 20>> sha1s(5000);
+  for (auto& h: sha1s) {
+    for (auto& b: h) {
+      b = rng();
+    }
+  }
+  std::sort(sha1s.begin(), sha1s.end());
+
+  SFHASH_Hashset hset;
+
+  hset.holder.hsets.emplace_back(
+    HashsetHeader{ SFHASH_SHA_1, "sha1", 20, sha1s.size() },
+    HashsetHint{},
+    ConstHashsetData{ sha1s.data(), sha1s.data() + sha1s.size() },
+    std::unique_ptr<LookupStrategy>(new BasicLookupStrategy<20>(sha1s.data(), sha1s.data() + sha1s.size())),
+    ConstRecordIndex{},
+    HashsetIndex{}
+  );
+
+  // every other one a hit
+  std::vector<std::array<uint8_t, 20>> lookup(200000);
+  for (size_t i = 0; i < lookup.size(); ++i) {
+    if (i % 2) {
+      for (auto& b: lookup[i]) {
+        b = rng();
+      }
+    }
+    else {
+      lookup[i] = sha1s[rng() % sha1s.size()];
+    }
+  }
+
+  std::vector<uint8_t> exp(lookup.size());
+  for (size_t i = 0; i < lookup.size(); ++i) {
+    exp[i] = sfhash_hashset_lookup(&hset, 0, lookup[i].data());
+  }
+
+  for (unsigned threads: { 0, 1, 3, 8 }) {
+    std::vector<uint8_t> results(lookup.size());
+
+    sfhash_hashset_lookup_bulk_mt(
+      &hset,
+      0,
+      lookup.data(),
+      lookup.size(),
+      reinterpret_cast<bool*>(results.data()),
+      threads
+    );
+
+    CHECK(results == exp);
+  }
+}
+
+TEST_CASE("hashset_stats") {
+  std::mt19937_64 rng(7);
+
+  std::vector<std::array<uint8_t, 20>> sha1s(1000);
+  for (auto& h: sha1s) {
+    for (auto& b: h) {
+      b = rng();
+    }
+  }
+  std::sort(sha1s.begin(), sha1s.end());
+
+  SFHASH_Hashset hset;
+
+  hset.holder.hsets.emplace_back(
+    HashsetHeader{ SFHASH_SHA_1, "sha1", 20, sha1s.size() },
+    HashsetHint{},
+    ConstHashsetData{ sha1s.data(), sha1s.data() + sha1s.size() },
+    std::unique_ptr<LookupStrategy>(new BasicLookupStrategy<20>(sha1s.data(), sha1s.data() + sha1s.size())),
+    ConstRecordIndex{},
+    HashsetIndex{}
+  );
+
+  // every other one a hit
+  std::vector<std::array<uint8_t, 20>> lookup(100);
+  for (size_t i = 0; i < lookup.size(); ++i) {
+    if (i % 2) {
+      for (auto& b: lookup[i]) {
+        b = rng();
+      }
+    }
+    else {
+      lookup[i] = sha1s[rng() % sha1s.size()];
+    }
+  }
+
+  SFHASH_HashsetLookupStats stats;
+  std::vector<uint8_t> results(lookup.size());
+
+  // off by default
+  sfhash_hashset_lookup(&hset, 0, lookup[0].data());
+  sfhash_hashset_stats(&hset, 0, &stats);
+  CHECK(stats.lookups == 0);
+
+  if (!sfhash_hashset_stats_enable(true)) {
+    // compiled out
+    return;
+  }
+
+  sfhash_hashset_lookup(&hset, 0, lookup[0].data());
+  sfhash_hashset_lookup(&hset, 0, lookup[1].data());
+
+  sfhash_hashset_stats(&hset, 0, &stats);
+  CHECK(stats.lookups == 2);
+  CHECK(stats.hits == 1);
+  CHECK(stats.misses == 1);
+  // a binary search over all 1000 hashes compares at most 10 times to
+  // narrow it to one, and once more to check that one
+  CHECK(stats.window_total == 2000);
+  CHECK(stats.window_max == 1000);
+  CHECK(stats.probes <= 2 * 11);
+  CHECK(stats.rejections == 0);
+
+  sfhash_hashset_stats_reset(&hset, 0);
+
+  sfhash_hashset_lookup_bulk(
+    &hset, 0, lookup.data(), lookup.size(),
+    reinterpret_cast<bool*>(results.data())
+  );
+
+  sfhash_hashset_lookup_bulk_merge(
+    &hset, 0, lookup.data(), lookup.size(),
+    reinterpret_cast<bool*>(results.data()), 1
+  );
+
+  sfhash_hashset_stats_enable(false);
+
+  sfhash_hashset_stats(&hset, 0, &stats);
+  CHECK(stats.lookups == 200);
+  CHECK(stats.hits == 100);
+  CHECK(stats.misses == 100);
+  // only the bulk lookup probes
+  CHECK(stats.window_total == 100 * 1000);
+  // which checks the two hashes it narrows to
+  CHECK(stats.probes <= 100 * 12);
+
+  // nothing more is counted once counting is off
+  sfhash_hashset_lookup(&hset, 0, lookup[0].data());
+  sfhash_hashset_stats(&hset, 0, &stats);
+  CHECK(stats.lookups == 200);
+}
+
 TEST_CASE("hashset_record_field") {
   uint8_t rec[1 + 16 + 1 + 20 + 1 + 8];
   rec[0] = 1;
@@ -328,39 +654,7 @@ TEST_CASE("hashset_record_field") {
   CHECK(!std::memcmp(sfhash_hashset_record_field(r, 38), &rec[38], 9));
 }
 
-constexpr std::initializer_list<SFHASH_HashAlgorithm> HASH_TYPES = {
-  SFHASH_SIZE,
-  SFHASH_MD5,
-  SFHASH_SHA_1,
-  SFHASH_SHA_2_224,
-  SFHASH_SHA_2_256,
-  SFHASH_SHA_2_384,
-  SFHASH_SHA_2_512,
-  SFHASH_SHA_3_224,
-  SFHASH_SHA_3_256,
-  SFHASH_SHA_3_384,
-  SFHASH_SHA_3_512,
-  SFHASH_BLAKE3,
-//  SFHASH_FUZZY,
-  SFHASH_ENTROPY,
-//  SFHASH_QUICK_MD5
-};
-
-constexpr size_t HASH_LENGTH[] = {
-  8,
-  16,
-  20,
-  28,
-  32,
-  48,
-  64,
-  28,
-  32,
-  48,
-  64,
-  20,
-  8
-};
+using RecordFields = std::map<SFHASH_HashAlgorithm, std::vector<uint8_t>>;
 
 template <class Tests>
 void do_record_lookups(
@@ -371,30 +665,37 @@ void do_record_lookups(
   const auto tidx = sfhash_hashset_index_for_type(hset, htype);
   REQUIRE(tidx != -1);
 
-  // list out all the hash types in the hashset
-  std::vector<std::pair<SFHASH_HashAlgorithm, int>> rec_offs;
-  for (auto t: HASH_TYPES) {
-    const auto toff = sfhash_hashset_record_field_index_for_type(hset, t);
-    if (toff != -1) {
-      rec_offs.emplace_back(t, toff);
-    }
-  }
-
   for (const auto& [hash, exp]: tests) {
-    for (auto [i, end] = sfhash_hashset_records_lookup(hset, tidx, hash.data()); i != end; ++i) {
+    const auto [beg, end] = sfhash_hashset_records_lookup(hset, tidx, hash.data());
+    CHECK((beg == end) == exp.empty());
+
+    for (auto i = beg; i != end; ++i) {
       const auto r = sfhash_hashset_record_for_hash(hset, tidx, i);
-      for (const auto& [t, toff]: rec_offs) {
-        const auto f = sfhash_hashset_record_field(r, toff);
-        const auto e = exp.find(t);
-        CHECK((e != exp.end() && !std::memcmp(&*e, f, HASH_LENGTH[t])));
+      for (const auto& [t, val]: exp) {
+        const auto toff = sfhash_hashset_record_field_index_for_type(hset, t);
+        REQUIRE(toff != -1);
+
+        const auto f = static_cast<const uint8_t*>(sfhash_hashset_record_field(r, toff));
+        CHECK(f[0] == 1);
+        CHECK(!std::memcmp(f + 1, val.data(), val.size()));
       }
     }
   }
 }
 
-TEST_CASE("hashset_record_lookup") {
-  // create a test hset
-  std::array md5s{
+template <size_t N>
+std::vector<uint8_t> to_vec(const std::array<uint8_t, N>& a) {
+  return { a.begin(), a.end() };
+}
+
+std::vector<uint8_t> to_vec(uint64_t x) {
+  std::vector<uint8_t> v(sizeof(x));
+  std::memcpy(v.data(), &x, sizeof(x));
+  return v;
+}
+
+struct RecordLookupFixture {
+  std::array<std::array<uint8_t, 16>, 10> md5s{
     to_bytes<16>("081d3d40b257d8bbc5858345ad186beb"),
     to_bytes<16>("19875d9651a319fdb8f7332b660c432d"),
     to_bytes<16>("297da3f7f9c7a38fcb8872193cf3b609"),
@@ -407,7 +708,7 @@ TEST_CASE("hashset_record_lookup") {
     to_bytes<16>("eb6fe7367307473c86c3438744c3b1db")
   };
 
-  std::array sha1s{
+  std::array<std::array<uint8_t, 20>, 10> sha1s{
     to_bytes<20>("0af8e028c7048ad772ddec2200ec7e0e4d58b0c3"),
     to_bytes<20>("1127ceb2c2d789c1d7615b12082ca30222f3c612"),
     to_bytes<20>("3e909896b309492e00444212bb2b270b5809a0cf"),
@@ -420,172 +721,237 @@ TEST_CASE("hashset_record_lookup") {
     to_bytes<20>("fad37e52be19b7a6ea321b848f2d6de4b75efcc9")
   };
 
-  std::array<uint64_t, 10> sizes{
-    0,
-    1,
-    2,
-    3,
-    4,
-    5,
-    6,
-    7,
-    8,
-    9
-  };
+  // little-endian sizes less than 256 sort as their values do
+  std::array<uint64_t, 10> sizes{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
 
-  std::array<
-    std::tuple<
-      std::array<uint8_t, 16>,
-      std::array<uint8_t, 20>,
-      uint64_t
-    >, 10
-  > recs;
+  static constexpr size_t RECORD_LENGTH = 1 + 16 + 1 + 20 + 1 + 8;
 
-  std::array<uint64_t, 10> md5s_r, sha1s_r, sizes_r;
+  // record i has md5s[i], sha1s[9-i], sizes[i]
+  std::array<uint8_t, 10 * RECORD_LENGTH> recs;
 
-  for (int i = 0; i < 10; ++i) {
-    recs[i] = { md5s[i], sha1s[9-i], sizes[i] };
-    md5s_r[i] = i;
-    sha1s_r[i] = 9-i;
-    sizes_r[i] = i;
-  }
+  std::array<uint64_t, 10> md5s_r, sha1s_r, sizes_r;
 
   SFHASH_Hashset hset;
 
-  hset.holder.rhdr = {
-    44,
-    10,
-    {
-      { SFHASH_MD5,   "MD5",   16 },
-      { SFHASH_SHA_1, "SHA-1", 20 },
-      { SFHASH_SIZE,  "size",   8 }
+  RecordLookupFixture() {
+    for (size_t i = 0; i < 10; ++i) {
+      uint8_t* r = recs.data() + i * RECORD_LENGTH;
+      r[0] = 1;
+      std::memcpy(r + 1, md5s[i].data(), 16);
+      r[17] = 1;
+      std::memcpy(r + 18, sha1s[9-i].data(), 20);
+      r[38] = 1;
+      std::memcpy(r + 39, &sizes[i], 8);
+
+      md5s_r[i] = i;
+      sha1s_r[i] = 9-i;
+      sizes_r[i] = i;
     }
-  };
 
-  hset.holder.rdat = {
-    reinterpret_cast<uint8_t*>(recs.begin()),
-    reinterpret_cast<uint8_t*>(recs.end())
-  };
+    hset.holder.rhdr = {
+      RECORD_LENGTH,
+      10,
+      {
+        { SFHASH_MD5,   "MD5",   16 },
+        { SFHASH_SHA_1, "SHA-1", 20 },
+        { SFHASH_SIZE,  "size",   8 }
+      }
+    };
 
-  hset.holder.hsets.emplace_back(
-    HashsetHeader{ SFHASH_MD5, "MD5", 16, 0 },
-    HashsetHint{},
-    ConstHashsetData{ md5s.begin(), md5s.end() },
-    std::unique_ptr<LookupStrategy>(),
-    ConstRecordIndex{ md5s_r.begin(), md5s_r.end() }
-  );
+    hset.holder.rdat = { recs.data(), recs.data() + recs.size() };
 
-  hset.holder.hsets.emplace_back(
-    HashsetHeader{ SFHASH_SHA_1, "SHA-1", 20, 0 },
-    HashsetHint{},
-    ConstHashsetData{ sha1s.begin(), sha1s.end() },
-    std::unique_ptr<LookupStrategy>(),
-    ConstRecordIndex{ sha1s_r.begin(), sha1s_r.end() }
-  );
+    hset.holder.hsets.emplace_back(
+      HashsetHeader{ SFHASH_MD5, "MD5", 16, 10 },
+      HashsetHint{},
+      ConstHashsetData{ md5s.begin(), md5s.end() },
+      std::unique_ptr<LookupStrategy>(new BasicLookupStrategy<16>(md5s.begin(), md5s.end())),
+      ConstRecordIndex{ md5s_r.begin(), md5s_r.end() },
+      HashsetIndex{}
+    );
 
-  hset.holder.hsets.emplace_back(
-    HashsetHeader{ SFHASH_SIZE, "size", 8, 0 },
-    HashsetHint{},
-    ConstHashsetData{ sizes.begin(), sizes.end() },
-    std::unique_ptr<LookupStrategy>(),
-    ConstRecordIndex{ sizes_r.begin(), sizes_r.end() }
-  );
+    hset.holder.hsets.emplace_back(
+      HashsetHeader{ SFHASH_SHA_1, "SHA-1", 20, 10 },
+      HashsetHint{},
+      ConstHashsetData{ sha1s.begin(), sha1s.end() },
+      std::unique_ptr<LookupStrategy>(new BasicLookupStrategy<20>(sha1s.begin(), sha1s.end())),
+      ConstRecordIndex{ sha1s_r.begin(), sha1s_r.end() },
+      HashsetIndex{}
+    );
+
+    hset.holder.hsets.emplace_back(
+      HashsetHeader{ SFHASH_SIZE, "size", 8, 10 },
+      HashsetHint{},
+      ConstHashsetData{ sizes.begin(), sizes.end() },
+      std::unique_ptr<LookupStrategy>(new BasicLookupStrategy<8>(sizes.begin(), sizes.end())),
+      ConstRecordIndex{ sizes_r.begin(), sizes_r.end() },
+      HashsetIndex{}
+    );
+  }
+};
+
+TEST_CASE("hashset_record_lookup") {
+  RecordLookupFixture fx;
 
   // lookup records for some MD5s
 
-  std::vector<
-    std::pair<
-      std::array<uint8_t, 16>,
-      std::map<
-        SFHASH_HashAlgorithm,
-        std::variant<
-          std::array<uint8_t, 16>,
-          std::array<uint8_t, 20>,
-          uint64_t
-        >
-      >
-    >
-  > tests_16{
-    {
-      to_bytes<16>("00000000000000000000000000000000"),
-      {}
-    },
-    {
-      to_bytes<16>("deadbeefdeadbeefdeadbeefdeadbeef"),
-      {}
-    },
-    {
-      to_bytes<16>("ffffffffffffffffffffffffffffffff"),
-      {}
-    }
+  std::vector<std::pair<std::array<uint8_t, 16>, RecordFields>> tests_16{
+    { to_bytes<16>("00000000000000000000000000000000"), {} },
+    { to_bytes<16>("deadbeefdeadbeefdeadbeefdeadbeef"), {} },
+    { to_bytes<16>("ffffffffffffffffffffffffffffffff"), {} }
   };
 
   for (int i = 0; i < 10; ++i) {
     tests_16.emplace_back(
-      md5s[i],
-      std::map<SFHASH_HashAlgorithm,
-        std::variant<
-          std::array<uint8_t, 16>,
-          std::array<uint8_t, 20>,
-          uint64_t
-        >
-      >{
-        { SFHASH_MD5, md5s[i] },
-        { SFHASH_SHA_1, sha1s[9-i] },
-        { SFHASH_SIZE, sizes[i] }
+      fx.md5s[i],
+      RecordFields{
+        { SFHASH_MD5, to_vec(fx.md5s[i]) },
+        { SFHASH_SHA_1, to_vec(fx.sha1s[9-i]) },
+        { SFHASH_SIZE, to_vec(fx.sizes[i]) }
       }
     );
   }
 
-  do_record_lookups(&hset, SFHASH_MD5, tests_16);
+  do_record_lookups(&fx.hset, SFHASH_MD5, tests_16);
 
   // lookup records for some SHA1s
 
-  std::vector<
-    std::pair<
-      std::array<uint8_t, 20>,
-      std::map<
-        SFHASH_HashAlgorithm,
-        std::variant<
-          std::array<uint8_t, 16>,
-          std::array<uint8_t, 20>,
-          uint64_t
-        >
-      >
-    >
-  > tests_20{
-    {
-      to_bytes<20>("0000000000000000000000000000000000000000"),
-      {}
-    },
-    {
-      to_bytes<20>("deadbeefdeadbeefdeadbeefdeadbeefdeadbeef"),
-      {}
-    },
-    {
-      to_bytes<20>("ffffffffffffffffffffffffffffffffffffffff"),
-      {}
-    }
+  std::vector<std::pair<std::array<uint8_t, 20>, RecordFields>> tests_20{
+    { to_bytes<20>("0000000000000000000000000000000000000000"), {} },
+    { to_bytes<20>("deadbeefdeadbeefdeadbeefdeadbeefdeadbeef"), {} },
+    { to_bytes<20>("ffffffffffffffffffffffffffffffffffffffff"), {} }
   };
 
   for (int i = 0; i < 10; ++i) {
     tests_20.emplace_back(
-      sha1s[i],
-      std::map<SFHASH_HashAlgorithm,
-        std::variant<
-          std::array<uint8_t, 16>,
-          std::array<uint8_t, 20>,
-          uint64_t
-        >
-      >{
-        { SFHASH_MD5, md5s[9-i] },
-        { SFHASH_SHA_1, sha1s[i] },
-        { SFHASH_SIZE, sizes[9-i] }
+      fx.sha1s[i],
+      RecordFields{
+        { SFHASH_MD5, to_vec(fx.md5s[9-i]) },
+        { SFHASH_SHA_1, to_vec(fx.sha1s[i]) },
+        { SFHASH_SIZE, to_vec(fx.sizes[9-i]) }
       }
     );
   }
 
-  do_record_lookups(&hset, SFHASH_SHA_1, tests_20);
+  do_record_lookups(&fx.hset, SFHASH_SHA_1, tests_20);
+}
+
+TEST_CASE("hashset_record_lookup_duplicates") {
+  // three records share a size
+  std::array<uint64_t, 6> sizes{ 1, 2, 2, 2, 3, 4 };
+  std::array<uint64_t, 6> sizes_r{ 5, 0, 3, 4, 1, 2 };
+
+  std::vector<uint8_t> recs(6 * 9);
+  for (size_t i = 0; i < 6; ++i) {
+    uint8_t* r = recs.data() + sizes_r[i] * 9;
+    r[0] = 1;
+    std::memcpy(r + 1, &sizes[i], 8);
+  }
+
+  SFHASH_Hashset hset;
+  hset.holder.rhdr = { 9, 6, { { SFHASH_SIZE, "size", 8 } } };
+  hset.holder.rdat = { recs.data(), recs.data() + recs.size() };
+  hset.holder.hsets.emplace_back(
+    HashsetHeader{ SFHASH_SIZE, "size", 8, 6 },
+    HashsetHint{},
+    ConstHashsetData{ sizes.begin(), sizes.end() },
+    std::unique_ptr<LookupStrategy>(new BasicLookupStrategy<8>(sizes.begin(), sizes.end())),
+    ConstRecordIndex{ sizes_r.begin(), sizes_r.end() },
+    HashsetIndex{}
+  );
+
+  const uint64_t two = 2;
+  const auto [beg, end] = sfhash_hashset_records_lookup(&hset, 0, &two);
+  CHECK(beg == 1);
+  CHECK(end == 4);
+
+  std::vector<const SFHASH_HashsetRecord*> recs_got;
+  for (auto i = beg; i != end; ++i) {
+    recs_got.push_back(sfhash_hashset_record_for_hash(&hset, 0, i));
+  }
+
+  const std::vector<const SFHASH_HashsetRecord*> recs_exp{
+    sfhash_hashset_record(&hset, 0),
+    sfhash_hashset_record(&hset, 3),
+    sfhash_hashset_record(&hset, 4)
+  };
+
+  CHECK(recs_got == recs_exp);
+}
+
+TEST_CASE("hashset_record_lookup_no_records") {
+  std::array<uint64_t, 3> sizes{ 1, 2, 3 };
+
+  SFHASH_Hashset hset;
+  hset.holder.hsets.emplace_back(
+    HashsetHeader{ SFHASH_SIZE, "size", 8, 3 },
+    HashsetHint{},
+    ConstHashsetData{ sizes.begin(), sizes.end() },
+    std::unique_ptr<LookupStrategy>(new BasicLookupStrategy<8>(sizes.begin(), sizes.end())),
+    ConstRecordIndex{},
+    HashsetIndex{}
+  );
+
+  const uint64_t two = 2;
+  const auto [beg, end] = sfhash_hashset_records_lookup(&hset, 0, &two);
+  CHECK(beg == end);
+
+  SFHASH_Error* err = nullptr;
+  const auto m = make_unique_del(
+    sfhash_hashset_records_lookup_bulk(&hset, 0, &two, 1, &err),
+    sfhash_hashset_record_matches_destroy
+  );
+
+  REQUIRE(!err);
+  REQUIRE(m);
+  CHECK(sfhash_hashset_record_matches_count(m.get()) == 0);
+}
+
+TEST_CASE("hashset_records_lookup_bulk") {
+  RecordLookupFixture fx;
+
+  // a miss, then the SHA1s in reverse, one of them twice
+  std::vector<std::array<uint8_t, 20>> hashes{
+    to_bytes<20>("deadbeefdeadbeefdeadbeefdeadbeefdeadbeef")
+  };
+  for (int i = 9; i >= 0; --i) {
+    hashes.push_back(fx.sha1s[i]);
+  }
+  hashes.push_back(fx.sha1s[4]);
+
+  const auto tidx = sfhash_hashset_index_for_type(&fx.hset, SFHASH_SHA_1);
+  REQUIRE(tidx != -1);
+
+  SFHASH_Error* err = nullptr;
+  const auto m = make_unique_del(
+    sfhash_hashset_records_lookup_bulk(
+      &fx.hset, tidx, hashes.data(), hashes.size(), &err
+    ),
+    sfhash_hashset_record_matches_destroy
+  );
+
+  REQUIRE(!err);
+  REQUIRE(m);
+
+  // sha1s[i] is in record 9-i, which hashes[i+1] sought
+  const std::vector<std::pair<size_t, uint64_t>> exp{
+    { 1, 0 }, { 2, 1 }, { 3, 2 }, { 4, 3 }, { 5, 4 },
+    { 6, 5 }, { 11, 5 }, { 7, 6 }, { 8, 7 }, { 9, 8 }, { 10, 9 }
+  };
+
+  const auto n = sfhash_hashset_record_matches_count(m.get());
+  const auto ms = sfhash_hashset_record_matches(m.get());
+
+  std::vector<std::pair<size_t, uint64_t>> act;
+  for (size_t i = 0; i < n; ++i) {
+    act.emplace_back(ms[i].hash_index, ms[i].record_index);
+
+    // each record has the hash which matched it
+    const auto r = sfhash_hashset_record(&fx.hset, ms[i].record_index);
+    const auto f = static_cast<const uint8_t*>(sfhash_hashset_record_field(r, 17));
+    CHECK(!std::memcmp(f + 1, hashes[ms[i].hash_index].data(), 20));
+  }
+
+  CHECK(act == exp);
 }
 
 TEST_CASE("hashset_builder_open_overlong_name") {
@@ -0,0 +1,162 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "hashset/block_linear_ls.h"
+#include "hashset/block_ls.h"
+#include "hashset/hint_select.h"
+#include "hashset/hset_structs.h"
+#include "hashset/radius_ls.h"
+#include "hashset/range_ls.h"
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <random>
+#include <vector>
+
+template <size_t HashLength>
+std::vector<std::array<uint8_t, HashLength>> make_hint_hashes(
+  size_t count,
+  unsigned seed,
+  size_t fixed = 0)
+{
+  std::mt19937 rng(seed);
+  std::vector<std::array<uint8_t, HashLength>> hashes(count);
+  for (auto& h: hashes) {
+    for (size_t i = 0; i < HashLength; ++i) {
+      // a fixed head skews the hashes, as truncation or small sizes do
+      h[i] = i < fixed ? 0 : rng();
+    }
+  }
+  std::sort(hashes.begin(), hashes.end());
+  hashes.erase(std::unique(hashes.begin(), hashes.end()), hashes.end());
+  return hashes;
+}
+
+template <size_t HashLength, size_t BlockBits>
+std::unique_ptr<BasicLookupStrategy<HashLength>> make_block_hint_ls(
+  const void* beg,
+  const void* end,
+  const HintCandidate& hint)
+{
+  if constexpr (BlockBits > MAX_HINT_BLOCK_BITS) {
+    return nullptr;
+  }
+  else if (hint_block_bits(hint.hint_type) != BlockBits) {
+    return make_block_hint_ls<HashLength, BlockBits + 1>(beg, end, hint);
+  }
+  else if (hint_kind(hint.hint_type) == HintType::BLOCK) {
+    return std::make_unique<BlockLookupStrategy<HashLength, BlockBits>>(
+      beg, end, hint.blocks
+    );
+  }
+  else {
+    return std::make_unique<BlockLinearLookupStrategy<HashLength, BlockBits>>(
+      beg, end, hint.lines
+    );
+  }
+}
+
+// Checks that the window of every hash under the hint holds it
+template <size_t HashLength>
+void check_hint_windows(
+  const std::vector<std::array<uint8_t, HashLength>>& hashes,
+  const HintCandidate& hint)
+{
+  const auto beg = hashes.data();
+  const auto end = hashes.data() + hashes.size();
+
+  std::unique_ptr<BasicLookupStrategy<HashLength>> ls;
+  switch (hint_kind(hint.hint_type)) {
+  case HintType::RADIUS:
+    ls = std::make_unique<RadiusLookupStrategy<HashLength>>(beg, end, hint.right);
+    break;
+  case HintType::RANGE:
+    ls = std::make_unique<RangeLookupStrategy<HashLength>>(beg, end, hint.left, hint.right);
+    break;
+  case HintType::BLOCK:
+  case HintType::BLOCK_LINEAR:
+    ls = make_block_hint_ls<HashLength, MIN_HINT_BLOCK_BITS>(beg, end, hint);
+    break;
+  default:
+    ls = std::make_unique<BasicLookupStrategy<HashLength>>(beg, end);
+  }
+
+  REQUIRE(ls);
+
+  for (const auto& h: hashes) {
+    REQUIRE(ls->contains(h.data()));
+  }
+}
+
+TEST_CASE("max_hint_block_bits") {
+  CHECK(max_hint_block_bits(0) == 0);
+  CHECK(max_hint_block_bits(1) == 0);
+  CHECK(max_hint_block_bits(1023) == 0);
+  CHECK(max_hint_block_bits(1024) == 4);
+  CHECK(max_hint_block_bits(100000) == 10);
+  CHECK(max_hint_block_bits(uint64_t(1) << 22) == 16);
+  CHECK(max_hint_block_bits(uint64_t(1) << 32) == 16);
+}
+
+TEST_CASE("select_hint_none") {
+  const auto hint = select_hint(nullptr, 0, 20);
+  CHECK(hint.hint_type == make_hint_type(HintType::BASIC));
+  CHECK(hint.cost == 0.0);
+}
+
+TEST_CASE("select_hint_small") {
+  // too few hashes for blocks, but a radius or range still narrows the
+  // search
+  const auto hashes = make_hint_hashes<20>(700, 1);
+  const auto hint = select_hint(hashes.front().data(), hashes.size(), 20);
+
+  const auto kind = hint_kind(hint.hint_type);
+  CHECK((kind == HintType::RADIUS || kind == HintType::RANGE));
+  CHECK(hint.left <= 0);
+  CHECK(hint.right >= 0);
+  CHECK(hint.cost < 10.0);
+
+  check_hint_windows(hashes, hint);
+}
+
+TEST_CASE("select_hint_uniform") {
+  const auto hashes = make_hint_hashes<20>(200000, 2);
+  const auto hint = select_hint(hashes.front().data(), hashes.size(), 20);
+
+  const auto kind = hint_kind(hint.hint_type);
+  CHECK((kind == HintType::BLOCK || kind == HintType::BLOCK_LINEAR));
+  CHECK(hint_block_bits(hint.hint_type) >= MIN_HINT_BLOCK_BITS);
+  CHECK(hint_block_bits(hint.hint_type) <= max_hint_block_bits(hashes.size()));
+
+  // far better than the 18 probes of a search of everything
+  CHECK(hint.cost < 10.0);
+
+  check_hint_windows(hashes, hint);
+}
+
+TEST_CASE("select_hint_skewed") {
+  // every hash has the same expected index, so no hint narrows the search
+  const auto hashes = make_hint_hashes<8>(20000, 3, 4);
+  const auto hint = select_hint(hashes.front().data(), hashes.size(), 8);
+
+  CHECK(hint.hint_type == make_hint_type(HintType::BASIC));
+
+  check_hint_windows(hashes, hint);
+}
+
+TEST_CASE("select_hint_half_skewed") {
+  // a fixed head on half the hashes wrecks any bounds over the whole set,
+  // but blocks can keep the damage to the blocks with those hashes
+  auto hashes = make_hint_hashes<16>(50000, 4, 3);
+  const auto rest = make_hint_hashes<16>(50000, 5);
+  hashes.insert(hashes.end(), rest.begin(), rest.end());
+  std::sort(hashes.begin(), hashes.end());
+  hashes.erase(std::unique(hashes.begin(), hashes.end()), hashes.end());
+
+  const auto hint = select_hint(hashes.front().data(), hashes.size(), 16);
+
+  const auto kind = hint_kind(hint.hint_type);
+  CHECK((kind == HintType::BLOCK || kind == HintType::BLOCK_LINEAR));
+
+  check_hint_windows(hashes, hint);
+}
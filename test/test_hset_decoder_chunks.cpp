@@ -255,3 +255,35 @@ TEST_CASE("parse_rdat") {
 
   CHECK(parse_rdat(ch) == exp);
 }
+
+TEST_CASE("parse_hidx") {
+  const uint8_t buf[] = {
+    // index type
+    0x01, 0x00,
+    // data!
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07
+  };
+
+  const Chunk ch{Chunk::Type::HIDX, std::begin(buf), std::end(buf)};
+
+  const HashsetIndex exp{ 0x0001, std::begin(buf) + 2, std::end(buf) };
+
+  CHECK(parse_hidx(ch) == exp);
+}
+
+TEST_CASE("parse_csum") {
+  const uint8_t buf[] = {
+    // checksum type
+    0x01, 0x00,
+    // segment length
+    0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00,
+    // digests
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07
+  };
+
+  const Chunk ch{Chunk::Type::CSUM, std::begin(buf), std::end(buf)};
+
+  const ChunkChecksums exp{ 0x0001, 1 << 22, std::begin(buf) + 10, std::end(buf) };
+
+  CHECK(parse_csum(ch) == exp);
+}
@@ -1,6 +1,17 @@
 #include "hashset/hset_encoder.h"
 
+#include "helper.h"
+#include "hex.h"
+#include "util.h"
+
+#include <array>
+#include <fstream>
+#include <functional>
 #include <initializer_list>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
 #include <utility>
 
 #include <catch2/catch_test_macros.hpp>
@@ -37,3 +48,487 @@ TEST_CASE("size_to_u64_bad") {
     }
   }
 }
+
+// lines of MD5s, sizes, and SHA-1s, some missing, with some blank lines
+std::string make_ingest_text() {
+  std::mt19937 rng(3);
+  std::ostringstream out;
+  for (size_t i = 0; i < 2000; ++i) {
+    std::array<uint8_t, 16> md5;
+    std::array<uint8_t, 20> sha1;
+    for (auto& b: md5) {
+      b = rng();
+    }
+    for (auto& b: sha1) {
+      b = rng();
+    }
+
+    if (i % 11) {
+      out << to_hex(md5);
+    }
+    out << ' ' << rng() << ' ';
+    if (i % 13) {
+      out << to_hex(sha1);
+    }
+    out << '\n';
+
+    if (i % 17 == 0) {
+      out << '\n';
+    }
+  }
+  return out.str();
+}
+
+template <class Input>
+void ingest_to(
+  const std::string& outfile,
+  Input& in,
+  unsigned threads,
+  size_t chunk_length)
+{
+  const std::vector<SFHASH_HashAlgorithm> htypes{
+    SFHASH_MD5, SFHASH_SIZE, SFHASH_SHA_1
+  };
+  const auto conv = make_text_converters(htypes);
+
+  SFHASH_Error* err = nullptr;
+  auto bctx = make_unique_del(
+    sfhash_hashset_builder_open(
+      "ingest", "in chunks", htypes.data(), htypes.size(), false, true,
+      outfile.c_str(), "test", &err
+    ),
+    sfhash_hashset_builder_destroy
+  );
+  REQUIRE(!err);
+
+  // the same timestamp, so the files can be compared
+  bctx->fhdr.time = "2000-01-01T00:00:00Z";
+
+  TextIngester ing(bctx.get(), conv, threads, chunk_length);
+  ing.ingest(in);
+  CHECK(ing.lines() == 2000 + 118);
+
+  sfhash_hashset_builder_write(bctx.get(), &err);
+  REQUIRE(!err);
+}
+
+TEST_CASE("text_ingester_chunks") {
+  const std::string text = make_ingest_text();
+  const std::string infile = "test/ingest.txt";
+  {
+    std::ofstream out(infile, std::ios::binary);
+    out << text;
+  }
+
+  {
+    std::istringstream in(text);
+    ingest_to("test/ingest_exp.hset", in, 1, 1 << 22);
+  }
+  const auto exp = read_file("test/ingest_exp.hset");
+
+  for (auto [threads, chunk_length]: {
+    std::make_pair(1u, size_t{1}),
+    std::make_pair(3u, size_t{100}),
+    std::make_pair(4u, size_t{4096})
+  }) {
+    INFO(threads << " x " << chunk_length);
+
+    std::istringstream in(text);
+    ingest_to("test/ingest_act.hset", in, threads, chunk_length);
+    CHECK(read_file("test/ingest_act.hset") == exp);
+
+    const std::filesystem::path p(infile);
+    ingest_to("test/ingest_act.hset", p, threads, chunk_length);
+    CHECK(read_file("test/ingest_act.hset") == exp);
+  }
+}
+
+TEST_CASE("text_ingester_errors") {
+  const std::vector<SFHASH_HashAlgorithm> htypes{ SFHASH_MD5, SFHASH_SIZE };
+  const auto conv = make_text_converters(htypes);
+
+  std::ostringstream good;
+  for (size_t i = 0; i < 40; ++i) {
+    good << "0123456789abcdef0123456789abcdef " << i << '\n';
+  }
+
+  for (const auto& [bad, msg]: {
+    std::make_pair("0123456789abcdef0123456789abcdef", "too few columns at line 41"),
+    std::make_pair("0123456789abcdef0123456789abcdef 1 2", "too many columns at line 41"),
+    std::make_pair("0123456789abcdef0123456789abcdeg 1", "at line 41"),
+    std::make_pair("0123456789abcdef0123456789abcdef x", "at line 41")
+  }) {
+    for (const size_t chunk_length: { size_t{1}, size_t{64}, size_t{1} << 22 }) {
+      INFO(bad << ' ' << chunk_length);
+
+      SFHASH_Error* err = nullptr;
+      auto bctx = make_unique_del(
+        sfhash_hashset_builder_open(
+          "bad", "line", htypes.data(), htypes.size(), false, true,
+          "test/ingest_bad.hset", "test", &err
+        ),
+        sfhash_hashset_builder_destroy
+      );
+      REQUIRE(!err);
+
+      std::istringstream in(good.str() + bad + "\n" + good.str());
+      TextIngester ing(bctx.get(), conv, 3, chunk_length);
+      std::string what;
+      try {
+        ing.ingest(in);
+      }
+      catch (const std::exception& e) {
+        what = e.what();
+      }
+
+      const std::string exp(msg);
+      REQUIRE(what.size() >= exp.size());
+      CHECK(what.substr(what.size() - exp.size()) == exp);
+      CHECK(ing.lines() <= 40);
+    }
+  }
+}
+
+// MD5+SHA-1 records, a few without the SHA-1, some duplicated
+std::vector<std::array<uint8_t, 38>> make_thread_records() {
+  std::mt19937 rng(5);
+  std::vector<std::array<uint8_t, 38>> recs(20000);
+  for (size_t i = 0; i < recs.size(); ++i) {
+    auto& r = recs[i];
+    if (i % 9 == 8) {
+      r = recs[i / 3];
+      continue;
+    }
+
+    std::generate(r.begin(), r.end(), std::ref(rng));
+    r[0] = 0x01;
+    r[17] = i % 7 ? 0x01 : 0x00;
+    if (!r[17]) {
+      std::fill(r.begin() + 18, r.end(), 0);
+    }
+  }
+  return recs;
+}
+
+auto open_thread_test_builder(const std::string& outfile, bool with_records) {
+  const SFHASH_HashAlgorithm htypes[] = { SFHASH_MD5, SFHASH_SHA_1 };
+
+  SFHASH_Error* err = nullptr;
+  auto bctx = make_unique_del(
+    sfhash_hashset_builder_open(
+      "threads", "staged", htypes, 2, with_records, !with_records,
+      outfile.c_str(), "test", &err
+    ),
+    sfhash_hashset_builder_destroy
+  );
+  REQUIRE(!err);
+
+  // the same timestamp, so the files can be compared
+  bctx->fhdr.time = "2000-01-01T00:00:00Z";
+  return bctx;
+}
+
+void add_thread_test_hashes(
+  const std::array<uint8_t, 38>& r,
+  SFHASH_HashsetBuildThreadCtx* tctx)
+{
+  sfhash_hashset_builder_thread_add_hash(tctx, r.data() + 1, 16);
+  sfhash_hashset_builder_thread_add_hash(tctx, r.data() + 18, r[17] ? 20 : 0);
+}
+
+TEST_CASE("hset_builder_threads") {
+  const auto recs = make_thread_records();
+
+  for (const bool with_records: { true, false }) {
+    INFO(with_records);
+
+    SFHASH_Error* err = nullptr;
+
+    {
+      auto bctx = open_thread_test_builder("test/threads_exp.hset", with_records);
+      for (const auto& r: recs) {
+        if (with_records) {
+          sfhash_hashset_builder_add_record(bctx.get(), r.data());
+        }
+        else {
+          sfhash_hashset_builder_add_hash(bctx.get(), r.data() + 1, 16);
+          sfhash_hashset_builder_add_hash(bctx.get(), r.data() + 18, r[17] ? 20 : 0);
+        }
+      }
+      sfhash_hashset_builder_write(bctx.get(), &err);
+      REQUIRE(!err);
+    }
+
+    {
+      auto bctx = open_thread_test_builder("test/threads_act.hset", with_records);
+
+      const unsigned threads = 4;
+      std::vector<SFHASH_HashsetBuildThreadCtx*> tctxs;
+      for (unsigned k = 0; k < threads; ++k) {
+        tctxs.push_back(sfhash_hashset_builder_thread_open(bctx.get(), &err));
+        REQUIRE(!err);
+        // flush often
+        tctxs.back()->buffer_length = 100 * (k + 1);
+      }
+
+      std::vector<std::thread> workers;
+      for (unsigned k = 0; k < threads; ++k) {
+        workers.emplace_back([&recs, tctx = tctxs[k], k]() {
+          for (size_t i = k; i < recs.size(); i += threads) {
+            if (i % 2) {
+              sfhash_hashset_builder_thread_add_record(tctx, recs[i].data());
+            }
+            else {
+              add_thread_test_hashes(recs[i], tctx);
+            }
+          }
+        });
+      }
+
+      for (auto& w: workers) {
+        w.join();
+      }
+
+      // not until the handles are closed
+      sfhash_hashset_builder_write(bctx.get(), &err);
+      REQUIRE(err);
+      sfhash_free_error(err);
+      err = nullptr;
+
+      for (auto tctx: tctxs) {
+        sfhash_hashset_builder_thread_close(tctx, &err);
+        REQUIRE(!err);
+      }
+
+      sfhash_hashset_builder_write(bctx.get(), &err);
+      REQUIRE(!err);
+    }
+
+    CHECK(read_file("test/threads_act.hset") == read_file("test/threads_exp.hset"));
+  }
+}
+
+TEST_CASE("hset_builder_thread_incomplete") {
+  const auto recs = make_thread_records();
+
+  for (const bool with_records: { true, false }) {
+    INFO(with_records);
+
+    auto bctx = open_thread_test_builder("test/threads_incomplete.hset", with_records);
+
+    SFHASH_Error* err = nullptr;
+    auto tctx = sfhash_hashset_builder_thread_open(bctx.get(), &err);
+    REQUIRE(!err);
+
+    add_thread_test_hashes(recs[0], tctx);
+    sfhash_hashset_builder_thread_add_hash(tctx, recs[1].data() + 1, 16);
+
+    sfhash_hashset_builder_thread_close(tctx, &err);
+    REQUIRE(err);
+    sfhash_free_error(err);
+    err = nullptr;
+
+    // the incomplete record is dropped, hashes and all
+    CHECK(bctx->rhdr.record_count == 1);
+    if (!with_records) {
+      CHECK(std::get<HashsetHeader>(bctx->hsets[0]).hash_count == 1);
+    }
+
+    sfhash_hashset_builder_write(bctx.get(), &err);
+    REQUIRE(!err);
+  }
+}
+
+TEST_CASE("hset_builder_thread_add_error") {
+  const auto recs = make_thread_records();
+
+  for (const bool with_records: { true, false }) {
+    INFO(with_records);
+
+    auto bctx = open_thread_test_builder("test/threads_error.hset", with_records);
+
+    SFHASH_Error* err = nullptr;
+    auto tctx = sfhash_hashset_builder_thread_open(bctx.get(), &err);
+    REQUIRE(!err);
+
+    // flush every record, to outputs which can no longer be written
+    tctx->buffer_length = 0;
+    bctx->out.close();
+    for (auto& o: bctx->tmp_hashes_out) {
+      o.close();
+    }
+
+    CHECK_NOTHROW(add_thread_test_hashes(recs[0], tctx));
+    CHECK_NOTHROW(sfhash_hashset_builder_thread_add_record(tctx, recs[1].data()));
+
+    sfhash_hashset_builder_thread_close(tctx, &err);
+    REQUIRE(err);
+    sfhash_free_error(err);
+
+    CHECK(bctx->open_threads == 0);
+  }
+}
+
+TEST_CASE("hset_builder_thread_bad_length") {
+  const auto recs = make_thread_records();
+
+  for (const bool with_records: { true, false }) {
+    INFO(with_records);
+
+    SFHASH_Error* err = nullptr;
+
+    {
+      auto bctx = open_thread_test_builder("test/threads_exp.hset", with_records);
+      auto tctx = sfhash_hashset_builder_thread_open(bctx.get(), &err);
+      REQUIRE(!err);
+
+      add_thread_test_hashes(recs[0], tctx);
+      add_thread_test_hashes(recs[2], tctx);
+
+      sfhash_hashset_builder_thread_close(tctx, &err);
+      REQUIRE(!err);
+      sfhash_hashset_builder_write(bctx.get(), &err);
+      REQUIRE(!err);
+    }
+
+    {
+      auto bctx = open_thread_test_builder("test/threads_act.hset", with_records);
+      auto tctx = sfhash_hashset_builder_thread_open(bctx.get(), &err);
+      REQUIRE(!err);
+
+      add_thread_test_hashes(recs[0], tctx);
+      // a short MD5, then a long SHA-1
+      sfhash_hashset_builder_thread_add_hash(tctx, recs[1].data() + 1, 15);
+      sfhash_hashset_builder_thread_add_hash(tctx, recs[1].data() + 18, 20);
+      sfhash_hashset_builder_thread_add_hash(tctx, recs[3].data() + 1, 16);
+      sfhash_hashset_builder_thread_add_hash(tctx, recs[3].data() + 17, 21);
+      add_thread_test_hashes(recs[2], tctx);
+
+      sfhash_hashset_builder_thread_close(tctx, &err);
+      REQUIRE(err);
+      sfhash_free_error(err);
+      err = nullptr;
+
+      // the bad records are dropped, and the rest stay aligned
+      CHECK(bctx->rhdr.record_count == 2);
+
+      sfhash_hashset_builder_write(bctx.get(), &err);
+      REQUIRE(!err);
+    }
+
+    CHECK(read_file("test/threads_act.hset") == read_file("test/threads_exp.hset"));
+  }
+}
+
+TEST_CASE("hset_builder_add_records") {
+  const auto recs = make_thread_records();
+
+  for (const bool with_records: { true, false }) {
+    INFO(with_records);
+
+    SFHASH_Error* err = nullptr;
+
+    {
+      // a hash at a time, with missing hashes
+      auto bctx = open_thread_test_builder("test/bulk_exp.hset", with_records);
+      for (const auto& r: recs) {
+        sfhash_hashset_builder_add_hash(bctx.get(), r.data() + 1, 16);
+        sfhash_hashset_builder_add_hash(bctx.get(), r.data() + 18, r[17] ? 20 : 0);
+      }
+      sfhash_hashset_builder_write(bctx.get(), &err);
+      REQUIRE(!err);
+    }
+
+    {
+      auto bctx = open_thread_test_builder("test/bulk_act.hset", with_records);
+      sfhash_hashset_builder_add_record(bctx.get(), recs[0].data());
+      sfhash_hashset_builder_add_records(bctx.get(), recs[1].data(), recs.size() - 1, &err);
+      REQUIRE(!err);
+      CHECK(bctx->rhdr.record_count == recs.size());
+      sfhash_hashset_builder_write(bctx.get(), &err);
+      REQUIRE(!err);
+    }
+
+    CHECK(read_file("test/bulk_act.hset") == read_file("test/bulk_exp.hset"));
+  }
+}
+
+TEST_CASE("hset_builder_add_hashes") {
+  std::mt19937 rng(9);
+  std::vector<std::array<uint8_t, 20>> sha1s(30000);
+  for (auto& h: sha1s) {
+    std::generate(h.begin(), h.end(), std::ref(rng));
+  }
+
+  for (const bool with_records: { true, false }) {
+    INFO(with_records);
+
+    SFHASH_Error* err = nullptr;
+
+    {
+      auto bctx = open_thread_test_builder("test/bulk_exp.hset", with_records);
+      for (const auto& h: sha1s) {
+        sfhash_hashset_builder_add_hash(bctx.get(), nullptr, 0);
+        sfhash_hashset_builder_add_hash(bctx.get(), h.data(), h.size());
+      }
+      sfhash_hashset_builder_write(bctx.get(), &err);
+      REQUIRE(!err);
+    }
+
+    {
+      auto bctx = open_thread_test_builder("test/bulk_act.hset", with_records);
+      sfhash_hashset_builder_add_hashes(bctx.get(), 1, sha1s.data(), sha1s.size(), &err);
+      REQUIRE(!err);
+      sfhash_hashset_builder_write(bctx.get(), &err);
+      REQUIRE(!err);
+    }
+
+    CHECK(read_file("test/bulk_act.hset") == read_file("test/bulk_exp.hset"));
+  }
+}
+
+TEST_CASE("hset_builder_add_hashes_bad") {
+  auto bctx = open_thread_test_builder("test/bulk_bad.hset", true);
+  const std::array<uint8_t, 20> h{};
+
+  SFHASH_Error* err = nullptr;
+  sfhash_hashset_builder_add_hashes(bctx.get(), 2, h.data(), 1, &err);
+  REQUIRE(err);
+  sfhash_free_error(err);
+  err = nullptr;
+
+  // not in the middle of a record
+  sfhash_hashset_builder_add_hash(bctx.get(), h.data(), 16);
+  sfhash_hashset_builder_add_hashes(bctx.get(), 1, h.data(), 1, &err);
+  REQUIRE(err);
+  sfhash_free_error(err);
+}
+
+TEST_CASE("hset_builder_hashsets_only_duplicates") {
+  std::mt19937 rng(11);
+  std::vector<std::array<uint8_t, 16>> md5s(5000);
+  for (auto& h: md5s) {
+    std::generate(h.begin(), h.end(), std::ref(rng));
+  }
+
+  auto dups = md5s;
+  dups.insert(dups.end(), md5s.begin(), md5s.begin() + 3000);
+  std::shuffle(dups.begin(), dups.end(), rng);
+
+  SFHASH_Error* err = nullptr;
+
+  for (const auto& [hashes, outfile]: {
+    std::make_pair(&md5s, "test/dups_exp.hset"),
+    std::make_pair(&dups, "test/dups_act.hset")
+  }) {
+    auto bctx = open_thread_test_builder(outfile, false);
+    sfhash_hashset_builder_add_hashes(bctx.get(), 0, hashes->data(), hashes->size(), &err);
+    REQUIRE(!err);
+    sfhash_hashset_builder_write(bctx.get(), &err);
+    REQUIRE(!err);
+  }
+
+  // sorted in place, with nothing left of the duplicates in the room
+  // taken by the next field
+  CHECK(read_file("test/dups_act.hset") == read_file("test/dups_exp.hset"));
+}
@@ -150,11 +150,31 @@ TEST_CASE("write_hhnn_data") {
 }
 
 TEST_CASE("length_hint") {
-  CHECK(length_hint_data() == 4098);
-  CHECK(length_hint() == 4110);
+  CHECK(length_hint_data(0x6208) == 4098);
+  CHECK(length_hint(0x6208) == 4110);
+  CHECK(length_hint_data(0x6C08) == 4098);
+  CHECK(length_hint_data(0x6210) == 2 + 16 * 65536);
+  CHECK(length_hint_data(0x0000) == 2);
+  CHECK(length_hint_data(0x7200) == 6);
+  CHECK(length_hint_data(0x5200) == 18);
+
+  // no such type, or block bits out of range
+  CHECK_THROWS(length_hint_data(0x7800));
+  CHECK_THROWS(length_hint_data(0x6203));
+  CHECK_THROWS(length_hint_data(0x6C11));
+  CHECK_THROWS(length_hint_data(0x7201));
 }
 
-TEST_CASE("write_hint_data") {
+TEST_CASE("length_hint_max") {
+  // too few hashes for blocks leaves room for a range
+  CHECK(length_hint_max(0) == 12 + 18);
+  CHECK(length_hint_max(1023) == 12 + 18);
+  CHECK(length_hint_max(1024) == 12 + 2 + 16 * 16);
+  CHECK(length_hint_max(100000) == 12 + 2 + 16 * 1024);
+  CHECK(length_hint_max(uint64_t(1) << 30) == 12 + 2 + 16 * 65536);
+}
+
+TEST_CASE("write_block_hint_data") {
   std::vector<std::pair<int64_t, int64_t>> block_bounds(256);
   for (size_t i = 0; i < block_bounds.size(); ++i) {
     block_bounds[i] = { 2*i, 2*i + 1 };
@@ -173,12 +193,87 @@ TEST_CASE("write_hint_data") {
     cur += write_le<int64_t>(bb.second, cur);
   }
 
-  chunk_data_tester<write_hint_data>(
+  chunk_data_tester<write_block_hint_data>(
 // C++20:    std::span{exp}, block_bounds
     span{exp}, block_bounds
   );
 }
 
+TEST_CASE("write_linear_hint_data") {
+  std::vector<std::tuple<float, float, float, float>> block_lines(256);
+  for (size_t i = 0; i < block_lines.size(); ++i) {
+    block_lines[i] = { 0.5f * i, -1.0f * i, 0.25f, 2.0f * i + 1 };
+  }
+
+  uint8_t exp[2 + sizeof(float) * 4 * 256];
+
+  // hint type
+  exp[0] = 'l';
+  exp[1] = 0x08;
+
+  // block lines
+  char* cur = reinterpret_cast<char*>(exp + 2);
+  for (const auto& [la, lb, ua, ub]: block_lines) {
+    for (const float f: { la, lb, ua, ub }) {
+      uint32_t u;
+      std::memcpy(&u, &f, sizeof(u));
+      cur += write_le<uint32_t>(u, cur);
+    }
+  }
+
+  chunk_data_tester<write_linear_hint_data>(
+// C++20:    std::span{exp}, block_lines
+    span{exp}, block_lines
+  );
+}
+
+TEST_CASE("write_hint_data") {
+  HintCandidate hint{0x0000, 0.0, -3, 5, {}, {}};
+
+  const uint8_t basic[] = { 0x00, 0x00 };
+  chunk_data_tester<write_hint_data>(
+// C++20:    std::span{basic}, hint
+    span{basic}, hint
+  );
+
+  hint.hint_type = 0x7200;
+  const uint8_t radius[] = {
+    'r', 0x00,
+    0x05, 0x00, 0x00, 0x00
+  };
+  chunk_data_tester<write_hint_data>(
+// C++20:    std::span{radius}, hint
+    span{radius}, hint
+  );
+
+  hint.hint_type = 0x5200;
+  const uint8_t range[] = {
+    'R', 0x00,
+    0xFD, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0x05, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+  };
+  chunk_data_tester<write_hint_data>(
+// C++20:    std::span{range}, hint
+    span{range}, hint
+  );
+
+  // the block bits come from the number of blocks
+  hint.hint_type = 0x6204;
+  hint.blocks.assign(16, { -1, 2 });
+  std::vector<uint8_t> block(2 + 16 * 16);
+  write_block_hint_data(hint.blocks, reinterpret_cast<char*>(block.data()));
+  CHECK(block[0] == 'b');
+  CHECK(block[1] == 0x04);
+  chunk_data_tester<write_hint_data>(
+// C++20:    std::span{block}, hint
+    span<const uint8_t>{block.data(), block.size()}, hint
+  );
+
+  hint.hint_type = 0x7800;
+  std::vector<char> buf(64);
+  CHECK_THROWS(write_hint_data(hint, buf.data()));
+}
+
 TEST_CASE("length_hdat") {
   CHECK(length_hdat_data(3914, 20) == 78280);
   CHECK(length_hdat(3914, 20) == 78292);
@@ -192,6 +287,12 @@ TEST_CASE("write_hdat_data") {
   CHECK(write_hdat_data(hdat, nullptr) == 456 - 123);
 }
 
+TEST_CASE("length_hidx") {
+  // 3914 keys -> ceil(7 * 3914 / log2(3914)) = 2296 buckets
+  CHECK(length_hidx_data(3914) == 26 + 4 * 2296 + 4 * 3914);
+  CHECK(length_hidx(3914) == 38 + 4 * 2296 + 4 * 3914);
+}
+
 TEST_CASE("length_filter") {
   CHECK(length_filter_data(50) == 126);
   CHECK(length_filter(50) == 138);
@@ -321,6 +422,11 @@ TEST_CASE("length_ftoc") {
   CHECK(length_ftoc(57) == 696);
 }
 
+TEST_CASE("length_csum") {
+  CHECK(length_csum_data(7) == 234);
+  CHECK(length_csum(7) == 246);
+}
+
 TEST_CASE("write_ftoc_data") {
   const TableOfContents toc{
     {
@@ -0,0 +1,237 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "helper.h"
+#include "util.h"
+
+#include "hasher/hashset.h"
+#include "hashset/hset.h"
+#include "hashset/hset_group.h"
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <random>
+#include <vector>
+
+using SHA1 = std::array<uint8_t, 20>;
+using MD5 = std::array<uint8_t, 16>;
+
+template <class Hash>
+std::vector<Hash> make_hashes(std::mt19937& rng, size_t count) {
+  std::vector<Hash> hashes(count);
+  for (auto& h: hashes) {
+    for (auto& b: h) {
+      b = rng();
+    }
+  }
+  return hashes;
+}
+
+template <class Hash>
+void add_hashes(
+  SFHASH_Hashset& hset,
+  SFHASH_HashAlgorithm htype,
+  std::vector<Hash>& hashes)
+{
+  std::sort(hashes.begin(), hashes.end());
+
+  hset.holder.hsets.emplace_back(
+    HashsetHeader{ htype, "", std::tuple_size<Hash>::value, hashes.size() },
+    HashsetHint{},
+    ConstHashsetData{ hashes.data(), hashes.data() + hashes.size() },
+    std::unique_ptr<LookupStrategy>(),
+    ConstRecordIndex{},
+    HashsetIndex{}
+  );
+}
+
+bool has_bit(const uint64_t* members, size_t i) {
+  return (members[i / 64] >> (i % 64)) & 1;
+}
+
+void check_group(size_t set_count, size_t set_size) {
+  std::mt19937 rng(set_count);
+
+  // a pool of hashes shared among the sets, so that many are in several
+  const auto pool = make_hashes<SHA1>(rng, set_size * 2);
+  const auto md5_pool = make_hashes<MD5>(rng, set_size * 2);
+
+  std::vector<std::vector<SHA1>> sha1s(set_count);
+  std::vector<std::vector<MD5>> md5s(set_count);
+  std::vector<SFHASH_Hashset> hsets(set_count);
+
+  for (size_t i = 0; i < set_count; ++i) {
+    for (size_t j = 0; j < set_size; ++j) {
+      // with a few repeats, as in HDAT for records sharing a hash
+      sha1s[i].push_back(pool[rng() % pool.size()]);
+    }
+    add_hashes(hsets[i], SFHASH_SHA_1, sha1s[i]);
+
+    // only every third set has MD5s
+    if (i % 3 == 0) {
+      for (size_t j = 0; j < set_size; ++j) {
+        md5s[i].push_back(md5_pool[rng() % md5_pool.size()]);
+      }
+      add_hashes(hsets[i], SFHASH_MD5, md5s[i]);
+    }
+  }
+
+  std::vector<const SFHASH_Hashset*> ptrs;
+  for (const auto& h: hsets) {
+    ptrs.push_back(&h);
+  }
+
+  SFHASH_Error* err = nullptr;
+  const auto grp = make_unique_del(
+    sfhash_hashset_group_create(ptrs.data(), ptrs.size(), &err),
+    sfhash_hashset_group_destroy
+  );
+
+  REQUIRE(!err);
+  REQUIRE(grp);
+
+  const size_t words = sfhash_hashset_group_bitmap_words(grp.get());
+  REQUIRE(words == std::max<size_t>(1, (set_count + 63) / 64));
+
+  const int sidx = sfhash_hashset_group_index_for_type(grp.get(), SFHASH_SHA_1);
+  REQUIRE(sidx != -1);
+  CHECK(sfhash_hashset_group_index_for_type(grp.get(), SFHASH_BLAKE3) == -1);
+
+  // the pool plus hashes in no set
+  auto queries = pool;
+  const auto absent = make_hashes<SHA1>(rng, set_size);
+  queries.insert(queries.end(), absent.begin(), absent.end());
+
+  std::vector<uint64_t> bulk(queries.size() * words);
+  sfhash_hashset_group_lookup_bulk(
+    grp.get(), sidx, queries.data(), queries.size(), bulk.data()
+  );
+
+  std::vector<uint64_t> members(words);
+  for (size_t q = 0; q < queries.size(); ++q) {
+    const bool any = sfhash_hashset_group_lookup(
+      grp.get(), sidx, queries[q].data(), members.data()
+    );
+
+    bool exp_any = false;
+    for (size_t i = 0; i < set_count; ++i) {
+      const bool exp = std::binary_search(
+        sha1s[i].begin(), sha1s[i].end(), queries[q]
+      );
+      exp_any |= exp;
+      REQUIRE(has_bit(members.data(), i) == exp);
+      REQUIRE(has_bit(bulk.data() + q * words, i) == exp);
+    }
+
+    REQUIRE(any == exp_any);
+
+    // no stray bits past the last set
+    for (size_t i = set_count; i < 64 * words; ++i) {
+      REQUIRE(!has_bit(members.data(), i));
+    }
+  }
+
+  const int midx = sfhash_hashset_group_index_for_type(grp.get(), SFHASH_MD5);
+  REQUIRE(midx != -1);
+  for (const auto& h: md5_pool) {
+    sfhash_hashset_group_lookup(grp.get(), midx, h.data(), members.data());
+    for (size_t i = 0; i < set_count; ++i) {
+      REQUIRE(has_bit(members.data(), i) ==
+              std::binary_search(md5s[i].begin(), md5s[i].end(), h));
+    }
+  }
+}
+
+TEST_CASE("hashset_group_lookup") {
+  check_group(1, 1000);
+  check_group(5, 2000);
+  check_group(30, 500);
+}
+
+TEST_CASE("hashset_group_lookup_many_sets") {
+  // more sets than bits in a word
+  check_group(70, 100);
+}
+
+TEST_CASE("hashset_group_empty") {
+  SFHASH_Error* err = nullptr;
+  const auto grp = make_unique_del(
+    sfhash_hashset_group_create(nullptr, 0, &err),
+    sfhash_hashset_group_destroy
+  );
+
+  REQUIRE(!err);
+  CHECK(sfhash_hashset_group_bitmap_words(grp.get()) == 1);
+  CHECK(sfhash_hashset_group_index_for_type(grp.get(), SFHASH_SHA_1) == -1);
+}
+
+TEST_CASE("hashset_group_length_mismatch") {
+  std::vector<SHA1> a(1);
+  std::vector<MD5> b(1);
+
+  SFHASH_Hashset l, r;
+  add_hashes(l, SFHASH_SHA_1, a);
+  add_hashes(r, SFHASH_SHA_1, b);
+
+  const SFHASH_Hashset* hsets[] = { &l, &r };
+
+  SFHASH_Error* err = nullptr;
+  const auto grp = make_unique_del(
+    sfhash_hashset_group_create(hsets, 2, &err),
+    sfhash_hashset_group_destroy
+  );
+
+  CHECK(!grp);
+  CHECK(err);
+  sfhash_free_error(err);
+}
+
+TEST_CASE("hashset_group_stats") {
+  std::mt19937 rng(3);
+  auto hashes = make_hashes<SHA1>(rng, 1000);
+
+  SFHASH_Hashset hset;
+  add_hashes(hset, SFHASH_SHA_1, hashes);
+
+  const SFHASH_Hashset* hsets[] = { &hset };
+
+  SFHASH_Error* err = nullptr;
+  const auto grp = make_unique_del(
+    sfhash_hashset_group_create(hsets, 1, &err),
+    sfhash_hashset_group_destroy
+  );
+  REQUIRE(!err);
+
+  // half hits, half most likely turned away by the filter
+  auto queries = make_hashes<SHA1>(rng, 1000);
+  for (size_t i = 0; i < queries.size(); i += 2) {
+    queries[i] = hashes[i];
+  }
+
+  if (!sfhash_hashset_stats_enable(true)) {
+    // compiled out
+    return;
+  }
+
+  std::vector<uint64_t> members(queries.size());
+  sfhash_hashset_group_lookup_bulk(
+    grp.get(), 0, queries.data(), queries.size(), members.data()
+  );
+  sfhash_hashset_group_lookup(grp.get(), 0, queries[0].data(), members.data());
+
+  sfhash_hashset_stats_enable(false);
+
+  SFHASH_HashsetLookupStats stats;
+  sfhash_hashset_group_stats(grp.get(), 0, &stats);
+
+  CHECK(stats.lookups == 1001);
+  CHECK(stats.hits == 501);
+  CHECK(stats.misses == 500);
+  // a 0.5% false positive rate leaves nearly all misses to the filter
+  CHECK(stats.rejections > 450);
+  CHECK(stats.probes >= stats.hits);
+
+  sfhash_hashset_group_stats_reset(grp.get(), 0);
+  sfhash_hashset_group_stats(grp.get(), 0, &stats);
+  CHECK(stats.lookups == 0);
+}
@@ -0,0 +1,344 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "util.h"
+
+#include "hasher/hashset.h"
+#include "hashset/hset_layers.h"
+
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+TEST_CASE("layer_manifest_round_trip") {
+  const LayerManifest m{
+    {
+      { SFHASH_MD5, 16, "md5" },
+      { SFHASH_SHA_1, 20, "sha1" }
+    },
+    { "base.hset", "dir/delta 1.hset" }
+  };
+
+  std::stringstream s;
+  write_layer_manifest(m, s);
+
+  const auto act = read_layer_manifest(s);
+
+  CHECK(act.types.size() == 2);
+  CHECK(act.layers == m.layers);
+}
+
+TEST_CASE("layer_manifest_bad") {
+  for (const char* bad: {
+    "not-layers 1\ntype 2 20 sha1\nlayer a.hset\n",
+    "hasher-layers 1\ntype 2 20 sha1\n",
+    "hasher-layers 1\ntype 2 20 sha1\nlayer\n",
+    "hasher-layers 1\ntype 2 20 sha1\nshard 0 10 a.hset\n"
+  }) {
+    INFO(bad);
+    std::istringstream in(bad);
+    CHECK_THROWS(read_layer_manifest(in));
+  }
+}
+
+using LayerRecord = std::array<uint8_t, 1 + 16 + 1 + 20>;
+
+std::vector<LayerRecord> make_layer_records(size_t count, std::mt19937& rng) {
+  std::vector<LayerRecord> recs(count);
+  for (auto& r: recs) {
+    std::generate(r.begin(), r.end(), std::ref(rng));
+    r[0] = 1;
+    // some without a SHA-1
+    r[17] = rng() % 4 != 0;
+    if (!r[17]) {
+      std::fill(r.begin() + 18, r.end(), 0);
+    }
+  }
+  return recs;
+}
+
+void write_layer_base(
+  const std::string& path,
+  const std::vector<LayerRecord>& recs,
+  bool with_records = true)
+{
+  const SFHASH_HashAlgorithm htypes[] = { SFHASH_MD5, SFHASH_SHA_1 };
+
+  SFHASH_Error* err = nullptr;
+  auto bctx = make_unique_del(
+    sfhash_hashset_builder_open(
+      "layers", "base and deltas", htypes, 2, with_records, true,
+      path.c_str(), "test", &err
+    ),
+    sfhash_hashset_builder_destroy
+  );
+  REQUIRE(!err);
+
+  sfhash_hashset_builder_add_records(bctx.get(), recs.data(), recs.size(), &err);
+  REQUIRE(!err);
+  sfhash_hashset_builder_write(bctx.get(), &err);
+  REQUIRE(!err);
+}
+
+void check_layer_lookups(
+  const std::string& manifest,
+  const std::vector<LayerRecord>& recs,
+  size_t layer_count)
+{
+  SFHASH_Error* err = nullptr;
+  auto layers = make_unique_del(
+    sfhash_open_hashset_layers(manifest.c_str(), 0, &err),
+    sfhash_destroy_hashset_layers
+  );
+  if (err) {
+    FAIL(err->message);
+  }
+  REQUIRE(layers);
+
+  CHECK(sfhash_hashset_layers_count(layers.get()) == layer_count);
+
+  const int md5_idx = sfhash_hashset_layers_index_for_type(layers.get(), SFHASH_MD5);
+  REQUIRE(md5_idx == 0);
+  CHECK(sfhash_hashset_layers_index_for_type(layers.get(), SFHASH_SHA_1) == 1);
+  CHECK(sfhash_hashset_layers_index_for_type(layers.get(), SFHASH_SHA_2_256) == -1);
+
+  // half hits, half misses
+  std::set<std::array<uint8_t, 16>> present;
+  std::vector<std::array<uint8_t, 16>> queries;
+  for (const auto& r: recs) {
+    std::array<uint8_t, 16> h;
+    std::copy(r.begin() + 1, r.begin() + 17, h.begin());
+    present.insert(h);
+    queries.push_back(h);
+    h[15] ^= 0x01;
+    queries.push_back(h);
+  }
+
+  std::unique_ptr<bool[]> results(new bool[queries.size()]);
+  sfhash_hashset_layers_lookup_bulk(
+    layers.get(), md5_idx, queries.data(), queries.size(), results.get(), &err
+  );
+  REQUIRE(!err);
+
+  for (size_t i = 0; i < queries.size(); ++i) {
+    const bool exp = present.count(queries[i]);
+    CHECK(sfhash_hashset_layers_lookup(layers.get(), md5_idx, queries[i].data()) == exp);
+    CHECK(results[i] == exp);
+  }
+
+  // the SHA-1s present are found
+  for (const auto& r: recs) {
+    if (r[17]) {
+      CHECK(sfhash_hashset_layers_lookup(layers.get(), 1, r.data() + 18));
+    }
+  }
+}
+
+TEST_CASE("hset_layers_append_and_compact") {
+  const std::string manifest = "test/layers.manifest";
+
+  std::mt19937 rng(17);
+  auto recs = make_layer_records(4000, rng);
+
+  write_layer_base("test/layers_base.hset", recs);
+
+  SFHASH_Error* err = nullptr;
+  sfhash_hashset_layers_create(manifest.c_str(), "test/layers_base.hset", &err);
+  if (err) {
+    FAIL(err->message);
+  }
+
+  check_layer_lookups(manifest, recs, 1);
+
+  // two deltas, the second repeating some of the base
+  for (size_t i = 0; i < 2; ++i) {
+    auto delta = make_layer_records(300, rng);
+    if (i == 1) {
+      delta.insert(delta.end(), recs.begin(), recs.begin() + 50);
+    }
+
+    const std::string dpath = "test/layers_delta_" + std::to_string(i) + ".hset";
+    sfhash_hashset_layers_append(
+      manifest.c_str(), delta.data(), delta.size(), dpath.c_str(), "test",
+      i == 1 ? SFHASH_HASHSET_BUILD_COMPRESSED : 0, &err
+    );
+    if (err) {
+      FAIL(err->message);
+    }
+
+    // a delta holds its own hashes only
+    auto d = make_unique_del(
+      sfhash_open_hashset(dpath.c_str(), 0, &err),
+      sfhash_destroy_hashset
+    );
+    REQUIRE(!err);
+    CHECK(sfhash_hashset_count(d.get(), 0) == delta.size());
+
+    recs.insert(recs.end(), delta.begin(), delta.end());
+  }
+
+  check_layer_lookups(manifest, recs, 3);
+
+  sfhash_hashset_layers_compact(
+    manifest.c_str(), "test/layers_compact.hset", "test", 0, &err
+  );
+  if (err) {
+    FAIL(err->message);
+  }
+
+  check_layer_lookups(manifest, recs, 1);
+
+  // the duplicates are merged
+  auto c = make_unique_del(
+    sfhash_open_hashset("test/layers_compact.hset", 0, &err),
+    sfhash_destroy_hashset
+  );
+  REQUIRE(!err);
+  CHECK(sfhash_hashset_count(c.get(), 0) == recs.size() - 50);
+
+  // the base's records are kept
+  for (size_t i = 0; i < 4000; i += 97) {
+    const auto r = sfhash_hashset_records_lookup(c.get(), 0, recs[i].data() + 1);
+    REQUIRE(r.end - r.beg == 1);
+
+    const auto rec = reinterpret_cast<const uint8_t*>(
+      sfhash_hashset_record_for_hash(c.get(), 0, r.beg)
+    );
+    CHECK(std::equal(recs[i].begin(), recs[i].end(), rec));
+  }
+
+  // and a delta's hash is a record of its own
+  const auto& d = recs[4000];
+  const auto r = sfhash_hashset_records_lookup(c.get(), 0, d.data() + 1);
+  REQUIRE(r.end - r.beg == 1);
+  const auto rec = reinterpret_cast<const uint8_t*>(
+    sfhash_hashset_record_for_hash(c.get(), 0, r.beg)
+  );
+  CHECK(std::equal(d.begin(), d.begin() + 17, rec));
+  CHECK(std::all_of(rec + 17, rec + d.size(), [](uint8_t b) { return b == 0; }));
+}
+
+TEST_CASE("hset_layers_compact_hashes_only") {
+  const std::string manifest = "test/layers_hashes.manifest";
+
+  std::mt19937 rng(29);
+  auto recs = make_layer_records(500, rng);
+  const auto delta = make_layer_records(100, rng);
+
+  write_layer_base("test/layers_hashes_base.hset", recs, false);
+
+  SFHASH_Error* err = nullptr;
+  sfhash_hashset_layers_create(manifest.c_str(), "test/layers_hashes_base.hset", &err);
+  REQUIRE(!err);
+  sfhash_hashset_layers_append(
+    manifest.c_str(), delta.data(), delta.size(), "test/layers_hashes_delta.hset",
+    "test", 0, &err
+  );
+  REQUIRE(!err);
+  sfhash_hashset_layers_compact(
+    manifest.c_str(), "test/layers_hashes_compact.hset", "test", 0, &err
+  );
+  REQUIRE(!err);
+
+  recs.insert(recs.end(), delta.begin(), delta.end());
+  check_layer_lookups(manifest, recs, 1);
+
+  // a base without records makes a compacted hashset without them
+  auto c = make_unique_del(
+    sfhash_open_hashset("test/layers_hashes_compact.hset", 0, &err),
+    sfhash_destroy_hashset
+  );
+  REQUIRE(!err);
+  const auto r = sfhash_hashset_records_lookup(c.get(), 0, recs[0].data() + 1);
+  CHECK(r.beg == r.end);
+}
+
+TEST_CASE("hset_layers_compact_over_layer") {
+  const std::string manifest = "test/layers_over.manifest";
+
+  std::mt19937 rng(31);
+  auto recs = make_layer_records(500, rng);
+  const auto delta = make_layer_records(100, rng);
+
+  write_layer_base("test/layers_over_base.hset", recs);
+
+  SFHASH_Error* err = nullptr;
+  sfhash_hashset_layers_create(manifest.c_str(), "test/layers_over_base.hset", &err);
+  REQUIRE(!err);
+  sfhash_hashset_layers_append(
+    manifest.c_str(), delta.data(), delta.size(), "test/layers_over_delta.hset",
+    "test", 0, &err
+  );
+  REQUIRE(!err);
+
+  // a delta may not be built over a layer
+  for (const char* path: { "test/layers_over_base.hset", "test/layers_over_delta.hset" }) {
+    sfhash_hashset_layers_append(
+      manifest.c_str(), delta.data(), delta.size(), path, "test", 0, &err
+    );
+    REQUIRE(err);
+    sfhash_free_error(err);
+    err = nullptr;
+  }
+
+  // the base is replaced, not written while it is mapped
+  sfhash_hashset_layers_compact(
+    manifest.c_str(), "test/layers_over_base.hset", "test", 0, &err
+  );
+  if (err) {
+    FAIL(err->message);
+  }
+
+  recs.insert(recs.end(), delta.begin(), delta.end());
+  check_layer_lookups(manifest, recs, 1);
+  CHECK(!std::filesystem::exists("test/layers_over_base.hset.tmp"));
+}
+
+TEST_CASE("hset_layers_mismatched_delta") {
+  const std::string manifest = "test/layers_mismatched.manifest";
+
+  std::mt19937 rng(23);
+  write_layer_base("test/layers_mismatched.hset", make_layer_records(100, rng));
+
+  SFHASH_Error* err = nullptr;
+  sfhash_hashset_layers_create(manifest.c_str(), "test/layers_mismatched.hset", &err);
+  REQUIRE(!err);
+
+  // a layer with other types than the base's
+  {
+    const SFHASH_HashAlgorithm htypes[] = { SFHASH_SHA_1 };
+    auto bctx = make_unique_del(
+      sfhash_hashset_builder_open(
+        "other", "other types", htypes, 1, false, true,
+        "test/layers_other.hset", "test", &err
+      ),
+      sfhash_hashset_builder_destroy
+    );
+    REQUIRE(!err);
+    sfhash_hashset_builder_write(bctx.get(), &err);
+    REQUIRE(!err);
+  }
+
+  {
+    std::ofstream out(manifest, std::ios::app);
+    out << "layer layers_other.hset\n";
+  }
+
+  CHECK(!sfhash_open_hashset_layers(manifest.c_str(), 0, &err));
+  REQUIRE(err);
+  sfhash_free_error(err);
+}
+
+TEST_CASE("hset_layers_no_manifest") {
+  SFHASH_Error* err = nullptr;
+  CHECK(!sfhash_open_hashset_layers("test/no_such.manifest", 0, &err));
+  REQUIRE(err);
+  sfhash_free_error(err);
+}
@@ -0,0 +1,60 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "hashset/hset_manifest.h"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+TEST_CASE("manifest_round_trip") {
+  const std::vector<ManifestType> types{
+    { SFHASH_MD5, 16, "md5" },
+    { SFHASH_SHA_1, 20, "sha1" }
+  };
+
+  std::stringstream s;
+  write_manifest_types(types, "hasher-test", 3, s);
+  s << "entry first one\n\nentry second\n";
+
+  std::vector<std::string> entries;
+  const auto act = read_manifest(
+    s, "hasher-test", 3, "test",
+    [&entries](const std::string& kind, std::istream& ls, size_t lineno) {
+      if (kind != "entry") {
+        return false;
+      }
+
+      std::string rest;
+      std::getline(ls >> std::ws, rest);
+      entries.push_back(std::to_string(lineno) + ' ' + rest);
+      return true;
+    }
+  );
+
+  REQUIRE(act.size() == 2);
+  CHECK(act[1].hash_type == SFHASH_SHA_1);
+  CHECK(act[1].hash_length == 20);
+  CHECK(act[1].hash_name == "sha1");
+
+  // blank lines still count
+  CHECK(entries == std::vector<std::string>{ "4 first one", "6 second" });
+}
+
+TEST_CASE("manifest_bad") {
+  for (const char* bad: {
+    "",
+    "not-test 1\ntype 2 20 sha1\n",
+    "hasher-test 2\ntype 2 20 sha1\n",
+    "hasher-test 1\n",
+    "hasher-test 1\ntype 2 x sha1\n",
+    "hasher-test 1\ntype 2 0 sha1\n",
+    "hasher-test 1\ntype 2 20 sha1\nfoo\n"
+  }) {
+    INFO(bad);
+    std::istringstream in(bad);
+    CHECK_THROWS(read_manifest(
+      in, "hasher-test", 1, "test",
+      [](const std::string&, std::istream&, size_t) { return false; }
+    ));
+  }
+}
@@ -5,14 +5,22 @@
 #include "hex.h"
 #include "util.h"
 #include "hasher/hashset.h"
+#include "hashset/hint_select.h"
+#include "hashset/hset_decoder.h"
 #include "hashset/hset.h"
 #include "hashset/hset_encoder.h"
+#include "hashset/range_ls.h"
 
+#include <algorithm>
+#include <array>
 #include <cstring>
 #include <iostream>
 #include <fstream>
+#include <memory>
+#include <random>
 #include <sstream>
 #include <string>
+#include <vector>
 
 TEST_CASE("hset_round_trip") {
   const std::string hsetfile = "test/sha1.hset";
@@ -56,9 +64,20 @@ TEST_CASE("hset_round_trip") {
 
   REQUIRE(hset);
 
+  // the FHDR alone is as in the whole
+  CHECK(decode_hset_fhdr(
+    reinterpret_cast<const uint8_t*>(beg), reinterpret_cast<const uint8_t*>(end)
+  ) == hset->holder.fhdr);
+
   const auto tidx = sfhash_hashset_index_for_type(hset.get(), SFHASH_SHA_1);
   REQUIRE(tidx == 0);
 
+  // too few hashes for blocks to pay, so lookups are windowed by a range
+  CHECK(std::get<HashsetHint>(hset->holder.hsets[tidx]).hint_type == 0x5200);
+  CHECK(dynamic_cast<const RangeLookupStrategy<20>*>(
+    std::get<std::unique_ptr<LookupStrategy>>(hset->holder.hsets[tidx]).get()
+  ));
+
   in.str(s);
 
   std::string line;
@@ -74,10 +93,101 @@ TEST_CASE("hset_round_trip") {
   }
 }
 
+void check_hint_selection_round_trip(bool with_records) {
+  const std::string hsetfile = "test/random_sha1.hset";
+
+  // enough hashes for a hint with blocks
+  std::mt19937 rng(with_records);
+  std::vector<std::array<uint8_t, 20>> hashes(100000);
+  std::ostringstream lines;
+  for (auto& h: hashes) {
+    for (auto& b: h) {
+      b = rng();
+    }
+    lines << to_hex(h) << '\n';
+  }
+
+  {
+    std::istringstream in(lines.str());
+    const std::vector<SFHASH_HashAlgorithm> htypes{ SFHASH_SHA_1 };
+
+    write_hset(
+      in,
+      htypes,
+      make_text_converters(htypes),
+      "Hints",
+      "Enough hashes for blocks",
+      hsetfile,
+      "test",
+      with_records,
+      true,
+      SFHASH_HASHSET_BUILD_CHECKSUMS
+    );
+  }
+
+  const auto hsf = read_file(hsetfile);
+
+  SFHASH_Error* err = nullptr;
+
+  auto hset = make_unique_del(
+    sfhash_load_hashset(hsf.data(), hsf.data() + hsf.size(), &err),
+    sfhash_destroy_hashset
+  );
+
+  CHECK(!err);
+  if (err) {
+    FAIL(err->message);
+  }
+
+  REQUIRE(hset);
+
+  // the room left by a smaller hint than the largest is checksummed too
+  sfhash_hashset_verify(hset.get(), 1, nullptr, &err);
+  CHECK(!err);
+
+  const auto tidx = sfhash_hashset_index_for_type(hset.get(), SFHASH_SHA_1);
+  REQUIRE(tidx == 0);
+
+  const auto& hnt = std::get<HashsetHint>(hset->holder.hsets[tidx]);
+  const auto kind = hint_kind(hnt.hint_type);
+  CHECK((kind == HintType::BLOCK || kind == HintType::BLOCK_LINEAR));
+  CHECK(hint_block_bits(hnt.hint_type) <= max_hint_block_bits(hashes.size()));
+  CHECK(
+    static_cast<const uint8_t*>(hnt.end) - static_cast<const uint8_t*>(hnt.beg) + 2 ==
+    static_cast<ptrdiff_t>(hint_data_length(hnt.hint_type))
+  );
+
+  const auto handle = sfhash_hashset_lookup_handle(hset.get(), tidx);
+  CHECK(handle.hash_length == 20);
+
+  for (auto& h: hashes) {
+    CHECK(sfhash_hashset_lookup(hset.get(), tidx, h.data()));
+    CHECK(handle.lookup(handle.ctx, h.data()));
+    h[19] ^= 0x01;
+    CHECK(!sfhash_hashset_lookup(hset.get(), tidx, h.data()));
+    CHECK(!handle.lookup(handle.ctx, h.data()));
+  }
+
+  std::unique_ptr<bool[]> results(new bool[hashes.size()]);
+  handle.lookup_bulk(handle.ctx, hashes.data(), hashes.size(), results.get());
+  CHECK(std::none_of(results.get(), results.get() + hashes.size(), [](bool b) { return b; }));
+}
+
+TEST_CASE("hset_hint_selection_round_trip_records") {
+  check_hint_selection_round_trip(true);
+}
+
+TEST_CASE("hset_hint_selection_round_trip_hashsets_only") {
+  check_hint_selection_round_trip(false);
+}
+
 auto read_hset(
   const std::string& inpath,
   const std::vector<SFHASH_HashAlgorithm>& hash_types,
-  const std::string& outpath)
+  const std::string& outpath,
+  bool with_records = true,
+  bool with_hashsets = true,
+  uint32_t flags = 0)
 {
   {
     std::ifstream in(inpath);
@@ -90,8 +200,9 @@ auto read_hset(
       "Do not adjust your hashset. This is only a test.",
       outpath,
       "test",
-      true,
-      true
+      with_records,
+      with_hashsets,
+      flags
     );
   }
 
@@ -434,3 +545,153 @@ TEST_CASE("hset_difference_round_trip") {
               << to_hex(br, br + rlen) << '\n'
               << to_hex(cr, cr + rlen) << "\n\n";
 */
+
+TEST_CASE("hset_records_lookup_round_trip") {
+  auto [buf, h] = read_hset(
+    "test/md5_sha1_a",
+    { SFHASH_MD5, SFHASH_SHA_1 },
+    "test/records_lookup.hset"
+  );
+
+  const auto md5_idx = sfhash_hashset_index_for_type(h.get(), SFHASH_MD5);
+  REQUIRE(md5_idx != -1);
+
+  const auto md5_off = sfhash_hashset_record_field_index_for_type(h.get(), SFHASH_MD5);
+  const auto sha1_off = sfhash_hashset_record_field_index_for_type(h.get(), SFHASH_SHA_1);
+  REQUIRE(md5_off != -1);
+  REQUIRE(sha1_off != -1);
+
+  std::ifstream in("test/md5_sha1_a");
+  std::vector<std::array<uint8_t, 16>> md5s;
+
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.empty()) {
+      continue;
+    }
+
+    const auto md5 = to_bytes<16>(line.c_str());
+    const auto sha1 = to_bytes<20>(line.c_str() + 33);
+    md5s.push_back(md5);
+
+    // some record for the MD5 has this line's SHA1
+    const auto [beg, end] = sfhash_hashset_records_lookup(h.get(), md5_idx, md5.data());
+    REQUIRE(beg < end);
+
+    bool found = false;
+    for (auto i = beg; i != end; ++i) {
+      const auto r = sfhash_hashset_record_for_hash(h.get(), md5_idx, i);
+      const auto mf = static_cast<const uint8_t*>(sfhash_hashset_record_field(r, md5_off));
+      const auto sf = static_cast<const uint8_t*>(sfhash_hashset_record_field(r, sha1_off));
+      CHECK(!std::memcmp(mf + 1, md5.data(), 16));
+      found |= !std::memcmp(sf + 1, sha1.data(), 20);
+    }
+    CHECK(found);
+  }
+
+  SFHASH_Error* err = nullptr;
+  const auto m = make_unique_del(
+    sfhash_hashset_records_lookup_bulk(
+      h.get(), md5_idx, md5s.data(), md5s.size(), &err
+    ),
+    sfhash_hashset_record_matches_destroy
+  );
+
+  REQUIRE(!err);
+  REQUIRE(m);
+
+  const auto n = sfhash_hashset_record_matches_count(m.get());
+  const auto ms = sfhash_hashset_record_matches(m.get());
+  CHECK(n >= md5s.size());
+
+  for (size_t i = 0; i < n; ++i) {
+    if (i > 0) {
+      CHECK(ms[i-1].record_index <= ms[i].record_index);
+    }
+
+    const auto r = sfhash_hashset_record(h.get(), ms[i].record_index);
+    const auto mf = static_cast<const uint8_t*>(sfhash_hashset_record_field(r, md5_off));
+    CHECK(!std::memcmp(mf + 1, md5s[ms[i].hash_index].data(), 16));
+  }
+}
+
+TEST_CASE("hset_checksums_round_trip") {
+  const std::pair<bool, bool> modes[] = {
+    { true, true },
+    { true, false },
+    { false, true }
+  };
+
+  for (const auto& [with_records, with_hashsets]: modes) {
+    auto [buf, h] = read_hset(
+      "test/md5_sha1_a",
+      { SFHASH_MD5, SFHASH_SHA_1 },
+      "test/checksums.hset",
+      with_records,
+      with_hashsets,
+      SFHASH_HASHSET_BUILD_CHECKSUMS
+    );
+
+    CHECK(h->holder.fhdr.version == 3);
+    REQUIRE(h->holder.csum.beg);
+
+    SFHASH_Error* err = nullptr;
+    SFHASH_HashsetVerifyStats stats{0, 0.0};
+
+    for (const unsigned int threads: { 1u, 4u }) {
+      sfhash_hashset_verify(h.get(), threads, &stats, &err);
+      CHECK(!err);
+      if (err) {
+        FAIL(err->message);
+      }
+
+      // everything but the magic, the hash, the CSUM, and the FEND
+      CHECK(stats.bytes == static_cast<uint64_t>(
+        static_cast<const char*>(h->holder.csum.beg) - 22 - buf.data() - 40
+      ));
+    }
+  }
+}
+
+TEST_CASE("hset_checksums_damaged") {
+  auto [buf, h] = read_hset(
+    "test/md5_sha1_a",
+    { SFHASH_MD5, SFHASH_SHA_1 },
+    "test/checksums.hset",
+    true,
+    true,
+    SFHASH_HASHSET_BUILD_CHECKSUMS
+  );
+
+  const auto md5_idx = sfhash_hashset_index_for_type(h.get(), SFHASH_MD5);
+  const auto sha1_idx = sfhash_hashset_index_for_type(h.get(), SFHASH_SHA_1);
+  REQUIRE(md5_idx != -1);
+  REQUIRE(sha1_idx != -1);
+
+  // damage a SHA1 hash
+  auto hdat = static_cast<const char*>(
+    std::get<ConstHashsetData>(h->holder.hsets[sha1_idx]).beg
+  );
+  buf[hdat - buf.data() + 5] ^= 0x40;
+
+  SFHASH_Error* err = nullptr;
+
+  sfhash_hashset_verify(h.get(), 4, nullptr, &err);
+  REQUIRE(err);
+  CHECK(std::string(err->message).find("HDAT") != std::string::npos);
+  sfhash_free_error(err);
+  err = nullptr;
+
+  // the MD5s are still good
+  SFHASH_HashsetVerifyStats stats{0, 0.0};
+  sfhash_hashset_verify_hashset(h.get(), md5_idx, 4, &stats, &err);
+  CHECK(!err);
+  if (err) {
+    FAIL(err->message);
+  }
+  CHECK(stats.bytes > 0);
+
+  sfhash_hashset_verify_hashset(h.get(), sha1_idx, 4, nullptr, &err);
+  REQUIRE(err);
+  sfhash_free_error(err);
+}
@@ -0,0 +1,251 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "hex.h"
+#include "util.h"
+
+#include "hasher/hashset.h"
+#include "hashset/hset_encoder.h"
+#include "hashset/hset_shards.h"
+
+#include <array>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+TEST_CASE("shard_range_first") {
+  CHECK(shard_range_first(0, 1) == 0);
+  CHECK(shard_range_first(0, 4) == 0);
+  CHECK(shard_range_first(1, 4) == 0x4000000000000000);
+  CHECK(shard_range_first(3, 4) == 0xC000000000000000);
+  CHECK(shard_range_first(1, 3) == 0x5555555555555555);
+}
+
+TEST_CASE("shard_manifest_round_trip") {
+  const ShardManifest m{
+    {
+      { SFHASH_MD5, 16, "md5" },
+      { SFHASH_SHA_1, 20, "sha1" }
+    },
+    {
+      { 0x0000000000000000, 0x7FFFFFFFFFFFFFFF, "a.hset" },
+      { 0x9000000000000000, 0xFFFFFFFFFFFFFFFF, "dir/b c.hset" }
+    }
+  };
+
+  std::stringstream s;
+  write_shard_manifest(m, s);
+
+  const auto act = read_shard_manifest(s);
+
+  CHECK(act.types.size() == 2);
+
+  REQUIRE(act.shards.size() == 2);
+  CHECK(act.shards[1].first == 0x9000000000000000);
+  CHECK(act.shards[1].last == 0xFFFFFFFFFFFFFFFF);
+  CHECK(act.shards[1].path == "dir/b c.hset");
+
+  CHECK(shard_for_prefix(act, 0) == 0);
+  CHECK(shard_for_prefix(act, 0x7FFFFFFFFFFFFFFF) == 0);
+  // a gap between shards is covered by neither
+  CHECK(shard_for_prefix(act, 0x8000000000000000) == -1);
+  CHECK(shard_for_prefix(act, 0x9000000000000000) == 1);
+  CHECK(shard_for_prefix(act, 0xFFFFFFFFFFFFFFFF) == 1);
+}
+
+TEST_CASE("shard_manifest_bad") {
+  for (const char* bad: {
+    "not-shards 1\ntype 2 20 sha1\n",
+    "hasher-shards 1\ntype 2 20 sha1\nshard 10 0 a.hset\n",
+    "hasher-shards 1\ntype 2 20 sha1\nshard 0 10 a.hset\nshard 10 20 b.hset\n",
+    "hasher-shards 1\ntype 2 20 sha1\nshard 0 10\n",
+    "hasher-shards 1\ntype 2 20 sha1\nfoo\n"
+  }) {
+    INFO(bad);
+    std::istringstream in(bad);
+    CHECK_THROWS(read_shard_manifest(in));
+  }
+}
+
+void check_shards_round_trip(size_t shard_count, uint32_t flags) {
+  const std::string hsetfile = "test/shards_src.hset";
+  const std::string manifest = "test/shards_" + std::to_string(shard_count) + ".manifest";
+
+  std::mt19937 rng(shard_count);
+  std::vector<std::array<uint8_t, 16>> md5s(5000);
+  std::vector<std::array<uint8_t, 20>> sha1s(5000);
+  std::ostringstream lines;
+  for (size_t i = 0; i < md5s.size(); ++i) {
+    for (auto& b: md5s[i]) {
+      b = rng();
+    }
+    for (auto& b: sha1s[i]) {
+      b = rng();
+    }
+    lines << to_hex(md5s[i]) << ' ' << to_hex(sha1s[i]) << '\n';
+  }
+
+  {
+    std::istringstream in(lines.str());
+    const std::vector<SFHASH_HashAlgorithm> htypes{ SFHASH_MD5, SFHASH_SHA_1 };
+
+    write_hset(
+      in,
+      htypes,
+      make_text_converters(htypes),
+      "Shards",
+      "Split by prefix",
+      hsetfile,
+      "test",
+      false,
+      true,
+      0
+    );
+  }
+
+  SFHASH_Error* err = nullptr;
+
+  {
+    auto hset = make_unique_del(
+      sfhash_open_hashset(hsetfile.c_str(), 0, &err),
+      sfhash_destroy_hashset
+    );
+    REQUIRE(!err);
+
+    sfhash_hashset_write_shards(hset.get(), shard_count, manifest.c_str(), "test", flags, &err);
+    if (err) {
+      FAIL(err->message);
+    }
+  }
+
+  auto shards = make_unique_del(
+    sfhash_open_hashset_shards(manifest.c_str(), 0, &err),
+    sfhash_destroy_hashset_shards
+  );
+  if (err) {
+    FAIL(err->message);
+  }
+  REQUIRE(shards);
+
+  CHECK(sfhash_hashset_shards_count(shards.get()) == shard_count);
+  // nothing is mapped until a lookup needs it
+  CHECK(sfhash_hashset_shards_open_count(shards.get()) == 0);
+
+  const int md5_idx = sfhash_hashset_shards_index_for_type(shards.get(), SFHASH_MD5);
+  const int sha1_idx = sfhash_hashset_shards_index_for_type(shards.get(), SFHASH_SHA_1);
+  REQUIRE(md5_idx == 0);
+  REQUIRE(sha1_idx == 1);
+  CHECK(sfhash_hashset_shards_index_for_type(shards.get(), SFHASH_SHA_2_256) == -1);
+
+  CHECK(sfhash_hashset_shards_lookup(shards.get(), sha1_idx, sha1s[0].data(), &err));
+  CHECK(!err);
+  CHECK(sfhash_hashset_shards_open_count(shards.get()) == 1);
+
+  // every hash is in its shard and no other
+  uint64_t total = 0;
+  for (size_t i = 0; i < shard_count; ++i) {
+    const auto shard = sfhash_hashset_shards_shard(shards.get(), i, &err);
+    REQUIRE(!err);
+    REQUIRE(shard);
+    total += sfhash_hashset_count(shard, sha1_idx);
+  }
+  CHECK(total == sha1s.size());
+
+  for (const auto& h: sha1s) {
+    const int si = sfhash_hashset_shards_shard_for_hash(shards.get(), sha1_idx, h.data());
+    REQUIRE(si != -1);
+    CHECK(sfhash_hashset_lookup(sfhash_hashset_shards_shard(shards.get(), si, &err), sha1_idx, h.data()));
+  }
+
+  // half hits, half misses
+  std::vector<std::array<uint8_t, 16>> queries;
+  std::set<std::array<uint8_t, 16>> present(md5s.begin(), md5s.end());
+  for (const auto& h: md5s) {
+    queries.push_back(h);
+    auto m = h;
+    m[15] ^= 0x01;
+    if (!present.count(m)) {
+      queries.push_back(m);
+    }
+  }
+
+  std::unique_ptr<bool[]> results(new bool[queries.size()]);
+  sfhash_hashset_shards_lookup_bulk(
+    shards.get(), md5_idx, queries.data(), queries.size(), results.get(), &err
+  );
+  CHECK(!err);
+
+  for (size_t i = 0; i < queries.size(); ++i) {
+    const bool exp = present.count(queries[i]);
+    CHECK(sfhash_hashset_shards_lookup(shards.get(), md5_idx, queries[i].data(), &err) == exp);
+    CHECK(results[i] == exp);
+  }
+
+  // a batch within one shard
+  sfhash_hashset_shards_lookup_bulk(
+    shards.get(), md5_idx, queries.data(), 1, results.get(), &err
+  );
+  CHECK(results[0]);
+}
+
+TEST_CASE("hset_shards_round_trip") {
+  check_shards_round_trip(1, 0);
+  check_shards_round_trip(8, 0);
+  check_shards_round_trip(8, SFHASH_HASHSET_BUILD_COMPRESSED);
+}
+
+TEST_CASE("hset_shards_missing_shard") {
+  const std::string manifest = "test/shards_missing.manifest";
+  {
+    std::ofstream out(manifest);
+    out << "hasher-shards 1\n"
+           "type 2 20 sha1\n"
+           "shard 0000000000000000 ffffffffffffffff shards_missing.0.hset\n";
+  }
+
+  SFHASH_Error* err = nullptr;
+  auto shards = make_unique_del(
+    sfhash_open_hashset_shards(manifest.c_str(), 0, &err),
+    sfhash_destroy_hashset_shards
+  );
+  REQUIRE(!err);
+  REQUIRE(shards);
+
+  const std::array<uint8_t, 20> h{};
+  CHECK(!sfhash_hashset_shards_lookup(shards.get(), 0, h.data(), &err));
+  REQUIRE(err);
+  sfhash_free_error(err);
+  err = nullptr;
+
+  bool r;
+  sfhash_hashset_shards_lookup_bulk(shards.get(), 0, h.data(), 1, &r, &err);
+  REQUIRE(err);
+  sfhash_free_error(err);
+
+  CHECK(sfhash_hashset_shards_open_count(shards.get()) == 0);
+}
+
+TEST_CASE("hset_shards_manifest_is_not_hset") {
+  const std::string manifest = "test/shards_not_hset.manifest";
+  {
+    std::ofstream out(manifest);
+    out << "hasher-shards 1\n"
+           "type 2 20 sha1\n";
+  }
+
+  SFHASH_Error* err = nullptr;
+  CHECK(!sfhash_open_hashset(manifest.c_str(), 0, &err));
+  REQUIRE(err);
+  CHECK(std::string(err->message).find("sfhash_open_hashset_shards") != std::string::npos);
+  sfhash_free_error(err);
+}
+
+TEST_CASE("hset_shards_no_manifest") {
+  SFHASH_Error* err = nullptr;
+  CHECK(!sfhash_open_hashset_shards("test/no_such.manifest", 0, &err));
+  REQUIRE(err);
+  sfhash_free_error(err);
+}
@@ -0,0 +1,79 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "hashset/hset_verify.h"
+
+#include <array>
+#include <vector>
+
+TEST_CASE("checksum_segments") {
+  const TableOfContents toc{
+    {
+      { 40, Chunk::Type::FTOC },
+      { 100, Chunk::Type::FHDR },
+      { 100, Chunk::Type::HHDR | 0x0001 },
+      { 4096, Chunk::Type::HDAT },
+      { 4096 + 2500, Chunk::Type::CSUM },
+      { 9000, Chunk::Type::FEND }
+    }
+  };
+
+  const std::vector<std::array<uint64_t, 4>> exp{
+    { 40, 60, 0, 0 },
+    { 100, 0, 1, 1 },
+    { 100, 1000, 2, 2 },
+    { 1100, 1000, 2, 3 },
+    { 2100, 1000, 2, 4 },
+    { 3100, 996, 2, 5 },
+    { 4096, 1000, 3, 6 },
+    { 5096, 1000, 3, 7 },
+    { 6096, 500, 3, 8 }
+  };
+
+  const auto segs = checksum_segments(toc, 1000);
+  REQUIRE(segs.size() == exp.size());
+
+  for (size_t i = 0; i < exp.size(); ++i) {
+    CHECK(segs[i].off == exp[i][0]);
+    CHECK(segs[i].len == exp[i][1]);
+    CHECK(segs[i].entry == exp[i][2]);
+    CHECK(segs[i].digest == exp[i][3]);
+  }
+}
+
+TEST_CASE("checksum_segments_no_csum") {
+  const TableOfContents toc{
+    {
+      { 40, Chunk::Type::FTOC },
+      { 100, Chunk::Type::FHDR },
+      { 200, Chunk::Type::FEND }
+    }
+  };
+
+  CHECK_THROWS(checksum_segments(toc, 1000));
+}
+
+TEST_CASE("compute_verify_checksums") {
+  std::vector<uint8_t> buf(10000);
+  for (size_t i = 0; i < buf.size(); ++i) {
+    buf[i] = i * 7;
+  }
+
+  const TableOfContents toc{
+    {
+      { 0, Chunk::Type::FTOC },
+      { 3000, Chunk::Type::HDAT },
+      { 10000, Chunk::Type::CSUM }
+    }
+  };
+
+  const auto segs = checksum_segments(toc, 1024);
+  std::vector<uint8_t> digests(segs.size() * CSUM_DIGEST_LENGTH);
+
+  compute_checksums(buf.data(), segs, digests.data(), 3);
+  CHECK(verify_checksums(buf.data(), segs, digests.data(), 3) == segs.size());
+
+  // damage two segments; the first is reported
+  buf[5000] ^= 1;
+  buf[9000] ^= 1;
+  CHECK(verify_checksums(buf.data(), segs, digests.data(), 3) == 4);
+}
@@ -0,0 +1,389 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "hashset/basic_ls.h"
+#include "hashset/block_ls.h"
+#include "hashset/block_linear_ls.h"
+#include "hashset/hset_encoder_chunks.h"
+#include "hashset/merge_lookup.h"
+#include "hashset/perfect_hash.h"
+#include "hashset/perfect_hash_ls.h"
+#include "hashset/radius_ls.h"
+#include "hashset/range_ls.h"
+#include "hashset/util.h"
+
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+template <size_t HashLength>
+using Hashes = std::vector<std::array<uint8_t, HashLength>>;
+
+template <size_t HashLength>
+Hashes<HashLength> make_hashes(std::mt19937& rng, size_t count) {
+  Hashes<HashLength> hashes(count);
+  for (auto& h: hashes) {
+    for (auto& b: h) {
+      b = rng();
+    }
+  }
+  return hashes;
+}
+
+template <size_t HashLength>
+std::pair<int64_t, int64_t> deltas(const Hashes<HashLength>& hashes, size_t i) {
+  const int64_t e = expected_index(hashes[i].data(), hashes.size());
+  return { hashes[i][0], static_cast<int64_t>(i) - e };
+}
+
+template <size_t HashLength>
+std::vector<std::pair<std::string, std::unique_ptr<LookupStrategy>>> make_strategies(
+  const Hashes<HashLength>& hashes,
+  std::vector<char>& hidx)
+{
+  const auto beg = hashes.data();
+  const auto end = hashes.data() + hashes.size();
+
+  int64_t left = 0, right = 0;
+  std::array<std::pair<int64_t, int64_t>, 256> blocks;
+  blocks.fill({
+    std::numeric_limits<int64_t>::max(),
+    std::numeric_limits<int64_t>::min()
+  });
+
+  for (size_t i = 0; i < hashes.size(); ++i) {
+    const auto [bi, d] = deltas(hashes, i);
+    left = std::min(left, d);
+    right = std::max(right, d);
+    blocks[bi].first = std::min(blocks[bi].first, d);
+    blocks[bi].second = std::max(blocks[bi].second, d);
+  }
+
+  // lines with zero slope through each block's bounds
+  std::array<std::tuple<float, float, float, float>, 16> lines;
+  for (size_t b = 0; b < 16; ++b) {
+    lines[b] = { 0.0f, static_cast<float>(left), 0.0f, static_cast<float>(right) };
+  }
+
+  const auto b = reinterpret_cast<const uint8_t*>(beg);
+  const auto e = reinterpret_cast<const uint8_t*>(end);
+  const auto phd = make_perfect_hash(b, e, HashLength);
+  hidx.resize(length_hidx_data(phd.key_count));
+  hidx.resize(write_hidx_data(phd, hidx.data()));
+
+  std::vector<std::pair<std::string, std::unique_ptr<LookupStrategy>>> strats;
+  strats.emplace_back("basic", new BasicLookupStrategy<HashLength>(beg, end));
+  strats.emplace_back("radius", new RadiusLookupStrategy<HashLength>(beg, end, std::max(-left, right)));
+  strats.emplace_back("range", new RangeLookupStrategy<HashLength>(beg, end, left, right));
+  strats.emplace_back("block", new BlockLookupStrategy<HashLength, 8>(beg, end, blocks));
+  strats.emplace_back("blinear", new BlockLinearLookupStrategy<HashLength, 4>(beg, end, lines));
+  strats.emplace_back(
+    "blinear fitted",
+    new BlockLinearLookupStrategy<HashLength, 8>(
+      beg, end,
+      make_linear_blocks<8>(
+        reinterpret_cast<const uint8_t*>(beg), hashes.size(), HashLength
+      )
+    )
+  );
+  strats.emplace_back(
+    "perfect",
+    new PerfectHashLookupStrategy<HashLength>(
+      beg, end, PerfectHash(hidx.data() + 2, hidx.data() + hidx.size())
+    )
+  );
+  return strats;
+}
+
+template <size_t HashLength>
+void check_bulk_agrees(size_t count) {
+  std::mt19937 rng(count);
+
+  auto hashes = make_hashes<HashLength>(rng, count);
+  std::sort(hashes.begin(), hashes.end());
+
+  // a mix of present and absent hashes, not a multiple of any group size
+  auto queries = make_hashes<HashLength>(rng, 1001);
+  for (size_t i = 0; i < queries.size() && count; i += 3) {
+    queries[i] = hashes[rng() % count];
+  }
+
+  std::vector<char> hidx;
+  const auto strats = make_strategies(hashes, hidx);
+
+  for (const auto& [name, ls]: strats) {
+    INFO(name << " over " << count);
+
+    std::unique_ptr<bool[]> results(new bool[queries.size()]);
+    ls->contains_bulk(queries.front().data(), queries.size(), results.get());
+
+    // and the same through the non-virtual entry points
+    const LookupFunctions f = ls->functions();
+    std::unique_ptr<bool[]> fresults(new bool[queries.size()]);
+    f.contains_bulk(ls.get(), queries.front().data(), queries.size(), fresults.get());
+
+    for (size_t i = 0; i < queries.size(); ++i) {
+      const bool exp = std::binary_search(hashes.begin(), hashes.end(), queries[i]);
+      REQUIRE(ls->contains(queries[i].data()) == exp);
+      REQUIRE(results[i] == exp);
+      REQUIRE(f.contains(ls.get(), queries[i].data()) == exp);
+      REQUIRE(fresults[i] == exp);
+    }
+  }
+}
+
+TEST_CASE("contains_bulk_agrees_with_contains") {
+  for (size_t count: { 0, 1, 2, 17, 1000, 100000 }) {
+    check_bulk_agrees<16>(count);
+    check_bulk_agrees<20>(count);
+  }
+}
+
+template <size_t HashLength>
+void check_linear_blocks(size_t count) {
+  std::mt19937 rng(count);
+
+  auto hashes = make_hashes<HashLength>(rng, count);
+  std::sort(hashes.begin(), hashes.end());
+
+  const auto beg = hashes.data();
+  const auto end = hashes.data() + hashes.size();
+
+  std::array<std::pair<int64_t, int64_t>, 256> blocks;
+  blocks.fill({
+    std::numeric_limits<int64_t>::max(),
+    std::numeric_limits<int64_t>::min()
+  });
+
+  for (size_t i = 0; i < hashes.size(); ++i) {
+    const auto [bi, d] = deltas(hashes, i);
+    blocks[bi].first = std::min(blocks[bi].first, d);
+    blocks[bi].second = std::max(blocks[bi].second, d);
+  }
+
+  const BlockLookupStrategy<HashLength, 8> bls(beg, end, blocks);
+  const BlockLinearLookupStrategy<HashLength, 8> lls(
+    beg, end,
+    make_linear_blocks<8>(
+      reinterpret_cast<const uint8_t*>(beg), hashes.size(), HashLength
+    )
+  );
+
+  // every hash is in its window
+  for (size_t i = 0; i < hashes.size(); ++i) {
+    const auto [l, r] = lls.window(hashes[i].data());
+    REQUIRE(l <= i);
+    REQUIRE(i < r);
+  }
+
+  // the lines follow the drift which constant bounds must cover
+  const auto queries = make_hashes<HashLength>(rng, 10000);
+  size_t bw = 0, lw = 0;
+  for (const auto& q: queries) {
+    const auto [bl, br] = bls.window(q.data());
+    const auto [ll, lr] = lls.window(q.data());
+    bw += br - bl;
+    lw += lr - ll;
+  }
+
+  CHECK(lw < bw);
+}
+
+TEST_CASE("make_linear_blocks") {
+  for (size_t count: { 1000, 100000, 1000000 }) {
+    check_linear_blocks<16>(count);
+  }
+  check_linear_blocks<4>(100000);
+}
+
+TEST_CASE("fit_linear_bounds_large_offsets") {
+  // past 2^24, floats are further apart than the misses here, which once
+  // rounded away and left the lines where they were
+  const std::vector<Point<int64_t>> pts{
+    { 300000007, 0 }, { 300001007, 997 }, { 300002007, 1990 }
+  };
+
+  const auto [la, lb, ua, ub] = fit_linear_bounds(pts, pts, 300001007.0);
+
+  for (const auto& p: pts) {
+    CHECK(linear_lower(la, lb, p.x) <= p.y);
+    CHECK(p.y <= linear_upper(ua, ub, p.x));
+  }
+}
+
+TEST_CASE("contains_bulk_empty_batch") {
+  std::mt19937 rng(0);
+  auto hashes = make_hashes<8>(rng, 10);
+  std::sort(hashes.begin(), hashes.end());
+
+  std::vector<char> hidx;
+  for (const auto& [name, ls]: make_strategies(hashes, hidx)) {
+    bool r = true;
+    ls->contains_bulk(hashes.front().data(), 0, &r);
+    CHECK(r);
+  }
+}
+
+template <size_t HashLength>
+void check_merge_lookup(size_t count, size_t qcount, unsigned threads) {
+  std::mt19937 rng(count + qcount);
+
+  auto hashes = make_hashes<HashLength>(rng, count);
+  // some runs of equal hashes, as in HDAT for records sharing a hash
+  for (size_t i = 1; i < count; i += 7) {
+    hashes[i] = hashes[i - 1];
+  }
+  std::sort(hashes.begin(), hashes.end());
+
+  auto queries = make_hashes<HashLength>(rng, qcount);
+  for (size_t i = 0; i < qcount; ++i) {
+    if (count && i % 3 == 0) {
+      queries[i] = hashes[rng() % count];
+    }
+    else if (count && i % 3 == 1) {
+      // differs from a present hash only in its last byte
+      queries[i] = hashes[rng() % count];
+      queries[i][HashLength - 1] ^= 0x01;
+    }
+  }
+  // repeated queries
+  for (size_t i = 5; i < qcount; i += 11) {
+    queries[i] = queries[i - 5];
+  }
+
+  std::unique_ptr<bool[]> results(new bool[qcount]);
+  MergeLookup<HashLength>()(
+    hashes.data(), hashes.data() + hashes.size(),
+    qcount ? queries.front().data() : nullptr, qcount,
+    results.get(), threads
+  );
+
+  for (size_t i = 0; i < qcount; ++i) {
+    INFO(HashLength << " " << count << " " << qcount << " " << threads << " " << i);
+    REQUIRE(results[i] == std::binary_search(hashes.begin(), hashes.end(), queries[i]));
+  }
+}
+
+TEST_CASE("merge_lookup_agrees_with_binary_search") {
+  for (const auto& [count, qcount]: {
+    std::pair<size_t, size_t>{ 0, 0 },
+    { 0, 10 },
+    { 1, 10 },
+    { 1000, 0 },
+    { 1000, 5000 },
+    { 100000, 1000 },
+    { 10000, 100000 }
+  }) {
+    for (unsigned threads: { 1, 4 }) {
+      check_merge_lookup<4>(count, qcount, threads);
+      check_merge_lookup<8>(count, qcount, threads);
+      check_merge_lookup<20>(count, qcount, threads);
+      check_merge_lookup<64>(count, qcount, threads);
+    }
+  }
+}
+
+TEST_CASE("merge_lookup_shared_prefixes") {
+  // hashes which agree on their first 12 bytes exercise the tie sorting
+  std::vector<std::array<uint8_t, 16>> hashes(256);
+  for (size_t i = 0; i < hashes.size(); ++i) {
+    hashes[i].fill(0xAB);
+    hashes[i][15] = i;
+  }
+
+  std::vector<std::array<uint8_t, 16>> queries;
+  for (size_t i = 0; i < 300; ++i) {
+    auto q = hashes[(i * 37) % hashes.size()];
+    q[12] = i % 2 ? 0xAB : 0xAC;
+    queries.push_back(q);
+  }
+
+  std::unique_ptr<bool[]> results(new bool[queries.size()]);
+  MergeLookup<16>()(
+    hashes.data(), hashes.data() + hashes.size(),
+    queries.front().data(), queries.size(), results.get(), 2
+  );
+
+  for (size_t i = 0; i < queries.size(); ++i) {
+    CHECK(results[i] == (i % 2 == 1));
+  }
+}
+
+TEST_CASE("lookup_stats") {
+  std::mt19937 rng(7);
+
+  // few enough hashes that most blocks are empty
+  auto hashes = make_hashes<20>(rng, 17);
+  std::sort(hashes.begin(), hashes.end());
+
+  auto queries = make_hashes<20>(rng, 100);
+  for (size_t i = 0; i < queries.size(); i += 2) {
+    queries[i] = hashes[rng() % hashes.size()];
+  }
+
+  std::vector<char> hidx;
+  const auto strats = make_strategies(hashes, hidx);
+
+  std::unique_ptr<bool[]> results(new bool[queries.size()]);
+
+  // nothing is counted while counting is off
+  for (const auto& [name, ls]: strats) {
+    ls->contains(queries[0].data());
+    ls->contains_bulk(queries.front().data(), queries.size(), results.get());
+    CHECK(ls->stats().total().lookups == 0);
+  }
+
+  if (!set_lookup_stats_enabled(true)) {
+    // compiled out
+    return;
+  }
+
+  for (const auto& [name, ls]: strats) {
+    INFO(name);
+
+    for (const auto& q: queries) {
+      ls->contains(q.data());
+    }
+    ls->contains_bulk(queries.front().data(), queries.size(), results.get());
+
+    const auto c = ls->stats().total();
+    CHECK(c.lookups == 2 * queries.size());
+    CHECK(c.hits == queries.size());
+    CHECK(c.window_max <= hashes.size());
+    CHECK(c.probes >= c.hits);
+
+    if (name == "basic") {
+      // which searches everything and rejects nothing
+      CHECK(c.window_total == c.lookups * hashes.size());
+      CHECK(c.rejections == 0);
+    }
+
+    ls->stats().reset();
+    CHECK(ls->stats().total().lookups == 0);
+  }
+
+  set_lookup_stats_enabled(false);
+
+  // the block hint turns away the misses in empty blocks
+  std::vector<bool> used(256);
+  for (const auto& h: hashes) {
+    used[h[0]] = true;
+  }
+
+  const size_t exp_rej = std::count_if(
+    queries.begin(), queries.end(),
+    [&used](const auto& q) { return !used[q[0]]; }
+  );
+
+  set_lookup_stats_enabled(true);
+  const auto& block = strats[3].second;
+  block->contains_bulk(queries.front().data(), queries.size(), results.get());
+  set_lookup_stats_enabled(false);
+
+  CHECK(exp_rej > 0);
+  CHECK(block->stats().total().rejections == exp_rej);
+}
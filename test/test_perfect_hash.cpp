@@ -0,0 +1,226 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "helper.h"
+
+#include "hex.h"
+#include "util.h"
+#include "hasher/hashset.h"
+#include "hashset/hset.h"
+#include "hashset/hset_encoder.h"
+#include "hashset/hset_encoder_chunks.h"
+#include "hashset/perfect_hash.h"
+#include "hashset/perfect_hash_ls.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+template <size_t HashLength>
+std::vector<std::array<uint8_t, HashLength>> make_sorted_hashes(size_t count, unsigned seed) {
+  std::mt19937 rng(seed);
+  std::vector<std::array<uint8_t, HashLength>> hashes(count);
+  for (auto& h: hashes) {
+    for (auto& b: h) {
+      b = rng();
+    }
+  }
+  std::sort(hashes.begin(), hashes.end());
+  return hashes;
+}
+
+std::vector<char> serialize(const PerfectHashData& phd) {
+  std::vector<char> buf(length_hidx_data(phd.key_count));
+  buf.resize(write_hidx_data(phd, buf.data()));
+  return buf;
+}
+
+TEST_CASE("make_perfect_hash_is_minimal_perfect") {
+  const auto hashes = make_sorted_hashes<16>(10000, 1);
+  const auto beg = hashes.front().data();
+  const auto end = beg + hashes.size() * 16;
+
+  const PerfectHashData phd = make_perfect_hash(beg, end, 16);
+  REQUIRE(phd.key_count == hashes.size());
+  REQUIRE(phd.pilots.size() == perfect_hash_bucket_count(hashes.size()));
+
+  // the positions are a permutation of the HDAT indices
+  std::vector<uint32_t> pos(phd.positions);
+  std::sort(pos.begin(), pos.end());
+  for (uint32_t i = 0; i < pos.size(); ++i) {
+    REQUIRE(pos[i] == i);
+  }
+
+  // every hash finds its own index
+  const auto buf = serialize(phd);
+  const PerfectHash ph(buf.data() + 2, buf.data() + buf.size());
+  for (size_t i = 0; i < hashes.size(); ++i) {
+    REQUIRE(ph.position(hashes[i].data(), 16) == i);
+  }
+}
+
+TEST_CASE("make_perfect_hash_duplicates") {
+  std::vector<std::array<uint8_t, 20>> hashes;
+  for (const auto& h: make_sorted_hashes<20>(500, 2)) {
+    // three copies of each hash, as in HDAT for records sharing a hash
+    hashes.insert(hashes.end(), 3, h);
+  }
+
+  const auto beg = hashes.front().data();
+  const PerfectHashData phd = make_perfect_hash(beg, beg + hashes.size() * 20, 20);
+  REQUIRE(phd.key_count == 500);
+
+  const auto buf = serialize(phd);
+  const PerfectHash ph(buf.data() + 2, buf.data() + buf.size());
+  for (size_t i = 0; i < hashes.size(); ++i) {
+    // each hash maps to the first of its run
+    CHECK(ph.position(hashes[i].data(), 20) == i - i % 3);
+  }
+}
+
+TEST_CASE("make_perfect_hash_empty") {
+  const uint8_t* p = nullptr;
+  const PerfectHashData phd = make_perfect_hash(p, p, 8);
+  CHECK(phd.key_count == 0);
+  CHECK(phd.positions.empty());
+
+  const auto buf = serialize(phd);
+  const PerfectHash ph(buf.data() + 2, buf.data() + buf.size());
+  CHECK(ph.key_count() == 0);
+}
+
+TEST_CASE("perfect_hash_bad_table_length") {
+  const auto hashes = make_sorted_hashes<8>(100, 3);
+  const auto beg = hashes.front().data();
+  const auto buf = serialize(make_perfect_hash(beg, beg + hashes.size() * 8, 8));
+  CHECK_THROWS(PerfectHash(buf.data() + 2, buf.data() + buf.size() - 4));
+}
+
+TEST_CASE("PerfectHashLookupStrategy") {
+  const auto all = make_sorted_hashes<32>(2000, 4);
+
+  // use every other hash, so the rest are known absent
+  std::vector<std::array<uint8_t, 32>> present, absent;
+  for (size_t i = 0; i < all.size(); ++i) {
+    (i % 2 ? absent : present).push_back(all[i]);
+  }
+
+  const auto beg = present.front().data();
+  const auto end = beg + present.size() * 32;
+  const auto buf = serialize(make_perfect_hash(beg, end, 32));
+
+  const PerfectHashLookupStrategy<32> ls(
+    beg, end, PerfectHash(buf.data() + 2, buf.data() + buf.size())
+  );
+
+  for (const auto& h: present) {
+    CHECK(ls.contains(h.data()));
+  }
+
+  for (const auto& h: absent) {
+    CHECK(!ls.contains(h.data()));
+  }
+}
+
+void check_perfect_hash_round_trip(bool with_records) {
+  const std::string hsetfile = "test/sha1_ph.hset";
+
+  {
+    std::ifstream in("test/sha1");
+
+    const std::vector<SFHASH_HashAlgorithm> htypes{ SFHASH_SHA_1 };
+
+    write_hset(
+      in,
+      htypes,
+      make_text_converters(htypes),
+      "Perfect",
+      "Hashes that know their places",
+      hsetfile,
+      "test",
+      with_records,
+      true,
+      SFHASH_HASHSET_BUILD_PERFECT_HASH
+    );
+  }
+
+  const auto hsf = read_file(hsetfile);
+
+  SFHASH_Error* err = nullptr;
+
+  auto hset = make_unique_del(
+    sfhash_load_hashset(hsf.data(), hsf.data() + hsf.size(), &err),
+    sfhash_destroy_hashset
+  );
+
+  CHECK(!err);
+  if (err) {
+    FAIL(err->message);
+  }
+
+  REQUIRE(hset);
+
+  const auto tidx = sfhash_hashset_index_for_type(hset.get(), SFHASH_SHA_1);
+  REQUIRE(tidx == 0);
+
+  const auto& t = hset->holder.hsets[tidx];
+  CHECK(std::get<HashsetIndex>(t).index_type == IndexType::PERFECT_HASH);
+  CHECK(dynamic_cast<const PerfectHashLookupStrategy<20>*>(
+    std::get<std::unique_ptr<LookupStrategy>>(t).get()
+  ));
+
+  std::ifstream in("test/sha1");
+  std::string line;
+  std::set<std::array<uint8_t, 20>> seen;
+  while (std::getline(in, line)) {
+    if (line.empty()) {
+      continue;
+    }
+
+    const auto hash = to_bytes<20>(line.c_str());
+    seen.insert(hash);
+    CHECK(sfhash_hashset_lookup(hset.get(), tidx, hash.data()));
+
+    // flip a bit to get a hash which should be absent
+    auto miss = hash;
+    miss[19] ^= 0x01;
+    if (!seen.count(miss)) {
+      CHECK(!sfhash_hashset_lookup(hset.get(), tidx, miss.data()));
+    }
+  }
+}
+
+TEST_CASE("perfect_hash_round_trip_records") {
+  check_perfect_hash_round_trip(true);
+}
+
+TEST_CASE("perfect_hash_round_trip_hashsets_only") {
+  check_perfect_hash_round_trip(false);
+}
+
+TEST_CASE("hashset_builder_set_flags_too_late") {
+  const SFHASH_HashAlgorithm htypes[] = { SFHASH_MD5 };
+
+  SFHASH_Error* err = nullptr;
+
+  auto bctx = make_unique_del(
+    sfhash_hashset_builder_open(
+      "late", "flags after data", htypes, 1, true, true,
+      "test/late.hset", "test", &err
+    ),
+    sfhash_hashset_builder_destroy
+  );
+
+  REQUIRE(!err);
+
+  const auto h = to_bytes<16>("0123456789abcdef0123456789abcdef");
+  sfhash_hashset_builder_add_hash(bctx.get(), h.data(), h.size());
+
+  sfhash_hashset_builder_set_flags(bctx.get(), SFHASH_HASHSET_BUILD_PERFECT_HASH, &err);
+  CHECK(err);
+  sfhash_free_error(err);
+}
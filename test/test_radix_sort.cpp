@@ -0,0 +1,106 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "hashset/radix_sort.h"
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <tuple>
+#include <vector>
+
+// count random strings of length len, with every fifth a copy of an
+// earlier one, and with the first fixed bytes the same in all, as the
+// presence flags of records are
+std::vector<uint8_t> make_strings(size_t count, size_t len, size_t fixed) {
+  std::mt19937 rng(count + len);
+
+  std::vector<uint8_t> dat(count * len);
+  for (size_t i = 0; i < dat.size(); ++i) {
+    dat[i] = i % len < fixed ? 0x01 : rng();
+  }
+
+  for (size_t i = 5; i < count; i += 5) {
+    std::memcpy(&dat[i * len], &dat[(rng() % i) * len], len);
+  }
+
+  return dat;
+}
+
+std::vector<std::vector<uint8_t>> split(const std::vector<uint8_t>& dat, size_t len) {
+  std::vector<std::vector<uint8_t>> v;
+  for (size_t i = 0; i < dat.size(); i += len) {
+    v.emplace_back(dat.begin() + i, dat.begin() + i + len);
+  }
+  return v;
+}
+
+void check_radix_sort(size_t count, size_t len, size_t fixed, unsigned threads) {
+  INFO(count << " x " << len << " on " << threads);
+
+  auto dat = make_strings(count, len, fixed);
+
+  std::vector<std::pair<std::vector<uint8_t>, uint64_t>> exp;
+  for (size_t i = 0; i < count; ++i) {
+    exp.emplace_back(
+      std::vector<uint8_t>(dat.begin() + i * len, dat.begin() + (i + 1) * len),
+      i
+    );
+  }
+  std::sort(exp.begin(), exp.end());
+
+  // with indices
+  {
+    auto d = dat;
+    std::vector<uint64_t> idx(count);
+    for (size_t i = 0; i < count; ++i) {
+      idx[i] = i;
+    }
+
+    radix_sort(d.data(), idx.data(), count, len, threads);
+
+    const auto act = split(d, len);
+    for (size_t i = 0; i < count; ++i) {
+      REQUIRE(act[i] == exp[i].first);
+      REQUIRE(idx[i] == exp[i].second);
+    }
+  }
+
+  // deduplicated
+  {
+    auto d = dat;
+    const size_t kept = radix_sort_unique(d.data(), count, len, threads);
+
+    auto u = split(dat, len);
+    std::sort(u.begin(), u.end());
+    u.erase(std::unique(u.begin(), u.end()), u.end());
+
+    REQUIRE(kept == u.size());
+    d.resize(kept * len);
+    CHECK(split(d, len) == u);
+  }
+}
+
+TEST_CASE("radix_sort") {
+  for (size_t count: { 0, 1, 2, 100, 5000, 300000 }) {
+    for (unsigned threads: { 1, 4 }) {
+      check_radix_sort(count, 20, 0, threads);
+      check_radix_sort(count, 16, 0, threads);
+      // records, which every fixed-width sort passes by
+      check_radix_sort(count, 47, 1, threads);
+    }
+  }
+}
+
+TEST_CASE("radix_sort_all_equal") {
+  const size_t count = 100000;
+  std::vector<uint8_t> dat(count * 8, 0xAB);
+  std::vector<uint64_t> idx(count);
+  for (size_t i = 0; i < count; ++i) {
+    idx[i] = count - i;
+  }
+
+  radix_sort(dat.data(), idx.data(), count, 8, 4);
+  CHECK(std::is_sorted(idx.begin(), idx.end()));
+
+  CHECK(radix_sort_unique(dat.data(), count, 8, 4) == 1);
+}
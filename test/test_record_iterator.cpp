@@ -1,9 +1,12 @@
 #include "hashset/record_iterator.h"
 
 #include <algorithm>
+#include <array>
 #include <cstring>
 #include <iterator>
 #include <numeric>
+#include <random>
+#include <vector>
 
 #include <catch2/catch_test_macros.hpp>
 
@@ -421,3 +424,100 @@ TEST_CASE("RecordIterator_unique") {
   CHECK(!std::memcmp(dat + rlen, exp + rlen, rlen));
   CHECK(!std::memcmp(dat + 2*rlen, exp + 2*rlen, rlen));
 }
+
+// Sorts count random records of length rlen, some duplicated, and checks
+// them against a sort of copies
+void check_record_sort(size_t rlen, size_t count) {
+  std::mt19937 rng(rlen);
+
+  std::vector<uint8_t> dat(rlen * count);
+  for (auto& b: dat) {
+    b = rng();
+  }
+  for (size_t i = 0; i + 1 < count; i += 7) {
+    std::memcpy(&dat[(i + 1) * rlen], &dat[i * rlen], rlen);
+  }
+
+  std::vector<std::vector<uint8_t>> exp;
+  for (size_t i = 0; i < count; ++i) {
+    exp.emplace_back(&dat[i * rlen], &dat[(i + 1) * rlen]);
+  }
+  std::sort(exp.begin(), exp.end());
+
+  RecordIterator beg(dat.data(), rlen);
+  RecordIterator end(dat.data() + dat.size(), rlen);
+
+  std::sort(beg, end);
+
+  for (size_t i = 0; i < count; ++i) {
+    REQUIRE(!std::memcmp(&dat[i * rlen], exp[i].data(), rlen));
+  }
+}
+
+TEST_CASE("RecordIterator_sort_record_lengths") {
+  // held in the proxies when moved, and too long for that
+  check_record_sort(37, 5000);
+  check_record_sort(RECORD_PROXY_INLINE, 1000);
+  check_record_sort(RECORD_PROXY_INLINE + 53, 1000);
+}
+
+TEST_CASE("HashRecordIterator_sort") {
+  std::mt19937 rng(1);
+
+  const size_t count = 5000;
+  std::vector<std::array<uint8_t, 20>> hashes(count);
+  for (auto& h: hashes) {
+    for (auto& b: h) {
+      b = rng();
+    }
+  }
+  // equal hashes sort by index
+  hashes[10] = hashes[20] = hashes[30];
+
+  std::vector<uint64_t> idx(count);
+  std::iota(idx.begin(), idx.end(), 0);
+
+  std::vector<std::pair<std::array<uint8_t, 20>, uint64_t>> exp;
+  for (size_t i = 0; i < count; ++i) {
+    exp.emplace_back(hashes[i], i);
+  }
+  std::sort(exp.begin(), exp.end());
+
+  uint8_t* h = hashes.front().data();
+  std::sort(
+    HashRecordIterator(0, h, 20, idx.data()),
+    HashRecordIterator(count, h, 20, idx.data())
+  );
+
+  for (size_t i = 0; i < count; ++i) {
+    REQUIRE(hashes[i] == exp[i].first);
+    REQUIRE(idx[i] == exp[i].second);
+  }
+}
+
+TEST_CASE("sort_unique_hashes") {
+  std::mt19937 rng(2);
+
+  std::vector<std::array<uint8_t, 32>> hashes(3000);
+  for (auto& h: hashes) {
+    for (auto& b: h) {
+      b = rng();
+    }
+  }
+  for (size_t i = 0; i < 1000; ++i) {
+    hashes.push_back(hashes[i * 2]);
+  }
+
+  auto exp = hashes;
+  std::sort(exp.begin(), exp.end());
+  exp.erase(std::unique(exp.begin(), exp.end()), exp.end());
+
+  uint8_t* beg = hashes.front().data();
+  uint8_t* end = sort_unique_hashes(beg, beg + hashes.size() * 32, 32);
+
+  REQUIRE(static_cast<size_t>(end - beg) == exp.size() * 32);
+  CHECK(!std::memcmp(beg, exp.front().data(), end - beg));
+
+  // hash lengths are the dispatchable ones
+  CHECK_THROWS(sort_unique_hashes(beg, beg + 30, 3));
+}